@@ -0,0 +1,175 @@
+/*
+ Arena.cpp - bump allocator for short lived allocations
+ Copyright (c) 2016 Ivan Grokhotkov. All rights reserved.
+ This file is part of the esp8266 core for Arduino environment.
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pgmspace.h>
+#include "Arena.h"
+
+Arena::Arena(size_t chunkSize)
+    : _chunk(nullptr)
+    , _next(nullptr)
+    , _end(nullptr)
+    , _chunkSize(chunkSize)
+    , _used(0)
+    , _chunks(0)
+{
+}
+
+Arena::~Arena() {
+    reset();
+}
+
+void* Arena::alloc(size_t size, size_t align) {
+    // a chunk has to hold the header, the padding and size
+    if (size > SIZE_MAX - sizeof(Chunk) - align) {
+        return nullptr;
+    }
+    uint8_t* ptr = (uint8_t*) (((uintptr_t) _next + align - 1) & ~(uintptr_t) (align - 1));
+    // compare sizes, ptr + size may wrap around
+    if (!_chunk || ptr > _end || size > (size_t) (_end - ptr)) {
+        size_t chunkSize = sizeof(Chunk) + align - 1 + size;
+        if (chunkSize < _chunkSize) {
+            chunkSize = _chunkSize;
+        }
+        Chunk* chunk = (Chunk*) malloc(chunkSize);
+        if (!chunk) {
+            return nullptr;
+        }
+        chunk->next = _chunk;
+        chunk->size = chunkSize;
+        _chunk = chunk;
+        _end = (uint8_t*) chunk + chunkSize;
+        ++_chunks;
+        ptr = (uint8_t*) (((uintptr_t) (chunk + 1) + align - 1) & ~(uintptr_t) (align - 1));
+    }
+    _next = ptr + size;
+    _used += size;
+    return ptr;
+}
+
+void* Arena::realloc(void* ptr, size_t oldSize, size_t newSize) {
+    if (!ptr) {
+        return alloc(newSize);
+    }
+    if ((uint8_t*) ptr + oldSize == _next && newSize <= (size_t) (_end - (uint8_t*) ptr)) {
+        _next = (uint8_t*) ptr + newSize;
+        _used = _used - oldSize + newSize;
+        return ptr;
+    }
+    void* moved = alloc(newSize);
+    if (moved) {
+        memcpy(moved, ptr, oldSize < newSize ? oldSize : newSize);
+    }
+    return moved;
+}
+
+void Arena::release(void* ptr, size_t size) {
+    if (ptr && (uint8_t*) ptr + size == _next) {
+        _next = (uint8_t*) ptr;
+        _used -= size;
+    }
+}
+
+void Arena::reset() {
+    while (_chunk) {
+        Chunk* next = _chunk->next;
+        free(_chunk);
+        _chunk = next;
+    }
+    _next = nullptr;
+    _end = nullptr;
+    _used = 0;
+    _chunks = 0;
+}
+
+bool ArenaString::reserve(size_t size) {
+    if (size < _capacity) {
+        return true;
+    }
+    if (size >= SIZE_MAX / 2) {
+        return false;
+    }
+    size_t capacity = _capacity ? _capacity : 16;
+    while (capacity < size + 1) {
+        capacity *= 2;
+    }
+    char* buffer = (char*) _arena.realloc(_buffer, _capacity, capacity);
+    if (!buffer) {
+        return false;
+    }
+    if (!_buffer) {
+        buffer[0] = 0;
+    }
+    _buffer = buffer;
+    _capacity = capacity;
+    return true;
+}
+
+bool ArenaString::concat(const char* str, size_t len) {
+    // _len stays below SIZE_MAX / 2, see reserve()
+    if (len >= SIZE_MAX / 2 || !reserve(_len + len)) {
+        return false;
+    }
+    memcpy(_buffer + _len, str, len);
+    _len += len;
+    _buffer[_len] = 0;
+    return true;
+}
+
+bool ArenaString::concat(const char* str) {
+    return concat(str, strlen(str));
+}
+
+bool ArenaString::concat(const __FlashStringHelper* str) {
+    PGM_P p = reinterpret_cast<PGM_P>(str);
+    size_t len = strlen_P(p);
+    if (!reserve(_len + len)) {
+        return false;
+    }
+    memcpy_P(_buffer + _len, p, len + 1);
+    _len += len;
+    return true;
+}
+
+bool ArenaString::prepend(const char* str, size_t len) {
+    if (len >= SIZE_MAX / 2 || !reserve(_len + len)) {
+        return false;
+    }
+    memmove(_buffer + len, _buffer, _len + 1);
+    memcpy(_buffer, str, len);
+    _len += len;
+    return true;
+}
+
+void ArenaString::clear() {
+    _arena.release(_buffer, _capacity);
+    _buffer = nullptr;
+    _len = 0;
+    _capacity = 0;
+}
+
+size_t ArenaString::write(const uint8_t* buffer, size_t size) {
+    return concat((const char*) buffer, size) ? size : 0;
+}
+
+size_t ArenaString::write(uint8_t data) {
+    return concat((char) data) ? 1 : 0;
+}
@@ -0,0 +1,177 @@
+/*
+ Arena.h - bump allocator for short lived allocations
+ Copyright (c) 2016 Ivan Grokhotkov. All rights reserved.
+ This file is part of the esp8266 core for Arduino environment.
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __Arena_h
+#define __Arena_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <WString.h>
+#include <Print.h>
+
+// Hands out memory from a chunk taken from the heap on first use, and gives
+// it all back at once in reset(). Objects that live and die together, like
+// everything allocated for one web server request, then take one block of
+// the heap instead of leaving holes between longer lived objects.
+//
+// An allocation that doesn't fit in the current chunk starts a new one, at
+// least chunkSize bytes long. Destructors are not run by reset().
+class Arena {
+    public:
+        Arena(size_t chunkSize = 512);
+        ~Arena();
+
+        void* alloc(size_t size, size_t align = sizeof(void*));
+
+        // Resizes the last allocation in place when it fits, otherwise moves
+        // it. Returns nullptr, leaving ptr alone, when out of memory.
+        void* realloc(void* ptr, size_t oldSize, size_t newSize);
+
+        // Takes back the last allocation, other ones stay until reset()
+        void release(void* ptr, size_t size);
+
+        void reset();
+
+        size_t used() const {
+            return _used;
+        }
+
+        size_t chunks() const {
+            return _chunks;
+        }
+
+    protected:
+        struct Chunk {
+            Chunk* next;
+            size_t size;
+        };
+
+        Chunk* _chunk;        // current chunk, links to the previous ones
+        uint8_t* _next;       // free space in the current chunk
+        uint8_t* _end;
+        size_t _chunkSize;
+        size_t _used;
+        size_t _chunks;
+
+    private:
+        Arena(const Arena&);
+        Arena& operator=(const Arena&);
+};
+
+// Allocator for standard containers, e.g. std::vector<int, ArenaAllocator<int>>
+template<typename T>
+class ArenaAllocator {
+    public:
+        typedef T value_type;
+
+        ArenaAllocator(Arena& arena) : _arena(&arena) {}
+        template<typename U>
+        ArenaAllocator(const ArenaAllocator<U>& other) : _arena(other.arena()) {}
+
+        T* allocate(size_t n) {
+            return static_cast<T*>(_arena->alloc(n * sizeof(T), alignof(T)));
+        }
+
+        void deallocate(T* ptr, size_t n) {
+            _arena->release(ptr, n * sizeof(T));
+        }
+
+        Arena* arena() const {
+            return _arena;
+        }
+
+    protected:
+        Arena* _arena;
+};
+
+template<typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+    return a.arena() == b.arena();
+}
+
+template<typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+    return a.arena() != b.arena();
+}
+
+// Text built in an arena, with the appending part of String's interface and
+// Print for numbers. Must be cleared before the arena is reset.
+class ArenaString: public Print {
+    public:
+        ArenaString(Arena& arena) : _arena(arena), _buffer(nullptr), _len(0), _capacity(0) {}
+
+        bool concat(const char* str, size_t len);
+        bool concat(const char* str);
+        bool concat(const String& str) {
+            return concat(str.c_str(), str.length());
+        }
+        bool concat(const __FlashStringHelper* str);
+        bool concat(char c) {
+            return concat(&c, 1);
+        }
+
+        ArenaString& operator +=(const char* str) {
+            concat(str);
+            return *this;
+        }
+        ArenaString& operator +=(const String& str) {
+            concat(str);
+            return *this;
+        }
+        ArenaString& operator +=(const __FlashStringHelper* str) {
+            concat(str);
+            return *this;
+        }
+        ArenaString& operator +=(char c) {
+            concat(c);
+            return *this;
+        }
+        ArenaString& operator +=(const ArenaString& str) {
+            concat(str.c_str(), str.length());
+            return *this;
+        }
+
+        bool prepend(const char* str, size_t len);
+        bool reserve(size_t size);
+        void clear();
+
+        const char* c_str() const {
+            return _buffer ? _buffer : "";
+        }
+
+        size_t length() const {
+            return _len;
+        }
+
+        size_t write(const uint8_t* buffer, size_t size) override;
+        size_t write(uint8_t data) override;
+
+    protected:
+        Arena& _arena;
+        char* _buffer;
+        size_t _len;
+        size_t _capacity;
+
+    private:
+        ArenaString(const ArenaString&);
+        ArenaString& operator=(const ArenaString&);
+};
+
+#endif
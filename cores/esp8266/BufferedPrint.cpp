@@ -0,0 +1,91 @@
+/*
+ BufferedPrint.cpp - coalesces small writes to a Print into block writes
+ Copyright (c) 2016 Ivan Grokhotkov. All rights reserved.
+ This file is part of the esp8266 core for Arduino environment.
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "BufferedPrint.h"
+
+BufferedPrint::BufferedPrint(Print& out, uint8_t* buffer, size_t size)
+    : _out(out)
+    , _buffer(buffer)
+    , _size(buffer ? size : 0)
+    , _len(0)
+    , _owned(false)
+{
+}
+
+BufferedPrint::BufferedPrint(Print& out, size_t size)
+    : _out(out)
+    , _buffer((uint8_t*) malloc(size))
+    , _size(_buffer ? size : 0)
+    , _len(0)
+    , _owned(true)
+{
+}
+
+BufferedPrint::~BufferedPrint() {
+    send();
+    if (_owned) {
+        free(_buffer);
+    }
+}
+
+bool BufferedPrint::send() {
+    if (!_len) {
+        return true;
+    }
+    size_t written = _out.write(_buffer, _len);
+    bool ok = written == _len;
+    if (!ok) {
+        setWriteError();
+    }
+    _len = 0;
+    return ok;
+}
+
+size_t BufferedPrint::write(uint8_t data) {
+    if (_len == _size && !send()) {
+        return 0;
+    }
+    if (!_size) {
+        return _out.write(data);
+    }
+    _buffer[_len++] = data;
+    return 1;
+}
+
+size_t BufferedPrint::write(const uint8_t* data, size_t size) {
+    if (_len + size > _size) {
+        if (!send()) {
+            return 0;
+        }
+        if (size >= _size) {
+            return _out.write(data, size);
+        }
+    }
+    memcpy(_buffer + _len, data, size);
+    _len += size;
+    return size;
+}
+
+void BufferedPrint::flush() {
+    send();
+    _out.flush();
+}
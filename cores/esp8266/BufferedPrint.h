@@ -0,0 +1,75 @@
+/*
+ BufferedPrint.h - coalesces small writes to a Print into block writes
+ Copyright (c) 2016 Ivan Grokhotkov. All rights reserved.
+ This file is part of the esp8266 core for Arduino environment.
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __BufferedPrint_h
+#define __BufferedPrint_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Print.h"
+
+// Collects what is printed to it and passes it on to another Print in
+// blocks of up to the buffer size. Worth it for sinks that are slow per call,
+// like ones that only implement write(uint8_t), or that send a packet for
+// each write. Writes at least as large as the buffer go straight through.
+//
+//     uint8_t buffer[128];
+//     BufferedPrint out(Serial, buffer, sizeof(buffer));
+//     out.printf("%d: ", id);
+//     out.println(value);
+//     out.flush();
+//
+// What is still buffered is written when the BufferedPrint goes away, or on
+// flush(), which then flushes the other Print too. Data the other Print
+// doesn't take is dropped and sets the write error.
+class BufferedPrint: public Print {
+    public:
+        // buffer owned by the caller, e.g. on the stack
+        BufferedPrint(Print& out, uint8_t* buffer, size_t size);
+        // buffer taken from the heap
+        BufferedPrint(Print& out, size_t size = 64);
+        ~BufferedPrint();
+
+        size_t write(uint8_t data) override;
+        size_t write(const uint8_t* data, size_t size) override;
+        void flush() override;
+
+        // writes out what is buffered, without flushing the other Print
+        bool send();
+
+        size_t buffered() const {
+            return _len;
+        }
+
+        using Print::write;
+
+    protected:
+        Print& _out;
+        uint8_t* _buffer;
+        size_t _size;
+        size_t _len;
+        bool _owned;
+
+    private:
+        BufferedPrint(const BufferedPrint&);
+        BufferedPrint& operator=(const BufferedPrint&);
+};
+
+#endif
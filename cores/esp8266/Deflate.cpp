@@ -0,0 +1,934 @@
+/*
+ Deflate.cpp - streaming deflate compression and decompression
+ Copyright (c) 2016 Ivan Grokhotkov. All rights reserved.
+ This file is part of the esp8266 core for Arduino environment.
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include "pgmspace.h"
+#include "Deflate.h"
+
+static const size_t MIN_MATCH = 3;
+static const size_t MAX_MATCH = 258;
+static const size_t MIN_LOOKAHEAD = MAX_MATCH + MIN_MATCH + 1;
+static const size_t MAX_CHAIN = 32;    // earlier positions tried for a match
+static const size_t NICE_MATCH = 128;  // long enough to stop looking
+static const size_t LAZY_MATCH = 16;   // long enough to not look at the next position
+static const size_t TOO_FAR = 4096;    // a 3 byte match further back costs more than literals
+
+static const uint16_t lengthBase[29] PROGMEM = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t lengthExtra[29] PROGMEM = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t distanceBase[30] PROGMEM = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t distanceExtra[30] PROGMEM = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+static const uint8_t codeLengthOrder[19] PROGMEM = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+static const uint32_t crcTable[16] PROGMEM = {
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+};
+
+static uint32_t crc32Update(uint32_t crc, const uint8_t* data, size_t size) {
+    crc = ~crc;
+    while (size--) {
+        crc ^= *data++;
+        crc = (crc >> 4) ^ pgm_read_dword(&crcTable[crc & 15]);
+        crc = (crc >> 4) ^ pgm_read_dword(&crcTable[crc & 15]);
+    }
+    return ~crc;
+}
+
+static uint32_t adler32Update(uint32_t adler, const uint8_t* data, size_t size) {
+    uint32_t a = adler & 0xffff;
+    uint32_t b = adler >> 16;
+    while (size--) {
+        a += *data++;
+        if (a >= 65521) {
+            a -= 65521;
+        }
+        b += a;
+        if (b >= 65521) {
+            b -= 65521;
+        }
+    }
+    return (b << 16) | a;
+}
+
+static uint32_t checkUpdate(deflate_format_t format, uint32_t check, const uint8_t* data, size_t size) {
+    if (format == DEFLATE_GZIP) {
+        return crc32Update(check, data, size);
+    }
+    if (format == DEFLATE_ZLIB) {
+        return adler32Update(check, data, size);
+    }
+    return check;
+}
+
+DeflatePrint::DeflatePrint(Print& out, deflate_format_t format, uint8_t windowBits)
+    : _out(out)
+    , _format(format == DEFLATE_AUTO ? DEFLATE_GZIP : format)
+    , _windowBits(std::min(std::max(windowBits, (uint8_t) 9), (uint8_t) 14))
+    , _hashBits(_windowBits - 1)
+    , _window(nullptr)
+    , _prev(nullptr)
+    , _head(nullptr)
+    , _pos(0)
+    , _end(0)
+    , _prevLength(0)
+    , _prevDistance(0)
+    , _pending(false)
+    , _started(false)
+    , _blockOpen(false)
+    , _finished(false)
+    , _bits(0)
+    , _bitCount(0)
+    , _outLen(0)
+    , _check(_format == DEFLATE_ZLIB ? 1 : 0)
+    , _totalIn(0)
+    , _totalOut(0)
+{
+    size_t windowSize = (size_t) 1 << _windowBits;
+    size_t tables = (windowSize + ((size_t) 1 << _hashBits)) * sizeof(uint16_t);
+    _window = (uint8_t*) malloc(2 * windowSize + tables);
+    if (_window) {
+        _prev = (uint16_t*) (_window + 2 * windowSize);
+        _head = _prev + windowSize;
+        memset(_prev, 0, tables);
+    }
+}
+
+DeflatePrint::~DeflatePrint() {
+    free(_window);
+}
+
+size_t DeflatePrint::write(uint8_t data) {
+    return write(&data, 1);
+}
+
+size_t DeflatePrint::write(const uint8_t* data, size_t size) {
+    if (!_window || _finished) {
+        setWriteError();
+        return 0;
+    }
+    _begin();
+    _check = checkUpdate(_format, _check, data, size);
+    _totalIn += size;
+
+    size_t windowSize = (size_t) 1 << _windowBits;
+    size_t done = 0;
+    while (done < size) {
+        if (_end == 2 * windowSize) {
+            _slide();
+        }
+        size_t len = std::min(size - done, 2 * windowSize - _end);
+        memcpy(_window + _end, data + done, len);
+        _end += len;
+        done += len;
+        _compress(false);
+    }
+    return getWriteError() ? 0 : size;
+}
+
+void DeflatePrint::flush() {
+    if (!_window || _finished) {
+        return;
+    }
+    _begin();
+    _compress(true);
+    if (_blockOpen) {
+        _putCode(0, 7);
+        _blockOpen = false;
+    }
+    // an empty stored block ends on a byte boundary
+    _putBits(0, 3);
+    _alignBits();
+    _putBits(0x0000, 16);
+    _putBits(0xffff, 16);
+    _send();
+    _out.flush();
+}
+
+bool DeflatePrint::finish() {
+    if (!_window) {
+        return false;
+    }
+    if (_finished) {
+        return !getWriteError();
+    }
+    _begin();
+    _compress(true);
+    if (_blockOpen) {
+        _putCode(0, 7);
+        _blockOpen = false;
+    }
+    // the last block flag goes first, so the stream ends with an empty block
+    _putBits(3, 3);
+    _putCode(0, 7);
+    _alignBits();
+    if (_format == DEFLATE_GZIP) {
+        _putBits(_check & 0xffff, 16);
+        _putBits(_check >> 16, 16);
+        _putBits(_totalIn & 0xffff, 16);
+        _putBits(_totalIn >> 16, 16);
+    } else if (_format == DEFLATE_ZLIB) {
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            _putBits((_check >> shift) & 0xff, 8);
+        }
+    }
+    _send();
+    _finished = true;
+    return !getWriteError();
+}
+
+void DeflatePrint::_begin() {
+    if (!_started) {
+        _started = true;
+        if (_format == DEFLATE_GZIP) {
+            // no name, no time, unknown OS
+            static const uint8_t header[10] PROGMEM = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0xff };
+            for (size_t i = 0; i < sizeof(header); ++i) {
+                _putBits(pgm_read_byte(&header[i]), 8);
+            }
+        } else if (_format == DEFLATE_ZLIB) {
+            uint8_t cmf = 8 | ((_windowBits - 8) << 4);
+            _putBits(cmf, 8);
+            _putBits((31 - (cmf << 8) % 31) % 31, 8);
+        }
+    }
+    if (!_blockOpen) {
+        // not the last one, fixed codes
+        _putBits(2, 3);
+        _blockOpen = true;
+    }
+}
+
+// Lazy matching as in zlib: a match is only taken once the next position
+// turned out to have no longer one.
+void DeflatePrint::_compress(bool all) {
+    while (_end - _pos >= MIN_LOOKAHEAD || (all && _pos < _end)) {
+        size_t length = 0;
+        size_t distance = 0;
+        if (_end - _pos >= MIN_MATCH) {
+            uint16_t candidate = _insert(_pos);
+            if (candidate && _prevLength < LAZY_MATCH) {
+                length = _longestMatch(candidate, _pos, distance);
+            }
+        }
+        if (_prevLength >= MIN_MATCH && length <= _prevLength) {
+            _putMatch(_prevLength, _prevDistance);
+            size_t end = _pos - 1 + _prevLength;
+            while (++_pos < end) {
+                if (_end - _pos >= MIN_MATCH) {
+                    _insert(_pos);
+                }
+            }
+            _prevLength = 0;
+            _pending = false;
+        } else {
+            if (_pending) {
+                _putLiteral(_window[_pos - 1]);
+            }
+            _pending = true;
+            _prevLength = length;
+            _prevDistance = distance;
+            ++_pos;
+        }
+    }
+    if (all && _pending) {
+        _putLiteral(_window[_pos - 1]);
+        _pending = false;
+        _prevLength = 0;
+    }
+}
+
+uint16_t DeflatePrint::_insert(size_t pos) {
+    const uint8_t* p = _window + pos;
+    uint32_t hash = ((((uint32_t) p[0] << 16) | ((uint32_t) p[1] << 8) | p[2]) * 2654435761u) >> (32 - _hashBits);
+    uint16_t candidate = _head[hash];
+    _prev[pos & (((size_t) 1 << _windowBits) - 1)] = candidate;
+    _head[hash] = pos + 1;
+    return candidate;
+}
+
+size_t DeflatePrint::_longestMatch(uint16_t candidate, size_t pos, size_t& distance) {
+    size_t windowSize = (size_t) 1 << _windowBits;
+    size_t maxLength = std::min(_end - pos, MAX_MATCH);
+    size_t best = MIN_MATCH - 1;
+    size_t chain = MAX_CHAIN;
+    const uint8_t* scan = _window + pos;
+    while (candidate && chain--) {
+        size_t match = candidate - 1;
+        if (match >= pos || pos - match > windowSize) {
+            break;
+        }
+        const uint8_t* m = _window + match;
+        if (m[best] == scan[best] && m[0] == scan[0]) {
+            size_t len = 1;
+            while (len < maxLength && m[len] == scan[len]) {
+                ++len;
+            }
+            if (len > best) {
+                best = len;
+                distance = pos - match;
+                if (len >= NICE_MATCH || len == maxLength) {
+                    break;
+                }
+            }
+        }
+        // a chain entry overwritten by a newer position ends the chain
+        uint16_t next = _prev[match & (windowSize - 1)];
+        if (next >= candidate) {
+            break;
+        }
+        candidate = next;
+    }
+    if (best < MIN_MATCH || (best == MIN_MATCH && distance > TOO_FAR)) {
+        return 0;
+    }
+    return best;
+}
+
+void DeflatePrint::_slide() {
+    // _pos is past the first window, which is no longer needed
+    size_t windowSize = (size_t) 1 << _windowBits;
+    memcpy(_window, _window + windowSize, windowSize);
+    _pos -= windowSize;
+    _end -= windowSize;
+    size_t entries = windowSize + ((size_t) 1 << _hashBits);
+    for (size_t i = 0; i < entries; ++i) {
+        uint16_t v = _prev[i];
+        _prev[i] = (v > windowSize) ? v - windowSize : 0;
+    }
+}
+
+void DeflatePrint::_putLiteral(uint8_t c) {
+    if (c < 144) {
+        _putCode(0x30 + c, 8);
+    } else {
+        _putCode(0x190 + c - 144, 9);
+    }
+}
+
+void DeflatePrint::_putMatch(size_t length, size_t distance) {
+    int i = 28;
+    while (pgm_read_word(&lengthBase[i]) > length) {
+        --i;
+    }
+    uint16_t symbol = 257 + i;
+    if (symbol < 280) {
+        _putCode(symbol - 256, 7);
+    } else {
+        _putCode(symbol - 280 + 0xc0, 8);
+    }
+    _putBits(length - pgm_read_word(&lengthBase[i]), pgm_read_byte(&lengthExtra[i]));
+
+    i = 29;
+    while (pgm_read_word(&distanceBase[i]) > distance) {
+        --i;
+    }
+    _putCode(i, 5);
+    _putBits(distance - pgm_read_word(&distanceBase[i]), pgm_read_byte(&distanceExtra[i]));
+}
+
+void DeflatePrint::_putBits(uint32_t bits, uint8_t count) {
+    _bits |= bits << _bitCount;
+    _bitCount += count;
+    while (_bitCount >= 8) {
+        _outBuf[_outLen++] = _bits;
+        _bits >>= 8;
+        _bitCount -= 8;
+        if (_outLen == sizeof(_outBuf)) {
+            _send();
+        }
+    }
+}
+
+void DeflatePrint::_putCode(uint16_t code, uint8_t count) {
+    // Huffman codes go out starting with their most significant bit
+    uint16_t reversed = 0;
+    for (uint8_t i = 0; i < count; ++i) {
+        reversed = (reversed << 1) | (code & 1);
+        code >>= 1;
+    }
+    _putBits(reversed, count);
+}
+
+void DeflatePrint::_alignBits() {
+    if (_bitCount) {
+        _putBits(0, 8 - _bitCount);
+    }
+}
+
+void DeflatePrint::_send() {
+    if (!_outLen) {
+        return;
+    }
+    if (_out.write(_outBuf, _outLen) != _outLen) {
+        setWriteError();
+    }
+    _totalOut += _outLen;
+    _outLen = 0;
+}
+
+InflatePrint::InflatePrint(Print& out, deflate_format_t format, uint8_t windowBits)
+    : _out(out)
+    , _format(format)
+    , _windowBits(std::min(std::max(windowBits, (uint8_t) 8), (uint8_t) 15))
+    , _state(format == DEFLATE_RAW ? BLOCK : HEADER)
+    , _error(NONE)
+    , _in(nullptr)
+    , _inLen(0)
+    , _bits(0)
+    , _bitCount(0)
+    , _lastBlock(false)
+    , _flags(0)
+    , _count(0)
+    , _literals(0)
+    , _distances(0)
+    , _codeLengths(0)
+    , _length(0)
+    , _symbol(0)
+    , _window(nullptr)
+    , _windowSize(0)
+    , _wpos(0)
+    , _sent(0)
+    , _check(0)
+    , _totalOut(0)
+{
+    _trailer[0] = _trailer[1] = 0;
+}
+
+InflatePrint::~InflatePrint() {
+    free(_window);
+}
+
+size_t InflatePrint::write(uint8_t data) {
+    return write(&data, 1);
+}
+
+size_t InflatePrint::write(const uint8_t* data, size_t size) {
+    if (_state == FAILED) {
+        setWriteError();
+        return 0;
+    }
+    _in = data;
+    _inLen = size;
+    _run();
+    _send();
+    size_t left = _inLen;
+    if (_state == DONE) {
+        // whole bytes read ahead past the end
+        left = std::min(size, left + _bitCount / 8);
+        _bits = 0;
+        _bitCount = 0;
+    }
+    _in = nullptr;
+    _inLen = 0;
+    if (_state == FAILED) {
+        return 0;
+    }
+    return size - left;
+}
+
+bool InflatePrint::_need(uint8_t count) {
+    while (_bitCount < count) {
+        if (!_inLen) {
+            return false;
+        }
+        _bits |= (uint32_t) *_in++ << _bitCount;
+        _bitCount += 8;
+        --_inLen;
+    }
+    return true;
+}
+
+uint32_t InflatePrint::_take(uint8_t count) {
+    uint32_t value = _bits & ((1UL << count) - 1);
+    _bits >>= count;
+    _bitCount -= count;
+    return value;
+}
+
+// Looks at the next code without taking it: the symbol, -1 if the input
+// ran out before its end, -2 if there is no such code.
+template<size_t N>
+int InflatePrint::_decode(const Huffman<N>& code, uint8_t& length) {
+    _need(15);
+    uint32_t bits = _bits;
+    int c = 0;
+    int first = 0;
+    int index = 0;
+    for (uint8_t len = 1; len <= 15; ++len) {
+        if (len > _bitCount) {
+            return -1;
+        }
+        c |= bits & 1;
+        bits >>= 1;
+        int count = code.count[len];
+        if (c - count < first) {
+            length = len;
+            return code.symbol[index + (c - first)];
+        }
+        index += count;
+        first += count;
+        first <<= 1;
+        c <<= 1;
+    }
+    return -2;
+}
+
+// Returns 0 for a complete code, the number of missing codes if it is
+// incomplete, negative if it is oversubscribed.
+template<size_t N>
+int InflatePrint::_build(Huffman<N>& code, const uint8_t* lengths, size_t count) {
+    memset(code.count, 0, sizeof(code.count));
+    for (size_t i = 0; i < count; ++i) {
+        code.count[lengths[i]]++;
+    }
+    if (code.count[0] == count) {
+        return 0;
+    }
+    int left = 1;
+    for (int len = 1; len < 16; ++len) {
+        left <<= 1;
+        left -= code.count[len];
+        if (left < 0) {
+            return left;
+        }
+    }
+    uint16_t offsets[16];
+    offsets[1] = 0;
+    for (int len = 1; len < 15; ++len) {
+        offsets[len + 1] = offsets[len] + code.count[len];
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (lengths[i]) {
+            code.symbol[offsets[lengths[i]]++] = i;
+        }
+    }
+    return left;
+}
+
+bool InflatePrint::_allocate() {
+    _windowSize = (size_t) 1 << _windowBits;
+    _window = (uint8_t*) malloc(_windowSize);
+    return _window != nullptr;
+}
+
+bool InflatePrint::_buildTables() {
+    if (!_lengths[256]) {
+        return false;
+    }
+    // an incomplete code is only allowed with a single code in it
+    int left = _build(_literalCode, _lengths, _literals);
+    if (left < 0 || (left > 0 && _literals != _literalCode.count[0] + _literalCode.count[1])) {
+        return false;
+    }
+    left = _build(_distanceCode, _lengths + _literals, _distances);
+    if (left < 0 || (left > 0 && _distances != _distanceCode.count[0] + _distanceCode.count[1])) {
+        return false;
+    }
+    return true;
+}
+
+void InflatePrint::_put(uint8_t c) {
+    _window[_wpos++] = c;
+    ++_totalOut;
+    if (_wpos == _windowSize) {
+        _send();
+        _wpos = 0;
+        _sent = 0;
+    }
+}
+
+void InflatePrint::_send() {
+    if (_wpos == _sent || _state == FAILED) {
+        return;
+    }
+    size_t len = _wpos - _sent;
+    const uint8_t* data = _window + _sent;
+    _check = checkUpdate(_format, _check, data, len);
+    _sent = _wpos;
+    if (_out.write(data, len) != len) {
+        _fail(WRITE_FAILED);
+    }
+}
+
+void InflatePrint::_fail(Error error) {
+    _state = FAILED;
+    _error = error;
+    setWriteError();
+}
+
+void InflatePrint::_run() {
+    while (true) {
+        switch (_state) {
+        case HEADER: {
+            if (!_need(16)) {
+                return;
+            }
+            uint8_t cmf = _bits & 0xff;
+            uint8_t flg = (_bits >> 8) & 0xff;
+            bool zlib = (cmf & 0x0f) == 8 && ((cmf << 8) | flg) % 31 == 0;
+            if (_format == DEFLATE_AUTO) {
+                _format = (cmf == 0x1f && flg == 0x8b) ? DEFLATE_GZIP : zlib ? DEFLATE_ZLIB : DEFLATE_RAW;
+            }
+            if (_format == DEFLATE_GZIP) {
+                if (cmf != 0x1f || flg != 0x8b) {
+                    return _fail(BAD_DATA);
+                }
+                _take(16);
+                _count = 0;
+                _state = GZIP_HEADER;
+            } else if (_format == DEFLATE_ZLIB) {
+                // no preset dictionaries
+                if (!zlib || (cmf >> 4) > 7 || (flg & 0x20)) {
+                    return _fail(BAD_DATA);
+                }
+                _windowBits = std::min(_windowBits, (uint8_t) ((cmf >> 4) + 8));
+                _take(16);
+                _check = 1;
+                _state = BLOCK;
+            } else {
+                _state = BLOCK;
+            }
+            break;
+        }
+
+        case GZIP_HEADER:
+            // method, flags, time, extra flags, OS
+            while (_count < 8) {
+                if (!_need(8)) {
+                    return;
+                }
+                uint8_t b = _take(8);
+                if ((_count == 0 && b != 8) || (_count == 1 && (b & 0xe0))) {
+                    return _fail(BAD_DATA);
+                }
+                if (_count == 1) {
+                    _flags = b;
+                }
+                ++_count;
+            }
+            _count = 0;
+            _state = GZIP_FIELDS;
+            break;
+
+        case GZIP_FIELDS:
+            // extra field, name, comment and header CRC, all skipped
+            if (_flags & 0x04) {
+                if (!_need(16)) {
+                    return;
+                }
+                _count = _take(16);
+                _flags &= ~0x04;
+            }
+            for (; _count; --_count) {
+                if (!_need(8)) {
+                    return;
+                }
+                _take(8);
+            }
+            while (_flags & 0x18) {
+                if (!_need(8)) {
+                    return;
+                }
+                if (_take(8) == 0) {
+                    _flags &= (_flags & 0x08) ? ~0x08 : ~0x10;
+                }
+            }
+            if (_flags & 0x02) {
+                if (!_need(16)) {
+                    return;
+                }
+                _take(16);
+                _flags &= ~0x02;
+            }
+            _state = BLOCK;
+            break;
+
+        case BLOCK:
+            if (_lastBlock) {
+                _take(_bitCount & 7);
+                _count = 0;
+                _state = TRAILER;
+                break;
+            }
+            if (!_window && !_allocate()) {
+                return _fail(NO_MEMORY);
+            }
+            if (!_need(3)) {
+                return;
+            }
+            _lastBlock = _take(1);
+            switch (_take(2)) {
+            case 0:
+                _take(_bitCount & 7);
+                _state = STORED_LENGTH;
+                break;
+            case 1: {
+                size_t i = 0;
+                for (; i < 144; ++i) {
+                    _lengths[i] = 8;
+                }
+                for (; i < 256; ++i) {
+                    _lengths[i] = 9;
+                }
+                for (; i < 280; ++i) {
+                    _lengths[i] = 7;
+                }
+                for (; i < 288; ++i) {
+                    _lengths[i] = 8;
+                }
+                for (; i < 288 + 30; ++i) {
+                    _lengths[i] = 5;
+                }
+                _build(_literalCode, _lengths, 288);
+                _build(_distanceCode, _lengths + 288, 30);
+                _state = LITERAL_LENGTH;
+                break;
+            }
+            case 2:
+                _state = TABLE_SIZES;
+                break;
+            default:
+                return _fail(BAD_DATA);
+            }
+            break;
+
+        case STORED_LENGTH:
+            if (!_need(16)) {
+                return;
+            }
+            _length = _take(16);
+            _state = STORED_CHECK;
+            break;
+
+        case STORED_CHECK:
+            if (!_need(16)) {
+                return;
+            }
+            if (_take(16) != (uint16_t) ~_length) {
+                return _fail(BAD_DATA);
+            }
+            _state = STORED;
+            break;
+
+        case STORED:
+            while (_length && _bitCount) {
+                _put(_take(8));
+                --_length;
+            }
+            while (_length && _inLen && _state == STORED) {
+                _put(*_in++);
+                --_inLen;
+                --_length;
+            }
+            if (_length) {
+                return;
+            }
+            if (_state == STORED) {
+                _state = BLOCK;
+            }
+            break;
+
+        case TABLE_SIZES:
+            if (!_need(14)) {
+                return;
+            }
+            _literals = _take(5) + 257;
+            _distances = _take(5) + 1;
+            _codeLengths = _take(4) + 4;
+            if (_literals > 286 || _distances > 30) {
+                return _fail(BAD_DATA);
+            }
+            memset(_lengths, 0, 19);
+            _count = 0;
+            _state = CODE_LENGTH_LENGTHS;
+            break;
+
+        case CODE_LENGTH_LENGTHS:
+            while (_count < _codeLengths) {
+                if (!_need(3)) {
+                    return;
+                }
+                _lengths[pgm_read_byte(&codeLengthOrder[_count++])] = _take(3);
+            }
+            // the code for the code lengths takes the place of the literal one
+            if (_build(_literalCode, _lengths, 19) != 0) {
+                return _fail(BAD_DATA);
+            }
+            _count = 0;
+            _state = CODE_LENGTHS;
+            break;
+
+        case CODE_LENGTHS:
+            while (_count < _literals + _distances) {
+                uint8_t length;
+                int symbol = _decode(_literalCode, length);
+                if (symbol == -1) {
+                    return;
+                }
+                if (symbol < 0) {
+                    return _fail(BAD_DATA);
+                }
+                if (symbol < 16) {
+                    _take(length);
+                    _lengths[_count++] = symbol;
+                    continue;
+                }
+                uint8_t extra = (symbol == 16) ? 2 : (symbol == 17) ? 3 : 7;
+                if (!_need(length + extra)) {
+                    return;
+                }
+                _take(length);
+                uint8_t value = 0;
+                size_t repeat;
+                if (symbol == 16) {
+                    if (!_count) {
+                        return _fail(BAD_DATA);
+                    }
+                    value = _lengths[_count - 1];
+                    repeat = 3 + _take(2);
+                } else if (symbol == 17) {
+                    repeat = 3 + _take(3);
+                } else {
+                    repeat = 11 + _take(7);
+                }
+                if (_count + repeat > (size_t) (_literals + _distances)) {
+                    return _fail(BAD_DATA);
+                }
+                while (repeat--) {
+                    _lengths[_count++] = value;
+                }
+            }
+            if (!_buildTables()) {
+                return _fail(BAD_DATA);
+            }
+            _state = LITERAL_LENGTH;
+            break;
+
+        case LITERAL_LENGTH: {
+            uint8_t length;
+            int symbol = _decode(_literalCode, length);
+            if (symbol == -1) {
+                return;
+            }
+            if (symbol < 0 || symbol > 285) {
+                return _fail(BAD_DATA);
+            }
+            if (symbol < 256) {
+                _take(length);
+                _put(symbol);
+            } else if (symbol == 256) {
+                _take(length);
+                _state = BLOCK;
+            } else {
+                symbol -= 257;
+                uint8_t extra = pgm_read_byte(&lengthExtra[symbol]);
+                if (!_need(length + extra)) {
+                    return;
+                }
+                _take(length);
+                _length = pgm_read_word(&lengthBase[symbol]) + _take(extra);
+                _state = DISTANCE;
+            }
+            break;
+        }
+
+        case DISTANCE: {
+            uint8_t length;
+            int symbol = _decode(_distanceCode, length);
+            if (symbol == -1) {
+                return;
+            }
+            if (symbol < 0 || symbol > 29) {
+                return _fail(BAD_DATA);
+            }
+            _take(length);
+            _symbol = symbol;
+            _state = DISTANCE_EXTRA;
+            break;
+        }
+
+        case DISTANCE_EXTRA: {
+            uint8_t extra = pgm_read_byte(&distanceExtra[_symbol]);
+            if (!_need(extra)) {
+                return;
+            }
+            size_t distance = pgm_read_word(&distanceBase[_symbol]) + _take(extra);
+            if (distance > _windowSize || distance > _totalOut) {
+                return _fail(BAD_DATA);
+            }
+            size_t from = (_wpos - distance) & (_windowSize - 1);
+            for (uint16_t i = 0; i < _length; ++i) {
+                _put(_window[from]);
+                from = (from + 1) & (_windowSize - 1);
+            }
+            if (_state == DISTANCE_EXTRA) {
+                _state = LITERAL_LENGTH;
+            }
+            break;
+        }
+
+        case TRAILER: {
+            size_t size = (_format == DEFLATE_GZIP) ? 8 : (_format == DEFLATE_ZLIB) ? 4 : 0;
+            while (_count < size) {
+                if (!_need(8)) {
+                    return;
+                }
+                uint32_t b = _take(8);
+                if (_format == DEFLATE_GZIP) {
+                    _trailer[_count / 4] |= b << (8 * (_count % 4));
+                } else {
+                    _trailer[0] = (_trailer[0] << 8) | b;
+                }
+                ++_count;
+            }
+            // the check covers everything passed on
+            _send();
+            if (_state == FAILED) {
+                return;
+            }
+            if ((_format == DEFLATE_GZIP && (_trailer[0] != _check || _trailer[1] != _totalOut)) ||
+                (_format == DEFLATE_ZLIB && _trailer[0] != _check)) {
+                return _fail(BAD_DATA);
+            }
+            _state = DONE;
+            return;
+        }
+
+        case DONE:
+        case FAILED:
+            return;
+        }
+    }
+}
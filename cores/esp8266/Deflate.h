@@ -0,0 +1,242 @@
+/*
+ Deflate.h - streaming deflate compression and decompression
+ Copyright (c) 2016 Ivan Grokhotkov. All rights reserved.
+ This file is part of the esp8266 core for Arduino environment.
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __Deflate_h
+#define __Deflate_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Print.h"
+
+#ifndef DEFLATE_WINDOW_BITS
+#define DEFLATE_WINDOW_BITS 10 // 1KB of history to find repeats in, about 5KB of heap
+#endif
+
+#ifndef INFLATE_WINDOW_BITS
+#define INFLATE_WINDOW_BITS 15 // 32KB, the most a sender may refer back
+#endif
+
+enum deflate_format_t {
+    DEFLATE_RAW,    // RFC 1951, no header
+    DEFLATE_ZLIB,   // RFC 1950, "Content-Encoding: deflate"
+    DEFLATE_GZIP,   // RFC 1952, "Content-Encoding: gzip"
+    DEFLATE_AUTO    // InflatePrint only, told apart by the header
+};
+
+// Compresses what is printed to it and passes it on to another Print, e.g.
+//
+//     DeflatePrint gzip(client, DEFLATE_GZIP);
+//     gzip.print(json);
+//     gzip.finish();
+//
+// Memory stays bounded by the window: repeats are looked for in the last
+// 1 << windowBits bytes, from 9 (512 bytes) to 14 (16KB), and the whole
+// state takes about 5 << windowBits bytes of heap. Data is coded with the
+// fixed Huffman codes, which need no per block tables to be collected, so
+// output is produced as input comes in.
+//
+// finish() ends the stream, it is not done on destruction. flush() makes
+// everything written so far decodable on the other side, at the cost of a
+// few bytes. Data the other Print doesn't take sets the write error.
+class DeflatePrint: public Print {
+    public:
+        DeflatePrint(Print& out, deflate_format_t format = DEFLATE_GZIP, uint8_t windowBits = DEFLATE_WINDOW_BITS);
+        ~DeflatePrint();
+
+        // the buffers could be allocated
+        bool ok() const {
+            return _window != nullptr;
+        }
+        deflate_format_t format() const {
+            return _format;
+        }
+
+        size_t write(uint8_t data) override;
+        size_t write(const uint8_t* data, size_t size) override;
+        void flush() override;
+        bool finish();
+
+        // uncompressed bytes taken, and compressed bytes passed on
+        uint32_t totalIn() const {
+            return _totalIn;
+        }
+        uint32_t totalOut() const {
+            return _totalOut;
+        }
+
+        using Print::write;
+
+    protected:
+        void _begin();
+        void _compress(bool all);
+        uint16_t _insert(size_t pos);
+        size_t _longestMatch(uint16_t candidate, size_t pos, size_t& distance);
+        void _slide();
+        void _putLiteral(uint8_t c);
+        void _putMatch(size_t length, size_t distance);
+        void _putBits(uint32_t bits, uint8_t count);
+        void _putCode(uint16_t code, uint8_t count);
+        void _alignBits();
+        void _send();
+
+        Print& _out;
+        deflate_format_t _format;
+        uint8_t _windowBits;
+        uint8_t _hashBits;
+        uint8_t* _window;   // two windows: history and lookahead
+        uint16_t* _prev;    // previous position with the same hash, plus one
+        uint16_t* _head;    // last position of each hash, plus one
+        size_t _pos;        // next byte to code
+        size_t _end;        // end of the data in _window
+        size_t _prevLength; // a match at _pos - 1, kept while _pos is tried
+        size_t _prevDistance;
+        bool _pending;      // _pos - 1 is not coded yet
+        bool _started;
+        bool _blockOpen;
+        bool _finished;
+        uint32_t _bits;
+        uint8_t _bitCount;
+        uint8_t _outLen;
+        uint8_t _outBuf[64];
+        uint32_t _check;    // of the input, CRC-32 or Adler-32
+        uint32_t _totalIn;
+        uint32_t _totalOut;
+
+    private:
+        DeflatePrint(const DeflatePrint&);
+        DeflatePrint& operator=(const DeflatePrint&);
+};
+
+// Decompresses what is written to it and passes it on to another Print.
+// The window has to reach as far back as the sender refers: any sender
+// fits in 15 bits (32KB), a smaller one only works with senders known to
+// use no more, such as a DeflatePrint. A zlib header announcing a smaller
+// window brings the allocation down to it. The window is taken from the
+// heap when the first block starts and doubles as the output buffer, the
+// rest of the state is about 1.2KB.
+//
+// Input can be split anywhere. Decoded data is passed on before write()
+// returns. Corrupt or truncated data and a missing window show up as
+// error(), and set the write error.
+class InflatePrint: public Print {
+    public:
+        enum Error {
+            NONE,
+            BAD_DATA,       // not a deflate stream, or the check failed
+            NO_MEMORY,      // for the window
+            WRITE_FAILED    // the other Print didn't take the output
+        };
+
+        InflatePrint(Print& out, deflate_format_t format = DEFLATE_AUTO, uint8_t windowBits = INFLATE_WINDOW_BITS);
+        ~InflatePrint();
+
+        size_t write(uint8_t data) override;
+        size_t write(const uint8_t* data, size_t size) override;
+
+        // the end of the stream and its checks went through, write() takes
+        // nothing after it
+        bool done() const {
+            return _state == DONE;
+        }
+        Error error() const {
+            return _error;
+        }
+        // bytes decoded so far
+        uint32_t totalOut() const {
+            return _totalOut;
+        }
+
+        using Print::write;
+
+    protected:
+        enum State {
+            HEADER,
+            GZIP_HEADER,
+            GZIP_FIELDS,
+            BLOCK,
+            STORED_LENGTH,
+            STORED_CHECK,
+            STORED,
+            TABLE_SIZES,
+            CODE_LENGTH_LENGTHS,
+            CODE_LENGTHS,
+            LITERAL_LENGTH,
+            DISTANCE,
+            DISTANCE_EXTRA,
+            TRAILER,
+            DONE,
+            FAILED
+        };
+
+        // canonical code: number of codes of each length, and the symbols
+        // ordered by code
+        template<size_t N>
+        struct Huffman {
+            uint16_t count[16];
+            uint16_t symbol[N];
+        };
+
+        bool _need(uint8_t count);
+        uint32_t _take(uint8_t count);
+        template<size_t N>
+        int _decode(const Huffman<N>& code, uint8_t& length);
+        template<size_t N>
+        static int _build(Huffman<N>& code, const uint8_t* lengths, size_t count);
+        bool _allocate();
+        bool _buildTables();
+        void _put(uint8_t c);
+        void _send();
+        void _fail(Error error);
+        void _run();
+
+        Print& _out;
+        deflate_format_t _format;
+        uint8_t _windowBits;
+        State _state;
+        Error _error;
+        const uint8_t* _in;
+        size_t _inLen;
+        uint32_t _bits;
+        uint8_t _bitCount;
+        bool _lastBlock;
+        uint8_t _flags;       // gzip header fields still to skip
+        uint16_t _count;      // a counter for the current state
+        uint16_t _literals;   // code lengths of a dynamic block
+        uint16_t _distances;
+        uint16_t _codeLengths;
+        uint16_t _length;     // of the match being decoded
+        uint16_t _symbol;
+        uint8_t* _window;
+        size_t _windowSize;
+        size_t _wpos;
+        size_t _sent;         // window bytes passed on
+        uint32_t _check;
+        uint32_t _trailer[2];
+        uint32_t _totalOut;
+        uint8_t _lengths[320];
+        Huffman<288> _literalCode;
+        Huffman<32> _distanceCode;
+
+    private:
+        InflatePrint(const InflatePrint&);
+        InflatePrint& operator=(const InflatePrint&);
+};
+
+#endif
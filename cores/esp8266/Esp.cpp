@@ -27,6 +27,7 @@
 
 extern "C" {
 #include "user_interface.h"
+#include "umm_malloc/umm_malloc.h"
 
 extern struct rst_info resetInfo;
 }
@@ -164,6 +165,31 @@ uint32_t EspClass::getFreeHeap(void)
     return system_get_free_heap_size();
 }
 
+uint32_t EspClass::getMaxFreeBlockSize(void)
+{
+    return umm_max_block_size();
+}
+
+uint8_t EspClass::getHeapFragmentation(void)
+{
+    return umm_fragmentation_metric();
+}
+
+void EspClass::printHeapSites(Print& out)
+{
+    UMM_SITE_INFO sites[16];
+    size_t count = umm_site_info(sites, sizeof(sites) / sizeof(sites[0]));
+    for (size_t i = 0; i < count; ++i) {
+        if (sites[i].site) {
+            out.printf("%p", sites[i].site);
+        } else {
+            out.print(F("others    "));
+        }
+        out.printf(" %6u bytes in %4u blocks, %lu allocations\n",
+                   (unsigned) sites[i].liveBytes, sites[i].liveCount, sites[i].allocCount);
+    }
+}
+
 uint32_t EspClass::getChipId(void)
 {
     return system_get_chip_id();
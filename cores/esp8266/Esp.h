@@ -103,6 +103,10 @@ class EspClass {
 
         uint16_t getVcc();
         uint32_t getFreeHeap();
+        uint32_t getMaxFreeBlockSize();
+        uint8_t getHeapFragmentation(); // 0 to 100
+        // Largest holders of heap memory, needs -DUMM_SITE_STATS
+        void printHeapSites(Print& out);
 
         uint32_t getChipId();
 
@@ -59,6 +59,21 @@ int File::peek() {
 	return result;
 }
 
+size_t File::peekAvailable() {
+	if (!_file_impl) return 0;
+	return _file_impl->peekAvailable();
+}
+
+const char* File::peekBuffer() {
+	if (!_file_impl) return nullptr;
+	return _file_impl->peekBuffer();
+}
+
+void File::peekConsume(size_t consume) {
+	if (!_file_impl) return;
+	_file_impl->peekConsume(consume);
+}
+
 void File::flush() {
 	if (!_file_impl) return;
 	_file_impl->flush();
@@ -218,6 +233,11 @@ bool FS::begin() {
 	return _fs_impl->begin();
 }
 
+bool FS::begin(const FSConfig& config) {
+	if (!_fs_impl) return false;
+	return _fs_impl->configure(config) && _fs_impl->begin();
+}
+
 void FS::end() {
 	if (_fs_impl) {
 		_fs_impl->end();
@@ -264,7 +284,7 @@ bool FS::isDir(const char *path) const {
 
 size_t FS::size(const char *path) const {
 	if (!_fs_impl) return false;
-	return _fs_impl->mtime(path);
+	return _fs_impl->size(path);
 }
 
 time_t FS::mtime(const char *path) const {
@@ -282,6 +302,16 @@ bool FS::rename(const char *pathFrom, const char *pathTo) {
 	return _fs_impl->rename(pathFrom, pathTo);
 }
 
+uint32_t FS::generation() const {
+	if (!_fs_impl) return 0;
+	return _fs_impl->generation();
+}
+
+bool FS::changedSince(const char* path, uint32_t generation) const {
+	if (!_fs_impl) return true;
+	return _fs_impl->changedSince(path, generation);
+}
+
 // Utility functions
 
 static bool sflags(const char *mode, OpenMode& om, AccessMode& am) {
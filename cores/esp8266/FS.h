@@ -66,6 +66,12 @@ public:
 	int peek() override;
 	void flush() override;
 
+	bool hasPeekBufferAPI() const override
+	{ return true; }
+	size_t peekAvailable() override;
+	const char* peekBuffer() override;
+	void peekConsume(size_t consume) override;
+
 	bool seek(int32_t pos, SeekMode mode);
 	bool seek(int32_t pos)
 	{ return seek(pos, SeekSet); }
@@ -167,6 +173,24 @@ struct FSInfo {
 	size_t pageSize;
 	size_t maxOpenFiles;
 	size_t maxPathLength;
+	// Read cache, counted since the file system was mounted
+	size_t cachePages;
+	uint32_t cacheHits;
+	uint32_t cacheMisses;
+	uint32_t cacheEvictions;
+};
+
+struct FSConfig {
+	FSConfig() : cachePages(0), readAhead(0), backgroundGC(false) { }
+
+	// Pages kept in the read cache, 0 for the default
+	size_t cachePages;
+	// Bytes files opened for reading fetch at once to serve small
+	// sequential reads from RAM, 0 to disable
+	size_t readAhead;
+	// Collect garbage in small steps from scheduled functions, so that
+	// writes rarely have to stop for it
+	bool backgroundGC;
 };
 
 class FS {
@@ -174,6 +198,8 @@ public:
 	FS(FSImplPtr fs_impl) : _fs_impl(fs_impl) { }
 
 	bool begin();
+	// Mounts with the given settings, remounting if they need it
+	bool begin(const FSConfig& config);
 	void end();
 
 	bool format();
@@ -217,6 +243,15 @@ public:
 	bool rename(String const &pathFrom, String const &pathTo)
 	{ return rename(pathFrom.c_str(), pathTo.c_str()); }
 
+	// Bumped by every change to the file system, for validating cached
+	// information about files; 0 if the implementation does not track it
+	uint32_t generation() const;
+	// Whether path may have changed after generation() returned the given
+	// value; errs on the side of true when the change is too old to tell
+	bool changedSince(const char* path, uint32_t generation) const;
+	bool changedSince(const String& path, uint32_t generation) const
+	{ return changedSince(path.c_str(), generation); }
+
 protected:
 	FSImplPtr _fs_impl;
 };
@@ -232,6 +267,7 @@ using fs::SeekSet;
 using fs::SeekCur;
 using fs::SeekEnd;
 using fs::FSInfo;
+using fs::FSConfig;
 #endif //FS_NO_GLOBALS
 
 #if !defined(NO_GLOBAL_INSTANCES) && !defined(NO_GLOBAL_SPIFFS)
@@ -44,6 +44,11 @@ public:
 	virtual bool rename(const char *pathTo) = 0;
 
 	virtual void close() = 0;
+
+	// what read() has buffered already, see Stream::peekBuffer()
+	virtual size_t peekAvailable() { return 0; }
+	virtual const char* peekBuffer() { return nullptr; }
+	virtual void peekConsume(size_t consume) { (void) consume; }
 };
 
 enum OpenMode {
@@ -91,6 +96,8 @@ public:
 class FSImpl {
 public:
 	virtual bool begin() = 0;
+	// Applies settings for the next begin(), unmounting if needed
+	virtual bool configure(const FSConfig& config) { (void) config; return true; }
 	virtual void end() = 0;
 	virtual bool format() = 0;
 	virtual bool info(FSInfo& info) const = 0;
@@ -103,6 +110,13 @@ public:
 	virtual DirImplPtr openDir(const char* path, bool create) = 0;
 	virtual bool remove(const char* path) = 0;
 	virtual bool rename(const char* pathFrom, const char* pathTo) = 0;
+	// Changes whenever the content may have changed; 0 if not tracked
+	virtual uint32_t generation() const { return 0; }
+	virtual bool changedSince(const char* path, uint32_t generation) const
+	{
+		(void) path;
+		return generation == 0 || generation != this->generation();
+	}
 };
 
 } // namespace fs
@@ -128,6 +128,22 @@ public:
         // this may return -1, but that's okay
         return uart_read_char(_uart);
     }
+    bool hasPeekBufferAPI() const override
+    {
+        return true;
+    }
+    size_t peekAvailable() override
+    {
+        return uart_peek_available(_uart);
+    }
+    const char* peekBuffer() override
+    {
+        return uart_peek_buffer(_uart);
+    }
+    void peekConsume(size_t consume) override
+    {
+        uart_peek_consume(_uart, consume);
+    }
     int availableForWrite(void)
     {
         return static_cast<int>(uart_tx_free(_uart));
@@ -0,0 +1,566 @@
+/*
+ NumberFormat.cpp - number to text conversions shared by Print, String and Stream
+ Copyright (c) 2016 Ivan Grokhotkov. All rights reserved.
+ This file is part of the esp8266 core for Arduino environment.
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pgmspace.h>
+#include "NumberFormat.h"
+
+static const char digitPairs[] PROGMEM =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static inline char digitChar(unsigned digit, bool upperCase) {
+    return (digit < 10) ? '0' + digit : (upperCase ? 'A' : 'a') + digit - 10;
+}
+
+static char* formatDecimal(uint32_t value, char* end) {
+    char* p = end;
+    while (value >= 100) {
+        uint32_t quotient = value / 100;
+        uint32_t pair = 2 * (value - quotient * 100);
+        *--p = pgm_read_byte(&digitPairs[pair + 1]);
+        *--p = pgm_read_byte(&digitPairs[pair]);
+        value = quotient;
+    }
+    if (value >= 10) {
+        *--p = pgm_read_byte(&digitPairs[2 * value + 1]);
+        *--p = pgm_read_byte(&digitPairs[2 * value]);
+    } else {
+        *--p = '0' + value;
+    }
+    return p;
+}
+
+template<typename T>
+static char* formatPowerOfTwo(T value, unsigned shift, char* end, bool upperCase) {
+    char* p = end;
+    const unsigned mask = (1 << shift) - 1;
+    do {
+        *--p = digitChar(value & mask, upperCase);
+        value >>= shift;
+    } while (value);
+    return p;
+}
+
+char* formatUnsigned(uint64_t value, uint8_t base, char* end, bool upperCase) {
+    if (base < 2 || base > 36) {
+        base = 10;
+    }
+    char* p = end;
+    if (base == 10) {
+        // 64 bit divisions are slow, only use them to get down to 32 bits
+        while (value > UINT32_MAX) {
+            uint64_t quotient = value / 100000000;
+            char* stop = p - 8;
+            p = formatDecimal(value - quotient * 100000000, p);
+            while (p > stop) {
+                *--p = '0';
+            }
+            value = quotient;
+        }
+        return formatDecimal(value, p);
+    }
+    if ((base & (base - 1)) == 0) {
+        unsigned shift = __builtin_ctz(base);
+        if (value > UINT32_MAX) {
+            return formatPowerOfTwo<uint64_t>(value, shift, p, upperCase);
+        }
+        return formatPowerOfTwo<uint32_t>(value, shift, p, upperCase);
+    }
+    while (value > UINT32_MAX) {
+        uint64_t quotient = value / base;
+        *--p = digitChar(value - quotient * base, upperCase);
+        value = quotient;
+    }
+    uint32_t rest = value;
+    do {
+        uint32_t quotient = rest / base;
+        *--p = digitChar(rest - quotient * base, upperCase);
+        rest = quotient;
+    } while (rest);
+    return p;
+}
+
+char* formatSigned(int64_t value, uint8_t base, char* end, bool upperCase) {
+    if (value >= 0) {
+        return formatUnsigned(value, base, end, upperCase);
+    }
+    char* p = formatUnsigned(-(uint64_t) value, base, end, upperCase);
+    *--p = '-';
+    return p;
+}
+
+// Shortest digits, using Grisu2 (Florian Loitsch, "Printing Floating-Point
+// Numbers Quickly and Accurately with Integers", 2010). The digits always
+// read back as the same value, and are the shortest such in all but a
+// fraction of a percent of cases, where one more digit than needed comes out.
+
+struct DiyFp {
+    uint64_t f;
+    int e;
+};
+
+struct CachedPower {
+    uint64_t f;
+    int16_t e;
+    int16_t k;
+};
+
+// 10^k ~= f * 2^e, for k = -300, -292, ..., 324
+static const CachedPower cachedPowers[] PROGMEM = {
+    { 0xAB70FE17C79AC6CAULL, -1060, -300 },
+    { 0xFF77B1FCBEBCDC4FULL, -1034, -292 },
+    { 0xBE5691EF416BD60CULL, -1007, -284 },
+    { 0x8DD01FAD907FFC3CULL,  -980, -276 },
+    { 0xD3515C2831559A83ULL,  -954, -268 },
+    { 0x9D71AC8FADA6C9B5ULL,  -927, -260 },
+    { 0xEA9C227723EE8BCBULL,  -901, -252 },
+    { 0xAECC49914078536DULL,  -874, -244 },
+    { 0x823C12795DB6CE57ULL,  -847, -236 },
+    { 0xC21094364DFB5637ULL,  -821, -228 },
+    { 0x9096EA6F3848984FULL,  -794, -220 },
+    { 0xD77485CB25823AC7ULL,  -768, -212 },
+    { 0xA086CFCD97BF97F4ULL,  -741, -204 },
+    { 0xEF340A98172AACE5ULL,  -715, -196 },
+    { 0xB23867FB2A35B28EULL,  -688, -188 },
+    { 0x84C8D4DFD2C63F3BULL,  -661, -180 },
+    { 0xC5DD44271AD3CDBAULL,  -635, -172 },
+    { 0x936B9FCEBB25C996ULL,  -608, -164 },
+    { 0xDBAC6C247D62A584ULL,  -582, -156 },
+    { 0xA3AB66580D5FDAF6ULL,  -555, -148 },
+    { 0xF3E2F893DEC3F126ULL,  -529, -140 },
+    { 0xB5B5ADA8AAFF80B8ULL,  -502, -132 },
+    { 0x87625F056C7C4A8BULL,  -475, -124 },
+    { 0xC9BCFF6034C13053ULL,  -449, -116 },
+    { 0x964E858C91BA2655ULL,  -422, -108 },
+    { 0xDFF9772470297EBDULL,  -396, -100 },
+    { 0xA6DFBD9FB8E5B88FULL,  -369,  -92 },
+    { 0xF8A95FCF88747D94ULL,  -343,  -84 },
+    { 0xB94470938FA89BCFULL,  -316,  -76 },
+    { 0x8A08F0F8BF0F156BULL,  -289,  -68 },
+    { 0xCDB02555653131B6ULL,  -263,  -60 },
+    { 0x993FE2C6D07B7FACULL,  -236,  -52 },
+    { 0xE45C10C42A2B3B06ULL,  -210,  -44 },
+    { 0xAA242499697392D3ULL,  -183,  -36 },
+    { 0xFD87B5F28300CA0EULL,  -157,  -28 },
+    { 0xBCE5086492111AEBULL,  -130,  -20 },
+    { 0x8CBCCC096F5088CCULL,  -103,  -12 },
+    { 0xD1B71758E219652CULL,   -77,   -4 },
+    { 0x9C40000000000000ULL,   -50,    4 },
+    { 0xE8D4A51000000000ULL,   -24,   12 },
+    { 0xAD78EBC5AC620000ULL,     3,   20 },
+    { 0x813F3978F8940984ULL,    30,   28 },
+    { 0xC097CE7BC90715B3ULL,    56,   36 },
+    { 0x8F7E32CE7BEA5C70ULL,    83,   44 },
+    { 0xD5D238A4ABE98068ULL,   109,   52 },
+    { 0x9F4F2726179A2245ULL,   136,   60 },
+    { 0xED63A231D4C4FB27ULL,   162,   68 },
+    { 0xB0DE65388CC8ADA8ULL,   189,   76 },
+    { 0x83C7088E1AAB65DBULL,   216,   84 },
+    { 0xC45D1DF942711D9AULL,   242,   92 },
+    { 0x924D692CA61BE758ULL,   269,  100 },
+    { 0xDA01EE641A708DEAULL,   295,  108 },
+    { 0xA26DA3999AEF774AULL,   322,  116 },
+    { 0xF209787BB47D6B85ULL,   348,  124 },
+    { 0xB454E4A179DD1877ULL,   375,  132 },
+    { 0x865B86925B9BC5C2ULL,   402,  140 },
+    { 0xC83553C5C8965D3DULL,   428,  148 },
+    { 0x952AB45CFA97A0B3ULL,   455,  156 },
+    { 0xDE469FBD99A05FE3ULL,   481,  164 },
+    { 0xA59BC234DB398C25ULL,   508,  172 },
+    { 0xF6C69A72A3989F5CULL,   534,  180 },
+    { 0xB7DCBF5354E9BECEULL,   561,  188 },
+    { 0x88FCF317F22241E2ULL,   588,  196 },
+    { 0xCC20CE9BD35C78A5ULL,   614,  204 },
+    { 0x98165AF37B2153DFULL,   641,  212 },
+    { 0xE2A0B5DC971F303AULL,   667,  220 },
+    { 0xA8D9D1535CE3B396ULL,   694,  228 },
+    { 0xFB9B7CD9A4A7443CULL,   720,  236 },
+    { 0xBB764C4CA7A44410ULL,   747,  244 },
+    { 0x8BAB8EEFB6409C1AULL,   774,  252 },
+    { 0xD01FEF10A657842CULL,   800,  260 },
+    { 0x9B10A4E5E9913129ULL,   827,  268 },
+    { 0xE7109BFBA19C0C9DULL,   853,  276 },
+    { 0xAC2820D9623BF429ULL,   880,  284 },
+    { 0x80444B5E7AA7CF85ULL,   907,  292 },
+    { 0xBF21E44003ACDD2DULL,   933,  300 },
+    { 0x8E679C2F5E44FF8FULL,   960,  308 },
+    { 0xD433179D9C8CB841ULL,   986,  316 },
+    { 0x9E19DB92B4E31BA9ULL,  1013,  324 },
+};
+
+static DiyFp multiply(DiyFp x, DiyFp y) {
+    uint64_t xLow = x.f & 0xffffffff;
+    uint64_t xHigh = x.f >> 32;
+    uint64_t yLow = y.f & 0xffffffff;
+    uint64_t yHigh = y.f >> 32;
+    uint64_t low = xLow * yLow;
+    uint64_t mid1 = xLow * yHigh;
+    uint64_t mid2 = xHigh * yLow;
+    uint64_t high = xHigh * yHigh;
+    uint64_t mid = (low >> 32) + (mid1 & 0xffffffff) + (mid2 & 0xffffffff);
+    mid += 1U << 31; // round
+    return { high + (mid1 >> 32) + (mid2 >> 32) + (mid >> 32), x.e + y.e + 64 };
+}
+
+static DiyFp normalize(DiyFp x) {
+    while (!(x.f >> 63)) {
+        x.f <<= 1;
+        --x.e;
+    }
+    return x;
+}
+
+static int generateDigits(char* digits, int& exponent, DiyFp low, DiyFp w, DiyFp high) {
+    uint64_t delta = high.f - low.f;
+    uint64_t distance = high.f - w.f;
+    const int shift = -high.e;
+    const uint64_t one = 1ULL << shift;
+    uint32_t integral = high.f >> shift;
+    uint64_t fraction = high.f & (one - 1);
+    int length = 0;
+    uint64_t rest;
+    uint64_t unit;
+
+    uint32_t power = 1;
+    int count = 1;
+    while (count < 10 && integral / power >= 10) {
+        power *= 10;
+        ++count;
+    }
+
+    for (;;) {
+        if (count > 0) {
+            uint32_t digit = integral / power;
+            integral -= digit * power;
+            digits[length++] = '0' + digit;
+            --count;
+            rest = ((uint64_t) integral << shift) + fraction;
+            if (rest <= delta) {
+                exponent += count;
+                unit = (uint64_t) power << shift;
+                break;
+            }
+            power /= 10;
+        } else {
+            fraction *= 10;
+            digits[length++] = '0' + (fraction >> shift);
+            fraction &= one - 1;
+            delta *= 10;
+            distance *= 10;
+            --exponent;
+            if (fraction <= delta) {
+                rest = fraction;
+                unit = one;
+                break;
+            }
+        }
+    }
+
+    // move the last digit towards w while it stays within the bounds
+    while (rest < distance && delta - rest >= unit &&
+           (rest + unit < distance || distance - rest > rest + unit - distance)) {
+        --digits[length - 1];
+        rest += unit;
+    }
+    return length;
+}
+
+// value = fraction * 2^(exponent - bias), with the hidden bit for precision
+// still to be added unless exponent is 0
+static int shortestDigits(uint64_t fraction, int exponent, int precision, int bias, char* digits, int& decimalExponent) {
+    const uint64_t hidden = 1ULL << (precision - 1);
+    DiyFp v = exponent ? DiyFp{ fraction + hidden, exponent - bias } : DiyFp{ fraction, 1 - bias };
+
+    // the bounds halfway to the neighbouring values, closer below powers of two
+    DiyFp high = normalize({ 2 * v.f + 1, v.e - 1 });
+    DiyFp low = (fraction == 0 && exponent > 1) ? DiyFp{ 4 * v.f - 1, v.e - 2 } : DiyFp{ 2 * v.f - 1, v.e - 1 };
+    low = { low.f << (low.e - high.e), high.e };
+    v = normalize(v);
+
+    // scale so that high.e ends up in -60..-32
+    int e = -60 - high.e - 1;
+    int k = (e * 78913) / (1 << 18) + (e > 0);
+    CachedPower cached;
+    memcpy_P(&cached, &cachedPowers[(300 + k + 7) / 8], sizeof(cached));
+    DiyFp power = { cached.f, cached.e };
+    DiyFp w = multiply(v, power);
+    low = multiply(low, power);
+    high = multiply(high, power);
+    ++low.f;
+    --high.f;
+
+    decimalExponent = -cached.k;
+    return generateDigits(digits, decimalExponent, low, w, high);
+}
+
+static int shortestDigits(double value, char* digits, int& exponent) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return shortestDigits(bits & ((1ULL << 52) - 1), (bits >> 52) & 0x7ff, 53, 1075, digits, exponent);
+}
+
+static int shortestDigits(float value, char* digits, int& exponent) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return shortestDigits(bits & ((1UL << 23) - 1), (bits >> 23) & 0xff, 24, 150, digits, exponent);
+}
+
+static size_t writeShortest(bool negative, const char* digits, int length, int exponent, char* buffer) {
+    char* p = buffer;
+    if (negative) {
+        *p++ = '-';
+    }
+    int point = length + exponent;
+    if (exponent >= 0 && point <= 21) {
+        memcpy(p, digits, length);
+        p += length;
+        memset(p, '0', exponent);
+        p += exponent;
+    } else if (point > 0 && point <= 21) {
+        memcpy(p, digits, point);
+        p += point;
+        *p++ = '.';
+        memcpy(p, digits + point, length - point);
+        p += length - point;
+    } else if (point > -6 && point <= 0) {
+        *p++ = '0';
+        *p++ = '.';
+        memset(p, '0', -point);
+        p += -point;
+        memcpy(p, digits, length);
+        p += length;
+    } else {
+        *p++ = digits[0];
+        if (length > 1) {
+            *p++ = '.';
+            memcpy(p, digits + 1, length - 1);
+            p += length - 1;
+        }
+        *p++ = 'e';
+        *p++ = (point > 0) ? '+' : '-';
+        char buf[4];
+        char* end = &buf[sizeof(buf)];
+        char* str = formatDecimal(abs(point - 1), end);
+        memcpy(p, str, end - str);
+        p += end - str;
+    }
+    return p - buffer;
+}
+
+template<typename T>
+static size_t formatShortestImpl(T value, char* buffer) {
+    if (isnan(value)) {
+        memcpy(buffer, "nan", 3);
+        return 3;
+    }
+    bool negative = signbit(value);
+    char* p = buffer;
+    if (negative) {
+        *p++ = '-';
+        value = -value;
+    }
+    if (isinf(value)) {
+        memcpy(p, "inf", 3);
+        return p + 3 - buffer;
+    }
+    if (value == 0) {
+        *p = '0';
+        return p + 1 - buffer;
+    }
+    char digits[18];
+    int exponent;
+    int length = shortestDigits(value, digits, exponent);
+    return writeShortest(negative, digits, length, exponent, buffer);
+}
+
+size_t formatShortest(double value, char* buffer) {
+    return formatShortestImpl(value, buffer);
+}
+
+size_t formatShortest(float value, char* buffer) {
+    return formatShortestImpl(value, buffer);
+}
+
+// Fraction digits of m / 2^shift for shifts past what fits in 64 bits, one
+// multiplication by 10 of a multi word number per digit. Returns whether the
+// rest rounds the last digit up.
+static bool longFractionDigits(uint64_t m, unsigned shift, char* digits, unsigned count) {
+    uint32_t words[(1074 + 31) / 32] = { 0 };
+    const unsigned size = (shift + 31) / 32;
+    // make it m * 2^up / 2^(32 * size), least significant word first
+    const unsigned up = 32 * size - shift;
+    uint64_t low = m << up;
+    words[0] = low;
+    words[1] = low >> 32;
+    if (size > 2 && up) {
+        words[2] = m >> (64 - up);
+    }
+    unsigned lowest = 0;
+    for (unsigned i = 0; i < count; ++i) {
+        uint32_t carry = 0;
+        for (unsigned j = lowest; j < size; ++j) {
+            uint64_t t = (uint64_t) words[j] * 10 + carry;
+            words[j] = t;
+            carry = t >> 32;
+        }
+        digits[i] = '0' + carry;
+        while (lowest < size && !words[lowest]) {
+            ++lowest;
+        }
+    }
+    return words[size - 1] >= 0x80000000;
+}
+
+size_t formatFixed(double value, unsigned int decimals, char* buffer, size_t size) {
+    if (isnan(value) || isinf(value)) {
+        if (size >= 3) {
+            memcpy(buffer, isnan(value) ? "nan" : "inf", 3);
+        }
+        return 3;
+    }
+
+    // value = m * 2^e
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const bool negative = value < 0;
+    const unsigned biased = (bits >> 52) & 0x7ff;
+    uint64_t m = bits & ((1ULL << 52) - 1);
+    int e = -1074;
+    if (biased) {
+        m |= 1ULL << 52;
+        e = biased - 1075;
+    }
+
+    const size_t fraction = decimals ? decimals + 1 : 0;
+    if (e > 11) {
+        // 2^64 and up, which is an integer with more digits than a double
+        // keeps: the shortest digits, then zeros
+        char digits[18];
+        int exponent;
+        int length = shortestDigits(negative ? -value : value, digits, exponent);
+        size_t need = negative + length + exponent + fraction;
+        if (need <= size) {
+            char* p = buffer;
+            if (negative) {
+                *p++ = '-';
+            }
+            memcpy(p, digits, length);
+            memset(p + length, '0', exponent + fraction);
+            if (decimals) {
+                p[length + exponent] = '.';
+            }
+        }
+        return need;
+    }
+
+    // The integer part goes right before the point, and is formatted after
+    // the fraction, which can carry into it when rounding. So there must be
+    // room for the longest one.
+    const size_t point = negative + 20;
+    if (point + fraction > size) {
+        return point + fraction;
+    }
+    char* digits = buffer + point + 1;
+    uint64_t integer = 0;
+    bool roundUp = false;
+    if (e >= 0) {
+        integer = m << e;
+        memset(digits, '0', decimals);
+    } else if (e >= -60) {
+        const unsigned shift = -e;
+        const uint64_t mask = (1ULL << shift) - 1;
+        uint64_t rest = m & mask;
+        integer = m >> shift;
+        for (unsigned i = 0; i < decimals; ++i) {
+            rest *= 10;
+            digits[i] = '0' + (rest >> shift);
+            rest &= mask;
+        }
+        roundUp = rest >= (1ULL << (shift - 1));
+    } else {
+        roundUp = longFractionDigits(m, -e, digits, decimals);
+    }
+
+    if (roundUp) {
+        unsigned i = decimals;
+        while (i && digits[i - 1] == '9') {
+            digits[--i] = '0';
+        }
+        if (i) {
+            ++digits[i - 1];
+        } else {
+            ++integer;
+        }
+    }
+    if (decimals) {
+        buffer[point] = '.';
+    }
+    char* start = formatUnsigned(integer, 10, buffer + point);
+    if (negative) {
+        *--start = '-';
+    }
+    size_t length = buffer + point + fraction - start;
+    memmove(buffer, start, length);
+    return length;
+}
+
+static const double exactPowers[] PROGMEM = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5,
+    1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+    1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+double decimalToDouble(uint64_t significand, int exponent) {
+    double value = significand;
+    if (!significand) {
+        return value;
+    }
+    // a single rounding when both the significand and the power of ten are
+    // exact, several otherwise
+    while (exponent > 22) {
+        value *= 1e22;
+        exponent -= 22;
+        if (isinf(value)) {
+            return value;
+        }
+    }
+    while (exponent < -22) {
+        value /= 1e22;
+        exponent += 22;
+        if (value == 0) {
+            return value;
+        }
+    }
+    double power;
+    memcpy_P(&power, &exactPowers[(exponent < 0) ? -exponent : exponent], sizeof(power));
+    return (exponent < 0) ? value / power : value * power;
+}
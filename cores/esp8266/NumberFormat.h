@@ -0,0 +1,58 @@
+/*
+ NumberFormat.h - number to text conversions shared by Print, String and Stream
+ Copyright (c) 2016 Ivan Grokhotkov. All rights reserved.
+ This file is part of the esp8266 core for Arduino environment.
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __NumberFormat_h
+#define __NumberFormat_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Room formatUnsigned and formatSigned need: 64 binary digits and a sign
+#define NUMBER_FORMAT_INT_SIZE (8 * sizeof(uint64_t) + 1)
+// Room formatShortest needs, e.g. "-0.0000012345678901234567"
+#define NUMBER_FORMAT_SHORTEST_SIZE 25
+
+// Writes value in base 2 to 36 (anything else means 10) backwards, ending
+// right before end, and returns where it starts. Base 10 goes two digits per
+// division. Nothing is terminated.
+char* formatUnsigned(uint64_t value, uint8_t base, char* end, bool upperCase = false);
+// same, with a '-' in front of negative values, in any base
+char* formatSigned(int64_t value, uint8_t base, char* end, bool upperCase = false);
+
+// Writes value with exactly decimals digits after the point, rounded from
+// its exact binary value like "%.*f" does, but with ties going away from
+// zero. NaN and infinities come out as "nan" and "inf", and values of 2^64
+// and more as their shortest digits followed by zeros.
+// Returns the length. When that is larger than size nothing useful was
+// written, and the returned length is enough room to call again with.
+// Nothing is terminated.
+size_t formatFixed(double value, unsigned int decimals, char* buffer, size_t size);
+
+// Writes the shortest text that reads back as exactly value, in plain
+// notation for values from 1e-6 up to 1e21 and as 1.5e+22 otherwise.
+// Needs NUMBER_FORMAT_SHORTEST_SIZE bytes, returns the length.
+size_t formatShortest(double value, char* buffer);
+size_t formatShortest(float value, char* buffer);
+
+// significand * 10^exponent, correctly rounded as long as significand is
+// below 2^53 and exponent within +-22, which covers what people type
+double decimalToDouble(uint64_t significand, int exponent);
+
+#endif
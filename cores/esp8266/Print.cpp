@@ -28,6 +28,7 @@
 #include <Arduino.h>
 
 #include "Print.h"
+#include "NumberFormat.h"
 
 // Public Methods //////////////////////////////////////////////////////////////
 
@@ -104,11 +105,20 @@ size_t Print::printf_P(PGM_P format, ...) {
 size_t Print::print(const __FlashStringHelper *ifsh) {
     PGM_P p = reinterpret_cast<PGM_P>(ifsh);
 
+    // copied out of flash in blocks, and written as such
+    char buf[64];
+    size_t len = strlen_P(p);
     size_t n = 0;
-    while (1) {
-        uint8_t c = pgm_read_byte(p++);
-        if (c == 0) break;
-        n += write(c);
+    while (len) {
+        size_t chunk = (len < sizeof(buf)) ? len : sizeof(buf);
+        memcpy_P(buf, p, chunk);
+        size_t written = write((const uint8_t*) buf, chunk);
+        n += written;
+        if (written != chunk) {
+            break;
+        }
+        p += chunk;
+        len -= chunk;
     }
     return n;
 }
@@ -142,9 +152,7 @@ size_t Print::print(long n, int base) {
         return write(n);
     } else if(base == 10) {
         if(n < 0) {
-            int t = print('-');
-            n = -n;
-            return printNumber(n, 10) + t;
+            return printNumber(-(unsigned long) n, 10, true);
         }
         return printNumber(n, 10);
     } else {
@@ -239,29 +247,17 @@ size_t Print::println(const Printable& x) {
 
 // Private Methods /////////////////////////////////////////////////////////////
 
-size_t Print::printNumber(unsigned long n, uint8_t base) {
-    char buf[8 * sizeof(long) + 1]; // Assumes 8-bit chars plus zero byte.
-    char *str = &buf[sizeof(buf) - 1];
-
-    *str = '\0';
-
-    // prevent crash if called with base == 1
-    if(base < 2)
-        base = 10;
-
-    do {
-        unsigned long m = n;
-        n /= base;
-        char c = m - base * n;
-        *--str = c < 10 ? c + '0' : c + 'A' - 10;
-    } while(n);
+size_t Print::printNumber(unsigned long n, uint8_t base, bool negative) {
+    char buf[NUMBER_FORMAT_INT_SIZE];
+    char *end = &buf[sizeof(buf)];
+    char *str = formatUnsigned(n, base, end, true);
+    if(negative)
+        *--str = '-';
 
-    return write(str);
+    return write((const uint8_t *) str, end - str);
 }
 
 size_t Print::printFloat(double number, uint8_t digits) {
-    size_t n = 0;
-
     if(isnan(number))
         return print("nan");
     if(isinf(number))
@@ -271,36 +267,17 @@ size_t Print::printFloat(double number, uint8_t digits) {
     if(number < -4294967040.0)
         return print("ovf");  // constant determined empirically
 
-    // Handle negative numbers
-    if(number < 0.0) {
-        n += print('-');
-        number = -number;
-    }
-
-    // Round correctly so that print(1.999, 2) prints as "2.00"
-    double rounding = 0.5;
-    for(uint8_t i = 0; i < digits; ++i)
-        rounding /= 10.0;
-
-    number += rounding;
-
-    // Extract the integer part of the number and print it
-    unsigned long int_part = (unsigned long) number;
-    double remainder = number - (double) int_part;
-    n += print(int_part);
-
-    // Print the decimal point, but only if there are digits beyond
-    if(digits > 0) {
-        n += print(".");
-    }
-
-    // Extract digits from the remainder one at a time
-    while(digits-- > 0) {
-        remainder *= 10.0;
-        int toPrint = int(remainder);
-        n += print(toPrint);
-        remainder -= toPrint;
-    }
-
-    return n;
+    char buf[48];
+    size_t len = formatFixed(number, digits, buf, sizeof(buf));
+    if(len <= sizeof(buf))
+        return write((const uint8_t *) buf, len);
+
+    // lots of digits
+    char* buffer = new char[len];
+    if(!buffer)
+        return 0;
+    len = formatFixed(number, digits, buffer, len);
+    len = write((const uint8_t *) buffer, len);
+    delete[] buffer;
+    return len;
 }
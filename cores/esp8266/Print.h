@@ -34,7 +34,7 @@
 class Print {
     private:
         int write_error;
-        size_t printNumber(unsigned long, uint8_t);
+        size_t printNumber(unsigned long, uint8_t, bool negative = false);
         size_t printFloat(double, uint8_t);
     protected:
         void setWriteError(int err = 1) {
@@ -1,78 +1,197 @@
+#include <stddef.h>
+#include <string.h>
+#include <Arduino.h>
 #include "Schedule.h"
 
+#ifdef ARDUINO
+#include "interrupts.h"
+// Interrupt handlers may schedule functions too. The sections this guards
+// are a few instructions, the lx106 has no compare-and-swap to do without.
+#define SCHEDULE_LOCK() InterruptLock lock
+#else
+#define SCHEDULE_LOCK()
+#define ICACHE_RAM_ATTR
+#endif
+
+static_assert((SCHEDULED_FN_MAX_COUNT & (SCHEDULED_FN_MAX_COUNT - 1)) == 0 &&
+              SCHEDULED_FN_MAX_COUNT <= 256,
+              "SCHEDULED_FN_MAX_COUNT must be a power of two, at most 256");
+static_assert(SCHEDULED_RECURRENT_MAX_COUNT <= 32,
+              "SCHEDULED_RECURRENT_MAX_COUNT must be at most 32");
+
+static const uint8_t NO_STATS = 0xff;
+
 struct scheduled_fn_t
 {
-    scheduled_fn_t* mNext;
-    std::function<void(void)> mFunc;
+    alignas(SCHEDULED_FN_INLINE_ALIGN) uint8_t mStorage[SCHEDULED_FN_INLINE_SIZE];
+    scheduled_fn_invoke_t mInvoke;
+    uint32_t mNotBefore;    // micros()
+    uint32_t mRepeat;       // us, 0 for functions that run once
+    bool mDelayed;
+    uint8_t mStats;         // index into sStats of a recurrent function
 };
 
-static scheduled_fn_t* sFirst = 0;
-static scheduled_fn_t* sLast = 0;
+// Queued entries, by index into sFns. A queue is only ever emptied by
+// run_scheduled_functions, so mHead is left alone by everyone else and only
+// adding to it needs the lock. Every entry is in one queue at most, so they
+// can't overflow.
+struct scheduled_queue_t
+{
+    uint8_t mItems[SCHEDULED_FN_MAX_COUNT];
+    volatile uint32_t mHead;
+    volatile uint32_t mTail;
+};
 
-static scheduled_fn_t* sFirstUnused = 0;
-static scheduled_fn_t* sLastUnused = 0;
+static scheduled_fn_t sFns[SCHEDULED_FN_MAX_COUNT];
+static scheduled_queue_t sQueues[SCHEDULE_PRIORITY_COUNT];
 
-static int sCount = 0;
+// free entries, as a stack of indices into sFns
+static uint8_t sUnused[SCHEDULED_FN_MAX_COUNT];
+static int sUnusedCount = -1;
 
-static scheduled_fn_t* get_fn() {
-    scheduled_fn_t* result = NULL;
-    // try to get an item from unused items list
-    if (sFirstUnused) {
-        result = sFirstUnused;
-        sFirstUnused = result->mNext;
-        if (sFirstUnused == NULL) {
-            sLastUnused = NULL;
-        }
+static scheduled_fn_stats_t sStats[SCHEDULED_RECURRENT_MAX_COUNT];
+static uint32_t sStatsUsed;     // bit per sStats entry
+
+static uint32_t sBudgetUs = SCHEDULED_FN_BUDGET_US;
+
+static void ICACHE_RAM_ATTR init_unused()
+{
+    for (int i = 0; i < SCHEDULED_FN_MAX_COUNT; ++i) {
+        sUnused[i] = SCHEDULED_FN_MAX_COUNT - 1 - i;
     }
-    // if no unused items, and count not too high, allocate a new one
-    else if (sCount != SCHEDULED_FN_MAX_COUNT) {
-        result = new scheduled_fn_t;
-        result->mNext = NULL;
-        ++sCount;
+    sUnusedCount = SCHEDULED_FN_MAX_COUNT;
+}
+
+static void ICACHE_RAM_ATTR push_queue(scheduled_queue_t& queue, uint8_t index)
+{
+    SCHEDULE_LOCK();
+    queue.mItems[queue.mTail % SCHEDULED_FN_MAX_COUNT] = index;
+    queue.mTail = queue.mTail + 1;
+}
+
+static void recycle_fn(uint8_t index)
+{
+    SCHEDULE_LOCK();
+    uint8_t stats = sFns[index].mStats;
+    if (stats != NO_STATS) {
+        sStatsUsed &= ~(1u << stats);
     }
-    return result;
+    sUnused[sUnusedCount++] = index;
 }
 
-static void recycle_fn(scheduled_fn_t* fn)
+void* ICACHE_RAM_ATTR scheduled_fn_reserve(bool recurrent)
 {
-    if (!sLastUnused) {
-        sFirstUnused = fn;
+    SCHEDULE_LOCK();
+    if (sUnusedCount < 0) {
+        init_unused();
+    }
+    if (sUnusedCount == 0) {
+        return NULL;
     }
-    else {
-        sLastUnused->mNext = fn;
+    uint8_t stats = NO_STATS;
+    if (recurrent) {
+        for (stats = 0; stats < SCHEDULED_RECURRENT_MAX_COUNT && (sStatsUsed & (1u << stats)); ++stats);
+        if (stats == SCHEDULED_RECURRENT_MAX_COUNT) {
+            return NULL;
+        }
+        sStatsUsed |= 1u << stats;
+        memset(&sStats[stats], 0, sizeof(sStats[stats]));
     }
-    fn->mNext = NULL;
-    sLastUnused = fn;
+    scheduled_fn_t* item = &sFns[sUnused[--sUnusedCount]];
+    item->mStats = stats;
+    return item->mStorage;
 }
 
-bool schedule_function(std::function<void(void)> fn)
+int ICACHE_RAM_ATTR scheduled_fn_commit(void* storage, scheduled_fn_invoke_t invoke,
+                                        uint32_t delayUs, uint32_t repeatUs,
+                                        schedule_priority_t priority)
 {
-    scheduled_fn_t* item = get_fn();
-    if (!item) {
+    scheduled_fn_t* item = reinterpret_cast<scheduled_fn_t*>(storage);
+    item->mInvoke = invoke;
+    item->mDelayed = delayUs != 0;
+    item->mNotBefore = micros() + delayUs;
+    item->mRepeat = repeatUs;
+    if ((unsigned) priority >= SCHEDULE_PRIORITY_COUNT) {
+        priority = SCHEDULE_PRIORITY_LOW;
+    }
+    push_queue(sQueues[priority], item - sFns);
+    return item->mStats == NO_STATS ? 0 : item->mStats;
+}
+
+bool get_scheduled_function_stats(int id, scheduled_fn_stats_t& stats)
+{
+    if (id < 0 || id >= SCHEDULED_RECURRENT_MAX_COUNT || !(sStatsUsed & (1u << id))) {
         return false;
     }
-    item->mFunc = fn;
-    item->mNext = NULL;
-    if (!sFirst) {
-        sFirst = item;
+    stats = sStats[id];
+    return true;
+}
+
+void set_scheduled_functions_budget_us(uint32_t budgetUs)
+{
+    sBudgetUs = budgetUs;
+}
+
+bool schedule_function(std::function<void(void)> fn)
+{
+    return schedule_function_us(std::move(fn), 0);
+}
+
+// Runs a recurrent function and works out when it is due next
+static bool run_recurrent(scheduled_fn_t& item, uint32_t start)
+{
+    scheduled_fn_stats_t& stats = sStats[item.mStats];
+    uint32_t late = start - item.mNotBefore;
+    bool again = item.mInvoke(item.mStorage);
+    uint32_t runUs = micros() - start;
+
+    ++stats.runs;
+    stats.totalRunUs += runUs;
+    if (runUs > stats.maxRunUs) {
+        stats.maxRunUs = runUs;
     }
-    else {
-        sLast->mNext = item;
+    if (late > stats.maxLateUs) {
+        stats.maxLateUs = late;
     }
-    sLast = item;
-    return true;
+    // keep the phase, skipping the periods that were missed
+    uint32_t missed = (late + runUs) / item.mRepeat;
+    stats.overruns += missed;
+    item.mNotBefore += (missed + 1) * item.mRepeat;
+    return again;
 }
 
 void run_scheduled_functions()
 {
-	scheduled_fn_t* rFirst = sFirst;
-	sFirst = NULL;
-	sLast  = NULL;
-    while (rFirst) {
-        scheduled_fn_t* item = rFirst;
-        rFirst = item->mNext;
-        item->mFunc();
-        item->mFunc = std::function<void(void)>();
-        recycle_fn(item);
+    uint32_t start = micros();
+    uint32_t now = start;
+    for (int priority = 0; priority < SCHEDULE_PRIORITY_COUNT; ++priority) {
+        scheduled_queue_t& queue = sQueues[priority];
+        // only the ones queued so far, later ones wait for the next run
+        uint32_t tail = queue.mTail;
+        while (queue.mHead != tail) {
+            if (sBudgetUs && now - start >= sBudgetUs) {
+                // the rest stays queued, in order
+                return;
+            }
+            uint8_t index = queue.mItems[queue.mHead % SCHEDULED_FN_MAX_COUNT];
+            queue.mHead = queue.mHead + 1;
+            scheduled_fn_t& item = sFns[index];
+            if (item.mDelayed && (int32_t) (item.mNotBefore - now) > 0) {
+                push_queue(queue, index);
+                continue;
+            }
+            bool again;
+            if (item.mRepeat) {
+                again = run_recurrent(item, now);
+            } else {
+                again = item.mInvoke(item.mStorage);
+            }
+            if (again) {
+                push_queue(queue, index);
+            } else {
+                recycle_fn(index);
+            }
+            now = micros();
+        }
     }
 }
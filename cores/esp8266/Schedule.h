@@ -1,17 +1,47 @@
 #ifndef ESP_SCHEDULE_H
 #define ESP_SCHEDULE_H
 
+#include <stddef.h>
+#include <stdint.h>
 #include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
 
 #define SCHEDULED_FN_MAX_COUNT 32
-#define SCHEDULED_FN_INITIAL_COUNT 4
 
-// Warning 
-// This API is not considered stable. 
+// Recurrent functions, each keeps an entry in the SCHEDULED_FN_MAX_COUNT too
+#define SCHEDULED_RECURRENT_MAX_COUNT 8
+
+// Once scheduled functions have run for this long, the ones left are run
+// the next time, so that `loop` returns to the WiFi stack in time
+#define SCHEDULED_FN_BUDGET_US 10000
+
+// Bytes of storage each scheduled function has for its callable: a lambda
+// capturing up to four pointers, or a std::function. Larger callables are
+// wrapped in a std::function, which allocates.
+#define SCHEDULED_FN_INLINE_SIZE (4 * sizeof(void*))
+#define SCHEDULED_FN_INLINE_ALIGN 8
+
+// The templates below are forced inline, so that scheduling from a function
+// in IRAM runs no code from flash other than the callable's constructor
+#define SCHEDULED_FN_ALWAYS_INLINE inline __attribute__((always_inline))
+
+// Warning
+// This API is not considered stable.
 // Function signatures will change.
 // You have been warned.
 
-// Run given function next time `loop` function returns, 
+// Higher priority functions run first, functions of the same priority run
+// in the order they were scheduled.
+enum schedule_priority_t {
+    SCHEDULE_PRIORITY_HIGH,
+    SCHEDULE_PRIORITY_NORMAL,
+    SCHEDULE_PRIORITY_LOW,
+    SCHEDULE_PRIORITY_COUNT
+};
+
+// Run given function next time `loop` function returns,
 // or `run_scheduled_functions` is called.
 // Use std::bind to pass arguments to a function, or call a class member function.
 // Note: there is no mechanism for cancelling scheduled functions.
@@ -19,9 +49,141 @@
 // Returns false if the number of scheduled functions exceeds SCHEDULED_FN_MAX_COUNT.
 bool schedule_function(std::function<void(void)> fn);
 
-// Run all scheduled functions. 
+// Same, for any callable. Functions are kept in a fixed table, callables that
+// fit in SCHEDULED_FN_INLINE_SIZE are stored there without using the heap.
+// Such callables can be scheduled from an ICACHE_RAM_ATTR interrupt handler
+// too, e.g. to defer the work of a pin interrupt to `loop`: apart from the
+// IRAM entry points scheduled_fn_reserve and scheduled_fn_commit, only the
+// callable's copy or move runs, inline for lambdas capturing pointers and
+// integers. Larger callables, wrapped in a std::function, are not ISR safe.
+template<typename F>
+SCHEDULED_FN_ALWAYS_INLINE bool schedule_function(F&& fn, schedule_priority_t priority = SCHEDULE_PRIORITY_NORMAL);
+
+// Run given function once at least delayUs microseconds have passed, the
+// next time scheduled functions are run after that. Delays up to 2^31 us.
+template<typename F>
+SCHEDULED_FN_ALWAYS_INLINE bool schedule_function_us(F&& fn, uint32_t delayUs,
+                          schedule_priority_t priority = SCHEDULE_PRIORITY_NORMAL);
+
+// Run given function every repeatUs microseconds, until it returns false.
+// The first run is repeatUs from now. Runs that are late by more than
+// repeatUs are counted as overruns, and the periods missed are skipped.
+// Returns an id for get_scheduled_function_stats, valid until the function
+// returns false, or -1 if SCHEDULED_RECURRENT_MAX_COUNT are running already.
+template<typename F>
+SCHEDULED_FN_ALWAYS_INLINE int schedule_recurrent_function_us(F&& fn, uint32_t repeatUs,
+                                   schedule_priority_t priority = SCHEDULE_PRIORITY_NORMAL);
+
+struct scheduled_fn_stats_t
+{
+    uint32_t runs;
+    uint32_t overruns;      // periods skipped because a run came too late
+    uint32_t maxLateUs;     // longest a run started after it was due
+    uint32_t maxRunUs;
+    uint64_t totalRunUs;
+};
+
+bool get_scheduled_function_stats(int id, scheduled_fn_stats_t& stats);
+
+// Time run_scheduled_functions may take before it leaves the remaining
+// functions for the next time, SCHEDULED_FN_BUDGET_US by default. A single
+// function is never interrupted. 0 runs everything that is due.
+void set_scheduled_functions_budget_us(uint32_t budgetUs);
+
+// Run all scheduled functions.
 // Use this function if your are not using `loop`, or `loop` does not return
 // on a regular basis.
+// Functions scheduled while this runs, and ones not due yet, run next time.
 void run_scheduled_functions();
 
+
+// Used by the templates above: a scheduled function is a free entry taken with
+// scheduled_fn_reserve, the callable constructed in its storage, and the entry
+// queued with scheduled_fn_commit, which returns the id of a recurrent one.
+// invoke runs the callable, and destroys it unless it is to run again.
+typedef bool (*scheduled_fn_invoke_t)(void* storage);
+
+void* scheduled_fn_reserve(bool recurrent);
+int scheduled_fn_commit(void* storage, scheduled_fn_invoke_t invoke,
+                        uint32_t delayUs, uint32_t repeatUs, schedule_priority_t priority);
+
+// recurrent functions return bool, the ones that run once void
+template<typename R, typename Fn>
+struct scheduled_fn_invoker
+{
+    static bool invoke(void* storage)
+    {
+        Fn* fn = static_cast<Fn*>(storage);
+        if ((*fn)()) {
+            return true;
+        }
+        fn->~Fn();
+        return false;
+    }
+};
+
+template<typename Fn>
+struct scheduled_fn_invoker<void, Fn>
+{
+    static bool invoke(void* storage)
+    {
+        Fn* fn = static_cast<Fn*>(storage);
+        (*fn)();
+        fn->~Fn();
+        return false;
+    }
+};
+
+template<typename R, typename Fn, typename F>
+SCHEDULED_FN_ALWAYS_INLINE int scheduled_fn_push(F&& fn, uint32_t delayUs, uint32_t repeatUs,
+                      schedule_priority_t priority, std::true_type)
+{
+    void* storage = scheduled_fn_reserve(repeatUs != 0);
+    if (!storage) {
+        return -1;
+    }
+    new (storage) Fn(std::forward<F>(fn));
+    return scheduled_fn_commit(storage, &scheduled_fn_invoker<R, Fn>::invoke, delayUs, repeatUs, priority);
+}
+
+template<typename R, typename Fn, typename F>
+int scheduled_fn_push(F&& fn, uint32_t delayUs, uint32_t repeatUs,
+                      schedule_priority_t priority, std::false_type)
+{
+    typedef std::function<R(void)> Wrapper;
+    static_assert(sizeof(Wrapper) <= SCHEDULED_FN_INLINE_SIZE, "std::function must fit inline");
+    return scheduled_fn_push<R, Wrapper>(Wrapper(std::forward<F>(fn)), delayUs, repeatUs,
+                                         priority, std::true_type());
+}
+
+template<typename R, typename F>
+SCHEDULED_FN_ALWAYS_INLINE int scheduled_fn_push(F&& fn, uint32_t delayUs, uint32_t repeatUs, schedule_priority_t priority)
+{
+    typedef typename std::decay<F>::type Fn;
+    typedef std::integral_constant<bool,
+        sizeof(Fn) <= SCHEDULED_FN_INLINE_SIZE && alignof(Fn) <= SCHEDULED_FN_INLINE_ALIGN> fits;
+    return scheduled_fn_push<R, Fn>(std::forward<F>(fn), delayUs, repeatUs, priority, fits());
+}
+
+template<typename F>
+SCHEDULED_FN_ALWAYS_INLINE bool schedule_function_us(F&& fn, uint32_t delayUs, schedule_priority_t priority)
+{
+    return scheduled_fn_push<void>(std::forward<F>(fn), delayUs, 0, priority) >= 0;
+}
+
+template<typename F>
+SCHEDULED_FN_ALWAYS_INLINE int schedule_recurrent_function_us(F&& fn, uint32_t repeatUs, schedule_priority_t priority)
+{
+    if (repeatUs == 0) {
+        repeatUs = 1;
+    }
+    return scheduled_fn_push<bool>(std::forward<F>(fn), repeatUs, repeatUs, priority);
+}
+
+template<typename F>
+SCHEDULED_FN_ALWAYS_INLINE bool schedule_function(F&& fn, schedule_priority_t priority)
+{
+    return schedule_function_us(std::forward<F>(fn), 0, priority);
+}
+
 #endif //ESP_SCHEDULE_H
@@ -22,6 +22,8 @@
 
 #include <Arduino.h>
 #include <Stream.h>
+#include "NumberFormat.h"
+#include <algorithm>
 #define PARSE_TIMEOUT 1000  // default number of milli-seconds to wait
 #define NO_SKIP_CHAR  1  // a magic char not found in a valid ASCII numeric field
 
@@ -91,6 +93,27 @@ bool Stream::findUntil(const char *target, const char *terminator) {
     return findUntil(target, strlen(target), terminator, strlen(terminator));
 }
 
+// one character of findUntil, returns 1 when the target string is complete,
+// 0 when the terminator string is, -1 otherwise
+static int findStep(char c, const char *target, size_t targetLen, size_t &index,
+                    const char *terminator, size_t termLen, size_t &termIndex) {
+    if(c != target[index])
+        index = 0; // reset index if any char does not match
+
+    if(c == target[index]) {
+        if(++index >= targetLen) { // return true if all chars in the target match
+            return 1;
+        }
+    }
+
+    if(termLen > 0 && c == terminator[termIndex]) {
+        if(++termIndex >= termLen)
+            return 0;       // return false if terminate string found before target string
+    } else
+        termIndex = 0;
+    return -1;
+}
+
 // reads data from the stream until the target string of the given length is found
 // search terminated if the terminator string is found
 // returns true if target string is found, false if terminated or timed out
@@ -101,25 +124,34 @@ bool Stream::findUntil(const char *target, size_t targetLen, const char *termina
 
     if(*target == 0)
         return true;   // return true if target is a null string
-    while((c = timedRead()) > 0) {
-
-        if(c != target[index])
-            index = 0; // reset index if any char does not match
-
-        if(c == target[index]) {
-            //////Serial.print("found "); Serial.write(c); Serial.print("index now"); Serial.println(index+1);
-            if(++index >= targetLen) { // return true if all chars in the target match
-                return true;
+    while(true) {
+        size_t avail = hasPeekBufferAPI() ? peekAvailable() : 0;
+        if(avail) {
+            const char *data = peekBuffer();
+            size_t i = 0;
+            int found = -1;
+            while(i < avail && found < 0) {
+                if(!index && !termIndex) {
+                    // skip what can't start either string
+                    while(i < avail && data[i] && data[i] != target[0] && (!termLen || data[i] != terminator[0]))
+                        i++;
+                    if(i == avail)
+                        break;
+                }
+                char ch = data[i++];
+                found = ch ? findStep(ch, target, targetLen, index, terminator, termLen, termIndex) : 0;
             }
+            peekConsume(i);
+            if(found >= 0)
+                return found;
+            continue;
         }
-
-        if(termLen > 0 && c == terminator[termIndex]) {
-            if(++termIndex >= termLen)
-                return false;       // return false if terminate string found before target string
-        } else
-            termIndex = 0;
+        if((c = timedRead()) <= 0)
+            return false;
+        int found = findStep(c, target, targetLen, index, terminator, termLen, termIndex);
+        if(found >= 0)
+            return found;
     }
-    return false;
 }
 
 // returns the first valid (long) integer value from the current position.
@@ -167,9 +199,9 @@ float Stream::parseFloat() {
 float Stream::parseFloat(char skipChar) {
     boolean isNegative = false;
     boolean isFraction = false;
-    long value = 0;
+    uint64_t value = 0;
+    int exponent = 0;
     int c;
-    float fraction = 1.0;
 
     c = peekNextDigit();
     // ignore non numeric leading characters
@@ -184,20 +216,20 @@ float Stream::parseFloat(char skipChar) {
         else if(c == '.')
             isFraction = true;
         else if(c >= '0' && c <= '9') {      // is c a digit?
-            value = value * 10 + c - '0';
-            if(isFraction)
-                fraction *= 0.1;
+            // digits that no longer fit only move the point
+            if(value < 100000000000000000ULL) {
+                value = value * 10 + c - '0';
+                if(isFraction)
+                    exponent--;
+            } else if(!isFraction)
+                exponent++;
         }
         read();  // consume the character we got with peek
         c = timedPeek();
     } while((c >= '0' && c <= '9') || c == '.' || c == skipChar);
 
-    if(isNegative)
-        value = -value;
-    if(isFraction)
-        return value * fraction;
-    else
-        return value;
+    float result = decimalToDouble(value, exponent);
+    return isNegative ? -result : result;
 }
 
 // read characters from stream into buffer
@@ -208,6 +240,15 @@ float Stream::parseFloat(char skipChar) {
 size_t Stream::readBytes(char *buffer, size_t length) {
     size_t count = 0;
     while(count < length) {
+        size_t avail = hasPeekBufferAPI() ? peekAvailable() : 0;
+        if(avail) {
+            size_t n = std::min(avail, length - count);
+            memcpy(buffer, peekBuffer(), n);
+            peekConsume(n);
+            buffer += n;
+            count += n;
+            continue;
+        }
         int c = timedRead();
         if(c < 0)
             break;
@@ -226,6 +267,21 @@ size_t Stream::readBytesUntil(char terminator, char *buffer, size_t length) {
         return 0;
     size_t index = 0;
     while(index < length) {
+        size_t avail = hasPeekBufferAPI() ? peekAvailable() : 0;
+        if(avail) {
+            const char *data = peekBuffer();
+            size_t n = std::min(avail, length - index);
+            const char *found = (const char *) memchr(data, terminator, n);
+            if(found)
+                n = found - data;
+            memcpy(buffer, data, n);
+            peekConsume(found ? n + 1 : n);
+            buffer += n;
+            index += n;
+            if(found)
+                break;
+            continue;
+        }
         int c = timedRead();
         if(c < 0 || c == terminator)
             break;
@@ -237,20 +293,39 @@ size_t Stream::readBytesUntil(char terminator, char *buffer, size_t length) {
 
 String Stream::readString() {
     String ret;
-    int c = timedRead();
-    while(c >= 0) {
+    while(true) {
+        size_t avail = hasPeekBufferAPI() ? peekAvailable() : 0;
+        if(avail) {
+            ret.concat(peekBuffer(), avail);
+            peekConsume(avail);
+            continue;
+        }
+        int c = timedRead();
+        if(c < 0)
+            break;
         ret += (char) c;
-        c = timedRead();
     }
     return ret;
 }
 
 String Stream::readStringUntil(char terminator) {
     String ret;
-    int c = timedRead();
-    while(c >= 0 && c != terminator) {
+    while(true) {
+        size_t avail = hasPeekBufferAPI() ? peekAvailable() : 0;
+        if(avail) {
+            const char *data = peekBuffer();
+            const char *found = (const char *) memchr(data, terminator, avail);
+            size_t n = found ? found - data : avail;
+            ret.concat(data, n);
+            peekConsume(found ? n + 1 : n);
+            if(found)
+                break;
+            continue;
+        }
+        int c = timedRead();
+        if(c < 0 || c == terminator)
+            break;
         ret += (char) c;
-        c = timedRead();
     }
     return ret;
 }
@@ -52,6 +52,26 @@ class Stream: public Print {
             _timeout = 1000;
         }
 
+// bulk access to what the stream already holds
+
+        // Streams that keep received data in a buffer can hand it out in
+        // place: peekAvailable() tells how many bytes peekBuffer() then points
+        // to, which may be fewer than available(). The pointer stays valid
+        // until peekConsume() or any read. The helpers below use this to work
+        // on whole chunks instead of calling read() for every byte.
+        virtual bool hasPeekBufferAPI() const {
+            return false;
+        }
+        virtual size_t peekAvailable() {
+            return 0;
+        }
+        virtual const char* peekBuffer() {
+            return nullptr;
+        }
+        virtual void peekConsume(size_t consume) {
+            (void) consume;
+        }
+
 // parsing methods
 
         void setTimeout(unsigned long timeout);  // sets maximum milliseconds to wait for stream data, default is 1 second
@@ -28,6 +28,7 @@
 #include <Print.h>
 
 #include <utility>
+#include <algorithm>
 
 class PrintString: public String, public Print {
   public:
@@ -61,6 +62,11 @@ class StreamString: public Stream, public String {
     int peek() override;
     void flush() override;
 
+    bool hasPeekBufferAPI() const override { return true; }
+    size_t peekAvailable() override { return available(); }
+    const char* peekBuffer() override { return c_str() + _offset; }
+    void peekConsume(size_t consume) override { _offset += std::min(consume, peekAvailable()); }
+
     void reset() { _offset = 0; }
 };
 
@@ -26,6 +26,7 @@
 #include <utility>
 #include "WString.h"
 #include "stdlib_noniso.h"
+#include "NumberFormat.h"
 
 String const String::EMPTY("");
 
@@ -111,30 +112,52 @@ String::~String() {
 // /*********************************************/
 
 inline void String::init(void) {
-	buffer = NULL;
-	capacity = 0;
-	len = 0;
+	setSSO(true);
+	sso.len = 0;
+	sso.buff[0] = '\0';
 }
 
 void String::invalidate(void) {
-	if(buffer) {
-		free(buffer);
-		init();
-	}
+	if(!isSSO())
+		free(ptr.buff);
+	init();
 }
 
 unsigned char String::reserve(unsigned int size) {
-	if(buffer && capacity >= size)
+	if(capacity() >= size)
 		return 1;
 	return changeBuffer(size);
 }
 
+// Appending grows the buffer at least twofold, so a string built piece by
+// piece is reallocated a logarithmic number of times instead of on every
+// 16 characters. reserve() still gives exactly what was asked for.
+unsigned char String::reserveToAppend(unsigned int size) {
+	unsigned int cap = capacity();
+	if(cap >= size)
+		return 1;
+	return changeBuffer(size > 2 * cap ? size : 2 * cap);
+}
+
 unsigned char String::changeBuffer(unsigned int maxStrLen) {
+	if(isSSO() && maxStrLen < SSOSIZE)
+		return 1;
 	size_t newSize = (maxStrLen + 16) & (~0xf);
-	char *newbuffer = (char *) realloc(buffer, newSize);
+	if(isSSO()) {
+		char *newbuffer = (char *) malloc(newSize);
+		if(!newbuffer)
+			return 0;
+		unsigned int oldLen = sso.len;
+		memcpy(newbuffer, sso.buff, oldLen + 1);
+		ptr.buff = newbuffer;
+		ptr.cap = newSize - 1;
+		ptr.len = oldLen;  // also clears isSSO
+		return 1;
+	}
+	char *newbuffer = (char *) realloc(ptr.buff, newSize);
 	if(newbuffer) {
-		capacity = newSize - 1;
-		buffer = newbuffer;
+		setCapacity(newSize - 1);
+		setBuffer(newbuffer);
 		return 1;
 	}
 	return 0;
@@ -149,9 +172,9 @@ String & String::copy(const char *cstr, unsigned int length) {
 		invalidate();
 		return *this;
 	}
-	len = length;
-	memcpy(buffer, cstr, length);
-	buffer[len] = '\0';
+	setLen(length);
+	memcpy(wbuffer(), cstr, length);
+	wbuffer()[length] = '\0';
 	return *this;
 }
 
@@ -160,30 +183,33 @@ String & String::copy(const __FlashStringHelper *pstr, unsigned int length) {
 		invalidate();
 		return *this;
 	}
-	len = length;
-	memcpy_P(buffer, (PGM_P)pstr, length);
-	buffer[len] = '\0';
+	setLen(length);
+	memcpy_P(wbuffer(), (PGM_P)pstr, length);
+	wbuffer()[length] = '\0';
 	return *this;
 }
 
 #ifdef __GXX_EXPERIMENTAL_CXX0X__
+// Takes over the value of rhs, inline or on the heap, and leaves rhs empty.
+// Only for strings that don't hold a heap buffer of their own.
 void String::move(String &rhs) {
-	free(buffer);
-	buffer = rhs.buffer;
-	capacity = rhs.capacity;
-	len = rhs.len;
+	memcpy(&ptr, &rhs.ptr, sizeof(ptr));
 	rhs.init();
 }
+
+void String::swap(String &rhs) {
+	struct _ptr temp;
+	memcpy(&temp, &ptr, sizeof(ptr));
+	memcpy(&ptr, &rhs.ptr, sizeof(ptr));
+	memcpy(&rhs.ptr, &temp, sizeof(ptr));
+}
 #endif
 
 String & String::operator =(String const &rhs) {
 	if(this == &rhs)
 		return *this;
 
-	if(rhs.buffer)
-		copy(rhs.buffer, rhs.len);
-	else
-		invalidate();
+	copy(rhs.buffer(), rhs.len());
 
 	return *this;
 }
@@ -191,13 +217,13 @@ String & String::operator =(String const &rhs) {
 #ifdef __GXX_EXPERIMENTAL_CXX0X__
 String & String::operator =(String &&rval) {
 	if(this != &rval)
-		move(rval);
+		swap(rval);
 	return *this;
 }
 
 String & String::operator =(StringSumHelper &&rval) {
 	if(this != &rval)
-		move(rval);
+		swap(rval);
 	return *this;
 }
 #endif
@@ -224,7 +250,7 @@ String & String::operator = (const __FlashStringHelper *pstr)
 // /*********************************************/
 
 unsigned char String::concat(String const &s) {
-	return concat(s.buffer, s.len);
+	return concat(s.buffer(), s.len());
 }
 
 unsigned char String::concat(const char *cstr) {
@@ -236,66 +262,74 @@ unsigned char String::concat(const char *cstr) {
 unsigned char String::concat(char c, size_t count) {
 	if (count == 0)
 		return 1;
-	unsigned int newlen = len + count;
-	if(!reserve(newlen))
+	unsigned int oldlen = len();
+	unsigned int newlen = oldlen + count;
+	if(!reserveToAppend(newlen))
 		return 0;
-	if (count == 1) buffer[len] = c;
-	else memset(buffer + len, c, count);
-	buffer[newlen] = '\0';
-	len = newlen;
+	if (count == 1) wbuffer()[oldlen] = c;
+	else memset(wbuffer() + oldlen, c, count);
+	wbuffer()[newlen] = '\0';
+	setLen(newlen);
 	return 1;
 }
 
 unsigned char String::concat(unsigned char num, unsigned char base) {
-	char buf[1 + 8 * sizeof(unsigned char)];
-	utoa(num, buf, base);
-	return concat(buf, strlen(buf));
+	return concat((unsigned long) num, base);
 }
 
 unsigned char String::concat(int num, unsigned char base) {
-	char buf[2 + 8 * sizeof(int)];
-	itoa(num, buf, base);
-	return concat(buf, strlen(buf));
+	return concat((long) num, base);
 }
 
 unsigned char String::concat(unsigned int num, unsigned char base) {
-	char buf[1 + 8 * sizeof(unsigned int)];
-	utoa(num, buf, base);
-	return concat(buf, strlen(buf));
+	return concat((unsigned long) num, base);
 }
 
 unsigned char String::concat(long num, unsigned char base) {
-	char buf[2 + 8 * sizeof(long)];
-	ltoa(num, buf, base);
-	return concat(buf, strlen(buf));
+	char buf[NUMBER_FORMAT_INT_SIZE];
+	char *end = &buf[sizeof(buf)];
+	char *str = formatSigned(num, base, end);
+	return concat(str, end - str);
 }
 
 unsigned char String::concat(unsigned long num, unsigned char base) {
-	char buf[1 + 8 * sizeof(unsigned long)];
-	ultoa(num, buf, base);
-	return concat(buf, strlen(buf));
+	char buf[NUMBER_FORMAT_INT_SIZE];
+	char *end = &buf[sizeof(buf)];
+	char *str = formatUnsigned(num, base, end);
+	return concat(str, end - str);
 }
 
 unsigned char String::concat(float num, unsigned char decimalPlaces) {
-	char buf[33];
-	dtostrf(num, (decimalPlaces + 2), decimalPlaces, buf);
-	return concat(buf, strlen(buf));
+	return concat((double) num, decimalPlaces);
 }
 
 unsigned char String::concat(double num, unsigned char decimalPlaces) {
-	char buf[33];
-	dtostrf(num, (decimalPlaces + 2), decimalPlaces, buf);
-	return concat(buf, strlen(buf));
+	char buf[48];
+	size_t length = formatFixed(num, decimalPlaces, buf, sizeof(buf));
+	// padded like dtostrf(num, decimalPlaces + 2, ...) used to
+	size_t width = decimalPlaces + 2;
+	if (length < width && !concat(' ', width - length))
+		return 0;
+	if (length <= sizeof(buf))
+		return concat(buf, length);
+	unsigned int oldlen = len();
+	if (!reserveToAppend(oldlen + length))
+		return 0;
+	length = formatFixed(num, decimalPlaces, wbuffer() + oldlen, length);
+	wbuffer()[oldlen + length] = '\0';
+	setLen(oldlen + length);
+	return 1;
 }
 
 unsigned char String::concat(const __FlashStringHelper * str) {
 	if (!str) return 0;
 	int length = strlen_P((PGM_P)str);
 	if (length == 0) return 1;
-	unsigned int newlen = len + length;
-	if (!reserve(newlen)) return 0;
-	strcpy_P(buffer + len, (PGM_P)str);
-	len = newlen;
+	unsigned int oldlen = len();
+	unsigned int newlen = oldlen + length;
+	if (!reserveToAppend(newlen)) return 0;
+	strcpy_P(wbuffer() + oldlen, (PGM_P)str);
+	setLen(newlen);
 	return 1;
 }
 
@@ -304,12 +338,21 @@ unsigned char String::concat(const char *cstr, unsigned int length) {
 		return 1;
 	if(!cstr)
 		return 0;
-	unsigned int newlen = len + length;
-	if(!reserve(newlen))
+	unsigned int oldlen = len();
+	unsigned int newlen = oldlen + length;
+	// appending a part of this string: the buffer may move, or be
+	// overwritten when a short value goes to the heap
+	const char *buf = buffer();
+	if(cstr >= buf && cstr < buf + oldlen) {
+		unsigned int offset = cstr - buf;
+		if(!reserveToAppend(newlen))
+			return 0;
+		cstr = buffer() + offset;
+	} else if(!reserveToAppend(newlen))
 		return 0;
-	memcpy(buffer + len, cstr, length);
-	buffer[newlen] = '\0';
-	len = newlen;
+	memcpy(wbuffer() + oldlen, cstr, length);
+	wbuffer()[newlen] = '\0';
+	setLen(newlen);
 	return 1;
 }
 
@@ -319,7 +362,7 @@ unsigned char String::concat(const char *cstr, unsigned int length) {
 
 StringSumHelper & operator +(const StringSumHelper &lhs, String const &rhs) {
 	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
-	if(!a.concat(rhs.buffer, rhs.len) && rhs.begin())
+	if(!a.concat(rhs.buffer(), rhs.len()) && rhs.begin())
 		a.invalidate();
 	return a;
 }
@@ -399,24 +442,24 @@ StringSumHelper & operator + (const StringSumHelper &lhs,
 // /*********************************************/
 
 int String::compareTo(String const &s, bool ignoreCase) const {
-	return compareTo(s.buffer, ignoreCase);
+	return compareTo(s.buffer(), ignoreCase);
 }
 
 int String::compareTo(const char *cstr, bool ignoreCase) const {
-	const char* aBuf = buffer? buffer : EMPTY.buffer;
-	const char* bBuf = cstr? cstr : EMPTY.buffer;
+	const char* aBuf = buffer();
+	const char* bBuf = cstr? cstr : EMPTY.buffer();
 	return ignoreCase? strcasecmp(aBuf, bBuf): strcmp(aBuf, bBuf);
 }
 
 int String::compareTo(const __FlashStringHelper *str, bool ignoreCase) const {
-	const char* aBuf = buffer? buffer : EMPTY.buffer;
-	PGM_P bBuf = str? (PGM_P)str : EMPTY.buffer;
+	const char* aBuf = buffer();
+	PGM_P bBuf = str? (PGM_P)str : EMPTY.buffer();
 	return ignoreCase? strcasecmp_P(aBuf, bBuf): strcmp_P(aBuf, bBuf);
 
 }
 
 bool String::equals(String const &s2, bool ignoreCase) const {
-	return (len == s2.len && compareTo(s2, ignoreCase) == 0);
+	return (len() == s2.len() && compareTo(s2, ignoreCase) == 0);
 }
 
 bool String::equals(const char *cstr, bool ignoreCase) const {
@@ -442,14 +485,14 @@ bool String::equalsIgnoreCase(const __FlashStringHelper *str) const {
 bool String::equalsConstantTime(String const &s2) const {
 	// To avoid possible time-based attacks present function
 	// compares given strings in a constant time.
-	if(len != s2.len)
+	if(len() != s2.len())
 		return false;
 	//at this point lengths are the same
-	if(len == 0)
+	if(len() == 0)
 		return true;
 	//at this point lenghts are the same and non-zero
-	const char *p1 = buffer;
-	const char *p2 = s2.buffer;
+	const char *p1 = buffer();
+	const char *p2 = s2.buffer();
 	unsigned int equalchars = 0;
 	unsigned int diffchars = 0;
 	while(*p1) {
@@ -462,7 +505,7 @@ bool String::equalsConstantTime(String const &s2) const {
 	}
 	// The following should force a constant time eval of the condition
 	//	without a compiler "logical shortcut"
-	unsigned char equalcond = (equalchars == len);
+	unsigned char equalcond = (equalchars == len());
 	unsigned char diffcond = (diffchars == 0);
 	return (equalcond & diffcond); //bitwise AND
 }
@@ -488,7 +531,7 @@ bool String::startsWith(String const &s2, bool ignoreCase) const {
 }
 
 bool String::startsWith(String const &s2, unsigned int offset, bool ignoreCase) const {
-	return startsWith(s2.buffer, s2.len, offset, ignoreCase);
+	return startsWith(s2.buffer(), s2.len(), offset, ignoreCase);
 }
 
 bool String::startsWith(const char *cstr, unsigned int offset, bool ignoreCase) const {
@@ -498,8 +541,8 @@ bool String::startsWith(const char *cstr, unsigned int offset, bool ignoreCase)
 bool String::startsWith(const char *cstr, unsigned int bLen,
 	unsigned int offset, bool ignoreCase) const {
 	if (!bLen) return 1;
-	if (offset + bLen > len) return 0;
-	const char* cBuf = buffer+offset;
+	if (offset + bLen > len()) return 0;
+	const char* cBuf = buffer()+offset;
 	return (ignoreCase? strncasecmp(cBuf, cstr, bLen)
 		: strncmp(cBuf, cstr, bLen)) == 0;
 }
@@ -512,8 +555,8 @@ bool String::startsWith(const __FlashStringHelper *str, unsigned int offset,
 bool String::startsWith(const __FlashStringHelper *str, unsigned int bLen,
 	unsigned int offset, bool ignoreCase) const {
 	if (!bLen) return 1;
-	if (offset + bLen > len) return 0;
-	const char* cBuf = buffer+offset;
+	if (offset + bLen > len()) return 0;
+	const char* cBuf = buffer()+offset;
 	return (ignoreCase? strncasecmp_P(cBuf, (PGM_P)str, bLen)
 		: strncmp_P(cBuf, (PGM_P)str, bLen)) == 0;
 }
@@ -524,7 +567,7 @@ bool String::endsWith(String const &s2, bool ignoreCase) const {
 
 bool String::endsWith(String const &s2, unsigned int offset,
 	bool ignoreCase) const {
-	return endsWith(s2.buffer, s2.len, offset, ignoreCase);
+	return endsWith(s2.buffer(), s2.len(), offset, ignoreCase);
 }
 
 bool String::endsWith(const char *cstr, unsigned int offset,
@@ -535,8 +578,8 @@ bool String::endsWith(const char *cstr, unsigned int offset,
 bool String::endsWith(const char *cstr, unsigned int bLen,
 	unsigned int offset, bool ignoreCase) const {
 	if (!bLen) return 1;
-	if (offset + bLen > len) return 0;
-	const char* cBuf = buffer+len-offset-bLen;
+	if (offset + bLen > len()) return 0;
+	const char* cBuf = buffer()+len()-offset-bLen;
 	return (ignoreCase? strncasecmp(cBuf, cstr, bLen) : strncmp(cBuf, cstr, bLen)) == 0;
 }
 
@@ -548,8 +591,8 @@ bool String::endsWith(const __FlashStringHelper *str, unsigned int offset,
 bool String::endsWith(const __FlashStringHelper *str, unsigned int bLen,
 	unsigned int offset, bool ignoreCase) const {
 	if (!bLen) return 1;
-	if (offset + bLen > len) return 0;
-	const char* cBuf = buffer+len-offset-bLen;
+	if (offset + bLen > len()) return 0;
+	const char* cBuf = buffer()+len()-offset-bLen;
 	return (ignoreCase? strncasecmp_P(cBuf, (PGM_P)str, bLen)
 		: strncmp_P(cBuf, (PGM_P)str, bLen)) == 0;
 }
@@ -563,36 +606,36 @@ char String::charAt(unsigned int loc) const {
 }
 
 void String::setCharAt(unsigned int loc, char c) {
-	if(loc < len)
-		buffer[loc] = c;
+	if(loc < len())
+		wbuffer()[loc] = c;
 }
 
 char & String::operator[](unsigned int index) {
 	static char dummy_writable_char;
-	if(index >= len || !buffer) {
+	if(index >= len()) {
 		dummy_writable_char = 0;
 		return dummy_writable_char;
 	}
-	return buffer[index];
+	return wbuffer()[index];
 }
 
 char String::operator[](unsigned int index) const {
-	if(index >= len || !buffer)
+	if(index >= len())
 		return 0;
-	return buffer[index];
+	return buffer()[index];
 }
 
 void String::getBytes(unsigned char *buf, unsigned int bufsize, unsigned int index) const {
 	if(!bufsize || !buf)
 		return;
-	if(index >= len) {
+	if(index >= len()) {
 		buf[0] = 0;
 		return;
 	}
 	unsigned int n = bufsize - 1;
-	if(n > len - index)
-		n = len - index;
-	memcpy((char *) buf, buffer + index, n);
+	if(n > len() - index)
+		n = len() - index;
+	memcpy((char *) buf, buffer() + index, n);
 	buf[n] = 0;
 }
 
@@ -605,12 +648,12 @@ int String::indexOf(char c) const {
 }
 
 int String::indexOf(char ch, unsigned int fromIndex) const {
-	if(fromIndex >= len)
+	if(fromIndex >= len())
 		return -1;
-	const char* temp = strchr(buffer + fromIndex, ch);
+	const char* temp = strchr(buffer() + fromIndex, ch);
 	if(temp == NULL)
 		return -1;
-	return temp - buffer;
+	return temp - buffer();
 }
 
 int String::indexOf(String const &s2) const {
@@ -618,57 +661,56 @@ int String::indexOf(String const &s2) const {
 }
 
 int String::indexOf(String const &s2, unsigned int fromIndex) const {
-	if(fromIndex >= len)
+	if(fromIndex >= len())
 		return -1;
 	if(!s2)
 		return fromIndex;
-	const char *found = strstr(buffer + fromIndex, s2.buffer);
+	const char *found = strstr(buffer() + fromIndex, s2.buffer());
 	if(found == NULL)
 		return -1;
-	return found - buffer;
+	return found - buffer();
 }
 
 int String::lastIndexOf(char theChar) const {
-	return lastIndexOf(theChar, len - 1);
+	return lastIndexOf(theChar, len() - 1);
 }
 
 int String::lastIndexOf(char ch, unsigned int fromIndex) const {
-	if(fromIndex >= len)
-		return -1;
-	char tempchar = buffer[fromIndex + 1];
-	buffer[fromIndex + 1] = '\0';
-	char* temp = strrchr(buffer, ch);
-	buffer[fromIndex + 1] = tempchar;
-	if(temp == NULL)
+	if(fromIndex >= len())
 		return -1;
-	return temp - buffer;
+	const char* buf = buffer();
+	for(int i = fromIndex; i >= 0; i--) {
+		if(buf[i] == ch)
+			return i;
+	}
+	return -1;
 }
 
 int String::lastIndexOf(String const &s2) const {
-	return lastIndexOf(s2, len - s2.len);
+	return lastIndexOf(s2, len() - s2.len());
 }
 
 int String::lastIndexOf(String const &s2, unsigned int fromIndex) const {
-	if(s2.len == 0 || len == 0 || s2.len > len)
+	if(s2.len() == 0 || len() == 0 || s2.len() > len())
 		return -1;
-	if(fromIndex >= len)
-		fromIndex = len - 1;
+	if(fromIndex >= len())
+		fromIndex = len() - 1;
 	int found = -1;
-	for(char *p = buffer; p <= buffer + fromIndex; p++) {
-		p = strstr(p, s2.buffer);
+	for(const char *p = buffer(); p <= buffer() + fromIndex; p++) {
+		p = strstr(p, s2.buffer());
 		if(!p)
 			break;
-		if((unsigned int) (p - buffer) <= fromIndex)
-			found = p - buffer;
+		if((unsigned int) (p - buffer()) <= fromIndex)
+			found = p - buffer();
 	}
 	return found;
 }
 
 String String::substring(unsigned int left, unsigned int right) const {
 	String out;
-	if(left < right && left < len) {
-		if(right > len) right = len;
-		out.concat(buffer+left, right-left);
+	if(left < right && left < len()) {
+		if(right > len()) right = len();
+		out.concat(buffer()+left, right-left);
 	}
 	return std::move(out);
 }
@@ -678,53 +720,55 @@ String String::substring(unsigned int left, unsigned int right) const {
 // /*********************************************/
 
 void String::replace(char find, char replace) {
-	if(!buffer)
-		return;
-	for(char *p = buffer; (unsigned int)(p-buffer) < len; p++) {
+	char *buf = wbuffer();
+	for(char *p = buf; (unsigned int)(p-buf) < len(); p++) {
 		if(*p == find) *p = replace;
 	}
 }
 
 void String::replace(const String& find, const String& replace) {
-	if(len == 0 || find.len == 0)
+	if(len() == 0 || find.len() == 0)
 		return;
-	int diff = replace.len - find.len;
-	char *readFrom = buffer;
+	int diff = replace.len() - find.len();
+	char *readFrom = wbuffer();
 	char *foundAt;
 	if(diff == 0) {
-		while((foundAt = strstr(readFrom, find.buffer)) != NULL) {
-			memcpy(foundAt, replace.buffer, replace.len);
-			readFrom = foundAt + replace.len;
+		while((foundAt = strstr(readFrom, find.buffer())) != NULL) {
+			memcpy(foundAt, replace.buffer(), replace.len());
+			readFrom = foundAt + replace.len();
 		}
 	} else if(diff < 0) {
-		char *writeTo = buffer;
-		while((foundAt = strstr(readFrom, find.buffer)) != NULL) {
+		unsigned int size = len(); // compute size needed for result
+		char *writeTo = wbuffer();
+		while((foundAt = strstr(readFrom, find.buffer())) != NULL) {
 			unsigned int n = foundAt - readFrom;
-			memcpy(writeTo, readFrom, n);
+			memmove(writeTo, readFrom, n);
 			writeTo += n;
-			memcpy(writeTo, replace.buffer, replace.len);
-			writeTo += replace.len;
-			readFrom = foundAt + find.len;
-			len += diff;
+			memcpy(writeTo, replace.buffer(), replace.len());
+			writeTo += replace.len();
+			readFrom = foundAt + find.len();
+			size += diff;
 		}
-		strcpy(writeTo, readFrom);
+		memmove(writeTo, readFrom, strlen(readFrom) + 1);
+		setLen(size);
 	} else {
-		unsigned int size = len; // compute size needed for result
-		while((foundAt = strstr(readFrom, find.buffer)) != NULL) {
-			readFrom = foundAt + find.len;
+		unsigned int size = len(); // compute size needed for result
+		while((foundAt = strstr(readFrom, find.buffer())) != NULL) {
+			readFrom = foundAt + find.len();
 			size += diff;
 		}
-		if(size == len)
+		if(size == len())
 			return;
-		if(size > capacity && !changeBuffer(size))
+		if(size > capacity() && !changeBuffer(size))
 			return; // XXX: tell user!
-		int index = len - 1;
+		int index = len() - 1;
 		while(index >= 0 && (index = lastIndexOf(find, index)) >= 0) {
-			readFrom = buffer + index + find.len;
-			memmove(readFrom + diff, readFrom, len - (readFrom - buffer));
-			len += diff;
-			buffer[len] = 0;
-			memcpy(buffer + index, replace.buffer, replace.len);
+			readFrom = wbuffer() + index + find.len();
+			memmove(readFrom + diff, readFrom, len() - (readFrom - buffer()));
+			int newLen = len() + diff;
+			setLen(newLen);
+			wbuffer()[newLen] = 0;
+			memcpy(wbuffer() + index, replace.buffer(), replace.len());
 			index--;
 		}
 	}
@@ -738,59 +782,56 @@ void String::remove(unsigned int index) {
 }
 
 void String::remove(unsigned int index, unsigned int count) {
-	if(index >= len || count <= 0) {
+	if(index >= len() || count <= 0) {
 		return;
 	}
-	if(count < len - index) {
-		char *writeTo = buffer + index;
-		memmove(writeTo, writeTo + count, len - count - index);
+	if(count < len() - index) {
+		char *writeTo = wbuffer() + index;
+		memmove(writeTo, writeTo + count, len() - count - index);
 	} else {
-		count = len - index;
+		count = len() - index;
 	}
-	len = len - count;
-	buffer[len] = 0;
+	setLen(len() - count);
+	wbuffer()[len()] = 0;
 }
 
 void String::toLowerCase(void) {
-	if(!buffer)
-		return;
-	for(char *p = buffer; *p; p++) {
+	for(char *p = wbuffer(); *p; p++) {
 		*p = tolower(*p);
 	}
 }
 
 void String::toUpperCase(void) {
-	if(!buffer)
-		return;
-	for(char *p = buffer; *p; p++) {
+	for(char *p = wbuffer(); *p; p++) {
 		*p = toupper(*p);
 	}
 }
 
 void String::trim(void) {
-	if(!buffer || len == 0)
+	if(len() == 0)
 		return;
-	char *begin = buffer;
+	char *begin = wbuffer();
 	while(isspace(*begin))
 		begin++;
-	char *end = buffer + len - 1;
+	char *end = wbuffer() + len() - 1;
 	while(isspace(*end) && end >= begin)
 		end--;
-	len = end + 1 - begin;
-	if(begin > buffer)
-		memcpy(buffer, begin, len);
-	buffer[len] = 0;
+	unsigned int newlen = end + 1 - begin;
+	if(begin > buffer())
+		memmove(wbuffer(), begin, newlen);
+	setLen(newlen);
+	wbuffer()[newlen] = 0;
 }
 
 bool String::empty(void) const {
-	return len == 0;
+	return len() == 0;
 }
 
 void String::clear(bool free) {
 	if (free) invalidate();
-	else if (len) {
-	   len = 0;
-	   buffer[len] = 0;
+	else if (len()) {
+	   setLen(0);
+	   wbuffer()[0] = 0;
 	}
 }
 
@@ -825,41 +866,41 @@ bool String::toUInt(unsigned int &val, unsigned char base) const {
 bool String::toLong(long &val, unsigned char base) const {
 	if (empty()) return false;
 	char *endptr;
-	val = strtol(buffer, &endptr, base);
+	val = strtol(buffer(), &endptr, base);
 	return endptr == end();
 }
 
 bool String::toULong(unsigned long &val, unsigned char base) const {
 	if (empty()) return false;
 	char *endptr;
-	val = strtoul(buffer, &endptr, base);
+	val = strtoul(buffer(), &endptr, base);
 	return endptr == end();
 }
 
 bool String::toLLong(long long &val, unsigned char base) const {
 	if (empty()) return false;
 	char *endptr;
-	val = strtoll(buffer, &endptr, base);
+	val = strtoll(buffer(), &endptr, base);
 	return endptr == end();
 }
 
 bool String::toULLong(unsigned long long &val, unsigned char base) const {
 	if (empty()) return false;
 	char *endptr;
-	val = strtoull(buffer, &endptr, base);
+	val = strtoull(buffer(), &endptr, base);
 	return endptr == end();
 }
 
 bool String::toFloat(float &val) const {
 	if (empty()) return false;
 	char *endptr;
-	val = strtof(buffer, &endptr);
+	val = strtof(buffer(), &endptr);
 	return endptr == end();
 }
 
 bool String::toDouble(double &val) const {
 	if (empty()) return false;
 	char *endptr;
-	val = strtod(buffer, &endptr);
+	val = strtod(buffer(), &endptr);
 	return endptr == end();
 }
@@ -76,8 +76,10 @@ class String {
 		// memory management
 		// return true on success, false on failure (in which case, the string
 		// is left unchanged).
+		// short values (up to 10 characters on the ESP8266) are stored in
+		// the object and don't use the heap at all.
 		unsigned char reserve(unsigned int size);
-		inline unsigned int length(void) const { return buffer? len: 0; }
+		inline unsigned int length(void) const { return len(); }
 
 		// creates a copy of the assigned value.  if the value is null or
 		// invalid, or if the memory allocation fails, the string will be
@@ -86,6 +88,8 @@ class String {
 		String & operator = (const char *cstr);
 		String & operator = (const __FlashStringHelper *str);
 #ifdef __GXX_EXPERIMENTAL_CXX0X__
+		// moving never calls the allocator: the moved-from string is left
+		// holding the previous value, which it frees when it goes away
 		String & operator = (String &&rval);
 		String & operator = (StringSumHelper &&rval);
 #endif
@@ -214,8 +218,7 @@ class String {
 			unsigned int index = 0) const
 		{ getBytes((unsigned char *) buf, bufsize, index); }
 
-		const char* c_str() const
-		{ return buffer? buffer : EMPTY.begin(); }
+		const char* c_str() const { return buffer(); }
 		char* begin() { return &(*this)[0]; }
 		char* end() { return begin() + length(); }
 		const char* begin() const { return c_str(); }
@@ -232,7 +235,7 @@ class String {
 		int lastIndexOf(String const &str, unsigned int fromIndex) const;
 
 		String substring(unsigned int beginIndex) const
-		{ return substring(beginIndex, len); }
+		{ return substring(beginIndex, len()); }
 		String substring(unsigned int beginIndex, unsigned int endIndex) const;
 
 		// modification
@@ -264,19 +267,50 @@ class String {
 		{ return empty() ? 0 : &String::StringIfHelper; }
 
 	protected:
-		char *buffer;           // the actual char array
-		unsigned int capacity;  // the array length minus one (for the '\0')
-		unsigned int len;       // the String length (not counting the '\0')
+		// Short values are kept inside the object itself, in the space the
+		// heap pointer, capacity and length take otherwise, so the size of
+		// String doesn't change. The top bit of the last byte tells the two
+		// apart: in heap mode it's the top bit of ptr.len, which is never
+		// set (both the ESP8266 and the host are little endian).
+		// There are no buffer, capacity and len members, subclasses
+		// go through the accessors below.
+		struct _ptr {
+			char *buff;         // the actual char array
+			unsigned int cap;   // the array length minus one (for the '\0')
+			unsigned int len;   // the String length (not counting the '\0')
+		};
+		enum { SSOSIZE = sizeof(struct _ptr) - 1 };
+		struct _sso {
+			char buff[SSOSIZE];
+			unsigned char len : 7;
+			unsigned char isSSO : 1;
+		};
+		union {
+			struct _ptr ptr;
+			struct _sso sso;
+		};
+
+		inline bool isSSO() const { return sso.isSSO; }
+		inline unsigned int len() const { return isSSO() ? sso.len : ptr.len; }
+		inline unsigned int capacity() const { return isSSO() ? (unsigned int) SSOSIZE - 1 : ptr.cap; }
+		inline void setSSO(bool set) { sso.isSSO = set; }
+		inline void setLen(int len) { if (isSSO()) sso.len = len; else ptr.len = len; }
+		inline void setCapacity(int cap) { if (!isSSO()) ptr.cap = cap; }
+		inline void setBuffer(char *buff) { if (!isSSO()) ptr.buff = buff; }
+		inline const char *buffer() const { return isSSO() ? sso.buff : ptr.buff; }
+		inline char *wbuffer() const { return isSSO() ? const_cast<char *>(sso.buff) : ptr.buff; }
 
 		void init(void);
 		void invalidate(void);
 		unsigned char changeBuffer(unsigned int maxStrLen);
+		unsigned char reserveToAppend(unsigned int size);
 
 		// copy and move
 		String & copy(const char *cstr, unsigned int length);
 		String & copy(const __FlashStringHelper *pstr, unsigned int length);
 #ifdef __GXX_EXPERIMENTAL_CXX0X__
 		void move(String &rhs);
+		void swap(String &rhs);
 #endif
 };
 
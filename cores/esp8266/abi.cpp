@@ -21,6 +21,7 @@
 #include <debug.h>
 #include <Arduino.h>
 #include <cxxabi.h>
+#include "umm_malloc/umm_malloc.h"
 
 using __cxxabiv1::__guard;
 
@@ -30,22 +31,30 @@ extern int umm_last_fail_alloc_size;
 
 void *operator new(size_t size)
 {
+#ifdef UMM_SITE_STATS
+    return umm_malloc_at(size, __builtin_return_address(0));
+#else
     void *ret = malloc(size);
     if (0 != size && 0 == ret) {
         umm_last_fail_alloc_addr = __builtin_return_address(0);
         umm_last_fail_alloc_size = size;
     }
     return ret;
+#endif
 }
 
 void *operator new[](size_t size)
 {
+#ifdef UMM_SITE_STATS
+    return umm_malloc_at(size, __builtin_return_address(0));
+#else
     void *ret = malloc(size);
     if (0 != size && 0 == ret) {
         umm_last_fail_alloc_addr = __builtin_return_address(0);
         umm_last_fail_alloc_size = size;
     }
     return ret;
+#endif
 }
 
 void operator delete(void * ptr)
@@ -19,10 +19,14 @@
  */
 
 #include "cbuf.h"
+#ifdef ARDUINO
 #include "c_types.h"
+#else
+#define ICACHE_RAM_ATTR
+#endif
 
 cbuf::cbuf(size_t size) :
-    next(NULL), _size(size), _buf(new char[size]), _bufend(_buf + size), _begin(_buf), _end(_begin) {
+    next(NULL), _size(size), _buf(new char[size]), _head(0), _tail(0) {
 }
 
 cbuf::~cbuf() {
@@ -55,9 +59,8 @@ size_t cbuf::resize(size_t newSize) {
         memset((newbuf + bytes_available), 0x00, (newSize - bytes_available));
     }
 
-    _begin = newbuf;
-    _end = newbuf + bytes_available;
-    _bufend = newbuf + newSize;
+    _head = 0;
+    _tail = bytes_available;
     _size = newSize;
 
     _buf = newbuf;
@@ -67,68 +70,56 @@ size_t cbuf::resize(size_t newSize) {
 }
 
 size_t ICACHE_RAM_ATTR cbuf::available() const {
-    if(_end >= _begin) {
-        return _end - _begin;
+    size_t head = _head;
+    size_t tail = _load(_tail);
+    if(tail >= head) {
+        return tail - head;
     }
-    return _size - (_begin - _end);
+    return _size - (head - tail);
 }
 
 size_t cbuf::size() {
     return _size;
 }
 
-size_t cbuf::room() const {
-    if(_end >= _begin) {
-        return _size - (_end - _begin) - 1;
+size_t ICACHE_RAM_ATTR cbuf::room() const {
+    size_t head = _load(_head);
+    size_t tail = _tail;
+    if(tail >= head) {
+        return _size - (tail - head) - 1;
     }
-    return _begin - _end - 1;
+    return head - tail - 1;
 }
 
 int cbuf::peek() {
     if(empty())
         return -1;
 
-    return static_cast<int>(*_begin);
+    return static_cast<int>(_buf[_head]);
 }
 
 size_t cbuf::peek(char *dst, size_t size) {
-    size_t bytes_available = available();
+    span first, second;
+    size_t bytes_available = readSpans(first, second);
     size_t size_to_read = (size < bytes_available) ? size : bytes_available;
-    size_t size_read = size_to_read;
-    char * begin = _begin;
-    if(_end < _begin && size_to_read > (size_t) (_bufend - _begin)) {
-        size_t top_size = _bufend - _begin;
-        memcpy(dst, _begin, top_size);
-        begin = _buf;
-        size_to_read -= top_size;
-        dst += top_size;
-    }
-    memcpy(dst, begin, size_to_read);
-    return size_read;
+    size_t top_size = (size_to_read < first.size) ? size_to_read : first.size;
+    memcpy(dst, first.data, top_size);
+    memcpy(dst + top_size, second.data, size_to_read - top_size);
+    return size_to_read;
 }
 
 int ICACHE_RAM_ATTR cbuf::read() {
     if(empty())
         return -1;
 
-    char result = *_begin;
-    _begin = wrap_if_bufend(_begin + 1);
+    char result = _buf[_head];
+    _store(_head, _wrap(_head + 1));
     return static_cast<int>(result);
 }
 
 size_t cbuf::read(char* dst, size_t size) {
-    size_t bytes_available = available();
-    size_t size_to_read = (size < bytes_available) ? size : bytes_available;
-    size_t size_read = size_to_read;
-    if(_end < _begin && size_to_read > (size_t) (_bufend - _begin)) {
-        size_t top_size = _bufend - _begin;
-        memcpy(dst, _begin, top_size);
-        _begin = _buf;
-        size_to_read -= top_size;
-        dst += top_size;
-    }
-    memcpy(dst, _begin, size_to_read);
-    _begin = wrap_if_bufend(_begin + size_to_read);
+    size_t size_read = peek(dst, size);
+    consume(size_read);
     return size_read;
 }
 
@@ -136,30 +127,24 @@ size_t ICACHE_RAM_ATTR cbuf::write(char c) {
     if(full())
         return 0;
 
-    *_end = c;
-    _end = wrap_if_bufend(_end + 1);
+    _buf[_tail] = c;
+    _store(_tail, _wrap(_tail + 1));
     return 1;
 }
 
 size_t cbuf::write(const char* src, size_t size) {
-    size_t bytes_available = room();
+    span first, second;
+    size_t bytes_available = writeSpans(first, second);
     size_t size_to_write = (size < bytes_available) ? size : bytes_available;
-    size_t size_written = size_to_write;
-    if(_end >= _begin && size_to_write > (size_t) (_bufend - _end)) {
-        size_t top_size = _bufend - _end;
-        memcpy(_end, src, top_size);
-        _end = _buf;
-        size_to_write -= top_size;
-        src += top_size;
-    }
-    memcpy(_end, src, size_to_write);
-    _end = wrap_if_bufend(_end + size_to_write);
-    return size_written;
+    size_t top_size = (size_to_write < first.size) ? size_to_write : first.size;
+    memcpy(first.data, src, top_size);
+    memcpy(second.data, src + top_size, size_to_write - top_size);
+    commit(size_to_write);
+    return size_to_write;
 }
 
 void cbuf::flush() {
-    _begin = _buf;
-    _end = _buf;
+    _store(_head, _load(_tail));
 }
 
 size_t cbuf::remove(size_t size) {
@@ -168,12 +153,50 @@ size_t cbuf::remove(size_t size) {
         flush();
         return 0;
     }
-    size_t size_to_remove = (size < bytes_available) ? size : bytes_available;
-    if(_end < _begin && size_to_remove > (size_t) (_bufend - _begin)) {
-        size_t top_size = _bufend - _begin;
-        _begin = _buf;
-        size_to_remove -= top_size;
+    consume(size);
+    return bytes_available - size;
+}
+
+size_t ICACHE_RAM_ATTR cbuf::readSpans(span& first, span& second) {
+    size_t head = _head;
+    size_t tail = _load(_tail);
+    first.data = _buf + head;
+    second.data = _buf;
+    if(tail >= head) {
+        first.size = tail - head;
+        second.size = 0;
+    } else {
+        first.size = _size - head;
+        second.size = tail;
+    }
+    return first.size + second.size;
+}
+
+void ICACHE_RAM_ATTR cbuf::consume(size_t size) {
+    _store(_head, _wrap(_head + size));
+}
+
+size_t ICACHE_RAM_ATTR cbuf::writeSpans(span& first, span& second) {
+    size_t head = _load(_head);
+    size_t tail = _tail;
+    first.data = _buf + tail;
+    second.data = _buf;
+    // one byte always stays free, to tell a full buffer from an empty one
+    if(tail >= head) {
+        first.size = _size - tail;
+        second.size = head;
+        if(second.size) {
+            --second.size;
+        } else {
+            --first.size;
+        }
+    } else {
+        first.size = head - tail - 1;
+        second.size = 0;
     }
-    _begin = wrap_if_bufend(_begin + size_to_remove);
-    return available();
+    return first.size + second.size;
+}
+
+void ICACHE_RAM_ATTR cbuf::commit(size_t size) {
+    _store(_tail, _wrap(_tail + size));
 }
@@ -1,8 +1,8 @@
-/* 
+/*
  cbuf.h - Circular buffer implementation
  Copyright (c) 2014 Ivan Grokhotkov. All rights reserved.
  This file is part of the esp8266 core for Arduino environment.
- 
+
  This library is free software; you can redistribute it and/or
  modify it under the terms of the GNU Lesser General Public
  License as published by the Free Software Foundation; either
@@ -25,6 +25,12 @@
 #include <stdint.h>
 #include <string.h>
 
+// One producer and one consumer may use a cbuf at the same time without
+// locking, e.g. an interrupt handler writing and loop() reading. Each side
+// only moves its own index, once per call, after copying the data:
+//  - producer: write, room, full, writeSpans, commit
+//  - consumer: read, peek, remove, flush, readSpans, consume, available, empty
+// resize and resizeAdd need both sides to be idle.
 class cbuf {
     public:
         cbuf(size_t size);
@@ -38,11 +44,11 @@ class cbuf {
         size_t room() const;
 
         inline bool empty() const {
-            return _begin == _end;
+            return _load(_head) == _load(_tail);
         }
 
         inline bool full() const {
-            return wrap_if_bufend(_end + 1) == _begin;
+            return _wrap(_tail + 1) == _load(_head);
         }
 
         int peek();
@@ -57,18 +63,44 @@ class cbuf {
         void flush();
         size_t remove(size_t size);
 
+        // A contiguous part of the buffer
+        struct span {
+            char* data;
+            size_t size;
+        };
+
+        // The data that can be read, in place: first, and when it wraps around
+        // the end of the buffer, the rest in second. Returns the total size.
+        // consume(size) then takes the bytes that were used out of the buffer.
+        size_t readSpans(span& first, span& second);
+        void consume(size_t size);
+
+        // Same for the free space, e.g. to have it filled by DMA: commit(size)
+        // makes the bytes that were written available to the consumer.
+        size_t writeSpans(span& first, span& second);
+        void commit(size_t size);
+
         cbuf *next;
 
     private:
-        inline char* wrap_if_bufend(char* ptr) const {
-            return (ptr == _bufend) ? _buf : ptr;
+        inline size_t _wrap(size_t index) const {
+            return (index >= _size) ? index - _size : index;
+        }
+
+        // the index the other side moves is read with acquire semantics, and
+        // ours is published with release semantics, after the data
+        static inline size_t _load(const size_t& index) {
+            return __atomic_load_n(&index, __ATOMIC_ACQUIRE);
+        }
+
+        static inline void _store(size_t& index, size_t value) {
+            __atomic_store_n(&index, value, __ATOMIC_RELEASE);
         }
 
         size_t _size;
         char* _buf;
-        const char* _bufend;
-        char* _begin;
-        char* _end;
+        size_t _head;   // next byte to read, moved by the consumer
+        size_t _tail;   // next byte to write, moved by the producer
 
 };
 
@@ -15,12 +15,16 @@ int umm_last_fail_alloc_size = 0;
 void* _malloc_r(struct _reent* unused, size_t size)
 {
     (void) unused;
+#ifdef UMM_SITE_STATS
+    return umm_malloc_at(size, __builtin_return_address(0));
+#else
     void *ret = malloc(size);
     if (0 != size && 0 == ret) {
         umm_last_fail_alloc_addr = __builtin_return_address(0);
         umm_last_fail_alloc_size = size;
     }
     return ret;
+#endif
 }
 
 void _free_r(struct _reent* unused, void* ptr)
@@ -32,23 +36,31 @@ void _free_r(struct _reent* unused, void* ptr)
 void* _realloc_r(struct _reent* unused, void* ptr, size_t size)
 {
     (void) unused;
+#ifdef UMM_SITE_STATS
+    return umm_realloc_at(ptr, size, __builtin_return_address(0));
+#else
     void *ret = realloc(ptr, size);
     if (0 != size && 0 == ret) {
         umm_last_fail_alloc_addr = __builtin_return_address(0);
         umm_last_fail_alloc_size = size;
     }
     return ret;
+#endif
 }
 
 void* _calloc_r(struct _reent* unused, size_t count, size_t size)
 {
     (void) unused;
+#ifdef UMM_SITE_STATS
+    return umm_calloc_at(count, size, __builtin_return_address(0));
+#else
     void *ret = calloc(count, size);
     if (0 != (count * size) && 0 == ret) {
         umm_last_fail_alloc_addr = __builtin_return_address(0);
         umm_last_fail_alloc_size = count * size;
     }
     return ret;
+#endif
 }
 
 void ICACHE_RAM_ATTR vPortFree(void *ptr, const char* file, int line)
@@ -149,28 +161,44 @@ void* ICACHE_RAM_ATTR pvPortMalloc(size_t size, const char* file, int line)
 {
     (void) file;
     (void) line;
+#ifdef UMM_SITE_STATS
+    return umm_malloc_at(size, __builtin_return_address(0));
+#else
     return malloc(size);
+#endif
 }
 
 void* ICACHE_RAM_ATTR pvPortCalloc(size_t count, size_t size, const char* file, int line)
 {
     (void) file;
     (void) line;
+#ifdef UMM_SITE_STATS
+    return umm_calloc_at(count, size, __builtin_return_address(0));
+#else
     return calloc(count, size);
+#endif
 }
 
 void* ICACHE_RAM_ATTR pvPortRealloc(void *ptr, size_t size, const char* file, int line)
 {
     (void) file;
     (void) line;
+#ifdef UMM_SITE_STATS
+    return umm_realloc_at(ptr, size, __builtin_return_address(0));
+#else
     return realloc(ptr, size);
+#endif
 }
 
 void* ICACHE_RAM_ATTR pvPortZalloc(size_t size, const char* file, int line)
 {
     (void) file;
     (void) line;
+#ifdef UMM_SITE_STATS
+    return umm_calloc_at(1, size, __builtin_return_address(0));
+#else
     return calloc(1, size);
+#endif
 }
 
 #endif // !defined(DEBUG_ESP_OOM)
@@ -278,6 +278,7 @@ typedef struct spiffs_t {
 #if SPIFFS_CACHE_STATS
   u32_t cache_hits;
   u32_t cache_misses;
+  u32_t cache_evictions;
 #endif
 #endif
 
@@ -674,6 +675,21 @@ s32_t SPIFFS_gc_quick(spiffs *fs, u16_t max_free_pages);
  */
 s32_t SPIFFS_gc(spiffs *fs, u32_t size);
 
+/**
+ * Does one bounded step of garbage collection if fewer than min_free_blocks
+ * blocks are free: the written block with the best score among those with at
+ * least a quarter of their pages deleted has its remaining pages moved and is
+ * erased. Calling this regularly while the system is idle keeps writes from
+ * running into the garbage collector, which kicks in at 3 free blocks.
+ *
+ * Returns 1 if a block was erased, 0 if there was nothing worth erasing, or
+ * an error.
+ *
+ * @param fs              the file system struct
+ * @param min_free_blocks number of free blocks to keep
+ */
+s32_t SPIFFS_gc_step(spiffs *fs, u32_t min_free_blocks);
+
 /**
  * Check if EOF reached.
  * @param fs            the file system struct
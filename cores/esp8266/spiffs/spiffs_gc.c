@@ -195,6 +195,116 @@ s32_t spiffs_gc_check(
   return res;
 }
 
+// Does one bounded unit of garbage collection ahead of need: if fewer than
+// min_free_blocks blocks are free, the fully written block with the best
+// score among those with at least a quarter of their pages deleted is
+// cleansed and erased. Returns 1 if a block was erased, 0 if there was
+// nothing worth erasing.
+s32_t spiffs_gc_step(
+    spiffs *fs,
+    u32_t min_free_blocks) {
+  s32_t res = SPIFFS_OK;
+  s32_t free_pages =
+      (SPIFFS_PAGES_PER_BLOCK(fs) - SPIFFS_OBJ_LOOKUP_PAGES(fs)) * (fs->block_count-2)
+      - fs->stats_p_allocated - fs->stats_p_deleted;
+  u32_t data_pages = SPIFFS_PAGES_PER_BLOCK(fs) - SPIFFS_OBJ_LOOKUP_PAGES(fs);
+  u32_t min_deleted = data_pages / 4 ? data_pages / 4 : 1;
+  u32_t blocks = fs->block_count;
+  spiffs_block_ix cur_block = 0;
+  u32_t cur_block_addr = 0;
+  spiffs_obj_id *obj_lu_buf = (spiffs_obj_id *)fs->lu_work;
+  int entries_per_page = (SPIFFS_CFG_LOG_PAGE_SZ(fs) / sizeof(spiffs_obj_id));
+  spiffs_block_ix cand = (spiffs_block_ix)-1;
+  s32_t cand_score = 0;
+
+  if (fs->free_blocks >= min_free_blocks || fs->stats_p_deleted < min_deleted) {
+    return 0;
+  }
+
+  // check each block
+  while (res == SPIFFS_OK && blocks--) {
+    u16_t deleted_pages_in_block = 0;
+    u16_t used_pages_in_block = 0;
+    int cur_entry = 0;
+
+    int obj_lookup_page = 0;
+    // check each object lookup page
+    while (res == SPIFFS_OK && obj_lookup_page < (int)SPIFFS_OBJ_LOOKUP_PAGES(fs)) {
+      int entry_offset = obj_lookup_page * entries_per_page;
+      res = _spiffs_rd(fs, SPIFFS_OP_T_OBJ_LU | SPIFFS_OP_C_READ,
+          0, cur_block_addr + SPIFFS_PAGE_TO_PADDR(fs, obj_lookup_page), SPIFFS_CFG_LOG_PAGE_SZ(fs), fs->lu_work);
+      // check each entry
+      while (res == SPIFFS_OK &&
+          cur_entry - entry_offset < entries_per_page &&
+          cur_entry < (int)data_pages) {
+        spiffs_obj_id obj_id = obj_lu_buf[cur_entry-entry_offset];
+        if (obj_id == SPIFFS_OBJ_ID_FREE) {
+          // a block still being written is left alone
+          res = 1; // kill object lu loop
+          break;
+        } else if (obj_id == SPIFFS_OBJ_ID_DELETED) {
+          deleted_pages_in_block++;
+        } else {
+          used_pages_in_block++;
+        }
+        cur_entry++;
+      } // per entry
+      obj_lookup_page++;
+    } // per object lookup page
+
+    if (res == SPIFFS_OK &&
+        deleted_pages_in_block >= min_deleted &&
+        (s32_t)used_pages_in_block < free_pages) {
+      spiffs_obj_id erase_count;
+      res = _spiffs_rd(fs, SPIFFS_OP_C_READ | SPIFFS_OP_T_OBJ_LU2, 0,
+          SPIFFS_ERASE_COUNT_PADDR(fs, cur_block),
+          sizeof(spiffs_obj_id), (u8_t *)&erase_count);
+      SPIFFS_CHECK_RES(res);
+
+      spiffs_obj_id erase_age;
+      if (fs->max_erase_count > erase_count) {
+        erase_age = fs->max_erase_count - erase_count;
+      } else {
+        erase_age = SPIFFS_OBJ_ID_FREE - (erase_count - fs->max_erase_count);
+      }
+
+      s32_t score =
+          deleted_pages_in_block * SPIFFS_GC_HEUR_W_DELET +
+          used_pages_in_block * SPIFFS_GC_HEUR_W_USED +
+          erase_age * SPIFFS_GC_HEUR_W_ERASE_AGE;
+      if (cand == (spiffs_block_ix)-1 || score > cand_score) {
+        cand = cur_block;
+        cand_score = score;
+      }
+    }
+    if (res == 1) res = SPIFFS_OK;
+
+    cur_block++;
+    cur_block_addr += SPIFFS_CFG_LOG_BLOCK_SZ(fs);
+  } // per block
+  SPIFFS_CHECK_RES(res);
+
+  if (cand == (spiffs_block_ix)-1) {
+    return 0;
+  }
+
+  SPIFFS_GC_DBG("gc_step: cleaning block "_SPIPRIbl" free_blocks:"_SPIPRIi"\n", cand, fs->free_blocks);
+#if SPIFFS_GC_STATS
+  fs->stats_gc_runs++;
+#endif
+  fs->cleaning = 1;
+  res = spiffs_gc_clean(fs, cand);
+  fs->cleaning = 0;
+  SPIFFS_CHECK_RES(res);
+
+  res = spiffs_gc_erase_page_stats(fs, cand);
+  SPIFFS_CHECK_RES(res);
+
+  res = spiffs_gc_erase_block(fs, cand);
+  SPIFFS_CHECK_RES(res);
+  return 1;
+}
+
 // Updates page statistics for a block that is about to be erased
 s32_t spiffs_gc_erase_page_stats(
     spiffs *fs,
@@ -746,6 +746,10 @@ s32_t spiffs_gc_check(
     spiffs *fs,
     u32_t len);
 
+s32_t spiffs_gc_step(
+    spiffs *fs,
+    u32_t min_free_blocks);
+
 s32_t spiffs_gc_erase_page_stats(
     spiffs *fs,
     spiffs_block_ix bix);
@@ -32,6 +32,24 @@ FileImplPtr SPIFFSImpl::openFile(const char* path, OpenMode openMode, AccessMode
         return FileImplPtr();
     }
     int mode = getSpiffsMode(openMode, accessMode);
+    if (accessMode & AM_WRITE) {
+        // creating or truncating counts as a change, even before any write
+        _changed(path);
+    }
+    if (openMode == OM_DEFAULT && accessMode == AM_READ && _index.ready(&_fs)) {
+        // the index knows where the header is, skip the lookup scan
+        spiffs_stat stat;
+        if (!_index.find(&_fs, path, &stat)) {
+            DEBUGV("SPIFFSImpl::open: path=`%s` not found\r\n", path);
+            return FileImplPtr();
+        }
+        int fd = SPIFFS_open_by_page(&_fs, stat.pix, mode, 0);
+        if (fd < 0) {
+            DEBUGV("SPIFFSImpl::open: fd=%d path=`%s` err=%d\r\n", fd, path, _fs.err_code);
+            return FileImplPtr();
+        }
+        return std::make_shared<SPIFFSFileImpl>(this, fd, (accessMode & AM_WRITE) ? 0 : _readAhead);
+    }
     int fd = SPIFFS_open(&_fs, path, mode, 0);
     if (fd < 0 && _fs.err_code == SPIFFS_ERR_DELETED && (openMode & OM_CREATE)) {
         DEBUGV("SPIFFSImpl::open: fd=%d path=`%s` openMode=%d accessMode=%d err=%d, trying to remove\r\n",
@@ -49,7 +67,7 @@ FileImplPtr SPIFFSImpl::openFile(const char* path, OpenMode openMode, AccessMode
                fd, path, openMode, accessMode, _fs.err_code);
         return FileImplPtr();
     }
-    return std::make_shared<SPIFFSFileImpl>(this, fd);
+    return std::make_shared<SPIFFSFileImpl>(this, fd, (accessMode & AM_WRITE) ? 0 : _readAhead);
 }
 
 bool SPIFFSImpl::exists(const char* path) const
@@ -58,11 +76,57 @@ bool SPIFFSImpl::exists(const char* path) const
         DEBUGV("SPIFFSImpl::exists: invalid path=`%s` \r\n", path);
         return false;
     }
+    spiffs* fs = const_cast<spiffs*>(&_fs);
+    if (_index.ready(fs)) {
+        return _index.find(fs, path, nullptr);
+    }
     spiffs_stat stat;
-    int rc = SPIFFS_stat(const_cast<spiffs*>(&_fs), path, &stat);
+    int rc = SPIFFS_stat(fs, path, &stat);
     return rc == SPIFFS_OK;
 }
 
+bool SPIFFSImpl::isDir(const char* path) const
+{
+    // there are no directories, only names with slashes in them
+    spiffs* fs = const_cast<spiffs*>(&_fs);
+    if (_index.ready(fs)) {
+        return _index.isDir(fs, path);
+    }
+    String prefix(path);
+    if (!prefix.endsWith("/")) {
+        prefix += '/';
+    }
+    if (prefix == "/") {
+        return SPIFFS_mounted(fs) != 0;
+    }
+    spiffs_DIR dir;
+    if (!SPIFFS_opendir(fs, path, &dir)) {
+        return false;
+    }
+    spiffs_dirent dirent;
+    bool found = false;
+    while (!found && SPIFFS_readdir(&dir, &dirent)) {
+        found = strncmp((const char*) dirent.name, prefix.c_str(), prefix.length()) == 0;
+    }
+    SPIFFS_closedir(&dir);
+    return found;
+}
+
+size_t SPIFFSImpl::size(const char* path) const
+{
+    if (!isSpiffsFilenameValid(path)) {
+        DEBUGV("SPIFFSImpl::size: invalid path=`%s` \r\n", path);
+        return 0;
+    }
+    spiffs* fs = const_cast<spiffs*>(&_fs);
+    spiffs_stat stat;
+    if (_index.ready(fs)) {
+        return _index.find(fs, path, &stat) ? stat.size : 0;
+    }
+    int rc = SPIFFS_stat(fs, path, &stat);
+    return (rc == SPIFFS_OK) ? stat.size : 0;
+}
+
 DirImplPtr SPIFFSImpl::openDir(const char* path, bool create)
 {
     (void)create;
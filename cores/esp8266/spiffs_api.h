@@ -25,19 +25,34 @@
  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
  */
 #include <limits>
+#include <algorithm>
+#include <new>
 #include "FS.h"
 #undef max
 #undef min
 #include "FSImpl.h"
 #include "spiffs/spiffs.h"
+#include "spiffs_index.h"
+#include "spiffs_hal.h"
 #include "debug.h"
 #include "flash_utils.h"
+#include "Schedule.h"
 
 using namespace fs;
 
-extern int32_t spiffs_hal_write(uint32_t addr, uint32_t size, uint8_t *src);
-extern int32_t spiffs_hal_erase(uint32_t addr, uint32_t size);
-extern int32_t spiffs_hal_read(uint32_t addr, uint32_t size, uint8_t *dst);
+
+// the cache keeps track of its pages in a 32 bit map
+#define SPIFFS_MAX_CACHE_PAGES 32
+
+// background GC keeps this many blocks free, writes collect inline at 3
+#ifndef SPIFFS_BACKGROUND_GC_FREE_BLOCKS
+#define SPIFFS_BACKGROUND_GC_FREE_BLOCKS 5
+#endif
+
+// changedSince() knows which paths the last this many changes touched
+#ifndef SPIFFS_CHANGE_LOG
+#define SPIFFS_CHANGE_LOG 8
+#endif
 
 int getSpiffsMode(OpenMode openMode, AccessMode accessMode);
 bool isSpiffsFilenameValid(const char* name);
@@ -54,8 +69,17 @@ public:
     , _pageSize(pageSize)
     , _blockSize(blockSize)
     , _maxOpenFds(maxOpenFds)
+    , _generation(1)
+    , _changeNext(0)
+    , _cachePages(maxOpenFds)
+    , _cacheBufSize(0)
+    , _readAhead(0)
+    , _backgroundGC(false)
+    , _gcPending(false)
     {
         memset(&_fs, 0, sizeof(_fs));
+        memset(_changes, 0, sizeof(_changes));
+        _fs.user_data = this;
     }
 
     FileImplPtr openFile(const char* path, OpenMode openMode, AccessMode accessMode) override;
@@ -72,12 +96,15 @@ public:
             DEBUGV("SPIFFSImpl::rename: invalid pathTo=`%s` \r\n", pathTo);
             return false;
         }
+        _changed(pathFrom);
+        _changed(pathTo);
         auto rc = SPIFFS_rename(&_fs, pathFrom, pathTo);
         if (rc != SPIFFS_OK) {
             DEBUGV("SPIFFS_rename: rc=%d, from=`%s`, to=`%s`\r\n", rc,
                    pathFrom, pathTo);
             return false;
         }
+        _scheduleGC();
         return true;
     }
     bool info(FSInfo& info) const override
@@ -95,6 +122,10 @@ public:
         }
         info.totalBytes = totalBytes;
         info.usedBytes = usedBytes;
+        info.cachePages = _cachePages;
+        info.cacheHits = _fs.cache_hits;
+        info.cacheMisses = _fs.cache_misses;
+        info.cacheEvictions = _fs.cache_evictions;
         return true;
     }
 
@@ -104,11 +135,13 @@ public:
             DEBUGV("SPIFFSImpl::remove: invalid path=`%s`\r\n", path);
             return false;
         }
+        _changed(path);
         auto rc = SPIFFS_remove(&_fs, path);
         if (rc != SPIFFS_OK) {
             DEBUGV("SPIFFS_remove: rc=%d path=`%s`\r\n", rc, path);
             return false;
         }
+        _scheduleGC();
         return true;
     }
 
@@ -117,19 +150,41 @@ public:
         if (SPIFFS_mounted(&_fs) != 0) {
             return true;
         }
+        _changed();
         if (_size == 0) {
             DEBUGV("SPIFFS size is zero");
             return false;
         }
-        if (_tryMount()) {
-            return true;
+        // flash may have been written while unmounted, e.g. by an update
+        spiffs_hal_invalidate();
+        if (!_tryMount()) {
+            auto rc = SPIFFS_format(&_fs);
+            if (rc != SPIFFS_OK) {
+                DEBUGV("SPIFFS_format: rc=%d, err=%d\r\n", rc, _fs.err_code);
+                return false;
+            }
+            if (!_tryMount()) {
+                return false;
+            }
+        }
+        _index.build(&_fs);
+        return true;
+    }
+
+    bool configure(const FSConfig& config) override
+    {
+        size_t cachePages = config.cachePages ? config.cachePages : _maxOpenFds;
+        if (cachePages > SPIFFS_MAX_CACHE_PAGES) {
+            cachePages = SPIFFS_MAX_CACHE_PAGES;
         }
-        auto rc = SPIFFS_format(&_fs);
-        if (rc != SPIFFS_OK) {
-            DEBUGV("SPIFFS_format: rc=%d, err=%d\r\n", rc, _fs.err_code);
-            return false;
+        // files opened from now on pick this up
+        _readAhead = config.readAhead;
+        _backgroundGC = config.backgroundGC;
+        if (cachePages != _cachePages) {
+            _cachePages = cachePages;
+            end();
         }
-        return _tryMount();
+        return true;
     }
 
     void end() override
@@ -138,6 +193,7 @@ public:
             return;
         }
         SPIFFS_unmount(&_fs);
+        _index.clear();
     }
 
     bool format() override
@@ -148,6 +204,8 @@ public:
         }
 
         bool wasMounted = (SPIFFS_mounted(&_fs) != 0);
+        _changed();
+        _index.clear();
 
         if (_tryMount()) {
             SPIFFS_unmount(&_fs);
@@ -159,31 +217,55 @@ public:
         }
 
         if (wasMounted) {
-            return _tryMount();
+            if (!_tryMount()) {
+                return false;
+            }
+            _index.build(&_fs);
         }
 
         return true;
     }
 
-    bool isDir(const char* path) const override
+    bool isDir(const char* path) const override;
+    size_t size(const char* path) const override;
+
+    time_t mtime(const char* path) const override
     {
         (void)path;
-        // Not implemented
-        return false;
+        // SPIFFS keeps no timestamps
+        return 0;
     }
 
-    size_t size(const char* path) const override
+    uint32_t generation() const override
     {
-        (void)path;
-        // Not implemented
-        return 0;
+        return _generation;
     }
 
-    time_t mtime(const char* path) const override
+    bool changedSince(const char* path, uint32_t generation) const override
     {
-        (void)path;
-        // Not implemented
-        return 0;
+        if (generation == 0) {
+            return true;
+        }
+        uint32_t hash = _pathHash(path);
+        // newest first, until the changes are older than the generation asked
+        for (size_t i = 0; i < SPIFFS_CHANGE_LOG; ++i) {
+            const Change& change = _changes[(_changeNext + SPIFFS_CHANGE_LOG - 1 - i) % SPIFFS_CHANGE_LOG];
+            if (change.generation == 0 || (int32_t)(change.generation - generation) <= 0) {
+                return false;
+            }
+            if (change.pathHash == 0 || change.pathHash == hash) {
+                return true;
+            }
+        }
+        // the log does not reach back that far
+        return true;
+    }
+
+    // The name index is on by default; turning it off frees it and
+    // turning it back on sweeps the fs again on first use
+    void setIndexEnabled(bool enabled)
+    {
+        _index.setEnabled(enabled);
     }
 
 protected:
@@ -195,6 +277,71 @@ protected:
         return &_fs;
     }
 
+    // Writes run into inline GC once only 3 blocks are free, which can
+    // take hundreds of milliseconds. In background mode every change that
+    // leaves fewer than SPIFFS_BACKGROUND_GC_FREE_BLOCKS free schedules a
+    // step, which frees at most one block and schedules the next one.
+    void _scheduleGC()
+    {
+        if (!_backgroundGC || _gcPending ||
+            _fs.free_blocks >= SPIFFS_BACKGROUND_GC_FREE_BLOCKS) {
+            return;
+        }
+        if (!_self) {
+            _self = std::make_shared<SPIFFSImpl*>(this);
+        }
+        // the fs may be gone by the time this runs
+        std::weak_ptr<SPIFFSImpl*> self = _self;
+        _gcPending = schedule_function([self]() {
+            if (auto fs = self.lock()) {
+                (*fs)->_gcStep();
+            }
+        });
+    }
+
+    void _gcStep()
+    {
+        _gcPending = false;
+        if (!_backgroundGC || SPIFFS_mounted(&_fs) == 0) {
+            return;
+        }
+        auto rc = SPIFFS_gc_step(&_fs, SPIFFS_BACKGROUND_GC_FREE_BLOCKS);
+        if (rc < 0) {
+            DEBUGV("SPIFFS_gc_step: rc=%d\r\n", rc);
+        } else if (rc > 0) {
+            _scheduleGC();
+        }
+    }
+
+    // Logs a change to path, or to every file if path is null
+    void _changed(const char* path = nullptr)
+    {
+        // 0 means "not tracked", skip it when wrapping around
+        if (++_generation == 0) {
+            _generation = 1;
+        }
+        uint32_t hash = path ? _pathHash(path) : 0;
+        Change& last = _changes[(_changeNext + SPIFFS_CHANGE_LOG - 1) % SPIFFS_CHANGE_LOG];
+        if (last.generation != 0 && last.pathHash == hash) {
+            // a run of writes to one file takes a single entry
+            last.generation = _generation;
+            return;
+        }
+        _changes[_changeNext].pathHash = hash;
+        _changes[_changeNext].generation = _generation;
+        _changeNext = (_changeNext + 1) % SPIFFS_CHANGE_LOG;
+    }
+
+    // FNV-1a, with 0 left for "every file"
+    static uint32_t _pathHash(const char* path)
+    {
+        uint32_t hash = 2166136261u;
+        while (*path) {
+            hash = (hash ^ (uint8_t) *path++) * 16777619u;
+        }
+        return hash ? hash : 1;
+    }
+
     bool _tryMount()
     {
         spiffs_config config;
@@ -238,15 +385,19 @@ protected:
 
         size_t workBufSize = 2 * _pageSize;
         size_t fdsBufSize = SPIFFS_buffer_bytes_for_filedescs(&_fs, _maxOpenFds);
-        size_t cacheBufSize = SPIFFS_buffer_bytes_for_cache(&_fs, _maxOpenFds);
+        size_t cacheBufSize = SPIFFS_buffer_bytes_for_cache(&_fs, _cachePages);
 
         if (!_workBuf) {
-            DEBUGV("SPIFFSImpl: allocating %d+%d+%d=%d bytes\r\n",
-                   workBufSize, fdsBufSize, cacheBufSize,
-                   workBufSize + fdsBufSize + cacheBufSize);
+            DEBUGV("SPIFFSImpl: allocating %d+%d bytes\r\n",
+                   workBufSize, fdsBufSize);
             _workBuf.reset(new uint8_t[workBufSize]);
             _fdsBuf.reset(new uint8_t[fdsBufSize]);
+        }
+        if (_cacheBufSize != cacheBufSize) {
+            DEBUGV("SPIFFSImpl: allocating %d bytes for %d cache pages\r\n",
+                   cacheBufSize, _cachePages);
             _cacheBuf.reset(new uint8_t[cacheBufSize]);
+            _cacheBufSize = cacheBufSize;
         }
 
         DEBUGV("SPIFFSImpl: mounting fs @%x, size=%x, block=%x, page=%x\r\n",
@@ -258,7 +409,17 @@ protected:
 
         DEBUGV("SPIFFSImpl: mount rc=%d\r\n", err);
 
-        return err == SPIFFS_OK;
+        if (err != SPIFFS_OK) {
+            return false;
+        }
+        // mount clears the callback, the index needs to see every change
+        SPIFFS_set_file_callback_func(&_fs, &SPIFFSImpl::_file_cb);
+        return true;
+    }
+
+    static void _file_cb(spiffs* fs, spiffs_fileop_type op, spiffs_obj_id objId, spiffs_page_ix pix)
+    {
+        static_cast<SPIFFSImpl*>(fs->user_data)->_index.update(op, objId, pix);
     }
 
     static void _check_cb(spiffs_check_type type, spiffs_check_report report,
@@ -281,6 +442,20 @@ protected:
     uint32_t _pageSize;
     uint32_t _blockSize;
     uint32_t _maxOpenFds;
+    uint32_t _generation;
+    struct Change {
+        uint32_t pathHash;
+        uint32_t generation;
+    };
+    Change _changes[SPIFFS_CHANGE_LOG];
+    size_t _changeNext;
+    mutable SPIFFSIndex _index;
+    size_t _cachePages;
+    size_t _cacheBufSize;
+    size_t _readAhead;
+    bool _backgroundGC;
+    bool _gcPending;
+    std::shared_ptr<SPIFFSImpl*> _self;
 
     std::unique_ptr<uint8_t[]> _workBuf;
     std::unique_ptr<uint8_t[]> _fdsBuf;
@@ -292,10 +467,13 @@ protected:
 class SPIFFSFileImpl : public FileImpl
 {
 public:
-    SPIFFSFileImpl(SPIFFSImpl* fs, spiffs_file fd)
+    SPIFFSFileImpl(SPIFFSImpl* fs, spiffs_file fd, size_t readAhead = 0)
         : _fs(fs)
         , _fd(fd)
     , _written(false)
+    , _readAhead(readAhead)
+    , _bufPos(0)
+    , _bufLen(0)
     {
         memset(&_stat, 0, sizeof(_stat));
         _getStat();
@@ -303,32 +481,70 @@ public:
 
     ~SPIFFSFileImpl() override
     {
-        close();
+        // File::close() may have closed it already
+        if (_fd) {
+            close();
+        }
     }
 
     size_t write(const uint8_t *buf, size_t size) override
     {
         CHECKFD();
 
+        _fs->_changed((const char*) _stat.name);
         auto result = SPIFFS_write(_fs->getFs(), _fd, (void*) buf, size);
         if (result < 0) {
             DEBUGV("SPIFFS_write rc=%d\r\n", result);
             return 0;
         }
         _written = true;
+        _fs->_scheduleGC();
         return result;
     }
 
     size_t read(uint8_t* buf, size_t size) override
     {
         CHECKFD();
-        auto result = SPIFFS_read(_fs->getFs(), _fd, (void*) buf, size);
-        if (result < 0) {
-            DEBUGV("SPIFFS_read rc=%d\r\n", result);
-            return 0;
+
+        size_t done = 0;
+        if (_bufPos < _bufLen) {
+            done = std::min(size, _bufLen - _bufPos);
+            memcpy(buf, _buf.get() + _bufPos, done);
+            _bufPos += done;
+            if (done == size) {
+                return done;
+            }
+        }
+        if (size - done >= _readAhead) {
+            // large reads go straight to the caller's buffer
+            return done + _read(buf + done, size - done);
+        }
+        if (!_buf) {
+            _buf.reset(new (std::nothrow) uint8_t[_readAhead]);
+            if (!_buf) {
+                _readAhead = 0;
+                return done + _read(buf + done, size - done);
+            }
         }
+        _bufLen = _read(_buf.get(), _readAhead);
+        _bufPos = std::min(size - done, _bufLen);
+        memcpy(buf + done, _buf.get(), _bufPos);
+        return done + _bufPos;
+    }
 
-        return result;
+    size_t peekAvailable() override
+    {
+        return _bufLen - _bufPos;
+    }
+
+    const char* peekBuffer() override
+    {
+        return reinterpret_cast<const char*>(_buf.get() + _bufPos);
+    }
+
+    void peekConsume(size_t consume) override
+    {
+        _bufPos += std::min(consume, _bufLen - _bufPos);
     }
 
     void flush() override
@@ -350,6 +566,17 @@ public:
         if (mode == SeekEnd) {
             offset = -offset;
         }
+        if (mode == SeekCur) {
+            // stay within the buffer if possible, as after File::peek()
+            int32_t bufPos = static_cast<int32_t>(_bufPos) + offset;
+            if (_bufLen && bufPos >= 0 && bufPos <= static_cast<int32_t>(_bufLen)) {
+                _bufPos = bufPos;
+                return true;
+            }
+            // the fd is ahead by what is still buffered
+            offset -= _bufLen - _bufPos;
+        }
+        _bufPos = _bufLen = 0;
         auto rc = SPIFFS_lseek(_fs->getFs(), _fd, offset, (int) mode);
         if (rc < 0) {
             DEBUGV("SPIFFS_lseek rc=%d\r\n", rc);
@@ -369,7 +596,7 @@ public:
             return 0;
         }
 
-        return result;
+        return result - (_bufLen - _bufPos);
     }
 
     bool truncate() override
@@ -396,6 +623,8 @@ public:
         SPIFFS_close(_fs->getFs(), _fd);
         DEBUGV("SPIFFS_close: fd=%d\r\n", _fd);
         _fd = 0;
+        _buf.reset();
+        _bufPos = _bufLen = 0;
     }
 
     const char* name() const override
@@ -449,10 +678,26 @@ protected:
         _written = false;
     }
 
+    size_t _read(uint8_t* buf, size_t size)
+    {
+        auto result = SPIFFS_read(_fs->getFs(), _fd, (void*) buf, size);
+        if (result < 0) {
+            DEBUGV("SPIFFS_read rc=%d\r\n", result);
+            return 0;
+        }
+        return result;
+    }
+
     SPIFFSImpl* _fs;
     spiffs_file _fd;
     mutable spiffs_stat _stat;
     mutable bool        _written;
+
+    // read-ahead buffer, only for files not opened for writing
+    size_t _readAhead;
+    std::unique_ptr<uint8_t[]> _buf;
+    size_t _bufPos;
+    size_t _bufLen;
 };
 
 class SPIFFSDirImpl : public DirImpl
@@ -463,6 +708,8 @@ public:
         , _fs(fs)
         , _dir(dir)
         , _valid(false)
+        , _indexed(fs->_index.ready(fs->getFs()))
+        , _cursor(0)
     {
         memset(&_dirent, 0, sizeof(_dirent));
     }
@@ -502,6 +749,9 @@ public:
             return FileImplPtr();
         }
         int mode = getSpiffsMode(openMode, accessMode);
+        if (accessMode & AM_WRITE) {
+            _fs->_changed((const char*) _dirent.name);
+        }
         auto fs = _fs->getFs();
         spiffs_file fd = SPIFFS_open_by_dirent(fs, &_dirent, mode, 0);
         if (fd < 0) {
@@ -509,7 +759,7 @@ public:
                    fd, _dirent.name, openMode, accessMode, fs->err_code);
             return FileImplPtr();
         }
-        return std::make_shared<SPIFFSFileImpl>(_fs, fd);
+        return std::make_shared<SPIFFSFileImpl>(_fs, fd, (accessMode & AM_WRITE) ? 0 : _fs->_readAhead);
     }
 
     DirImplPtr openEntryDir() override
@@ -622,7 +872,15 @@ public:
 
     bool next(bool reset) override
     {
-        if (reset) memset(&_dirent, 0, sizeof(_dirent));
+        if (reset) {
+            memset(&_dirent, 0, sizeof(_dirent));
+            _cursor = 0;
+        }
+        if (_indexed) {
+            // walks object ids, a listing ends early if the index is lost
+            _valid = _fs->_index.next(_fs->getFs(), _cursor, _pattern.c_str(), &_dirent);
+            return _valid;
+        }
         const int n = _pattern.length();
         do {
             spiffs_dirent* result = SPIFFS_readdir(&_dir, &_dirent);
@@ -677,6 +935,8 @@ protected:
     spiffs_DIR  _dir;
     spiffs_dirent _dirent;
     bool _valid;
+    bool _indexed;
+    spiffs_obj_id _cursor;
 };
 
 
@@ -18,73 +18,192 @@
  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
+#ifdef ARDUINO
 #include <Arduino.h>
+#endif
 #include <stdlib.h>
+#include <string.h>
 #include <algorithm>
 #include "spiffs/spiffs.h"
+#include "spiffs_hal.h"
+#include "flash_utils.h"
 #include "debug.h"
 
-extern "C" {
-#include "c_types.h"
-#include "spi_flash.h"
+static_assert((SPIFFS_HAL_LINE_SIZE & (SPIFFS_HAL_LINE_SIZE - 1)) == 0 &&
+              SPIFFS_HAL_LINE_SIZE >= 8 && SPIFFS_HAL_LINE_SIZE <= FLASH_SECTOR_SIZE,
+              "SPIFFS_HAL_LINE_SIZE must be a power of two between 8 and a sector");
+
+static const uint32_t NO_LINE = 0xffffffff;
+
+static uint32_t s_line[SPIFFS_HAL_LINE_SIZE / 4];
+static uint32_t s_lineAddr = NO_LINE;
+static SPIFFSHalStats s_stats;
+
+static uint8_t sizeBucket(uint32_t size)
+{
+    uint8_t bucket = 0;
+    for (uint32_t limit = 4; bucket + 1 < SPIFFS_HAL_SIZE_BUCKETS && size > limit; limit <<= 1) {
+        ++bucket;
+    }
+    return bucket;
+}
+
+static bool flashRead(uint32_t addr, uint32_t* dst, uint32_t size)
+{
+    ++s_stats.flashReads;
+    s_stats.flashReadBytes += size;
+    if (!spiffs_flash_read(addr, dst, size)) {
+        DEBUGV("_spif_read addr=%x size=%x\r\n", addr, size);
+        return false;
+    }
+    return true;
+}
+
+static bool flashWrite(uint32_t addr, const uint32_t* src, uint32_t size)
+{
+    ++s_stats.flashWrites;
+    if (!spiffs_flash_write(addr, src, size)) {
+        DEBUGV("_spif_write addr=%x size=%x\r\n", addr, size);
+        return false;
+    }
+    return true;
+}
+
+static void invalidate(uint32_t addr, uint32_t size)
+{
+    if (s_lineAddr != NO_LINE && addr < s_lineAddr + SPIFFS_HAL_LINE_SIZE && s_lineAddr < addr + size) {
+        s_lineAddr = NO_LINE;
+    }
+}
+
+void spiffs_hal_invalidate()
+{
+    s_lineAddr = NO_LINE;
+}
+
+void spiffs_hal_get_stats(SPIFFSHalStats* stats)
+{
+    *stats = s_stats;
 }
+
+void spiffs_hal_reset_stats()
+{
+    memset(&s_stats, 0, sizeof(s_stats));
+}
+
 /*
- spi_flash_read function requires flash address to be aligned on word boundary.
- We take care of this by reading first and last words separately and memcpy
- relevant bytes into result buffer.
-
-alignment:       012301230123012301230123
-bytes requested: -------***********------
-read directly:   --------xxxxxxxx--------
-read pre:        ----aaaa----------------
-read post:       ----------------bbbb----
-alignedBegin:            ^
-alignedEnd:                      ^
-*/
+ spi_flash_read function requires flash address and RAM address to be
+ aligned on word boundary, and size to be a multiple of a word.
 
-int32_t spiffs_hal_read(uint32_t addr, uint32_t size, uint8_t *dst) {
-    optimistic_yield(10000);
+ Reads shorter than a line are taken from the line buffer, which is
+ filled with the aligned line around them (or starting at them, if they
+ straddle two lines). SPIFFS reads lookup entries and page headers next
+ to each other, so most of those are answered without touching flash.
+
+ Larger reads go straight into the destination. When it is not aligned
+ like the flash address, all but the last word are read to the next
+ aligned RAM address and moved into place:
+
+ alignment:       012301230123012301230123
+ bytes requested: -------***********------
+ read directly:   --------xxxxxxxx--------
+ read pre:        ----aaaa----------------
+ read post:       ----------------bbbb----
+ alignedBegin:            ^
+ alignedEnd:                      ^
+*/
 
-    uint32_t result = SPIFFS_OK;
+static bool readDirect(uint32_t addr, uint32_t size, uint8_t* dst)
+{
     uint32_t alignedBegin = (addr + 3) & (~3);
     uint32_t alignedEnd = (addr + size) & (~3);
-    if (alignedEnd < alignedBegin) {
-        alignedEnd = alignedBegin;
+
+    if (alignedEnd <= alignedBegin) {
+        // no whole word in between, at most two words to read
+        uint32_t base = addr & (~3);
+        uint32_t tmp[2];
+        if (!flashRead(base, tmp, ((addr + size + 3) & (~3)) - base)) {
+            return false;
+        }
+        memcpy(dst, ((uint8_t*) tmp) + addr - base, size);
+        return true;
     }
 
-    if (addr < alignedBegin) {
-        uint32_t nb = alignedBegin - addr;
+    uint8_t* body = dst + alignedBegin - addr;
+    uint32_t bodySize = alignedEnd - alignedBegin;
+    if ((((uintptr_t) body) & 3) == 0) {
+        if (!flashRead(alignedBegin, (uint32_t*) body, bodySize)) {
+            return false;
+        }
+    } else {
+        uint8_t* aligned = (uint8_t*) ((((uintptr_t) body) + 3) & (~3));
+        uint32_t nb = bodySize - 4;
+        if (nb) {
+            if (!flashRead(alignedBegin, (uint32_t*) aligned, nb)) {
+                return false;
+            }
+            memmove(body, aligned, nb);
+        }
         uint32_t tmp;
-        if (!ESP.flashRead(alignedBegin - 4, &tmp, 4)) {
-            DEBUGV("_spif_read(%d) addr=%x size=%x ab=%x ae=%x\r\n",
-                __LINE__, addr, size, alignedBegin, alignedEnd);
-            return SPIFFS_ERR_INTERNAL;
+        if (!flashRead(alignedEnd - 4, &tmp, 4)) {
+            return false;
         }
-        memcpy(dst, ((uint8_t*) &tmp) + 4 - nb, nb);
+        memcpy(body + nb, &tmp, 4);
     }
 
-    if (alignedEnd != alignedBegin) {
-        if (!ESP.flashRead(alignedBegin, (uint32_t*) (dst + alignedBegin - addr),
-                alignedEnd - alignedBegin)) {
-            DEBUGV("_spif_read(%d) addr=%x size=%x ab=%x ae=%x\r\n",
-                __LINE__, addr, size, alignedBegin, alignedEnd);
-            return SPIFFS_ERR_INTERNAL;
+    if (addr < alignedBegin) {
+        uint32_t nb = alignedBegin - addr;
+        uint32_t tmp;
+        if (!flashRead(alignedBegin - 4, &tmp, 4)) {
+            return false;
         }
+        memcpy(dst, ((uint8_t*) &tmp) + 4 - nb, nb);
     }
 
     if (addr + size > alignedEnd) {
         uint32_t nb = addr + size - alignedEnd;
         uint32_t tmp;
-        if (!ESP.flashRead(alignedEnd, &tmp, 4)) {
-            DEBUGV("_spif_read(%d) addr=%x size=%x ab=%x ae=%x\r\n",
-                __LINE__, addr, size, alignedBegin, alignedEnd);
-            return SPIFFS_ERR_INTERNAL;
+        if (!flashRead(alignedEnd, &tmp, 4)) {
+            return false;
         }
-
         memcpy(dst + size - nb, &tmp, nb);
     }
+    return true;
+}
 
-    return result;
+int32_t spiffs_hal_read(uint32_t addr, uint32_t size, uint8_t *dst) {
+    ++s_stats.reads;
+    s_stats.readBytes += size;
+    ++s_stats.readSizes[sizeBucket(size)];
+
+    // anything that fits in a line from the word it starts in
+    if (size <= SPIFFS_HAL_LINE_SIZE - 4) {
+        if (s_lineAddr == NO_LINE || addr < s_lineAddr || addr + size > s_lineAddr + SPIFFS_HAL_LINE_SIZE) {
+            uint32_t lineAddr = addr & ~(SPIFFS_HAL_LINE_SIZE - 1);
+            if (addr + size > lineAddr + SPIFFS_HAL_LINE_SIZE) {
+                lineAddr = addr & (~3);
+            }
+            // a line must not run past the sector, nor past the file system
+            if ((lineAddr ^ (lineAddr + SPIFFS_HAL_LINE_SIZE - 1)) & ~(FLASH_SECTOR_SIZE - 1)) {
+                return readDirect(addr, size, dst) ? SPIFFS_OK : SPIFFS_ERR_INTERNAL;
+            }
+            s_lineAddr = NO_LINE;
+            if (!flashRead(lineAddr, s_line, SPIFFS_HAL_LINE_SIZE)) {
+                return SPIFFS_ERR_INTERNAL;
+            }
+            s_lineAddr = lineAddr;
+        } else {
+            ++s_stats.lineHits;
+        }
+        memcpy(dst, ((uint8_t*) s_line) + addr - s_lineAddr, size);
+        return SPIFFS_OK;
+    }
+
+    if (((addr | size | (uintptr_t) dst) & 3) == 0) {
+        // the common case for page sized reads into the cache
+        return flashRead(addr, (uint32_t*) dst, size) ? SPIFFS_OK : SPIFFS_ERR_INTERNAL;
+    }
+    return readDirect(addr, size, dst) ? SPIFFS_OK : SPIFFS_ERR_INTERNAL;
 }
 
 /*
@@ -100,7 +219,10 @@ int32_t spiffs_hal_read(uint32_t addr, uint32_t size, uint8_t *dst) {
 static const int UNALIGNED_WRITE_BUFFER_SIZE = 512;
 
 int32_t spiffs_hal_write(uint32_t addr, uint32_t size, uint8_t *src) {
-    optimistic_yield(10000);
+    ++s_stats.writes;
+    s_stats.writeBytes += size;
+    ++s_stats.writeSizes[sizeBucket(size)];
+    invalidate(addr, size);
 
     uint32_t alignedBegin = (addr + 3) & (~3);
     uint32_t alignedEnd = (addr + size) & (~3);
@@ -113,38 +235,32 @@ int32_t spiffs_hal_write(uint32_t addr, uint32_t size, uint8_t *src) {
         uint32_t nb = (size < ofs) ? size : ofs;
         uint8_t tmp[4] __attribute__((aligned(4))) = {0xff, 0xff, 0xff, 0xff};
         memcpy(tmp + 4 - ofs, src, nb);
-        if (!ESP.flashWrite(alignedBegin - 4, (uint32_t*) tmp, 4)) {
-            DEBUGV("_spif_write(%d) addr=%x size=%x ab=%x ae=%x\r\n",
-                __LINE__, addr, size, alignedBegin, alignedEnd);
+        if (!flashWrite(alignedBegin - 4, (uint32_t*) tmp, 4)) {
             return SPIFFS_ERR_INTERNAL;
         }
     }
 
     if (alignedEnd != alignedBegin) {
         uint32_t* srcLeftover = (uint32_t*) (src + alignedBegin - addr);
-        uint32_t srcAlign = ((uint32_t) srcLeftover) & 3;
+        uint32_t srcAlign = ((uintptr_t) srcLeftover) & 3;
         if (!srcAlign) {
-            if (!ESP.flashWrite(alignedBegin, (uint32_t*) srcLeftover,
+            if (!flashWrite(alignedBegin, (uint32_t*) srcLeftover,
                     alignedEnd - alignedBegin)) {
-                DEBUGV("_spif_write(%d) addr=%x size=%x ab=%x ae=%x\r\n",
-                    __LINE__, addr, size, alignedBegin, alignedEnd);
                 return SPIFFS_ERR_INTERNAL;
             }
         }
         else {
-            uint8_t buf[UNALIGNED_WRITE_BUFFER_SIZE];
+            uint8_t buf[UNALIGNED_WRITE_BUFFER_SIZE] __attribute__((aligned(4)));
             for (uint32_t sizeLeft = alignedEnd - alignedBegin; sizeLeft; ) {
-                size_t willCopy = std::min(sizeLeft, sizeof(buf));
+                uint32_t willCopy = std::min(sizeLeft, (uint32_t) sizeof(buf));
                 memcpy(buf, srcLeftover, willCopy);
 
-                if (!ESP.flashWrite(alignedBegin, (uint32_t*) buf, willCopy)) {
-                    DEBUGV("_spif_write(%d) addr=%x size=%x ab=%x ae=%x\r\n",
-                        __LINE__, addr, size, alignedBegin, alignedEnd);
+                if (!flashWrite(alignedBegin, (uint32_t*) buf, willCopy)) {
                     return SPIFFS_ERR_INTERNAL;
                 }
 
                 sizeLeft -= willCopy;
-                srcLeftover += willCopy;
+                srcLeftover = (uint32_t*) (((uint8_t*) srcLeftover) + willCopy);
                 alignedBegin += willCopy;
             }
         }
@@ -155,9 +271,7 @@ int32_t spiffs_hal_write(uint32_t addr, uint32_t size, uint8_t *src) {
         uint32_t tmp = 0xffffffff;
         memcpy(&tmp, src + size - nb, nb);
 
-        if (!ESP.flashWrite(alignedEnd, &tmp, 4)) {
-            DEBUGV("_spif_write(%d) addr=%x size=%x ab=%x ae=%x\r\n",
-                __LINE__, addr, size, alignedBegin, alignedEnd);
+        if (!flashWrite(alignedEnd, &tmp, 4)) {
             return SPIFFS_ERR_INTERNAL;
         }
     }
@@ -166,19 +280,37 @@ int32_t spiffs_hal_write(uint32_t addr, uint32_t size, uint8_t *src) {
 }
 
 int32_t spiffs_hal_erase(uint32_t addr, uint32_t size) {
-    if ((size & (SPI_FLASH_SEC_SIZE - 1)) != 0 ||
-        (addr & (SPI_FLASH_SEC_SIZE - 1)) != 0) {
+    if ((size & (FLASH_SECTOR_SIZE - 1)) != 0 ||
+        (addr & (FLASH_SECTOR_SIZE - 1)) != 0) {
         DEBUGV("_spif_erase called with addr=%x, size=%d\r\n", addr, size);
         abort();
     }
-    const uint32_t sector = addr / SPI_FLASH_SEC_SIZE;
-    const uint32_t sectorCount = size / SPI_FLASH_SEC_SIZE;
+    invalidate(addr, size);
+    const uint32_t sector = addr / FLASH_SECTOR_SIZE;
+    const uint32_t sectorCount = size / FLASH_SECTOR_SIZE;
     for (uint32_t i = 0; i < sectorCount; ++i) {
-        optimistic_yield(10000);
-        if (!ESP.flashEraseSector(sector + i)) {
+        ++s_stats.erases;
+        if (!spiffs_flash_erase_sector(sector + i)) {
             DEBUGV("_spif_erase addr=%x size=%d i=%d\r\n", addr, size, i);
             return SPIFFS_ERR_INTERNAL;
         }
     }
     return SPIFFS_OK;
 }
+
+#ifdef ARDUINO
+bool spiffs_flash_read(uint32_t addr, uint32_t* dst, uint32_t size) {
+    optimistic_yield(10000);
+    return ESP.flashRead(addr, dst, size);
+}
+
+bool spiffs_flash_write(uint32_t addr, const uint32_t* src, uint32_t size) {
+    optimistic_yield(10000);
+    return ESP.flashWrite(addr, const_cast<uint32_t*>(src), size);
+}
+
+bool spiffs_flash_erase_sector(uint32_t sector) {
+    optimistic_yield(10000);
+    return ESP.flashEraseSector(sector);
+}
+#endif
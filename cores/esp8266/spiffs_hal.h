@@ -0,0 +1,66 @@
+/*
+ spiffs_hal.h - SPI read/write/erase functions for SPIFFS.
+ Copyright (c) 2015 Ivan Grokhotkov. All rights reserved.
+ This file is part of the esp8266 core for Arduino environment.
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef spiffs_hal_h
+#define spiffs_hal_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Small reads are served from an aligned line of this many bytes (a power
+// of two, at most a sector), which is fetched with a single flash read
+#ifndef SPIFFS_HAL_LINE_SIZE
+#define SPIFFS_HAL_LINE_SIZE 64
+#endif
+
+// Call sizes are counted in buckets of up to 4, 8, ... 256 bytes and more
+#define SPIFFS_HAL_SIZE_BUCKETS 8
+
+struct SPIFFSHalStats {
+    uint32_t reads;
+    uint32_t readBytes;
+    uint32_t lineHits;          // reads answered from the line buffer
+    uint32_t flashReads;        // flash reads made for them
+    uint32_t flashReadBytes;
+    uint32_t writes;
+    uint32_t writeBytes;
+    uint32_t flashWrites;
+    uint32_t erases;
+    uint32_t readSizes[SPIFFS_HAL_SIZE_BUCKETS];
+    uint32_t writeSizes[SPIFFS_HAL_SIZE_BUCKETS];
+};
+
+// Called by SPIFFS
+int32_t spiffs_hal_read(uint32_t addr, uint32_t size, uint8_t *dst);
+int32_t spiffs_hal_write(uint32_t addr, uint32_t size, uint8_t *src);
+int32_t spiffs_hal_erase(uint32_t addr, uint32_t size);
+
+// Forgets the line buffer, for when flash was changed behind SPIFFS' back
+void spiffs_hal_invalidate();
+
+void spiffs_hal_get_stats(SPIFFSHalStats* stats);
+void spiffs_hal_reset_stats();
+
+// Word aligned flash access the above is built on: flash address, size
+// and RAM address are all multiples of 4
+bool spiffs_flash_read(uint32_t addr, uint32_t* dst, uint32_t size);
+bool spiffs_flash_write(uint32_t addr, const uint32_t* src, uint32_t size);
+bool spiffs_flash_erase_sector(uint32_t sector);
+
+#endif//spiffs_hal_h
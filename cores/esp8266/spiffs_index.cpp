@@ -0,0 +1,346 @@
+/*
+ spiffs_index.cpp - in-RAM name index for SPIFFS
+ Copyright (c) 2015 Ivan Grokhotkov. All rights reserved.
+ This file is part of the esp8266 core for Arduino environment.
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "spiffs_index.h"
+#include "debug.h"
+
+extern "C" {
+#include "spiffs/spiffs_nucleus.h"
+}
+
+SPIFFSIndex::SPIFFSIndex()
+    : _enabled(true)
+    , _state(STALE)
+    , _entries(nullptr)
+    , _count(0)
+    , _capacity(0)
+{
+}
+
+SPIFFSIndex::~SPIFFSIndex()
+{
+    _release();
+}
+
+void SPIFFSIndex::setEnabled(bool enabled)
+{
+    _enabled = enabled;
+    clear();
+}
+
+void SPIFFSIndex::clear()
+{
+    _release();
+    _state = STALE;
+}
+
+void SPIFFSIndex::_release()
+{
+    free(_entries);
+    _entries = nullptr;
+    _count = 0;
+    _capacity = 0;
+}
+
+bool SPIFFSIndex::build(spiffs* fs)
+{
+    clear();
+    if (!_enabled || !SPIFFS_mounted(fs)) {
+        return false;
+    }
+    spiffs_DIR dir;
+    if (!SPIFFS_opendir(fs, "/", &dir)) {
+        return false;
+    }
+    spiffs_dirent dirent;
+    bool ok = true;
+    while (SPIFFS_readdir(&dir, &dirent)) {
+        if (!_insert(dirent.obj_id, dirent.pix, (const char*) dirent.name)) {
+            ok = false;
+            break;
+        }
+    }
+    SPIFFS_closedir(&dir);
+    if (!ok) {
+        DEBUGV("SPIFFSIndex: out of memory at %d files\r\n", _count);
+        _release();
+        _state = FAILED;
+        return false;
+    }
+    if (fs->err_code != SPIFFS_VIS_END) {
+        DEBUGV("SPIFFSIndex: sweep failed, err=%d\r\n", fs->err_code);
+        _release();
+        return false;
+    }
+    _state = READY;
+    return true;
+}
+
+bool SPIFFSIndex::ready(spiffs* fs)
+{
+    if (!_enabled || _state == FAILED) {
+        return false;
+    }
+    if (_state == STALE) {
+        return build(fs);
+    }
+    return true;
+}
+
+void SPIFFSIndex::update(spiffs_fileop_type op, spiffs_obj_id objId, spiffs_page_ix pix)
+{
+    if (_state != READY) {
+        // the next build picks it up
+        return;
+    }
+    size_t i = _lowerBound(objId);
+    bool found = (i < _count && _entries[i].objId == objId);
+    switch (op) {
+    case SPIFFS_CB_CREATED:
+    case SPIFFS_CB_UPDATED:
+        // the header may have been renamed as well as moved
+        if (found) {
+            _entries[i].pix = pix;
+            _entries[i].nameHash = 0;
+        } else if (!_insert(objId, pix, nullptr)) {
+            _release();
+            _state = FAILED;
+        }
+        break;
+    case SPIFFS_CB_DELETED:
+        if (found) {
+            _remove(i);
+        }
+        break;
+    }
+}
+
+uint32_t SPIFFSIndex::_hash(const char* name, size_t len)
+{
+    // FNV-1a, with 0 left to mark pending entries
+    uint32_t hash = 2166136261UL;
+    for (size_t i = 0; i < len; ++i) {
+        hash ^= (uint8_t) name[i];
+        hash *= 16777619UL;
+    }
+    return hash ? hash : 1;
+}
+
+uint32_t SPIFFSIndex::_bits(const char* name, size_t len)
+{
+    // two bits per prefix keep false hits rare with a few dozen directories
+    uint32_t hash = _hash(name, len);
+    return (1UL << (hash >> 27)) | (1UL << ((hash >> 22) & 31));
+}
+
+uint32_t SPIFFSIndex::_dirBits(const char* name)
+{
+    uint32_t bits = 0;
+    for (size_t i = 1; name[i]; ++i) {
+        if (name[i] == '/') {
+            bits |= _bits(name, i + 1);
+        }
+    }
+    return bits;
+}
+
+void SPIFFSIndex::_setName(Entry& entry, const char* name)
+{
+    entry.nameHash = _hash(name, strlen(name));
+    entry.dirBits = _dirBits(name);
+}
+
+size_t SPIFFSIndex::_lowerBound(spiffs_obj_id objId) const
+{
+    size_t lo = 0;
+    size_t hi = _count;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (_entries[mid].objId < objId) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+bool SPIFFSIndex::_insert(spiffs_obj_id objId, spiffs_page_ix pix, const char* name)
+{
+    size_t i = _lowerBound(objId);
+    if (i == _count || _entries[i].objId != objId) {
+        if (_count == _capacity) {
+            size_t capacity = _capacity ? _capacity * 2 : 16;
+            Entry* entries = (Entry*) realloc(_entries, capacity * sizeof(Entry));
+            if (!entries) {
+                return false;
+            }
+            _entries = entries;
+            _capacity = capacity;
+        }
+        memmove(_entries + i + 1, _entries + i, (_count - i) * sizeof(Entry));
+        ++_count;
+    }
+    Entry& entry = _entries[i];
+    entry.objId = objId;
+    entry.pix = pix;
+    entry.nameHash = 0;
+    entry.dirBits = 0;
+    if (name) {
+        _setName(entry, name);
+    }
+    return true;
+}
+
+void SPIFFSIndex::_remove(size_t i)
+{
+    --_count;
+    memmove(_entries + i, _entries + i + 1, (_count - i) * sizeof(Entry));
+}
+
+bool SPIFFSIndex::_load(spiffs* fs, size_t i, spiffs_stat* stat)
+{
+    Entry& entry = _entries[i];
+    spiffs_page_object_ix_header hdr;
+    s32_t res = _spiffs_rd(fs, SPIFFS_OP_T_OBJ_IX | SPIFFS_OP_C_READ, 0,
+                           SPIFFS_PAGE_TO_PADDR(fs, entry.pix), sizeof(hdr), (u8_t*) &hdr);
+    const uint8_t mask = SPIFFS_PH_FLAG_DELET | SPIFFS_PH_FLAG_FINAL | SPIFFS_PH_FLAG_IXDELE;
+    if (res != SPIFFS_OK ||
+        hdr.p_hdr.obj_id != (entry.objId | SPIFFS_OBJ_ID_IX_FLAG) ||
+        hdr.p_hdr.span_ix != 0 ||
+        (hdr.p_hdr.flags & mask) != (SPIFFS_PH_FLAG_DELET | SPIFFS_PH_FLAG_IXDELE)) {
+        DEBUGV("SPIFFSIndex: stale entry id=%d pix=%d rc=%d\r\n", entry.objId, entry.pix, res);
+        _state = STALE;
+        return false;
+    }
+    memcpy(stat->name, hdr.name, SPIFFS_OBJ_NAME_LEN);
+    stat->name[SPIFFS_OBJ_NAME_LEN - 1] = 0;
+    stat->obj_id = entry.objId;
+    stat->size = (hdr.size == SPIFFS_UNDEFINED_LEN) ? 0 : hdr.size;
+    stat->type = hdr.type;
+    stat->pix = entry.pix;
+    if (!entry.nameHash) {
+        _setName(entry, (const char*) stat->name);
+    }
+    return true;
+}
+
+// A stale entry makes a query start over on a fresh index, once
+#define SPIFFS_INDEX_ATTEMPTS 2
+
+bool SPIFFSIndex::find(spiffs* fs, const char* name, spiffs_stat* stat)
+{
+    uint32_t hash = _hash(name, strlen(name));
+    spiffs_stat found;
+    for (int attempt = 0; attempt < SPIFFS_INDEX_ATTEMPTS && ready(fs); ++attempt) {
+        size_t i = 0;
+        for (; i < _count; ++i) {
+            if (_entries[i].nameHash && _entries[i].nameHash != hash) {
+                continue;
+            }
+            if (!_load(fs, i, &found)) {
+                break;
+            }
+            if (_entries[i].nameHash == hash && strcmp((const char*) found.name, name) == 0) {
+                if (stat) {
+                    *stat = found;
+                }
+                return true;
+            }
+        }
+        if (i == _count) {
+            return false;
+        }
+    }
+    return false;
+}
+
+bool SPIFFSIndex::isDir(spiffs* fs, const char* path)
+{
+    char prefix[SPIFFS_OBJ_NAME_LEN];
+    size_t len = strlen(path);
+    if (len + 2 > sizeof(prefix)) {
+        return false;
+    }
+    memcpy(prefix, path, len);
+    if (!len || prefix[len - 1] != '/') {
+        prefix[len++] = '/';
+    }
+    prefix[len] = 0;
+    if (len == 1) {
+        // the root always exists
+        return true;
+    }
+    uint32_t bits = _bits(prefix, len);
+    spiffs_stat found;
+    for (int attempt = 0; attempt < SPIFFS_INDEX_ATTEMPTS && ready(fs); ++attempt) {
+        size_t i = 0;
+        for (; i < _count; ++i) {
+            if (_entries[i].nameHash && (_entries[i].dirBits & bits) != bits) {
+                continue;
+            }
+            if (!_load(fs, i, &found)) {
+                break;
+            }
+            if (strncmp((const char*) found.name, prefix, len) == 0) {
+                return true;
+            }
+        }
+        if (i == _count) {
+            return false;
+        }
+    }
+    return false;
+}
+
+bool SPIFFSIndex::next(spiffs* fs, spiffs_obj_id& cursor, const char* prefix, spiffs_dirent* dirent)
+{
+    // only names within the directory part of the prefix can match
+    size_t len = strlen(prefix);
+    const char* slash = strrchr(prefix, '/');
+    uint32_t bits = (slash && slash != prefix) ? _bits(prefix, slash + 1 - prefix) : 0;
+    spiffs_stat found;
+    for (int attempt = 0; attempt < SPIFFS_INDEX_ATTEMPTS && ready(fs); ++attempt) {
+        // ids never have the top bit set, cursor + 1 can't wrap
+        size_t i = _lowerBound(cursor + 1);
+        for (; i < _count; ++i) {
+            if (bits && _entries[i].nameHash && (_entries[i].dirBits & bits) != bits) {
+                continue;
+            }
+            if (!_load(fs, i, &found)) {
+                break;
+            }
+            if (strncmp((const char*) found.name, prefix, len) == 0) {
+                cursor = found.obj_id;
+                dirent->obj_id = found.obj_id;
+                memcpy(dirent->name, found.name, SPIFFS_OBJ_NAME_LEN);
+                dirent->type = found.type;
+                dirent->size = found.size;
+                dirent->pix = found.pix;
+                return true;
+            }
+        }
+        if (i == _count) {
+            return false;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,114 @@
+/*
+ spiffs_index.h - in-RAM name index for SPIFFS
+ Copyright (c) 2015 Ivan Grokhotkov. All rights reserved.
+ This file is part of the esp8266 core for Arduino environment.
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef spiffs_index_h
+#define spiffs_index_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include "spiffs/spiffs.h"
+
+// Keeps the object id and index header page of every file, along with a
+// hash of its name and a small Bloom filter of its directory prefixes, so that
+// name lookups read a single header page instead of scanning the lookup
+// pages of every block.
+//
+// SPIFFS has no directories: a "directory prefix" is any leading part of a
+// name up to (and including) a '/', except for a leading "/" on its own.
+//
+// The index is built with one sweep after mount and kept up to date through
+// the SPIFFS file callback, which reports every move of an index header.
+// Entries touched by a callback are re-read lazily by the next query. Hash
+// matches are always confirmed against the name stored on flash. If the
+// index runs out of memory it disables itself and callers fall back to the
+// plain SPIFFS calls; if it finds a stale entry it rebuilds on next use.
+class SPIFFSIndex
+{
+public:
+    SPIFFSIndex();
+    ~SPIFFSIndex();
+
+    // Enabled by default; a disabled index stays empty
+    void setEnabled(bool enabled);
+    bool enabled() const
+    {
+        return _enabled;
+    }
+
+    // Sweeps a mounted fs; on OOM the index stays off until clear()
+    bool build(spiffs* fs);
+    // Forgets everything, e.g. when the fs is unmounted
+    void clear();
+    // Whether queries can be answered, rebuilding first if needed
+    bool ready(spiffs* fs);
+
+    // To be called from the spiffs_file_callback of the indexed fs
+    void update(spiffs_fileop_type op, spiffs_obj_id objId, spiffs_page_ix pix);
+
+    // Looks up a file by name, stat may be nullptr
+    bool find(spiffs* fs, const char* name, spiffs_stat* stat);
+    // Whether any file name starts with the prefix path + "/"
+    bool isDir(spiffs* fs, const char* path);
+    // Next file after cursor (an object id, 0 to start) whose name starts
+    // with prefix; ids are stable so files may be removed while iterating
+    bool next(spiffs* fs, spiffs_obj_id& cursor, const char* prefix, spiffs_dirent* dirent);
+
+    size_t size() const
+    {
+        return _count;
+    }
+
+protected:
+    enum State {
+        STALE,
+        READY,
+        FAILED,
+    };
+
+    struct Entry {
+        spiffs_obj_id objId;
+        spiffs_page_ix pix;
+        uint32_t nameHash;  // 0 while the header has to be re-read
+        uint32_t dirBits;
+    };
+
+    static uint32_t _hash(const char* name, size_t len);
+    static uint32_t _bits(const char* name, size_t len);
+    static uint32_t _dirBits(const char* name);
+    static void _setName(Entry& entry, const char* name);
+
+    size_t _lowerBound(spiffs_obj_id objId) const;
+    bool _insert(spiffs_obj_id objId, spiffs_page_ix pix, const char* name);
+    void _remove(size_t i);
+    // Reads and checks the header of entry i, refreshing a pending entry
+    bool _load(spiffs* fs, size_t i, spiffs_stat* stat);
+    void _release();
+
+    bool _enabled;
+    State _state;
+    Entry* _entries;
+    size_t _count;
+    size_t _capacity;
+
+private:
+    SPIFFSIndex(const SPIFFSIndex&);
+    SPIFFSIndex& operator=(const SPIFFSIndex&);
+};
+
+#endif//spiffs_index_h
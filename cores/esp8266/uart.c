@@ -212,6 +212,44 @@ uart_read_char(uart_t* uart)
     return data;
 }
 
+size_t
+uart_peek_available(uart_t* uart)
+{
+    if(uart == NULL || !uart->rx_enabled)
+        return 0;
+
+    ETS_UART_INTR_DISABLE();
+    uart_rx_copy_fifo_to_buffer_unsafe(uart);
+    size_t rpos = uart->rx_buffer->rpos;
+    size_t wpos = uart->rx_buffer->wpos;
+    ETS_UART_INTR_ENABLE();
+
+    // only up to the end of the ring, the rest comes with the next call
+    if(wpos < rpos)
+        return uart->rx_buffer->size - rpos;
+    return wpos - rpos;
+}
+
+const char*
+uart_peek_buffer(uart_t* uart)
+{
+    if(uart == NULL || !uart->rx_enabled)
+        return NULL;
+
+    return (const char*) &uart->rx_buffer->buffer[uart->rx_buffer->rpos];
+}
+
+void
+uart_peek_consume(uart_t* uart, size_t consume)
+{
+    if(uart == NULL || !uart->rx_enabled)
+        return;
+
+    ETS_UART_INTR_DISABLE();
+    uart->rx_buffer->rpos = (uart->rx_buffer->rpos + consume) % uart->rx_buffer->size;
+    ETS_UART_INTR_ENABLE();
+}
+
 size_t 
 uart_resize_rx_buffer(uart_t* uart, size_t new_size)
 {
@@ -131,6 +131,11 @@ size_t uart_write_char(uart_t* uart, char c);
 size_t uart_write(uart_t* uart, const char* buf, size_t size);
 int uart_read_char(uart_t* uart);
 int uart_peek_char(uart_t* uart);
+// contiguous received bytes at the read position, without copying them;
+// an overrun that discards the oldest data can overwrite them
+size_t uart_peek_available(uart_t* uart);
+const char* uart_peek_buffer(uart_t* uart);
+void uart_peek_consume(uart_t* uart, size_t consume);
 size_t uart_rx_available(uart_t* uart);
 size_t uart_tx_free(uart_t* uart);
 void uart_wait_tx_empty(uart_t* uart);
@@ -620,6 +620,20 @@ UMM_H_ATTPACKPRE typedef struct umm_block_t {
 #define UMM_FREELIST_MASK (0x8000)
 #define UMM_BLOCKNO_MASK  (0x7FFF)
 
+#if defined(UMM_SIZE_CLASSES) && !defined(UMM_POISON)
+static void umm_size_class_reset( void );
+#  define UMM_SIZE_CLASS_RESET() umm_size_class_reset()
+#else
+#  define UMM_SIZE_CLASS_RESET()
+#endif
+
+#if defined(UMM_SITE_STATS) && !defined(UMM_POISON)
+static void umm_site_reset( void );
+#  define UMM_SITE_RESET() umm_site_reset()
+#else
+#  define UMM_SITE_RESET()
+#endif
+
 /* ------------------------------------------------------------------------- */
 
 #ifdef UMM_REDEFINE_MEM_FUNCTIONS
@@ -978,6 +992,16 @@ static void *get_unpoisoned( unsigned char *ptr ) {
 
 UMM_HEAP_INFO ummHeapInfo;
 
+static void umm_info_free_run( size_t blocks ) {
+  int bucket = 0;
+
+  while( (blocks >> (bucket + 1)) && bucket < UMM_FREE_RUN_BUCKETS - 1 ) {
+    ++bucket;
+  }
+  ++ummHeapInfo.freeRuns[bucket];
+  ummHeapInfo.freeBlocksSquared += (unsigned long)blocks * blocks;
+}
+
 void ICACHE_FLASH_ATTR *umm_info( void *ptr, int force ) {
 
   unsigned short int blockNo = 0;
@@ -1025,6 +1049,7 @@ void ICACHE_FLASH_ATTR *umm_info( void *ptr, int force ) {
     if( UMM_NBLOCK(blockNo) & UMM_FREELIST_MASK ) {
       ++ummHeapInfo.freeEntries;
       ummHeapInfo.freeBlocks += curBlocks;
+      umm_info_free_run( curBlocks );
 
       if (ummHeapInfo.maxFreeContiguousBlocks < curBlocks) {
         ummHeapInfo.maxFreeContiguousBlocks = curBlocks;
@@ -1097,6 +1122,15 @@ void ICACHE_FLASH_ATTR *umm_info( void *ptr, int force ) {
       ummHeapInfo.usedBlocks,
       ummHeapInfo.freeBlocks  );
 
+  DBG_LOG_FORCE( force, "Free runs of 1, 2, 4 .. %d+ blocks:", 1 << (UMM_FREE_RUN_BUCKETS - 1) );
+  {
+    int i;
+    for( i = 0; i < UMM_FREE_RUN_BUCKETS; ++i ) {
+      DBG_LOG_FORCE( force, " %d", ummHeapInfo.freeRuns[i] );
+    }
+  }
+  DBG_LOG_FORCE( force, "\n" );
+
   /* Release the critical section... */
   UMM_CRITICAL_EXIT();
 
@@ -1205,6 +1239,8 @@ void umm_init( void ) {
   umm_heap = (umm_block *)UMM_MALLOC_CFG__HEAP_ADDR;
   umm_numblocks = (UMM_MALLOC_CFG__HEAP_SIZE / sizeof(umm_block));
   memset(umm_heap, 0x00, UMM_MALLOC_CFG__HEAP_SIZE);
+  UMM_SIZE_CLASS_RESET();
+  UMM_SITE_RESET();
 
   /* setup initial blank heap structure */
   {
@@ -1689,9 +1725,438 @@ static size_t _umm_size( void *ptr ) {
   return( curSize );
 }
 
+/* size classes (UMM_SIZE_CLASSES) {{{ */
+#if defined(UMM_SIZE_CLASSES) && !defined(UMM_POISON)
+/*
+ * Small allocations are served from a slab arena: UMM_SLAB_PAGES pages of
+ * UMM_SLAB_PAGE_SIZE bytes, taken from the heap in one piece on first use.
+ * Each page in use holds slots of one size class, and keeps its free slots
+ * on a list. Pages with free slots are linked per class, and empty pages go
+ * back to a pool shared by all classes. Allocating and freeing a slot are
+ * both a few list operations with interrupts off, where _umm_malloc()
+ * walks the whole free list to find the best fit.
+ *
+ * Keeping small objects out of the heap also keeps them from splitting up
+ * the free space that large buffers need. When the arena is full, or could
+ * not be allocated, small allocations go to the heap as before.
+ *
+ * Poisoning checks every heap block, so it turns the arena off.
+ */
+
+#ifndef UMM_SLAB_PAGE_SIZE
+#  define UMM_SLAB_PAGE_SIZE 256
+#endif
+
+#ifndef UMM_SLAB_PAGES
+#  define UMM_SLAB_PAGES 16
+#endif
+
+#define UMM_SLAB_NONE 0xFF
+
+static const unsigned short int umm_slab_sizes[] = { 8, 16, 24, 32, 48, 64 };
+
+#define UMM_SLAB_CLASSES (sizeof(umm_slab_sizes) / sizeof(umm_slab_sizes[0]))
+#define UMM_SLAB_MAX_SIZE 64
+
+typedef struct umm_slab_page_t {
+  unsigned char cls;       /* size class, UMM_SLAB_NONE when in the pool */
+  unsigned char used;      /* slots handed out */
+  unsigned char free;      /* first free slot, UMM_SLAB_NONE if full */
+  unsigned char next;      /* next page of the class or the pool */
+  unsigned char prev;
+} umm_slab_page;
+
+static unsigned char *umm_slab_arena = NULL;
+static int umm_slab_failed = 0;
+static umm_slab_page umm_slab_page_info[UMM_SLAB_PAGES];
+static unsigned char umm_slab_partial[UMM_SLAB_CLASSES];
+static unsigned char umm_slab_pool;
+static size_t umm_slab_free_bytes;
+
+static void umm_size_class_reset( void ) {
+  umm_slab_arena = NULL;
+  umm_slab_failed = 0;
+  umm_slab_free_bytes = 0;
+}
+
+static void umm_slab_init( void ) {
+  unsigned char i;
+
+  umm_slab_arena = (unsigned char *)_umm_malloc( UMM_SLAB_PAGES * UMM_SLAB_PAGE_SIZE );
+  if( NULL == umm_slab_arena ) {
+    umm_slab_failed = 1;
+    return;
+  }
+  for( i = 0; i < UMM_SLAB_PAGES; ++i ) {
+    umm_slab_page_info[i].cls  = UMM_SLAB_NONE;
+    umm_slab_page_info[i].next = (i + 1 < UMM_SLAB_PAGES) ? i + 1 : UMM_SLAB_NONE;
+  }
+  for( i = 0; i < UMM_SLAB_CLASSES; ++i ) {
+    umm_slab_partial[i] = UMM_SLAB_NONE;
+  }
+  umm_slab_pool = 0;
+  umm_slab_free_bytes = UMM_SLAB_PAGES * UMM_SLAB_PAGE_SIZE;
+}
+
+static unsigned char *umm_slab_slot( unsigned char page, unsigned char slot, unsigned char cls ) {
+  return( umm_slab_arena + page * UMM_SLAB_PAGE_SIZE + slot * umm_slab_sizes[cls] );
+}
+
+static void umm_slab_unlink( unsigned char page ) {
+  umm_slab_page *info = &umm_slab_page_info[page];
+
+  if( UMM_SLAB_NONE == info->prev ) {
+    umm_slab_partial[info->cls] = info->next;
+  } else {
+    umm_slab_page_info[info->prev].next = info->next;
+  }
+  if( UMM_SLAB_NONE != info->next ) {
+    umm_slab_page_info[info->next].prev = info->prev;
+  }
+}
+
+static void umm_slab_link( unsigned char page ) {
+  umm_slab_page *info = &umm_slab_page_info[page];
+
+  info->prev = UMM_SLAB_NONE;
+  info->next = umm_slab_partial[info->cls];
+  if( UMM_SLAB_NONE != info->next ) {
+    umm_slab_page_info[info->next].prev = page;
+  }
+  umm_slab_partial[info->cls] = page;
+}
+
+static void *_umm_slab_malloc( size_t size ) {
+  unsigned char cls = 0;
+  unsigned char page;
+  unsigned char slot;
+  umm_slab_page *info;
+  unsigned char *ret = NULL;
+
+  if( 0 == size || size > UMM_SLAB_MAX_SIZE ) {
+    return( (void *)NULL );
+  }
+  while( umm_slab_sizes[cls] < size ) {
+    ++cls;
+  }
+
+  UMM_CRITICAL_ENTRY();
+
+  if( NULL == umm_slab_arena && !umm_slab_failed ) {
+    umm_slab_init();
+  }
+
+  page = umm_slab_arena ? umm_slab_partial[cls] : UMM_SLAB_NONE;
+  if( UMM_SLAB_NONE == page && umm_slab_arena && UMM_SLAB_NONE != umm_slab_pool ) {
+    /* Thread the slots of a page from the pool into a free list */
+    unsigned char count = UMM_SLAB_PAGE_SIZE / umm_slab_sizes[cls];
+
+    page = umm_slab_pool;
+    info = &umm_slab_page_info[page];
+    umm_slab_pool = info->next;
+    info->cls  = cls;
+    info->used = 0;
+    info->free = 0;
+    for( slot = 0; slot < count; ++slot ) {
+      *umm_slab_slot( page, slot, cls ) = (slot + 1 < count) ? slot + 1 : UMM_SLAB_NONE;
+    }
+    /* the slack at the end of the page is not available */
+    umm_slab_free_bytes -= UMM_SLAB_PAGE_SIZE - count * umm_slab_sizes[cls];
+    umm_slab_link( page );
+  }
+
+  if( UMM_SLAB_NONE != page ) {
+    info = &umm_slab_page_info[page];
+    slot = info->free;
+    ret = umm_slab_slot( page, slot, cls );
+    info->free = *ret;
+    ++info->used;
+    umm_slab_free_bytes -= umm_slab_sizes[cls];
+    if( UMM_SLAB_NONE == info->free ) {
+      umm_slab_unlink( page );
+    }
+  }
+
+  UMM_CRITICAL_EXIT();
+
+  return( (void *)ret );
+}
+
+static int umm_slab_owns( void *ptr ) {
+  return( umm_slab_arena &&
+      (unsigned char *)ptr >= umm_slab_arena &&
+      (unsigned char *)ptr < umm_slab_arena + UMM_SLAB_PAGES * UMM_SLAB_PAGE_SIZE );
+}
+
+static size_t _umm_slab_size( void *ptr ) {
+  unsigned char page = ((unsigned char *)ptr - umm_slab_arena) / UMM_SLAB_PAGE_SIZE;
+
+  return( umm_slab_sizes[umm_slab_page_info[page].cls] );
+}
+
+static void _umm_slab_free( void *ptr ) {
+  unsigned char page = ((unsigned char *)ptr - umm_slab_arena) / UMM_SLAB_PAGE_SIZE;
+  umm_slab_page *info = &umm_slab_page_info[page];
+  unsigned char cls;
+  unsigned char slot;
+
+  UMM_CRITICAL_ENTRY();
+
+  cls  = info->cls;
+  slot = ((unsigned char *)ptr - umm_slab_slot( page, 0, cls )) / umm_slab_sizes[cls];
+  *(unsigned char *)ptr = info->free;
+  if( UMM_SLAB_NONE == info->free ) {
+    /* it was full, so it wasn't on the list of its class */
+    umm_slab_link( page );
+  }
+  info->free = slot;
+  --info->used;
+  umm_slab_free_bytes += umm_slab_sizes[cls];
+
+  if( 0 == info->used ) {
+    /* give the page back to the pool for any class */
+    umm_slab_unlink( page );
+    umm_slab_free_bytes += UMM_SLAB_PAGE_SIZE - (UMM_SLAB_PAGE_SIZE / umm_slab_sizes[cls]) * umm_slab_sizes[cls];
+    info->cls  = UMM_SLAB_NONE;
+    info->next = umm_slab_pool;
+    umm_slab_pool = page;
+  }
+
+  UMM_CRITICAL_EXIT();
+}
+
+size_t umm_size_class_free( void ) {
+  return( umm_slab_free_bytes );
+}
+
+static void *_umm_alloc( size_t size ) {
+  void *ret = _umm_slab_malloc( size );
+
+  if( NULL == ret ) {
+    ret = _umm_malloc( size );
+  }
+  return( ret );
+}
+
+static void *_umm_resize( void *ptr, size_t size ) {
+  void *ret;
+  size_t curSize;
+
+  if( NULL == ptr || !umm_slab_owns( ptr ) ) {
+    return( _umm_realloc( ptr, size ) );
+  }
+  if( 0 == size ) {
+    _umm_slab_free( ptr );
+    return( (void *)NULL );
+  }
+  curSize = _umm_slab_size( ptr );
+  if( size <= curSize && size > curSize / 2 ) {
+    return( ptr );
+  }
+  ret = _umm_alloc( size );
+  if( ret ) {
+    memcpy( ret, ptr, size < curSize ? size : curSize );
+    _umm_slab_free( ptr );
+  }
+  return( ret );
+}
+
+static void _umm_release( void *ptr ) {
+  if( umm_slab_owns( ptr ) ) {
+    _umm_slab_free( ptr );
+  } else {
+    _umm_free( ptr );
+  }
+}
+
+static size_t _umm_measure( void *ptr ) {
+  if( umm_slab_owns( ptr ) ) {
+    return( _umm_slab_size( ptr ) );
+  }
+  return( _umm_size( ptr ) );
+}
+
+#else
+
+size_t umm_size_class_free( void ) {
+  return( 0 );
+}
+
+#define _umm_alloc(size)       _umm_malloc(size)
+#define _umm_resize(ptr, size) _umm_realloc(ptr, size)
+#define _umm_release(ptr)      _umm_free(ptr)
+#define _umm_measure(ptr)      _umm_size(ptr)
+
+#endif
+/* }}} */
+
+/* allocation sites (UMM_SITE_STATS) {{{ */
+#if defined(UMM_SITE_STATS) && !defined(UMM_POISON)
+/*
+ * Every block starts with a word holding the index of the entry of the
+ * site that allocated it, so freeing it can update that entry. The table
+ * is searched linearly with interrupts off, which is fine for a debugging
+ * option. Sites that don't fit in the table are added up in entry 0.
+ */
+
+#ifndef UMM_SITE_STATS_SIZE
+#  define UMM_SITE_STATS_SIZE 32
+#endif
+
+#define UMM_SITE_HEADER sizeof(uint32_t)
+
+static UMM_SITE_INFO umm_sites[UMM_SITE_STATS_SIZE];
+static unsigned short int umm_sites_used;
+
+static void umm_site_reset( void ) {
+  memset( umm_sites, 0, sizeof(umm_sites) );
+  umm_sites_used = 1;
+}
+
+static void *umm_site_attach( void *ptr, const void *site ) {
+  unsigned short int i;
+  size_t bytes;
+
+  if( NULL == ptr ) {
+    return( (void *)NULL );
+  }
+
+  UMM_CRITICAL_ENTRY();
+
+  for( i = 1; i < umm_sites_used && umm_sites[i].site != site; ++i ) {
+  }
+  if( i == umm_sites_used ) {
+    if( umm_sites_used < UMM_SITE_STATS_SIZE ) {
+      umm_sites[umm_sites_used++].site = site;
+    } else {
+      i = 0;
+    }
+  }
+  bytes = _umm_measure( ptr ) - UMM_SITE_HEADER;
+  umm_sites[i].liveBytes += bytes;
+  ++umm_sites[i].liveCount;
+  ++umm_sites[i].allocCount;
+  *(uint32_t *)ptr = i;
+
+  UMM_CRITICAL_EXIT();
+
+  return( (char *)ptr + UMM_SITE_HEADER );
+}
+
+static void *umm_site_detach( void *ptr ) {
+  uint32_t i;
+
+  if( NULL == ptr ) {
+    return( (void *)NULL );
+  }
+  ptr = (char *)ptr - UMM_SITE_HEADER;
+
+  UMM_CRITICAL_ENTRY();
+
+  i = *(uint32_t *)ptr;
+  umm_sites[i].liveBytes -= _umm_measure( ptr ) - UMM_SITE_HEADER;
+  --umm_sites[i].liveCount;
+
+  UMM_CRITICAL_EXIT();
+
+  return( ptr );
+}
+
+static void *_umm_site_alloc( size_t size, const void *site ) {
+  if( 0 == size ) {
+    return( (void *)NULL );
+  }
+  return( umm_site_attach( _umm_alloc( size + UMM_SITE_HEADER ), site ) );
+}
+
+static void *_umm_site_resize( void *ptr, size_t size, const void *site ) {
+  void *raw;
+
+  if( NULL == ptr ) {
+    return( _umm_site_alloc( size, site ) );
+  }
+  raw = umm_site_detach( ptr );
+  if( 0 == size ) {
+    _umm_release( raw );
+    return( (void *)NULL );
+  }
+  ptr = _umm_resize( raw, size + UMM_SITE_HEADER );
+  if( NULL == ptr ) {
+    /* the block is still there, put it back on the books */
+    uint32_t i = *(uint32_t *)raw;
+
+    UMM_CRITICAL_ENTRY();
+    umm_sites[i].liveBytes += _umm_measure( raw ) - UMM_SITE_HEADER;
+    ++umm_sites[i].liveCount;
+    UMM_CRITICAL_EXIT();
+
+    return( (void *)NULL );
+  }
+  return( umm_site_attach( ptr, site ) );
+}
+
+static void _umm_site_release( void *ptr ) {
+  _umm_release( umm_site_detach( ptr ) );
+}
+
+static size_t _umm_site_measure( void *ptr ) {
+  if( NULL == ptr ) {
+    return( 0 );
+  }
+  return( _umm_measure( (char *)ptr - UMM_SITE_HEADER ) - UMM_SITE_HEADER );
+}
+
+size_t ICACHE_FLASH_ATTR umm_site_info( UMM_SITE_INFO *sites, size_t count ) {
+  size_t found = 0;
+  size_t i;
+  size_t j;
+
+  if( umm_heap == NULL ) {
+    umm_init();
+  }
+
+  /* sorted by live bytes, largest first */
+  UMM_CRITICAL_ENTRY();
+  for( i = 0; i < umm_sites_used; ++i ) {
+    if( 0 == umm_sites[i].allocCount ) {
+      continue;
+    }
+    for( j = found; j > 0 && sites[j - 1].liveBytes < umm_sites[i].liveBytes; --j ) {
+      if( j < count ) {
+        sites[j] = sites[j - 1];
+      }
+    }
+    if( j < count ) {
+      sites[j] = umm_sites[i];
+      if( found < count ) {
+        ++found;
+      }
+    }
+  }
+  UMM_CRITICAL_EXIT();
+
+  return( found );
+}
+
+#else
+
+size_t umm_site_info( UMM_SITE_INFO *sites, size_t count ) {
+  (void)sites;
+  (void)count;
+  return( 0 );
+}
+
+#define _umm_site_alloc(size, site)       _umm_alloc(size)
+#define _umm_site_resize(ptr, size, site) _umm_resize(ptr, size)
+#define _umm_site_release(ptr)            _umm_release(ptr)
+#define _umm_site_measure(ptr)            _umm_measure(ptr)
+
+#endif
+/* }}} */
+
 /* ------------------------------------------------------------------------ */
 
-void *umm_malloc( size_t size ) {
+void *umm_malloc_at( size_t size, const void *site ) {
   void *ret;
 
   /* check poison of each blocks, if poisoning is enabled */
@@ -1706,9 +2171,9 @@ void *umm_malloc( size_t size ) {
 
   size += POISON_SIZE(size);
 
-  ret = _umm_malloc( size );
+  ret = _umm_site_alloc( size, site );
   if (0 != size && 0 == ret) {
-    umm_last_fail_alloc_addr = __builtin_return_address(0);
+    umm_last_fail_alloc_addr = (void *)site;
     umm_last_fail_alloc_size = size;
   }
 
@@ -1717,9 +2182,13 @@ void *umm_malloc( size_t size ) {
   return ret;
 }
 
+void *umm_malloc( size_t size ) {
+  return umm_malloc_at( size, __builtin_return_address(0) );
+}
+
 /* ------------------------------------------------------------------------ */
 
-void *umm_calloc( size_t num, size_t item_size ) {
+void *umm_calloc_at( size_t num, size_t item_size, const void *site ) {
   void *ret;
   size_t size = item_size * num;
 
@@ -1734,12 +2203,12 @@ void *umm_calloc( size_t num, size_t item_size ) {
   }
 
   size += POISON_SIZE(size);
-  ret = _umm_malloc(size);
+  ret = _umm_site_alloc( size, site );
   if (ret) {
     memset(ret, 0x00, size);
   }
   if (0 != size && 0 == ret) {
-    umm_last_fail_alloc_addr = __builtin_return_address(0);
+    umm_last_fail_alloc_addr = (void *)site;
     umm_last_fail_alloc_size = size;
   }
 
@@ -1748,9 +2217,13 @@ void *umm_calloc( size_t num, size_t item_size ) {
   return ret;
 }
 
+void *umm_calloc( size_t num, size_t item_size ) {
+  return umm_calloc_at( num, item_size, __builtin_return_address(0) );
+}
+
 /* ------------------------------------------------------------------------ */
 
-void *umm_realloc( void *ptr, size_t size ) {
+void *umm_realloc_at( void *ptr, size_t size, const void *site ) {
   void *ret;
 
   ptr = GET_UNPOISONED(ptr);
@@ -1766,9 +2239,9 @@ void *umm_realloc( void *ptr, size_t size ) {
   }
 
   size += POISON_SIZE(size);
-  ret = _umm_realloc( ptr, size );
+  ret = _umm_site_resize( ptr, size, site );
   if (0 != size && 0 == ret) {
-    umm_last_fail_alloc_addr = __builtin_return_address(0);
+    umm_last_fail_alloc_addr = (void *)site;
     umm_last_fail_alloc_size = size;
   }
 
@@ -1777,6 +2250,10 @@ void *umm_realloc( void *ptr, size_t size ) {
   return ret;
 }
 
+void *umm_realloc( void *ptr, size_t size ) {
+  return umm_realloc_at( ptr, size, __builtin_return_address(0) );
+}
+
 /* ------------------------------------------------------------------------ */
 
 size_t umm_size( void *ptr ) {
@@ -1794,7 +2271,7 @@ size_t umm_size( void *ptr ) {
     return 0;
   }
 
-  ret = _umm_size( ptr );
+  ret = _umm_site_measure( ptr );
 
   return ret;
 }
@@ -1815,14 +2292,60 @@ void umm_free( void *ptr ) {
     return;
   }
 
-  _umm_free( ptr );
+  _umm_site_release( ptr );
 }
 
 /* ------------------------------------------------------------------------ */
 
 size_t ICACHE_FLASH_ATTR umm_free_heap_size( void ) {
   umm_info(NULL, 0);
-  return (size_t)ummHeapInfo.freeBlocks * sizeof(umm_block);
+  return (size_t)ummHeapInfo.freeBlocks * sizeof(umm_block) + umm_size_class_free();
+}
+
+/* ------------------------------------------------------------------------ */
+
+size_t ICACHE_FLASH_ATTR umm_max_block_size( void ) {
+  umm_info(NULL, 0);
+  if( 0 == ummHeapInfo.maxFreeContiguousBlocks ) {
+    return( 0 );
+  }
+  /* the first block of a run keeps its header */
+  return( (size_t)ummHeapInfo.maxFreeContiguousBlocks * sizeof(umm_block) -
+      (sizeof(umm_block) - sizeof(((umm_block *)0)->body)) );
+}
+
+/* ------------------------------------------------------------------------ */
+
+static unsigned long umm_isqrt( unsigned long n ) {
+  unsigned long root = 0;
+  unsigned long bit = 1UL << (sizeof(n) * 8 - 2);
+
+  while( bit > n ) {
+    bit >>= 2;
+  }
+  while( bit ) {
+    if( n >= root + bit ) {
+      n -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return( root );
+}
+
+int ICACHE_FLASH_ATTR umm_fragmentation_metric( void ) {
+  umm_info(NULL, 0);
+  if( 0 == ummHeapInfo.freeBlocks ) {
+    return( 0 );
+  }
+  /*
+   * 0 when all free space is one run, approaching 100 as it gets split into
+   * many small runs: the root of the sum of squared run lengths is the
+   * length of a single run of equal "weight".
+   */
+  return( 100 - (int)((umm_isqrt( ummHeapInfo.freeBlocksSquared ) * 100 + ummHeapInfo.freeBlocks / 2) / ummHeapInfo.freeBlocks) );
 }
 
 /* ------------------------------------------------------------------------ */
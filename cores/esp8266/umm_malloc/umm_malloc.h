@@ -16,6 +16,8 @@
 extern "C" {
 #endif
 
+#define UMM_FREE_RUN_BUCKETS 10
+
 typedef struct UMM_HEAP_INFO_t {
   unsigned short int totalEntries;
   unsigned short int usedEntries;
@@ -26,6 +28,10 @@ typedef struct UMM_HEAP_INFO_t {
   unsigned short int freeBlocks;
 
   unsigned short int maxFreeContiguousBlocks;
+
+  /* Free runs of 1, 2-3, 4-7 ... blocks, the last bucket counts the rest */
+  unsigned short int freeRuns[UMM_FREE_RUN_BUCKETS];
+  unsigned long freeBlocksSquared;
 }
 UMM_HEAP_INFO;
 
@@ -41,7 +47,33 @@ void *umm_realloc( void *ptr, size_t size );
 size_t umm_size( void *ptr );
 void umm_free( void *ptr );
 
+/* Same as above, with the caller to charge the allocation to given by the
+ * wrappers that stand between it and the allocator (operator new, _malloc_r)
+ */
+void *umm_malloc_at( size_t size, const void *site );
+void *umm_calloc_at( size_t num, size_t size, const void *site );
+void *umm_realloc_at( void *ptr, size_t size, const void *site );
+
 size_t umm_free_heap_size( void );
+/* Largest block that can be allocated right now */
+size_t umm_max_block_size( void );
+/* 0 (all free space in one block) to 100 (free space in tiny pieces) */
+int umm_fragmentation_metric( void );
+
+/* Free bytes in the slab arena for small blocks, see UMM_SIZE_CLASSES */
+size_t umm_size_class_free( void );
+
+/* Live allocations per caller, see UMM_SITE_STATS */
+typedef struct UMM_SITE_INFO_t {
+  const void *site;               /* return address, NULL for the overflow */
+  size_t liveBytes;
+  unsigned short int liveCount;
+  unsigned long allocCount;
+}
+UMM_SITE_INFO;
+
+/* Copies up to count sites, most live bytes first, returns how many */
+size_t umm_site_info( UMM_SITE_INFO *sites, size_t count );
 
 #ifdef __cplusplus
 }
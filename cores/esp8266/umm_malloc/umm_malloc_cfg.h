@@ -131,6 +131,35 @@ extern char _heap_start;
 #define UMM_INTEGRITY_CHECK
 */
 
+/*
+ * -D UMM_SIZE_CLASSES :
+ *
+ * Serves allocations of up to 64 bytes from a slab arena of UMM_SLAB_PAGES
+ * (16) pages of UMM_SLAB_PAGE_SIZE (256) bytes, taken from the heap on first
+ * use, in constant time instead of searching the free list with interrupts
+ * disabled. Each page holds slots of one size: 8, 16, 24, 32, 48 or 64
+ * bytes. Larger allocations, and small ones once the arena is full, go to
+ * the heap. Free slots count as free heap. Has no effect together with
+ * UMM_POISON.
+ */
+/*
+#define UMM_SIZE_CLASSES
+*/
+
+/*
+ * -D UMM_SITE_STATS :
+ *
+ * Keeps a table of UMM_SITE_STATS_SIZE (32) callers of malloc(), realloc(),
+ * calloc() and operator new, with the bytes and blocks each of them holds,
+ * for umm_site_info() and ESP.printHeapSites(). Costs 4 bytes per block and
+ * a table lookup per allocation. Callers are return addresses, which
+ * xtensa-lx106-elf-addr2line turns into file and line. Has no effect
+ * together with UMM_POISON.
+ */
+/*
+#define UMM_SITE_STATS
+*/
+
 /*
  * -D UMM_POISON :
  *
@@ -0,0 +1,58 @@
+/**
+   PipelinedRequests.ino
+
+    Polls several resources of one server over a single keep-alive
+    connection, without waiting for each response in turn.
+
+*/
+
+
+#include <Arduino.h>
+
+#include <ESP8266WiFi.h>
+#include <ESP8266WiFiMulti.h>
+
+#include <ESP8266HTTPClient.h>
+
+#define USE_SERIAL Serial
+
+ESP8266WiFiMulti WiFiMulti;
+
+HTTPClient http;
+
+const char* resources[] = { "/sensors/1", "/sensors/2", "/sensors/3", "/config" };
+
+unsigned long lastPoll = 0;
+
+void setup() {
+
+  USE_SERIAL.begin(115200);
+  // USE_SERIAL.setDebugOutput(true);
+
+  USE_SERIAL.println();
+  USE_SERIAL.println();
+  USE_SERIAL.println();
+
+  WiFi.mode(WIFI_STA);
+  WiFiMulti.addAP("SSID", "PASSWORD");
+
+  http.begin("192.168.1.12", 80, "/");
+}
+
+void loop() {
+  // wait for WiFi connection
+  if ((WiFiMulti.run() == WL_CONNECTED) && http.handleQueue() == 0 && millis() - lastPoll > 5000) {
+    lastPoll = millis();
+    for (const char* uri : resources) {
+      http.queueRequest("GET", uri, [uri](int httpCode, const String & payload) {
+        if (httpCode > 0) {
+          USE_SERIAL.printf("[HTTP] %s: %d, %s\n", uri, httpCode, payload.c_str());
+        } else {
+          USE_SERIAL.printf("[HTTP] %s failed, error: %s\n", uri, HTTPClient::errorToString(httpCode).c_str());
+        }
+      });
+    }
+  }
+
+  // the responses are handed out by handleQueue(), so keep loop() short
+}
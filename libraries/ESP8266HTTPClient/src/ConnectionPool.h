@@ -0,0 +1,184 @@
+/**
+ * ConnectionPool.h
+ *
+ * Copyright (c) 2016 Ivan Grokhotkov. All rights reserved.
+ * This file is part of the ESP8266HTTPClient for Arduino.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef ConnectionPool_H_
+#define ConnectionPool_H_
+
+#include <memory>
+#include <vector>
+#include <Arduino.h>
+
+/// idle keep-alive connections kept open, counting all hosts
+#ifndef HTTPCLIENT_POOL_MAX_CONNECTIONS
+#define HTTPCLIENT_POOL_MAX_CONNECTIONS (3)
+#endif
+
+/// ms an idle connection is kept; servers usually give up after 5 to 75 s
+#ifndef HTTPCLIENT_POOL_IDLE_TIMEOUT
+#define HTTPCLIENT_POOL_IDLE_TIMEOUT (10000)
+#endif
+
+/**
+ * Idle keep-alive connections, keyed by host, port and whether they are TLS.
+ * Connections are checked out for a request and checked back in once its
+ * response has been read. Connections idle for longer than the idle timeout
+ * are closed, and when the pool is full the least recently used one goes.
+ * Every parked TLS connection keeps its session buffers, so count them in
+ * when raising the cap.
+ */
+template<typename TClient>
+class ConnectionPool
+{
+public:
+    typedef std::unique_ptr<TClient> ClientPtr;
+
+    ConnectionPool(size_t maxConnections = HTTPCLIENT_POOL_MAX_CONNECTIONS,
+                   uint32_t idleTimeout = HTTPCLIENT_POOL_IDLE_TIMEOUT) :
+        _maxConnections(maxConnections),
+        _idleTimeout(idleTimeout)
+    {
+    }
+
+    ~ConnectionPool()
+    {
+        clear();
+    }
+
+    /**
+     * set the number of idle connections kept, 0 disables the pool
+     * @param maxConnections size_t
+     */
+    void setMaxConnections(size_t maxConnections)
+    {
+        _maxConnections = maxConnections;
+        while(_entries.size() > _maxConnections) {
+            evict(0);
+        }
+    }
+
+    /**
+     * set how long an idle connection is kept
+     * @param idleTimeout uint32_t ms
+     */
+    void setIdleTimeout(uint32_t idleTimeout)
+    {
+        _idleTimeout = idleTimeout;
+    }
+
+    /**
+     * takes out the most recently used idle connection to host:port
+     * connections the server closed in the meantime are dropped on the way
+     * @return the connection or nullptr
+     */
+    ClientPtr checkout(const String& host, uint16_t port, bool secure, uint32_t now = millis())
+    {
+        expire(now);
+        for(size_t i = _entries.size(); i-- > 0;) {
+            Entry& entry = _entries[i];
+            if(entry.port != port || entry.secure != secure || !entry.host.equalsIgnoreCase(host)) {
+                continue;
+            }
+            // unsolicited data on an idle connection is a close notice or junk
+            if(!entry.client->connected() || entry.client->available() > 0) {
+                evict(i);
+                continue;
+            }
+            ClientPtr client = std::move(entry.client);
+            _entries.erase(_entries.begin() + i);
+            return client;
+        }
+        return ClientPtr();
+    }
+
+    /**
+     * parks a connection whose response has been read completely
+     * closes it instead if it is gone or the pool is disabled
+     */
+    void checkin(const String& host, uint16_t port, bool secure, ClientPtr client, uint32_t now = millis())
+    {
+        if(!client) {
+            return;
+        }
+        if(_maxConnections == 0 || !client->connected()) {
+            client->stop();
+            return;
+        }
+        expire(now);
+        if(_entries.size() >= _maxConnections) {
+            evict(0);
+        }
+        _entries.push_back(Entry());
+        Entry& entry = _entries.back();
+        entry.host = host;
+        entry.port = port;
+        entry.secure = secure;
+        entry.lastUsed = now;
+        entry.client = std::move(client);
+    }
+
+    /**
+     * closes connections idle for longer than the idle timeout
+     */
+    void expire(uint32_t now = millis())
+    {
+        // entries are in checkin order, the oldest first
+        while(!_entries.empty() && (uint32_t) (now - _entries.front().lastUsed) >= _idleTimeout) {
+            evict(0);
+        }
+    }
+
+    /**
+     * closes all idle connections
+     */
+    void clear()
+    {
+        while(!_entries.empty()) {
+            evict(_entries.size() - 1);
+        }
+    }
+
+    size_t size() const
+    {
+        return _entries.size();
+    }
+
+protected:
+    struct Entry {
+        String host;
+        uint16_t port;
+        bool secure;
+        uint32_t lastUsed;
+        ClientPtr client;
+    };
+
+    void evict(size_t index)
+    {
+        _entries[index].client->stop();
+        _entries.erase(_entries.begin() + index);
+    }
+
+    std::vector<Entry> _entries;
+    size_t _maxConnections;
+    uint32_t _idleTimeout;
+};
+
+#endif /* ConnectionPool_H_ */
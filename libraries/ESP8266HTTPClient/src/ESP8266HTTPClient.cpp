@@ -27,8 +27,10 @@
 #include <WiFiClientSecure.h>
 #include <StreamString.h>
 #include <base64.h>
+#include <Deflate.h>
 
 #include "ESP8266HTTPClient.h"
+#include "HTTPBody.h"
 
 class TransportTraits
 {
@@ -48,6 +50,11 @@ public:
         (void)host;
         return true;
     }
+
+    virtual bool secure() const
+    {
+        return false;
+    }
 };
 
 class TLSTraits : public TransportTraits
@@ -69,10 +76,33 @@ public:
         return wcs.verify(_fingerprint.c_str(), host);
     }
 
+    bool secure() const override
+    {
+        return true;
+    }
+
 protected:
     String _fingerprint;
 };
 
+class RequestQueue
+{
+public:
+    struct Request {
+        bool head;
+        uint8_t attempts;
+        String uri;
+        HTTPResponseCallback callback;
+    };
+
+    std::vector<Request> requests;
+    /// requests at the front that are waiting for their response
+    size_t sent = 0;
+    HTTPResponseParser parser;
+    StreamString payload;
+    unsigned long lastDataTime = 0;
+};
+
 /**
  * constructor
  */
@@ -103,6 +133,7 @@ void HTTPClient::clear()
 
 bool HTTPClient::begin(String url, String httpsFingerprint)
 {
+    end();
     _transportTraits.reset(nullptr);
     _port = 443;
     if (httpsFingerprint.length() == 0) {
@@ -122,6 +153,8 @@ bool HTTPClient::begin(String url, String httpsFingerprint)
  */
 bool HTTPClient::begin(String url)
 {
+    // park or close the connection of the previous request
+    end();
     _transportTraits.reset(nullptr);
     _port = 80;
     if (!beginInternal(url, "http")) {
@@ -180,6 +213,7 @@ bool HTTPClient::beginInternal(String url, const char* expectedProtocol)
 
 bool HTTPClient::begin(String host, uint16_t port, String uri)
 {
+    end();
     clear();
     _host = host;
     _port = port;
@@ -200,6 +234,7 @@ bool HTTPClient::begin(String host, uint16_t port, String uri, bool https, Strin
 
 bool HTTPClient::begin(String host, uint16_t port, String uri, String httpsFingerprint)
 {
+    end();
     clear();
     _host = host;
     _port = port;
@@ -219,6 +254,14 @@ bool HTTPClient::begin(String host, uint16_t port, String uri, String httpsFinge
  */
 void HTTPClient::end(void)
 {
+    // queued requests can not be answered any more
+    if(_queue) {
+        _queue->sent = 0;
+        while(!_queue->requests.empty()) {
+            completeQueued(HTTPC_ERROR_CONNECTION_LOST);
+        }
+    }
+
     if(connected()) {
         if(_tcp->available() > 0) {
             DEBUG_HTTPCLIENT("[HTTP-Client][end] still data in buffer (%d), clean up.\n", _tcp->available());
@@ -226,8 +269,9 @@ void HTTPClient::end(void)
                 _tcp->read();
             }
         }
-        if(_reuse && _canReuse) {
+        if(_reuse && _canReuse && _transportTraits) {
             DEBUG_HTTPCLIENT("[HTTP-Client][end] tcp keep open for reuse\n");
+            connectionPool().checkin(_host, _port, _transportTraits->secure(), std::move(_tcp));
         } else {
             DEBUG_HTTPCLIENT("[HTTP-Client][end] tcp stop\n");
             _tcp->stop();
@@ -235,6 +279,19 @@ void HTTPClient::end(void)
     } else {
         DEBUG_HTTPCLIENT("[HTTP-Client][end] tcp is closed\n");
     }
+    _tcp.reset();
+    _canReuse = false;
+    _pooled = false;
+}
+
+/**
+ * idle keep-alive connections, shared by all HTTPClient instances
+ * @return HTTPConnectionPool
+ */
+HTTPConnectionPool& HTTPClient::connectionPool()
+{
+    static HTTPConnectionPool pool;
+    return pool;
 }
 
 /**
@@ -315,6 +372,18 @@ void HTTPClient::useHTTP10(bool useHTTP10)
     _useHTTP10 = useHTTP10;
 }
 
+/**
+ * asks for gzip or deflate compressed responses, writeToStream() and
+ * getString() decode them. Decoding takes a window of 1 << INFLATE_WINDOW_BITS
+ * bytes of heap. getSize() stays the compressed size.
+ * Queued requests are not affected.
+ * @param useCompression bool
+ */
+void HTTPClient::useCompression(bool useCompression)
+{
+    _useCompression = useCompression;
+}
+
 /**
  * send a GET request
  * @return http code
@@ -388,29 +457,40 @@ int HTTPClient::sendRequest(const char * type, String payload)
  */
 int HTTPClient::sendRequest(const char * type, uint8_t * payload, size_t size)
 {
-    // connect to server
-    if(!connect()) {
-        return returnError(HTTPC_ERROR_CONNECTION_REFUSED);
-    }
-
     if(payload && size > 0) {
         addHeader(F("Content-Length"), String(size));
     }
 
-    // send Header
-    if(!sendHeader(type)) {
-        return returnError(HTTPC_ERROR_SEND_HEADER_FAILED);
-    }
+    // a pooled connection the server closed while it was idle only fails
+    // once it is used, so the request gets one more try on another one,
+    // unless the server may have acted on it and doing so twice does harm
+    for(bool retry = true;; retry = false) {
+        // connect to server
+        if(!connect()) {
+            return returnError(HTTPC_ERROR_CONNECTION_REFUSED);
+        }
+        retry = retry && _pooled;
+
+        int code;
+        size_t sent = 0;
+        if(!sendHeader(type, _uri, _useCompression, &sent)) {
+            code = HTTPC_ERROR_SEND_HEADER_FAILED;
+        } else if(payload && size > 0 && _tcp->write(&payload[0], size) != size) {
+            code = HTTPC_ERROR_SEND_PAYLOAD_FAILED;
+        } else {
+            // handle Server Response (Header)
+            code = handleHeaderResponse();
+        }
 
-    // send Payload if needed
-    if(payload && size > 0) {
-        if(_tcp->write(&payload[0], size) != size) {
-            return returnError(HTTPC_ERROR_SEND_PAYLOAD_FAILED);
+        if(retry && (sent == 0 || isSafeMethod(type)) &&
+                (code == HTTPC_ERROR_SEND_HEADER_FAILED || code == HTTPC_ERROR_SEND_PAYLOAD_FAILED ||
+                 code == HTTPC_ERROR_NOT_CONNECTED || code == HTTPC_ERROR_CONNECTION_LOST)) {
+            DEBUG_HTTPCLIENT("[HTTP-Client][sendRequest] pooled connection is gone, retry\n");
+            _tcp->stop();
+            continue;
         }
+        return returnError(code);
     }
-
-    // handle Server Response (Header)
-    return returnError(handleHeaderResponse());
 }
 
 /**
@@ -606,72 +686,40 @@ int HTTPClient::writeToStream(Stream * stream)
         return returnError(HTTPC_ERROR_NOT_CONNECTED);
     }
 
-    // get length of document (is -1 when Server sends no Content-Length header)
-    int len = _size;
-    int ret = 0;
-
-    if(_transferEncoding == HTTPC_TE_IDENTITY) {
-        ret = writeToStreamDataBlock(stream, len);
+    std::unique_ptr<InflatePrint> inflate;
+    if(_compressed) {
+        inflate.reset(new InflatePrint(*stream));
+    }
 
-        // have we an error?
-        if(ret < 0) {
-            return returnError(ret);
+    int ret = writeHTTPBody(*_tcp, inflate ? (Print *) inflate.get() : stream, _size, _transferEncoding, _tcpTimeout);
+    if(inflate) {
+        if(inflate->error() == InflatePrint::NO_MEMORY) {
+            ret = HTTPC_ERROR_TOO_LESS_RAM;
+        } else if(inflate->error() == InflatePrint::BAD_DATA || (ret >= 0 && !inflate->done())) {
+            DEBUG_HTTPCLIENT("[HTTP-Client][writeToStream] bad compressed body\n");
+            ret = HTTPC_ERROR_DECOMPRESSION;
         }
-    } else if(_transferEncoding == HTTPC_TE_CHUNKED) {
-        int size = 0;
-        while(1) {
-            if(!connected()) {
-                return returnError(HTTPC_ERROR_CONNECTION_LOST);
-            }
-            String chunkHeader = _tcp->readStringUntil('\n');
-
-            if(chunkHeader.length() <= 0) {
-                return returnError(HTTPC_ERROR_READ_TIMEOUT);
-            }
-
-            chunkHeader.trim(); // remove \r
-
-            // read size of chunk
-            len = (uint32_t) strtol((const char *) chunkHeader.c_str(), NULL, 16);
-            size += len;
-            DEBUG_HTTPCLIENT("[HTTP-Client] read chunk len: %d\n", len);
-
-            // data left?
-            if(len > 0) {
-                int r = writeToStreamDataBlock(stream, len);
-                if(r < 0) {
-                    // error in writeToStreamDataBlock
-                    return returnError(r);
-                }
-                ret += r;
-            } else {
-
-                // if no length Header use global chunk size
-                if(_size <= 0) {
-                    _size = size;
-                }
-
-                // check if we have write all data out
-                if(ret != _size) {
-                    return returnError(HTTPC_ERROR_STREAM_WRITE);
-                }
-                break;
-            }
+    }
+    if(ret < 0) {
+        return returnError(ret);
+    }
 
-            // read trailing \r\n at the end of the chunk
-            char buf[2];
-            auto trailing_seq_len = _tcp->readBytes((uint8_t*)buf, 2);
-            if (trailing_seq_len != 2 || buf[0] != '\r' || buf[1] != '\n') {
-                return returnError(HTTPC_ERROR_READ_TIMEOUT);
-            }
+    if(_transferEncoding == HTTPC_TE_CHUNKED) {
+        // if no length Header use global chunk size
+        if(_size <= 0) {
+            _size = ret;
+        }
 
-            delay(0);
+        // check if we have write all data out
+        if(ret != _size) {
+            return returnError(HTTPC_ERROR_STREAM_WRITE);
         }
-    } else {
-        return returnError(HTTPC_ERROR_ENCODING);
     }
 
     end();
+    if(inflate) {
+        return inflate->totalOut();
+    }
     return ret;
 }
 
@@ -725,6 +773,8 @@ String HTTPClient::errorToString(int error)
         return F("Stream write error");
     case HTTPC_ERROR_READ_TIMEOUT:
         return F("read Timeout");
+    case HTTPC_ERROR_DECOMPRESSION:
+        return F("decompression failed");
     default:
         return String();
     }
@@ -766,6 +816,151 @@ void HTTPClient::addHeader(const String& name, const String& value, bool first,
 
 }
 
+/**
+ * queues a GET or HEAD request for uri on the host given to begin()
+ * Queued requests are pipelined on one keep-alive connection by
+ * handleQueue(), which calls callback with each response in order.
+ * Don't mix them with the blocking requests on the same HTTPClient.
+ * @param type const char *     "GET" or "HEAD", others can not be repeated safely
+ * @param uri String
+ * @param callback HTTPResponseCallback
+ * @return false if the request type can not be queued
+ */
+bool HTTPClient::queueRequest(const char * type, const String& uri, HTTPResponseCallback callback)
+{
+    bool head = (strcmp(type, "HEAD") == 0);
+    if(!head && strcmp(type, "GET") != 0) {
+        return false;
+    }
+    if(!_queue) {
+        _queue = RequestQueuePtr(new RequestQueue());
+    }
+    // pipelining needs keep-alive
+    _reuse = true;
+
+    RequestQueue::Request request;
+    request.head = head;
+    request.attempts = 0;
+    request.uri = uri;
+    request.callback = callback;
+    _queue->requests.push_back(request);
+    return true;
+}
+
+/**
+ * sends queued requests and hands out the responses that have arrived
+ * without waiting for more, call it from loop()
+ * Requests left unanswered by a closed connection are sent again on a
+ * new one. Once the queue is empty the connection goes to the pool.
+ * @return number of requests still queued
+ */
+size_t HTTPClient::handleQueue()
+{
+    if(!_queue || _queue->requests.empty()) {
+        return 0;
+    }
+    RequestQueue& queue = *_queue;
+
+    if(!connected()) {
+        if(queue.sent > 0) {
+            DEBUG_HTTPCLIENT("[HTTP-Client][handleQueue] connection lost, %d requests unanswered\n", queue.sent);
+            queue.sent = 0;
+            if(++queue.requests.front().attempts >= HTTPCLIENT_QUEUE_ATTEMPTS) {
+                completeQueued(HTTPC_ERROR_CONNECTION_LOST);
+                return queue.requests.size();
+            }
+        }
+        if(!connect()) {
+            while(!queue.requests.empty()) {
+                completeQueued(HTTPC_ERROR_CONNECTION_REFUSED);
+            }
+            return 0;
+        }
+    }
+
+    // keep up to HTTPCLIENT_QUEUE_DEPTH requests in flight
+    while(_tcp->connected() && queue.sent < queue.requests.size() && queue.sent < HTTPCLIENT_QUEUE_DEPTH) {
+        RequestQueue::Request& request = queue.requests[queue.sent];
+        if(queue.sent++ == 0) {
+            queue.parser.reset(request.head);
+            queue.payload.remove(0);
+            queue.lastDataTime = millis();
+        }
+        if(!sendHeader(request.head ? "HEAD" : "GET", request.uri)) {
+            // sent again on the next call
+            _tcp->stop();
+            return queue.requests.size();
+        }
+    }
+
+    // responses come back in request order
+    size_t len;
+    while(queue.sent > 0 && (len = _tcp->peekAvailable()) > 0) {
+        queue.lastDataTime = millis();
+        size_t used = queue.parser.feed(_tcp->peekBuffer(), len, &queue.payload);
+        _tcp->peekConsume(used);
+
+        if(queue.parser.failed()) {
+            _tcp->stop();
+            queue.sent = 0;
+            completeQueued(queue.parser.error());
+            break;
+        }
+        if(queue.parser.done()) {
+            bool keepAlive = queue.parser.keepAlive();
+            --queue.sent;
+            _canReuse = keepAlive;
+            if(!keepAlive) {
+                // the rest goes out again on a new connection
+                _tcp->stop();
+                queue.sent = 0;
+            }
+            completeQueued(queue.parser.code());
+            if(queue.sent > 0) {
+                queue.parser.reset(queue.requests.front().head);
+            }
+        }
+    }
+
+    if(queue.sent > 0 && !connected()) {
+        // which completes a body that lasts until the connection closes
+        queue.parser.close();
+        if(queue.parser.done()) {
+            queue.sent = 0;
+            _canReuse = false;
+            completeQueued(queue.parser.code());
+        }
+    } else if(queue.sent > 0 && (millis() - queue.lastDataTime) > _tcpTimeout) {
+        _tcp->stop();
+        queue.sent = 0;
+        completeQueued(HTTPC_ERROR_READ_TIMEOUT);
+    }
+
+    if(queue.requests.empty()) {
+        end();
+    }
+    return queue.requests.size();
+}
+
+/**
+ * hands the response to the first queued request to its callback
+ * @param code int      http code or HTTPC_ERROR_*
+ */
+void HTTPClient::completeQueued(int code)
+{
+    RequestQueue& queue = *_queue;
+    HTTPResponseCallback callback = queue.requests.front().callback;
+    queue.requests.erase(queue.requests.begin());
+    if(code < 0) {
+        queue.payload.remove(0);
+    }
+    DEBUG_HTTPCLIENT("[HTTP-Client][handleQueue] response code: %d size: %d\n", code, queue.payload.length());
+    if(callback) {
+        callback(code, queue.payload);
+    }
+    queue.payload.remove(0);
+}
+
 void HTTPClient::collectHeaders(const char* headerKeys[], const size_t headerKeysCount)
 {
     _headerKeysCount = headerKeysCount;
@@ -839,6 +1034,21 @@ bool HTTPClient::connect(void)
         return false;
     }
 
+    _pooled = false;
+    if(_reuse) {
+        _tcp = connectionPool().checkout(_host, _port, _transportTraits->secure());
+        if(_tcp) {
+            // the session may have been verified with another fingerprint
+            if(_transportTraits->verify(*_tcp, _host.c_str())) {
+                DEBUG_HTTPCLIENT("[HTTP-Client] reuse pooled connection to %s:%u\n", _host.c_str(), _port);
+                _tcp->setTimeout(_tcpTimeout);
+                _pooled = true;
+                return true;
+            }
+            _tcp->stop();
+        }
+    }
+
     _tcp = _transportTraits->create();
     _tcp->setTimeout(_tcpTimeout);
 
@@ -862,18 +1072,43 @@ bool HTTPClient::connect(void)
     return connected();
 }
 
+/**
+ * whether a request of this type only reads, so that sending it twice does
+ * no harm; PUT and DELETE are idempotent too, but not repeated unasked
+ * @param type (GET, POST, ...)
+ * @return bool
+ */
+bool HTTPClient::isSafeMethod(const char * type)
+{
+    return strcmp(type, "GET") == 0 || strcmp(type, "HEAD") == 0 ||
+           strcmp(type, "OPTIONS") == 0 || strcmp(type, "TRACE") == 0;
+}
+
 /**
  * sends HTTP request header
  * @param type (GET, POST, ...)
  * @return status
  */
 bool HTTPClient::sendHeader(const char * type)
+{
+    return sendHeader(type, _uri, _useCompression);
+}
+
+/**
+ * sends HTTP request header for another uri on the same host
+ * @param type (GET, POST, ...)
+ * @param uri String
+ * @param compression bool  accept a gzip or deflate compressed body
+ * @param sent size_t *     set to the bytes that went out, if given
+ * @return status
+ */
+bool HTTPClient::sendHeader(const char * type, const String& uri, bool compression, size_t * sent)
 {
     if(!connected()) {
         return false;
     }
 
-    String header = String(type) + " " + (_uri.length() ? _uri : F("/")) + F(" HTTP/1.");
+    String header = String(type) + " " + (uri.length() ? uri : F("/")) + F(" HTTP/1.");
 
     if(_useHTTP10) {
         header += "0";
@@ -897,7 +1132,9 @@ bool HTTPClient::sendHeader(const char * type)
     }
     header += "\r\n";
 
-    if(!_useHTTP10) {
+    if(compression) {
+        header += F("Accept-Encoding: gzip, deflate\r\n");
+    } else if(!_useHTTP10) {
         header += F("Accept-Encoding: identity;q=1,chunked;q=0.1,*;q=0\r\n");
     }
 
@@ -912,7 +1149,11 @@ bool HTTPClient::sendHeader(const char * type)
 
     DEBUG_HTTPCLIENT("[HTTP-Client] sending request header\n-----\n%s-----\n", header.c_str());
 
-    return (_tcp->write((const uint8_t *) header.c_str(), header.length()) == header.length());
+    size_t written = _tcp->write((const uint8_t *) header.c_str(), header.length());
+    if(sent) {
+        *sent = written;
+    }
+    return (written == header.length());
 }
 
 /**
@@ -929,7 +1170,9 @@ int HTTPClient::handleHeaderResponse()
     String transferEncoding;
     _returnCode = -1;
     _size = -1;
+    _canReuse = false;
     _transferEncoding = HTTPC_TE_IDENTITY;
+    _compressed = false;
     unsigned long lastDataTime = millis();
 
     while(connected()) {
@@ -944,6 +1187,8 @@ int HTTPClient::handleHeaderResponse()
 
             if(headerLine.startsWith("HTTP/1.")) {
                 _returnCode = headerLine.substring(9, headerLine.indexOf(' ', 9)).toInt();
+                // HTTP/1.1 connections persist unless the server says otherwise
+                _canReuse = (headerLine[7] != '0');
             } else if(headerLine.indexOf(':')) {
                 String headerName = headerLine.substring(0, headerLine.indexOf(':'));
                 String headerValue = headerLine.substring(headerLine.indexOf(':') + 1);
@@ -954,13 +1199,23 @@ int HTTPClient::handleHeaderResponse()
                 }
 
                 if(headerName.equalsIgnoreCase("Connection")) {
-                    _canReuse = headerValue.equalsIgnoreCase("keep-alive");
+                    if(headerValue.equalsIgnoreCase("keep-alive")) {
+                        _canReuse = true;
+                    } else if(headerValue.equalsIgnoreCase("close")) {
+                        _canReuse = false;
+                    }
                 }
 
                 if(headerName.equalsIgnoreCase("Transfer-Encoding")) {
                     transferEncoding = headerValue;
                 }
 
+                // only decoded when asked for, a .gz download stays as it is
+                if(_useCompression && headerName.equalsIgnoreCase("Content-Encoding")) {
+                    _compressed = headerValue.equalsIgnoreCase("gzip") || headerValue.equalsIgnoreCase("x-gzip") ||
+                                  headerValue.equalsIgnoreCase("deflate");
+                }
+
                 for(size_t i = 0; i < _headerKeysCount; i++) {
                     if(_currentHeaders[i].key.equalsIgnoreCase(headerName)) {
                         _currentHeaders[i].value = headerValue;
@@ -985,6 +1240,10 @@ int HTTPClient::handleHeaderResponse()
                     }
                 } else {
                     _transferEncoding = HTTPC_TE_IDENTITY;
+                    // without a length the body ends with the connection
+                    if(_size < 0) {
+                        _canReuse = false;
+                    }
                 }
 
                 if(_returnCode) {
@@ -1006,118 +1265,6 @@ int HTTPClient::handleHeaderResponse()
     return HTTPC_ERROR_CONNECTION_LOST;
 }
 
-/**
- * write one Data Block to Stream
- * @param stream Stream *
- * @param size int
- * @return < 0 = error >= 0 = size written
- */
-int HTTPClient::writeToStreamDataBlock(Stream * stream, int size)
-{
-    int buff_size = HTTP_TCP_BUFFER_SIZE;
-    int len = size;
-    int bytesWritten = 0;
-
-    // if possible create smaller buffer then HTTP_TCP_BUFFER_SIZE
-    if((len > 0) && (len < HTTP_TCP_BUFFER_SIZE)) {
-        buff_size = len;
-    }
-
-    // create buffer for read
-    uint8_t * buff = (uint8_t *) malloc(buff_size);
-
-    if(buff) {
-        // read all data from server
-        while(connected() && (len > 0 || len == -1)) {
-
-            // get available data size
-            size_t sizeAvailable = _tcp->available();
-
-            if(sizeAvailable) {
-
-                int readBytes = sizeAvailable;
-
-                // read only the asked bytes
-                if(len > 0 && readBytes > len) {
-                    readBytes = len;
-                }
-
-                // not read more the buffer can handle
-                if(readBytes > buff_size) {
-                    readBytes = buff_size;
-                }
-
-                // read data
-                int bytesRead = _tcp->readBytes(buff, readBytes);
-
-                // write it to Stream
-                int bytesWrite = stream->write(buff, bytesRead);
-                bytesWritten += bytesWrite;
-
-                // are all Bytes a writen to stream ?
-                if(bytesWrite != bytesRead) {
-                    DEBUG_HTTPCLIENT("[HTTP-Client][writeToStream] short write asked for %d but got %d retry...\n", bytesRead, bytesWrite);
-
-                    // check for write error
-                    if(stream->getWriteError()) {
-                        DEBUG_HTTPCLIENT("[HTTP-Client][writeToStreamDataBlock] stream write error %d\n", stream->getWriteError());
-
-                        //reset write error for retry
-                        stream->clearWriteError();
-                    }
-
-                    // some time for the stream
-                    delay(1);
-
-                    int leftBytes = (readBytes - bytesWrite);
-
-                    // retry to send the missed bytes
-                    bytesWrite = stream->write((buff + bytesWrite), leftBytes);
-                    bytesWritten += bytesWrite;
-
-                    if(bytesWrite != leftBytes) {
-                        // failed again
-                        DEBUG_HTTPCLIENT("[HTTP-Client][writeToStream] short write asked for %d but got %d failed.\n", leftBytes, bytesWrite);
-                        free(buff);
-                        return HTTPC_ERROR_STREAM_WRITE;
-                    }
-                }
-
-                // check for write error
-                if(stream->getWriteError()) {
-                    DEBUG_HTTPCLIENT("[HTTP-Client][writeToStreamDataBlock] stream write error %d\n", stream->getWriteError());
-                    free(buff);
-                    return HTTPC_ERROR_STREAM_WRITE;
-                }
-
-                // count bytes to read left
-                if(len > 0) {
-                    len -= readBytes;
-                }
-
-                delay(0);
-            } else {
-                delay(1);
-            }
-        }
-
-        free(buff);
-
-        DEBUG_HTTPCLIENT("[HTTP-Client][writeToStreamDataBlock] connection closed or file end (written: %d).\n", bytesWritten);
-
-        if((size > 0) && (size != bytesWritten)) {
-            DEBUG_HTTPCLIENT("[HTTP-Client][writeToStreamDataBlock] bytesWritten %d and size %d mismatch!.\n", bytesWritten, size);
-            return HTTPC_ERROR_STREAM_WRITE;
-        }
-
-    } else {
-        DEBUG_HTTPCLIENT("[HTTP-Client][writeToStreamDataBlock] too less ram! need %d\n", HTTP_TCP_BUFFER_SIZE);
-        return HTTPC_ERROR_TOO_LESS_RAM;
-    }
-
-    return bytesWritten;
-}
-
 /**
  * called to handle error return, may disconnect the connection if still exists
  * @param error
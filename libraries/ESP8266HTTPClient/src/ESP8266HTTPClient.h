@@ -26,8 +26,10 @@
 #define ESP8266HTTPClient_H_
 
 #include <memory>
+#include <functional>
 #include <Arduino.h>
 #include <WiFiClient.h>
+#include "ConnectionPool.h"
 
 #ifdef DEBUG_ESP_HTTP_CLIENT
 #ifdef DEBUG_ESP_PORT
@@ -53,10 +55,19 @@
 #define HTTPC_ERROR_ENCODING            (-9)
 #define HTTPC_ERROR_STREAM_WRITE        (-10)
 #define HTTPC_ERROR_READ_TIMEOUT        (-11)
+#define HTTPC_ERROR_DECOMPRESSION       (-12)
 
 /// size for the stream handling
 #define HTTP_TCP_BUFFER_SIZE (1460)
 
+/// queued requests sent ahead of their responses
+#ifndef HTTPCLIENT_QUEUE_DEPTH
+#define HTTPCLIENT_QUEUE_DEPTH (4)
+#endif
+
+/// connections a queued request may be sent on before it fails
+#define HTTPCLIENT_QUEUE_ATTEMPTS (2)
+
 /// HTTP codes see RFC7231
 typedef enum {
     HTTP_CODE_CONTINUE = 100,
@@ -127,6 +138,14 @@ typedef enum {
 class TransportTraits;
 typedef std::unique_ptr<TransportTraits> TransportTraitsPtr;
 
+typedef ConnectionPool<WiFiClient> HTTPConnectionPool;
+
+class RequestQueue;
+typedef std::unique_ptr<RequestQueue> RequestQueuePtr;
+
+/// gets the http code, or a negative HTTPC_ERROR_*, and the payload
+typedef std::function<void(int httpCode, const String& payload)> HTTPResponseCallback;
+
 class HTTPClient
 {
 public:
@@ -151,6 +170,7 @@ public:
     void setTimeout(uint16_t timeout);
 
     void useHTTP10(bool usehttp10 = true);
+    void useCompression(bool usecompression = true); /// gzip or deflate response bodies, decoded by writeToStream()
 
     /// request handling
     int GET();
@@ -166,6 +186,10 @@ public:
 
     void addHeader(const String& name, const String& value, bool first = false, bool replace = true);
 
+    /// pipelined GET and HEAD requests, driven by calling handleQueue() from loop()
+    bool queueRequest(const char * type, const String& uri, HTTPResponseCallback callback);
+    size_t handleQueue();
+
     /// Response handling
     void collectHeaders(const char* headerKeys[], const size_t headerKeysCount);
     String header(const char* name);   // get request header value by name
@@ -184,6 +208,9 @@ public:
 
     static String errorToString(int error);
 
+    /// idle keep-alive connections shared by all clients with setReuse(true)
+    static HTTPConnectionPool& connectionPool();
+
 protected:
     struct RequestArgument {
         String key;
@@ -195,12 +222,15 @@ protected:
     int returnError(int error);
     bool connect(void);
     bool sendHeader(const char * type);
+    bool sendHeader(const char * type, const String& uri, bool compression = false, size_t * sent = nullptr);
+    static bool isSafeMethod(const char * type);
+    void completeQueued(int code);
     int handleHeaderResponse();
-    int writeToStreamDataBlock(Stream * stream, int len);
 
 
     TransportTraitsPtr _transportTraits;
     std::unique_ptr<WiFiClient> _tcp;
+    RequestQueuePtr _queue;
 
     /// request handling
     String _host;
@@ -208,6 +238,7 @@ protected:
     bool _reuse = false;
     uint16_t _tcpTimeout = HTTPCLIENT_DEFAULT_TCP_TIMEOUT;
     bool _useHTTP10 = false;
+    bool _useCompression = false;
 
     String _uri;
     String _protocol;
@@ -222,7 +253,9 @@ protected:
     int _returnCode = 0;
     int _size = -1;
     bool _canReuse = false;
+    bool _pooled = false;
     transferEncoding_t _transferEncoding = HTTPC_TE_IDENTITY;
+    bool _compressed = false;
 };
 
 
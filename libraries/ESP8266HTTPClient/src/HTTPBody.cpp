@@ -0,0 +1,491 @@
+/**
+ * HTTPBody.cpp
+ *
+ * Copyright (c) 2016 Ivan Grokhotkov. All rights reserved.
+ * This file is part of the ESP8266HTTPClient for Arduino.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <algorithm>
+#include <string.h>
+#include <strings.h>
+#include <Arduino.h>
+
+#include "HTTPBody.h"
+
+static int hexDigit(char c)
+{
+    if(c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    c |= 0x20;
+    if(c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+ChunkedDecoder::ChunkedDecoder()
+{
+    reset();
+}
+
+void ChunkedDecoder::reset()
+{
+    _state = SIZE_START;
+    _remaining = 0;
+}
+
+void ChunkedDecoder::endSizeLine()
+{
+    _state = _remaining ? DATA : TRAILER_START;
+}
+
+size_t ChunkedDecoder::skipFraming(const char * data, size_t len)
+{
+    for(size_t i = 0; i < len; ++i) {
+        char c = data[i];
+        switch(_state) {
+        case SIZE_START:
+        case SIZE: {
+            int digit = hexDigit(c);
+            if(digit >= 0) {
+                // keep chunk sizes below 2^31, they end up in an int
+                if(_remaining >> 27) {
+                    _state = FAILED;
+                    return i;
+                }
+                _remaining = (_remaining << 4) | digit;
+                _state = SIZE;
+            } else if(_state == SIZE && (c == ';' || c == ' ' || c == '\t')) {
+                _state = EXTENSION;
+            } else if(_state == SIZE && c == '\r') {
+                _state = SIZE_LF;
+            } else if(_state == SIZE && c == '\n') {
+                endSizeLine();
+            } else {
+                _state = FAILED;
+                return i;
+            }
+            break;
+        }
+        case EXTENSION:
+            if(c == '\n') {
+                endSizeLine();
+            }
+            break;
+        case SIZE_LF:
+            if(c != '\n') {
+                _state = FAILED;
+                return i;
+            }
+            endSizeLine();
+            break;
+        case DATA:
+            return i;
+        case DATA_CR:
+            if(c == '\r') {
+                _state = DATA_LF;
+            } else if(c == '\n') {
+                _state = SIZE_START;
+            } else {
+                _state = FAILED;
+                return i;
+            }
+            break;
+        case DATA_LF:
+            if(c != '\n') {
+                _state = FAILED;
+                return i;
+            }
+            _state = SIZE_START;
+            break;
+        case TRAILER_START:
+            if(c == '\r') {
+                _state = TRAILER_LF;
+            } else if(c == '\n') {
+                // nothing after the message belongs to it
+                _state = DONE;
+                return i + 1;
+            } else {
+                _state = TRAILER;
+            }
+            break;
+        case TRAILER:
+            if(c == '\n') {
+                _state = TRAILER_START;
+            }
+            break;
+        case TRAILER_LF:
+            if(c != '\n') {
+                _state = FAILED;
+                return i;
+            }
+            _state = DONE;
+            return i + 1;
+        case DONE:
+        case FAILED:
+            return i;
+        }
+    }
+    return len;
+}
+
+void ChunkedDecoder::consumeBody(size_t len)
+{
+    if(_state != DATA) {
+        return;
+    }
+    _remaining -= std::min((size_t) _remaining, len);
+    if(_remaining == 0) {
+        _state = DATA_CR;
+    }
+}
+
+HTTPResponseParser::HTTPResponseParser()
+{
+    reset();
+}
+
+void HTTPResponseParser::reset(bool head)
+{
+    _state = STATUS;
+    _head = head;
+    _chunked = false;
+    _keepAlive = false;
+    _code = 0;
+    _size = -1;
+    _error = 0;
+    _remaining = 0;
+    _lineLen = 0;
+}
+
+void HTTPResponseParser::fail(int error)
+{
+    _state = FAILED;
+    _error = error;
+}
+
+size_t HTTPResponseParser::feed(const char * data, size_t len, Print * body)
+{
+    size_t used = 0;
+    while(used < len) {
+        const char * p = data + used;
+        size_t avail = len - used;
+        switch(_state) {
+        case STATUS:
+        case HEADERS: {
+            const char * end = (const char *) memchr(p, '\n', avail);
+            size_t n = end ? (size_t) (end - p) : avail;
+            size_t keep = std::min(n, sizeof(_line) - 1 - _lineLen);
+            memcpy(_line + _lineLen, p, keep);
+            _lineLen += keep;
+            used += n;
+            if(!end) {
+                return used;
+            }
+            ++used;
+            endLine();
+            break;
+        }
+        case BODY: {
+            size_t n = std::min(avail, (size_t) _remaining);
+            if(body) {
+                body->write((const uint8_t *) p, n);
+            }
+            used += n;
+            _remaining -= n;
+            if(_remaining == 0) {
+                _state = DONE;
+            }
+            break;
+        }
+        case CHUNKED: {
+            size_t framing = _chunks.skipFraming(p, avail);
+            used += framing;
+            if(_chunks.done()) {
+                _state = DONE;
+            } else if(_chunks.failed()) {
+                fail(HTTPC_ERROR_ENCODING);
+            } else if(framing == 0) {
+                size_t n = std::min(avail, _chunks.bodyAvailable());
+                if(body) {
+                    body->write((const uint8_t *) p, n);
+                }
+                _chunks.consumeBody(n);
+                used += n;
+            }
+            break;
+        }
+        case UNTIL_CLOSE:
+            if(body) {
+                body->write((const uint8_t *) p, avail);
+            }
+            used = len;
+            break;
+        case DONE:
+        case FAILED:
+            return used;
+        }
+    }
+    return used;
+}
+
+void HTTPResponseParser::close()
+{
+    if(_state == UNTIL_CLOSE) {
+        _state = DONE;
+    } else if(_state != DONE && _state != FAILED) {
+        fail(HTTPC_ERROR_CONNECTION_LOST);
+    }
+}
+
+void HTTPResponseParser::endLine()
+{
+    if(_lineLen > 0 && _line[_lineLen - 1] == '\r') {
+        --_lineLen;
+    }
+    _line[_lineLen] = 0;
+    size_t lineLen = _lineLen;
+    _lineLen = 0;
+
+    if(_state == STATUS) {
+        if(lineLen == 0) {
+            // tolerate empty lines before the status line
+            return;
+        }
+        if(lineLen < 12 || strncmp(_line, "HTTP/1.", 7) != 0) {
+            fail(HTTPC_ERROR_NO_HTTP_SERVER);
+            return;
+        }
+        _code = atoi(_line + 9);
+        // HTTP/1.1 connections persist unless the server says otherwise
+        _keepAlive = (_line[7] != '0');
+        _state = HEADERS;
+        return;
+    }
+
+    if(lineLen == 0) {
+        endHeaders();
+        return;
+    }
+
+    char * value = strchr(_line, ':');
+    if(!value) {
+        return;
+    }
+    *value++ = 0;
+    while(*value == ' ' || *value == '\t') {
+        ++value;
+    }
+    for(char * end = value + strlen(value); end > value && (end[-1] == ' ' || end[-1] == '\t');) {
+        *--end = 0;
+    }
+
+    if(strcasecmp(_line, "Content-Length") == 0) {
+        _size = atoi(value);
+    } else if(strcasecmp(_line, "Transfer-Encoding") == 0) {
+        if(strcasecmp(value, "chunked") == 0) {
+            _chunked = true;
+        } else if(strcasecmp(value, "identity") != 0) {
+            fail(HTTPC_ERROR_ENCODING);
+        }
+    } else if(strcasecmp(_line, "Connection") == 0) {
+        if(strcasecmp(value, "keep-alive") == 0) {
+            _keepAlive = true;
+        } else if(strcasecmp(value, "close") == 0) {
+            _keepAlive = false;
+        }
+    }
+}
+
+void HTTPResponseParser::endHeaders()
+{
+    if(_code < 200) {
+        // 100 Continue and friends, the real response follows
+        reset(_head);
+        return;
+    }
+    if(_head || _code == 204 || _code == 304) {
+        _state = DONE;
+    } else if(_chunked) {
+        _chunks.reset();
+        _state = CHUNKED;
+    } else if(_size >= 0) {
+        _remaining = _size;
+        _state = _remaining ? BODY : DONE;
+    } else {
+        _keepAlive = false;
+        _state = UNTIL_CLOSE;
+    }
+}
+
+// what a client has received, in place when it has the peek buffer API.
+// Otherwise it is read through a buffer, never more than asked for, so
+// the next response on a kept-alive connection stays where it is.
+class BodySource
+{
+public:
+    BodySource(Client& client) :
+        _client(client),
+        _peek(client.hasPeekBufferAPI())
+    {
+    }
+
+    ~BodySource()
+    {
+        free(_buffer);
+    }
+
+    bool begin()
+    {
+        if(!_peek) {
+            _buffer = (char *) malloc(HTTP_TCP_BUFFER_SIZE);
+        }
+        return _peek || _buffer;
+    }
+
+    size_t available(size_t wanted)
+    {
+        if(_peek) {
+            return _client.peekAvailable();
+        }
+        if(_pos == _len) {
+            _pos = _len = 0;
+            int avail = _client.available();
+            if(avail > 0) {
+                size_t len = std::min(std::min((size_t) avail, wanted), (size_t) HTTP_TCP_BUFFER_SIZE);
+                int got = _client.read((uint8_t *) _buffer, len);
+                _len = (got > 0) ? got : 0;
+            }
+        }
+        return _len - _pos;
+    }
+
+    const char * data()
+    {
+        return _peek ? _client.peekBuffer() : _buffer + _pos;
+    }
+
+    void consume(size_t len)
+    {
+        if(_peek) {
+            _client.peekConsume(len);
+        } else {
+            _pos += len;
+        }
+    }
+
+    bool connected()
+    {
+        return _client.connected() || _client.available() > 0 || _pos < _len;
+    }
+
+protected:
+    Client& _client;
+    bool _peek;
+    char * _buffer = nullptr;
+    size_t _pos = 0;
+    size_t _len = 0;
+};
+
+int writeHTTPBody(Client& client, Print * stream, int size, transferEncoding_t encoding, uint16_t timeout)
+{
+    BodySource source(client);
+    if(!source.begin()) {
+        DEBUG_HTTPCLIENT("[HTTP-Client][writeHTTPBody] too less ram! need %d\n", HTTP_TCP_BUFFER_SIZE);
+        return HTTPC_ERROR_TOO_LESS_RAM;
+    }
+
+    bool chunked = (encoding == HTTPC_TE_CHUNKED);
+    ChunkedDecoder decoder;
+    int left = chunked ? -1 : size;
+    int written = 0;
+    bool shortWrite = false;
+    unsigned long lastDataTime = millis();
+
+    while(chunked ? !decoder.done() : left != 0) {
+        // framing is read a byte at a time without the peek buffer
+        size_t wanted = chunked ? std::max(decoder.bodyAvailable(), (size_t) 1) : (left > 0) ? left : HTTP_TCP_BUFFER_SIZE;
+        size_t len = source.available(wanted);
+        if(len == 0) {
+            if(!source.connected()) {
+                break;
+            }
+            if((millis() - lastDataTime) > timeout) {
+                return HTTPC_ERROR_READ_TIMEOUT;
+            }
+            delay(1);
+            continue;
+        }
+        lastDataTime = millis();
+        const char * data = source.data();
+
+        if(chunked) {
+            size_t framing = decoder.skipFraming(data, len);
+            if(framing) {
+                source.consume(framing);
+                continue;
+            }
+            if(decoder.failed()) {
+                DEBUG_HTTPCLIENT("[HTTP-Client][writeHTTPBody] invalid chunk framing\n");
+                return HTTPC_ERROR_ENCODING;
+            }
+            len = std::min(len, decoder.bodyAvailable());
+        } else if(left > 0 && len > (size_t) left) {
+            len = left;
+        }
+
+        size_t bytesWrite = stream->write((const uint8_t *) data, len);
+        source.consume(bytesWrite);
+        decoder.consumeBody(bytesWrite);
+        written += bytesWrite;
+        if(left > 0) {
+            left -= bytesWrite;
+        }
+
+        if(bytesWrite != len) {
+            DEBUG_HTTPCLIENT("[HTTP-Client][writeHTTPBody] short write asked for %d but got %d\n", len, bytesWrite);
+            if(shortWrite) {
+                return HTTPC_ERROR_STREAM_WRITE;
+            }
+            // reset write error and give the stream some time for one retry
+            shortWrite = true;
+            stream->clearWriteError();
+            delay(1);
+            continue;
+        }
+        shortWrite = false;
+
+        if(stream->getWriteError()) {
+            DEBUG_HTTPCLIENT("[HTTP-Client][writeHTTPBody] stream write error %d\n", stream->getWriteError());
+            return HTTPC_ERROR_STREAM_WRITE;
+        }
+        delay(0);
+    }
+
+    DEBUG_HTTPCLIENT("[HTTP-Client][writeHTTPBody] connection closed or file end (written: %d).\n", written);
+
+    if(chunked && !decoder.done()) {
+        return HTTPC_ERROR_CONNECTION_LOST;
+    }
+    if((size > 0) && !chunked && (size != written)) {
+        DEBUG_HTTPCLIENT("[HTTP-Client][writeHTTPBody] bytesWritten %d and size %d mismatch!.\n", written, size);
+        return HTTPC_ERROR_STREAM_WRITE;
+    }
+    return written;
+}
@@ -0,0 +1,191 @@
+/**
+ * HTTPBody.h
+ *
+ * Copyright (c) 2016 Ivan Grokhotkov. All rights reserved.
+ * This file is part of the ESP8266HTTPClient for Arduino.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef HTTPBody_H_
+#define HTTPBody_H_
+
+#include "ESP8266HTTPClient.h"
+
+/**
+ * Incremental decoder for chunked transfer encoding (RFC 7230 4.1).
+ * It never copies body bytes: skipFraming() eats chunk headers, chunk
+ * ends and trailers from the front of whatever has been received, and
+ * stops where body bytes start. Up to bodyAvailable() of those can then be
+ * passed on in place and confirmed with consumeBody(). Input can be split
+ * at any byte. Chunk extensions and trailers are skipped, bare LF line
+ * ends are accepted.
+ */
+class ChunkedDecoder
+{
+public:
+    ChunkedDecoder();
+
+    void reset();
+
+    /**
+     * consumes framing from the front of data, up to body bytes or the end
+     * @return number of bytes consumed
+     */
+    size_t skipFraming(const char * data, size_t len);
+
+    /// body bytes left in the current chunk, when positioned on body bytes
+    size_t bodyAvailable() const
+    {
+        return (_state == DATA) ? _remaining : 0;
+    }
+    void consumeBody(size_t len);
+
+    /// the last chunk and the trailers have been read
+    bool done() const
+    {
+        return _state == DONE;
+    }
+    bool failed() const
+    {
+        return _state == FAILED;
+    }
+
+protected:
+    enum State {
+        SIZE_START,
+        SIZE,
+        EXTENSION,
+        SIZE_LF,
+        DATA,
+        DATA_CR,
+        DATA_LF,
+        TRAILER_START,
+        TRAILER,
+        TRAILER_LF,
+        DONE,
+        FAILED
+    };
+
+    void endSizeLine();
+
+    State _state;
+    uint32_t _remaining;
+};
+
+#ifndef HTTPCLIENT_LINE_MAX
+#define HTTPCLIENT_LINE_MAX (128)
+#endif
+
+/**
+ * Incremental parser for one response at a time, from the status line to
+ * the end of the body, for responses read back to back from a pipelined
+ * connection. feed() takes whatever has been received and consumes no
+ * more than the current response. Header lines are kept up to
+ * HTTPCLIENT_LINE_MAX characters, which is plenty for the Content-Length,
+ * Transfer-Encoding and Connection headers it looks at. Interim 1xx
+ * responses are skipped.
+ */
+class HTTPResponseParser
+{
+public:
+    HTTPResponseParser();
+
+    /**
+     * starts over on the next response
+     * @param head bool     it answers a HEAD request, so it has no body
+     */
+    void reset(bool head = false);
+
+    /**
+     * consumes response bytes from data, up to the end of the response
+     * @param body Print *  gets the decoded body, may be nullptr
+     * @return number of bytes consumed
+     */
+    size_t feed(const char * data, size_t len, Print * body);
+
+    /// the connection closed, which completes a body without a length
+    void close();
+
+    bool done() const
+    {
+        return _state == DONE;
+    }
+    bool failed() const
+    {
+        return _state == FAILED;
+    }
+    /// HTTPC_ERROR_* once failed
+    int error() const
+    {
+        return _error;
+    }
+    int code() const
+    {
+        return _code;
+    }
+    /// Content-Length, or -1
+    int size() const
+    {
+        return _size;
+    }
+    /// the connection can carry the next response
+    bool keepAlive() const
+    {
+        return _keepAlive;
+    }
+
+protected:
+    enum State {
+        STATUS,
+        HEADERS,
+        BODY,
+        CHUNKED,
+        UNTIL_CLOSE,
+        DONE,
+        FAILED
+    };
+
+    void endLine();
+    void endHeaders();
+    void fail(int error);
+
+    State _state;
+    bool _head;
+    bool _chunked;
+    bool _keepAlive;
+    int _code;
+    int _size;
+    int _error;
+    uint32_t _remaining;
+    ChunkedDecoder _chunks;
+    size_t _lineLen;
+    char _line[HTTPCLIENT_LINE_MAX];
+};
+
+/**
+ * Copies a response body from client to stream, which can be any Print,
+ * e.g. an InflatePrint in front of the Stream the caller passed. With the
+ * peek buffer API each received segment goes to stream->write() in place;
+ * other clients are read through a HTTP_TCP_BUFFER_SIZE buffer.
+ * @param size int              Content-Length, or -1 to read until the connection closes
+ * @param encoding              HTTPC_TE_CHUNKED decodes chunked framing, size is ignored then
+ * @param timeout uint16_t      ms to wait for more data
+ * @return body bytes written, or a negative HTTPC_ERROR_*
+ */
+int writeHTTPBody(Client& client, Print * stream, int size, transferEncoding_t encoding, uint16_t timeout);
+
+#endif /* HTTPBody_H_ */
@@ -1,6 +1,6 @@
 /*
   ESP8266WebServer.cpp - Dead simple web-server.
-  Supports only one simultaneous client, knows how to handle GET and POST.
+  Supports one client at a time, or several with setAsync(), knows how to handle GET and POST.
 
   Copyright (c) 2014 Ivan Grokhotkov. All rights reserved.
 
@@ -28,6 +28,7 @@
 #include "ESP8266WebServer.h"
 #include "FS.h"
 #include "detail/RequestHandlersImpl.h"
+#include "detail/Compression.h"
 
 //#define DEBUG_ESP_HTTP_SERVER
 #ifdef DEBUG_ESP_PORT
@@ -40,6 +41,7 @@ static const char AUTHORIZATION_HEADER[] PROGMEM = "Authorization";
 static const char qop_auth[] PROGMEM = "qop=auth";
 static const char WWW_Authenticate[] PROGMEM = "WWW-Authenticate";
 static const char Content_Length[] PROGMEM = "Content-Length";
+static const char Content_Encoding[] PROGMEM = "Content-Encoding";
 
 
 ESP8266WebServer::ESP8266WebServer(IPAddress addr, int port)
@@ -51,13 +53,21 @@ ESP8266WebServer::ESP8266WebServer(IPAddress addr, int port)
 , _currentHandler(nullptr)
 , _firstHandler(nullptr)
 , _lastHandler(nullptr)
-, _currentArgCount(0)
-, _currentArgs(nullptr)
+, _routesDirty(false)
+, _pathArgCount(0)
+, _arena(HTTP_ARENA_CHUNK)
+, _body(nullptr)
 , _headerKeysCount(0)
-, _currentHeaders(nullptr)
+, _headerKeys(nullptr)
 , _contentLength(0)
+, _responseHeaders(_arena)
 , _chunked(false)
+, _compression(false)
+, _contentEncoded(false)
+, _clientPrint(*this)
+, _currentConnection(nullptr)
 {
+  _parser.setHeaderFilter(_s_headerFilter, this);
 }
 
 ESP8266WebServer::ESP8266WebServer(int port)
@@ -69,19 +79,28 @@ ESP8266WebServer::ESP8266WebServer(int port)
 , _currentHandler(nullptr)
 , _firstHandler(nullptr)
 , _lastHandler(nullptr)
-, _currentArgCount(0)
-, _currentArgs(nullptr)
+, _routesDirty(false)
+, _pathArgCount(0)
+, _arena(HTTP_ARENA_CHUNK)
+, _body(nullptr)
 , _headerKeysCount(0)
-, _currentHeaders(nullptr)
+, _headerKeys(nullptr)
 , _contentLength(0)
+, _responseHeaders(_arena)
 , _chunked(false)
+, _compression(false)
+, _contentEncoded(false)
+, _clientPrint(*this)
+, _currentConnection(nullptr)
 {
+  _parser.setHeaderFilter(_s_headerFilter, this);
 }
 
 ESP8266WebServer::~ESP8266WebServer() {
   _server.close();
-  if (_currentHeaders)
-    delete[]_currentHeaders;
+  _freeRequest();
+  if (_headerKeys)
+    delete[] _headerKeys;
   RequestHandler* handler = _firstHandler;
   while (handler) {
     RequestHandler* next = handler->next();
@@ -92,11 +111,13 @@ ESP8266WebServer::~ESP8266WebServer() {
 
 void ESP8266WebServer::begin() {
   close();
+  _buildRoutes();
   _server.begin();
 }
 
 void ESP8266WebServer::begin(uint16_t port) {
   close();
+  _buildRoutes();
   _server.begin(port);
 }
 
@@ -262,13 +283,118 @@ void ESP8266WebServer::_addRequestHandler(RequestHandler* handler) {
       _lastHandler->next(handler);
       _lastHandler = handler;
     }
+    // picked up by the next request when added after begin()
+    _routesDirty = true;
+}
+
+void ESP8266WebServer::_buildRoutes() {
+  _routesDirty = false;
+  size_t entries = 0;
+  size_t segments = 0;
+  for (RequestHandler* handler = _firstHandler; handler; handler = handler->next()) {
+    HTTPMethod method = HTTP_ANY;
+    ++entries;
+    segments += RouteTable::segments(handler->route(method));
+  }
+  if (!entries || !_routes.reserve(entries, segments)) {
+    _routes.clear();
+    return;
+  }
+  for (RequestHandler* handler = _firstHandler; handler; handler = handler->next()) {
+    HTTPMethod method = HTTP_ANY;
+    const char* uri = handler->route(method);
+    if (!RouteTable::routable(uri))
+      uri = nullptr;
+    int routeMethod = (method == HTTP_ANY) ? RouteTable::ANY_METHOD : (int) method;
+    if (!_routes.add(routeMethod, uri, handler)) {
+      // dispatch falls back to probing every handler
+      _routes.clear();
+      return;
+    }
+  }
+}
+
+RequestHandler* ESP8266WebServer::_findHandler() {
+  if (_routesDirty)
+    _buildRoutes();
+  _pathArgCount = 0;
+
+  if (!_routes.size()) {
+    RequestHandler* handler;
+    for (handler = _firstHandler; handler; handler = handler->next()) {
+      if (handler->canHandle(_currentMethod, _currentUri))
+        break;
+    }
+    return handler;
+  }
+
+  const RouteTable::Entry* route = _routes.match(_currentMethod, _currentUri.c_str(), _currentUri.length(),
+                                                 _pathArgs, _pathArgCount);
+  // handlers without a fixed route still win if they were added first
+  for (size_t i = 0; i < _routes.fallbacks(); i++) {
+    const RouteTable::Entry& entry = _routes.fallback(i);
+    if (route && entry.order > route->order)
+      break;
+    RequestHandler* handler = reinterpret_cast<RequestHandler*>(entry.target);
+    if (handler->canHandle(_currentMethod, _currentUri)) {
+      _pathArgCount = 0;
+      return handler;
+    }
+  }
+  return route ? reinterpret_cast<RequestHandler*>(route->target) : nullptr;
 }
 
 void ESP8266WebServer::serveStatic(const char* uri, FS& fs, const char* path, const char* cache_header) {
     _addRequestHandler(new StaticRequestHandler(fs, path, uri, cache_header));
 }
 
+bool ESP8266WebServer::setAsync(bool async) {
+  if (!async) {
+    _connections.reset();
+  } else if (!_connections) {
+    _connections.reset(new AsyncConnectionSet(HTTP_ASYNC_MAX_CONNECTIONS, HTTP_MAX_DATA_WAIT, HTTP_MAX_SEND_WAIT));
+  }
+  return true;
+}
+
+void ESP8266WebServer::setCompression(bool compression) {
+  _compression = compression;
+}
+
+void ESP8266WebServer::_handleAsync() {
+  // the others wait with the server until a slot frees up
+  while (!_connections->full() && _server.hasClient()) {
+    WiFiClient client = _server.available();
+#ifdef DEBUG_ESP_HTTP_SERVER
+    DEBUG_OUTPUT.println("New client");
+#endif
+    _connections->add(new AsyncConnection(client), millis());
+  }
+  _connections->poll(_s_asyncRequest, this, millis());
+}
+
+void ESP8266WebServer::_s_asyncRequest(void* arg, AsyncConnection& conn) {
+  // the request is all there, so parsing it does not wait
+  ESP8266WebServer* server = reinterpret_cast<ESP8266WebServer*>(arg);
+  server->_currentClient = conn.client();
+  server->_currentConnection = &conn;
+  // a rejected request gets its answer out before the connection is
+  // dropped, others are dropped as soon as nothing is left to send
+  if (server->_parseRequest(server->_currentClient)) {
+    server->_contentLength = CONTENT_LENGTH_NOT_SET;
+    server->_handleRequest();
+  }
+  server->_currentConnection = nullptr;
+  server->_currentClient = WiFiClient();
+  server->_currentUpload.reset();
+}
+
 void ESP8266WebServer::handleClient() {
+  if (_connections) {
+    _handleAsync();
+    return;
+  }
+
   if (_currentStatus == HC_NONE) {
     WiFiClient client = _server.available();
     if (!client) {
@@ -336,6 +462,8 @@ void ESP8266WebServer::handleClient() {
 void ESP8266WebServer::close() {
   _server.close();
   _currentStatus = HC_NONE;
+  if (_connections)
+    _connections->clear();
   if(!_headerKeysCount)
     collectHeaders(0, 0);
 }
@@ -345,16 +473,19 @@ void ESP8266WebServer::stop() {
 }
 
 void ESP8266WebServer::sendHeader(const String& name, const String& value, bool first) {
-  String headerLine = name;
-  headerLine += F(": ");
-  headerLine += value;
-  headerLine += "\r\n";
-
+  if (name.equalsIgnoreCase(FPSTR(Content_Encoding)))
+    _contentEncoded = true;
   if (first) {
-    _responseHeaders = headerLine + _responseHeaders;
+    _responseHeaders.prepend("\r\n", 2);
+    _responseHeaders.prepend(value.c_str(), value.length());
+    _responseHeaders.prepend(": ", 2);
+    _responseHeaders.prepend(name.c_str(), name.length());
   }
   else {
-    _responseHeaders += headerLine;
+    _responseHeaders += name;
+    _responseHeaders += F(": ");
+    _responseHeaders += value;
+    _responseHeaders += F("\r\n");
   }
 }
 
@@ -362,37 +493,94 @@ void ESP8266WebServer::setContentLength(const size_t contentLength) {
     _contentLength = contentLength;
 }
 
-void ESP8266WebServer::_prepareHeader(String& response, int code, const char* content_type, size_t contentLength) {
-    response = String(F("HTTP/1.")) + String(_currentVersion) + ' ';
-    response += String(code);
+void ESP8266WebServer::_prepareHeader(ArenaString& response, int code, const char* content_type, size_t contentLength) {
+    // built in the request arena, as are the headers added with sendHeader()
+    response += F("HTTP/1.");
+    response.print(_currentVersion);
+    response += ' ';
+    response.print(code);
     response += ' ';
     response += _responseCodeToString(code);
-    response += "\r\n";
+    response += F("\r\n");
 
     using namespace mime;
     if (!content_type)
         content_type = mimeTable[html].mimeType;
 
-    sendHeader(String(F("Content-Type")), String(FPSTR(content_type)), true);
-    if (_contentLength == CONTENT_LENGTH_NOT_SET) {
-        sendHeader(String(FPSTR(Content_Length)), String(contentLength));
+    response += F("Content-Type: ");
+    response += FPSTR(content_type);
+    response += F("\r\n");
+    response += _responseHeaders;
+    _deflate.reset();
+    bool negotiated = _negotiatesEncoding(content_type);
+    if (negotiated && _startCompression(code, contentLength)) {
+        // the compressed length is not known up front
+        response += FPSTR(Content_Encoding);
+        response += F(": ");
+        response += (_deflate->format() == DEFLATE_GZIP) ? F("gzip") : F("deflate");
+        response += F("\r\n");
+    } else if (_contentLength == CONTENT_LENGTH_NOT_SET) {
+        response += FPSTR(Content_Length);
+        response += F(": ");
+        response.print(contentLength);
+        response += F("\r\n");
     } else if (_contentLength != CONTENT_LENGTH_UNKNOWN) {
-        sendHeader(String(FPSTR(Content_Length)), String(_contentLength));
+        response += FPSTR(Content_Length);
+        response += F(": ");
+        response.print(_contentLength);
+        response += F("\r\n");
     } else if(_contentLength == CONTENT_LENGTH_UNKNOWN && _currentVersion){ //HTTP/1.1 or above client
       //let's do chunked
       _chunked = true;
-      sendHeader(String(F("Accept-Ranges")),String(F("none")));
-      sendHeader(String(F("Transfer-Encoding")),String(F("chunked")));
+      response += F("Accept-Ranges: none\r\n");
+      response += F("Transfer-Encoding: chunked\r\n");
     }
-    sendHeader(String(F("Connection")), String(F("close")));
+    if (negotiated) {
+        // compressed or not, a cache has to tell the clients apart
+        response += F("Vary: Accept-Encoding\r\n");
+    }
+    response += F("Connection: close\r\n");
+    response += F("\r\n");
+    _responseHeaders.clear();
+    _contentEncoded = false;
+}
+
+bool ESP8266WebServer::_negotiatesEncoding(const char* content_type) {
+  if (!_compression || _contentEncoded)
+    return false;
+  char type[64];
+  strncpy_P(type, content_type, sizeof(type) - 1);
+  type[sizeof(type) - 1] = 0;
+  return compression::isCompressible(type);
+}
+
+bool ESP8266WebServer::_startCompression(int code, size_t contentLength) {
+  if (code < 200 || code == 204 || code == 304)
+    return false;
+  if (_contentLength == CONTENT_LENGTH_NOT_SET) {
+    if (contentLength < HTTP_DEFLATE_MIN_SIZE)
+      return false;
+  } else if (_contentLength != CONTENT_LENGTH_UNKNOWN) {
+    return false;
+  }
 
-    response += _responseHeaders;
-    response += "\r\n";
-    _responseHeaders = "";
+  const char* coding = compression::chooseCoding(_parser.header("Accept-Encoding"));
+  if (!coding)
+    return false;
+
+  deflate_format_t format = (strcmp(coding, "gzip") == 0) ? DEFLATE_GZIP : DEFLATE_ZLIB;
+  _deflate.reset(new DeflatePrint(_clientPrint, format, HTTP_DEFLATE_WINDOW_BITS));
+  if (!_deflate->ok()) {
+    // not enough heap, send it as it is
+    _deflate.reset();
+    return false;
+  }
+  _chunked = false;
+  return true;
 }
 
 void ESP8266WebServer::send(int code, const char* content_type, const String& content) {
-    String header;
+    ArenaString header(_arena);
     // Can we asume the following?
     //if(code == 200 && content.length() == 0 && _contentLength == CONTENT_LENGTH_NOT_SET)
     //  _contentLength = CONTENT_LENGTH_UNKNOWN;
@@ -409,7 +597,7 @@ void ESP8266WebServer::send_P(int code, PGM_P content_type, PGM_P content) {
         contentLength = strlen_P(content);
     }
 
-    String header;
+    ArenaString header(_arena);
     char type[64];
     memccpy_P((void*)type, (PGM_VOID_P)content_type, 0, sizeof(type));
     _prepareHeader(header, code, (const char* )type, contentLength);
@@ -418,11 +606,11 @@ void ESP8266WebServer::send_P(int code, PGM_P content_type, PGM_P content) {
 }
 
 void ESP8266WebServer::send_P(int code, PGM_P content_type, PGM_P content, size_t contentLength) {
-    String header;
+    ArenaString header(_arena);
     char type[64];
     memccpy_P((void*)type, (PGM_VOID_P)content_type, 0, sizeof(type));
     _prepareHeader(header, code, (const char* )type, contentLength);
-    sendContent(header);
+    _currentClientWrite(header.c_str(), header.length());
     sendContent_P(content, contentLength);
 }
 
@@ -434,20 +622,47 @@ void ESP8266WebServer::send(int code, const String& content_type, const String&
   send(code, (const char*)content_type.c_str(), content);
 }
 
+size_t ESP8266WebServer::_currentClientWrite(const char* b, size_t l) {
+  if (_currentConnection)
+    return _currentConnection->write(b, l);
+  return _currentClient.write(b, l);
+}
+
+size_t ESP8266WebServer::_currentClientWrite_P(PGM_P b, size_t l) {
+  if (!_currentConnection)
+    return _currentClient.write_P(b, l);
+  char chunk[128];
+  size_t written = 0;
+  while (written < l) {
+    size_t len = std::min(sizeof(chunk), l - written);
+    memcpy_P(chunk, b + written, len);
+    size_t sent = _currentConnection->write(chunk, len);
+    written += sent;
+    if (sent < len)
+      break;
+  }
+  return written;
+}
+
+void ESP8266WebServer::_sendChunkHeader(size_t size) {
+  char chunkSize[11];
+  snprintf(chunkSize, sizeof(chunkSize), "%x\r\n", (unsigned) size);
+  _currentClientWrite(chunkSize, strlen(chunkSize));
+}
+
 void ESP8266WebServer::sendContent(const String& content) {
   const char * footer = "\r\n";
   size_t len = content.length();
+  if (_deflate) {
+    _deflate->write((const uint8_t*) content.c_str(), len);
+    return;
+  }
   if(_chunked) {
-    char * chunkSize = (char *)malloc(11);
-    if(chunkSize){
-      sprintf(chunkSize, "%x%s", len, footer);
-      _currentClientWrite(chunkSize, strlen(chunkSize));
-      free(chunkSize);
-    }
+    _sendChunkHeader(len);
   }
   _currentClientWrite(content.c_str(), len);
   if(_chunked){
-    _currentClient.write(footer, 2);
+    _currentClientWrite(footer, 2);
     if (len == 0) {
       _chunked = false;
     }
@@ -460,17 +675,21 @@ void ESP8266WebServer::sendContent_P(PGM_P content) {
 
 void ESP8266WebServer::sendContent_P(PGM_P content, size_t size) {
   const char * footer = "\r\n";
-  if(_chunked) {
-    char * chunkSize = (char *)malloc(11);
-    if(chunkSize){
-      sprintf(chunkSize, "%x%s", size, footer);
-      _currentClientWrite(chunkSize, strlen(chunkSize));
-      free(chunkSize);
+  if (_deflate) {
+    char chunk[128];
+    for (size_t pos = 0; pos < size; pos += sizeof(chunk)) {
+      size_t len = std::min(sizeof(chunk), size - pos);
+      memcpy_P(chunk, content + pos, len);
+      _deflate->write((const uint8_t*) chunk, len);
     }
+    return;
+  }
+  if(_chunked) {
+    _sendChunkHeader(size);
   }
   _currentClientWrite_P(content, size);
   if(_chunked){
-    _currentClient.write(footer, 2);
+    _currentClientWrite(footer, 2);
     if (size == 0) {
       _chunked = false;
     }
@@ -491,67 +710,65 @@ void ESP8266WebServer::_streamFileCore(const size_t fileSize, const String & fil
 }
 
 
+String ESP8266WebServer::pathArg(unsigned int i) {
+  if (i >= _pathArgCount)
+    return String();
+  return _currentUri.substring(_pathArgs[i].offset, _pathArgs[i].offset + _pathArgs[i].len);
+}
+
+int ESP8266WebServer::pathArgs() {
+  return _pathArgCount;
+}
+
 String ESP8266WebServer::arg(String name) {
-  for (int i = 0; i < _currentArgCount; ++i) {
-    if ( _currentArgs[i].key == name )
-      return _currentArgs[i].value;
-  }
-  return "";
+  return String(_parser.arg(name.c_str()));
 }
 
 String ESP8266WebServer::arg(int i) {
-  if (i < _currentArgCount)
-    return _currentArgs[i].value;
-  return "";
+  return String(_parser.argValue(i));
 }
 
 String ESP8266WebServer::argName(int i) {
-  if (i < _currentArgCount)
-    return _currentArgs[i].key;
-  return "";
+  return String(_parser.argName(i));
 }
 
 int ESP8266WebServer::args() {
-  return _currentArgCount;
+  return _parser.args();
 }
 
 bool ESP8266WebServer::hasArg(String  name) {
-  for (int i = 0; i < _currentArgCount; ++i) {
-    if (_currentArgs[i].key == name)
-      return true;
-  }
-  return false;
+  return _parser.arg(name.c_str()) != nullptr;
 }
 
 
 String ESP8266WebServer::header(String name) {
   for (int i = 0; i < _headerKeysCount; ++i) {
-    if (_currentHeaders[i].key.equalsIgnoreCase(name))
-      return _currentHeaders[i].value;
+    if (_headerKeys[i].equalsIgnoreCase(name))
+      return String(_parser.header(_headerKeys[i].c_str()));
   }
   return "";
 }
 
 void ESP8266WebServer::collectHeaders(const char* headerKeys[], const size_t headerKeysCount) {
   _headerKeysCount = headerKeysCount + 1;
-  if (_currentHeaders)
-     delete[]_currentHeaders;
-  _currentHeaders = new RequestArgument[_headerKeysCount];
-  _currentHeaders[0].key = FPSTR(AUTHORIZATION_HEADER);
+  if (_headerKeys)
+     delete[] _headerKeys;
+  _headerKeys = new String[_headerKeysCount];
+  _headerKeys[0] = FPSTR(AUTHORIZATION_HEADER);
   for (int i = 1; i < _headerKeysCount; i++){
-    _currentHeaders[i].key = headerKeys[i-1];
+    _headerKeys[i] = headerKeys[i-1];
   }
 }
 
 String ESP8266WebServer::header(int i) {
   if (i < _headerKeysCount)
-    return _currentHeaders[i].value;
+    return String(_parser.header(_headerKeys[i].c_str()));
   return "";
 }
 
 String ESP8266WebServer::headerName(int i) {
   if (i < _headerKeysCount)
-    return _currentHeaders[i].key;
+    return _headerKeys[i];
   return "";
 }
 
@@ -561,14 +778,16 @@ int ESP8266WebServer::headers() {
 
 bool ESP8266WebServer::hasHeader(String name) {
   for (int i = 0; i < _headerKeysCount; ++i) {
-    if ((_currentHeaders[i].key.equalsIgnoreCase(name)) &&  (_currentHeaders[i].value.length() > 0))
-      return true;
+    if (_headerKeys[i].equalsIgnoreCase(name)) {
+      const char* value = _parser.header(_headerKeys[i].c_str());
+      return value && *value;
+    }
   }
   return false;
 }
 
 String ESP8266WebServer::hostHeader() {
-  return _hostHeader;
+  return String(_parser.header("Host"));
 }
 
 void ESP8266WebServer::onFileUpload(THandlerFunction fn) {
@@ -607,16 +826,21 @@ void ESP8266WebServer::_handleRequest() {
     _finalizeResponse();
   }
   _currentUri = "";
+  _freeRequest();
 }
 
 
 void ESP8266WebServer::_finalizeResponse() {
+  if (_deflate) {
+    _deflate->finish();
+    _deflate.reset();
+  }
   if (_chunked) {
     sendContent("");
   }
 }
 
-String ESP8266WebServer::_responseCodeToString(int code) {
+const __FlashStringHelper* ESP8266WebServer::_responseCodeToString(int code) {
   switch (code) {
     case 100: return F("Continue");
     case 101: return F("Switching Protocols");
@@ -652,6 +876,7 @@ String ESP8266WebServer::_responseCodeToString(int code) {
     case 415: return F("Unsupported Media Type");
     case 416: return F("Requested range not satisfiable");
     case 417: return F("Expectation Failed");
+    case 431: return F("Request Header Fields Too Large");
     case 500: return F("Internal Server Error");
     case 501: return F("Not Implemented");
     case 502: return F("Bad Gateway");
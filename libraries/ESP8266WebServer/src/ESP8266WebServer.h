@@ -1,6 +1,6 @@
 /*
   ESP8266WebServer.h - Dead simple web-server.
-  Supports only one simultaneous client, knows how to handle GET and POST.
+  Supports one client at a time, or several with setAsync(), knows how to handle GET and POST.
 
   Copyright (c) 2014 Ivan Grokhotkov. All rights reserved.
 
@@ -27,6 +27,8 @@
 #include <functional>
 #include <memory>
 #include <ESP8266WiFi.h>
+#include <Arena.h>
+#include <Deflate.h>
 
 enum HTTPMethod { HTTP_ANY, HTTP_GET, HTTP_POST, HTTP_PUT, HTTP_PATCH, HTTP_DELETE, HTTP_OPTIONS };
 enum HTTPUploadStatus { UPLOAD_FILE_START, UPLOAD_FILE_WRITE, UPLOAD_FILE_END,
@@ -40,11 +42,31 @@ enum HTTPAuthMethod { BASIC_AUTH, DIGEST_AUTH };
 #define HTTP_UPLOAD_BUFLEN 2048
 #endif
 
+#ifndef HTTP_ARENA_CHUNK
+#define HTTP_ARENA_CHUNK 512 // heap taken per request for its headers and body
+#endif
+
+#ifndef HTTP_MAX_BODY_SIZE
+#define HTTP_MAX_BODY_SIZE 16384 // longest request body read into RAM, longer ones get 413 (uploads are streamed)
+#endif
+
 #define HTTP_MAX_DATA_WAIT 5000 //ms to wait for the client to send the request
 #define HTTP_MAX_POST_WAIT 5000 //ms to wait for POST data to arrive
 #define HTTP_MAX_SEND_WAIT 5000 //ms to wait for data chunk to be ACKed
 #define HTTP_MAX_CLOSE_WAIT 2000 //ms to wait for the client to close the connection
 
+#ifndef HTTP_ASYNC_MAX_CONNECTIONS
+#define HTTP_ASYNC_MAX_CONNECTIONS 4 // clients served at a time with setAsync(true)
+#endif
+
+#ifndef HTTP_DEFLATE_WINDOW_BITS
+#define HTTP_DEFLATE_WINDOW_BITS DEFLATE_WINDOW_BITS // heap per compressed response is about 5 << bits
+#endif
+
+#ifndef HTTP_DEFLATE_MIN_SIZE
+#define HTTP_DEFLATE_MIN_SIZE 256 // responses of known length below this are sent as they are
+#endif
+
 #define CONTENT_LENGTH_UNKNOWN ((size_t) -1)
 #define CONTENT_LENGTH_NOT_SET ((size_t) -2)
 
@@ -61,6 +83,9 @@ typedef struct {
 } HTTPUpload;
 
 #include "detail/RequestHandler.h"
+#include "detail/RequestParser.h"
+#include "detail/RouteTable.h"
+#include "detail/AsyncConnection.h"
 
 namespace fs {
 class FS;
@@ -80,6 +105,26 @@ public:
   virtual void close();
   void stop();
 
+  // Serves up to HTTP_ASYNC_MAX_CONNECTIONS clients side by side: a request
+  // is handled once it has arrived, and responses are sent as the client
+  // takes them, so no client has to wait for a slow one. Handlers respond
+  // with send(), sendContent() and streamFile() as usual. Plain HTTP only,
+  // returns false for ESP8266WebServerSecure.
+  // Request bodies, uploads included, longer than HTTP_ASYNC_BODY_BUFLEN are
+  // refused with 413, they would hold up the other clients. What send() and
+  // sendContent() write is queued on the heap until the client takes it, up
+  // to HTTP_ASYNC_TX_MAX per response, and cut short beyond that; send more
+  // with streamFile(), which reads the file as the client goes.
+  virtual bool setAsync(bool async);
+
+  // Compresses what send() and sendContent() respond with, for clients that
+  // accept gzip or deflate, when the content type is text, JSON, JavaScript
+  // or XML. The compressed response has no Content-Length and ends with the
+  // connection. Responses with setContentLength() or a Content-Encoding
+  // header, and streamFile(), go out as they are. Every response of those
+  // types gets Vary: Accept-Encoding, compressed or not, for caches.
+  void setCompression(bool compression);
+
   bool authenticate(const char * username, const char * password);
   void requestAuthentication(HTTPAuthMethod mode = BASIC_AUTH, const char* realm = NULL, const String& authFailMsg = String("") );
 
@@ -97,6 +142,8 @@ public:
   virtual WiFiClient client() { return _currentClient; }
   HTTPUpload& upload() { return *_currentUpload; }
 
+  String pathArg(unsigned int i); // get request path parameter by number, for "{}" segments in on() uris
+  int pathArgs();                 // get path parameter count
   String arg(String name);        // get request argument value by name
   String arg(int i);              // get request argument value by number
   String argName(int i);          // get request argument name by number
@@ -132,36 +179,53 @@ public:
   template<typename T> 
   size_t streamFile(T &file, const String& contentType) {
     _streamFileCore(file.size(), file.name(), contentType);
+    if (_currentConnection)
+      return _currentConnection->stream(file, file.size());
     return _currentClient.write(file);
   }
   
 protected:
-  virtual size_t _currentClientWrite(const char* b, size_t l) { return _currentClient.write( b, l ); }
-  virtual size_t _currentClientWrite_P(PGM_P b, size_t l) { return _currentClient.write_P( b, l ); }
+  // reads If-None-Match straight from _parser, it is not in _headerKeys
+  friend class StaticRequestHandler;
+
+  virtual size_t _currentClientWrite(const char* b, size_t l);
+  virtual size_t _currentClientWrite_P(PGM_P b, size_t l);
+  void _handleAsync();
+  static void _s_asyncRequest(void* arg, AsyncConnection& conn);
   void _addRequestHandler(RequestHandler* handler);
+  void _buildRoutes();
+  RequestHandler* _findHandler();
   void _handleRequest();
   void _finalizeResponse();
   bool _parseRequest(WiFiClient& client);
-  void _parseArguments(String data);
-  static String _responseCodeToString(int code);
-  bool _parseForm(WiFiClient& client, String boundary, uint32_t len);
+  void _rejectRequest(int code);
+  static bool _s_headerFilter(void* arg, const char* name);
+  void _freeRequest();
+  static const __FlashStringHelper* _responseCodeToString(int code);
+  class FormListener;
+  bool _parseForm(WiFiClient& client, const String& boundary, uint32_t len);
   bool _parseFormUploadAborted();
-  void _uploadWriteByte(uint8_t b);
-  uint8_t _uploadReadByte(WiFiClient& client);
-  void _prepareHeader(String& response, int code, const char* content_type, size_t contentLength);
-  bool _collectHeader(const char* headerName, const char* headerValue);
- 
+  void _prepareHeader(ArenaString& response, int code, const char* content_type, size_t contentLength);
+  void _sendChunkHeader(size_t size);
+
   void _streamFileCore(const size_t fileSize, const String & fileName, const String & contentType);
+  bool _negotiatesEncoding(const char* content_type);
+  bool _startCompression(int code, size_t contentLength);
+
+  // passes compressed response data on to _currentClientWrite()
+  class ClientPrint : public Print {
+  public:
+    ClientPrint(ESP8266WebServer& server) : _server(server) {}
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* b, size_t l) override { return _server._currentClientWrite((const char*) b, l); }
+  protected:
+    ESP8266WebServer& _server;
+  };
 
   String _getRandomHexString();
   // for extracting Auth parameters
   String _extractParam(String& authReq,const String& param,const char delimit = '"');
 
-  struct RequestArgument {
-    String key;
-    String value;
-  };
-
   WiFiServer  _server;
 
   WiFiClient  _currentClient;
@@ -177,17 +241,29 @@ protected:
   THandlerFunction _notFoundHandler;
   THandlerFunction _fileUploadHandler;
 
-  int              _currentArgCount;
-  RequestArgument* _currentArgs;
+  RouteTable       _routes;
+  bool             _routesDirty;
+  uint8_t          _pathArgCount;
+  RouteTable::Capture _pathArgs[ROUTE_MAX_PARAMS];
+
+  RequestParser    _parser;
+  Arena            _arena; // freed in one go when the request is done
+  char*            _body;  // request body, when it did not fit in _parser, in _arena
   std::unique_ptr<HTTPUpload> _currentUpload;
 
   int              _headerKeysCount;
-  RequestArgument* _currentHeaders;
+  String*          _headerKeys;
   size_t           _contentLength;
-  String           _responseHeaders;
+  ArenaString      _responseHeaders;
 
-  String           _hostHeader;
   bool             _chunked;
+  bool             _compression;
+  bool             _contentEncoded; // the handler set Content-Encoding
+  ClientPrint      _clientPrint;
+  std::unique_ptr<DeflatePrint> _deflate; // for the response being sent
+
+  std::unique_ptr<AsyncConnectionSet> _connections; // set in async mode
+  AsyncConnection* _currentConnection;              // the one being handled
 
   String           _snonce;  // Store noance and opaque for future comparison
   String           _sopaque;
@@ -69,6 +69,7 @@ ESP8266WebServerSecure::~ESP8266WebServerSecure() {
 
 void ESP8266WebServerSecure::begin() {
   _currentStatus = HC_NONE;
+  _buildRoutes();
   _serverSecure.begin();
   if(!_headerKeysCount)
     collectHeaders(0, 0);
@@ -41,6 +41,8 @@ public:
   void begin() override;
   void handleClient() override;
   void close() override;
+  // clients are served one at a time, handleClient() has no async mode
+  bool setAsync(bool async) override { return !async; }
 
   template<typename T>
   size_t streamFile(T &file, const String& contentType) {
@@ -24,6 +24,7 @@
 #include "WiFiClient.h"
 #include "ESP8266WebServer.h"
 #include "detail/mimetable.h"
+#include "detail/MultipartParser.h"
 
 //#define DEBUG_ESP_HTTP_SERVER
 #ifdef DEBUG_ESP_PORT
@@ -35,82 +36,100 @@
 static const char Content_Type[] PROGMEM = "Content-Type";
 static const char filename[] PROGMEM = "filename";
 
-static char* readBytesWithTimeout(WiFiClient& client, size_t maxLength, size_t& dataLength, int timeout_ms)
+static const char Content_Length[] PROGMEM = "Content-Length";
+static const char Host[] PROGMEM = "Host";
+static const char Accept_Encoding[] PROGMEM = "Accept-Encoding";
+static const char If_None_Match[] PROGMEM = "If-None-Match";
+// lookups in the request parser need strings in RAM
+static const char* const Content_Type_RAM = "Content-Type";
+static const char* const Content_Length_RAM = "Content-Length";
+
+static bool readBytesWithTimeout(WiFiClient& client, char* buf, size_t length, int timeout_ms)
 {
-  char *buf = nullptr;
-  dataLength = 0;
-  while (dataLength < maxLength) {
+  size_t dataLength = 0;
+  while (dataLength < length) {
     int tries = timeout_ms;
-    size_t newLength;
-    while (!(newLength = client.available()) && tries--) delay(1);
-    if (!newLength) {
-      break;
-    }
-    if (!buf) {
-      buf = (char *) malloc(newLength + 1);
-      if (!buf) {
-        return nullptr;
-      }
+    while (!client.available() && tries--) delay(1);
+    int newLength = client.read((uint8_t*) buf + dataLength, length - dataLength);
+    if (newLength <= 0) {
+      return false;
     }
-    else {
-      char* newBuf = (char *) realloc(buf, dataLength + newLength + 1);
-      if (!newBuf) {
-        free(buf);
-        return nullptr;
-      }
-      buf = newBuf;
-    }
-    client.readBytes(buf + dataLength, newLength);
     dataLength += newLength;
-    buf[dataLength] = '\0';
   }
-  return buf;
+  buf[dataLength] = '\0';
+  return true;
+}
+
+bool ESP8266WebServer::_s_headerFilter(void* arg, const char* name) {
+  ESP8266WebServer* server = reinterpret_cast<ESP8266WebServer*>(arg);
+  if (strcasecmp_P(name, Content_Type) == 0 ||
+      strcasecmp_P(name, Content_Length) == 0 ||
+      strcasecmp_P(name, Host) == 0 ||
+      strcasecmp_P(name, If_None_Match) == 0) {
+    return true;
+  }
+  if (server->_compression && strcasecmp_P(name, Accept_Encoding) == 0)
+    return true;
+  for (int i = 0; i < server->_headerKeysCount; i++) {
+    if (server->_headerKeys[i].equalsIgnoreCase(name))
+      return true;
+  }
+  return false;
+}
+
+void ESP8266WebServer::_freeRequest() {
+  _body = nullptr;
+  _deflate.reset();
+  _responseHeaders.clear();
+  _arena.reset();
 }
 
 bool ESP8266WebServer::_parseRequest(WiFiClient& client) {
-  // Read the first line of HTTP request
-  String req = client.readStringUntil('\r');
-  client.readStringUntil('\n');
-  //reset header value
-  for (int i = 0; i < _headerKeysCount; ++i) {
-    _currentHeaders[i].value =String();
-   }
-
-  // First line of HTTP request looks like "GET /path HTTP/1.1"
-  // Retrieve the "/path" part by finding the spaces
-  int addr_start = req.indexOf(' ');
-  int addr_end = req.indexOf(' ', addr_start + 1);
-  if (addr_start == -1 || addr_end == -1) {
+  // Feed the request line and headers to the parser straight from the
+  // receive buffer, it stops at the start of the body
+  _parser.reset();
+  _freeRequest();
+  unsigned long start = millis();
+  while (!_parser.done()) {
+    size_t avail = client.peekAvailable();
+    if (avail) {
+      client.peekConsume(_parser.feed(client.peekBuffer(), avail));
+      if (_parser.failed()) {
 #ifdef DEBUG_ESP_HTTP_SERVER
-    DEBUG_OUTPUT.print("Invalid request: ");
-    DEBUG_OUTPUT.println(req);
+        DEBUG_OUTPUT.println("Invalid request");
 #endif
-    return false;
+        _currentVersion = _parser.version();
+        switch (_parser.error()) {
+          case RequestParser::ERROR_URI_TOO_LONG: _rejectRequest(414); break;
+          case RequestParser::ERROR_HEADERS_TOO_LARGE: _rejectRequest(431); break;
+          default: _rejectRequest(400); break;
+        }
+        return false;
+      }
+      start = millis();
+    } else if (!client.connected() || millis() - start > HTTP_MAX_DATA_WAIT) {
+      return false;
+    } else {
+      delay(1);
+    }
   }
 
-  String methodStr = req.substring(0, addr_start);
-  String url = req.substring(addr_start + 1, addr_end);
-  String versionEnd = req.substring(addr_end + 8);
-  _currentVersion = atoi(versionEnd.c_str());
-  String searchStr = "";
-  int hasSearch = url.indexOf('?');
-  if (hasSearch != -1){
-    searchStr = url.substring(hasSearch + 1);
-    url = url.substring(0, hasSearch);
-  }
-  _currentUri = url;
+  const char* methodStr = _parser.method();
+  _currentVersion = _parser.version();
+  _currentUri = _parser.uri();
   _chunked = false;
+  _contentEncoded = false;
 
   HTTPMethod method = HTTP_GET;
-  if (methodStr == F("POST")) {
+  if (strcmp_P(methodStr, PSTR("POST")) == 0) {
     method = HTTP_POST;
-  } else if (methodStr == F("DELETE")) {
+  } else if (strcmp_P(methodStr, PSTR("DELETE")) == 0) {
     method = HTTP_DELETE;
-  } else if (methodStr == F("OPTIONS")) {
+  } else if (strcmp_P(methodStr, PSTR("OPTIONS")) == 0) {
     method = HTTP_OPTIONS;
-  } else if (methodStr == F("PUT")) {
+  } else if (strcmp_P(methodStr, PSTR("PUT")) == 0) {
     method = HTTP_PUT;
-  } else if (methodStr == F("PATCH")) {
+  } else if (strcmp_P(methodStr, PSTR("PATCH")) == 0) {
     method = HTTP_PATCH;
   }
   _currentMethod = method;
@@ -119,462 +138,338 @@ bool ESP8266WebServer::_parseRequest(WiFiClient& client) {
   DEBUG_OUTPUT.print("method: ");
   DEBUG_OUTPUT.print(methodStr);
   DEBUG_OUTPUT.print(" url: ");
-  DEBUG_OUTPUT.print(url);
+  DEBUG_OUTPUT.print(_parser.uri());
   DEBUG_OUTPUT.print(" search: ");
-  DEBUG_OUTPUT.println(searchStr);
+  DEBUG_OUTPUT.println(_parser.query());
+  for (int i = 0; i < _parser.headers(); i++) {
+    DEBUG_OUTPUT.print("headerName: ");
+    DEBUG_OUTPUT.println(_parser.headerName(i));
+    DEBUG_OUTPUT.print("headerValue: ");
+    DEBUG_OUTPUT.println(_parser.headerValue(i));
+  }
 #endif
 
   //attach handler
-  RequestHandler* handler;
-  for (handler = _firstHandler; handler; handler = handler->next()) {
-    if (handler->canHandle(_currentMethod, _currentUri))
-      break;
-  }
-  _currentHandler = handler;
+  _currentHandler = _findHandler();
+
+  _parser.parseQuery();
 
-  String formData;
   // below is needed only when POST type request
   if (method == HTTP_POST || method == HTTP_PUT || method == HTTP_PATCH || method == HTTP_DELETE){
     String boundaryStr;
-    String headerName;
-    String headerValue;
     bool isForm = false;
     bool isEncoded = false;
     uint32_t contentLength = 0;
-    //parse headers
-    while(1){
-      req = client.readStringUntil('\r');
-      client.readStringUntil('\n');
-      if (req == "") break;//no moar headers
-      int headerDiv = req.indexOf(':');
-      if (headerDiv == -1){
-        break;
-      }
-      headerName = req.substring(0, headerDiv);
-      headerValue = req.substring(headerDiv + 1);
-      headerValue.trim();
-       _collectHeader(headerName.c_str(),headerValue.c_str());
-
-      #ifdef DEBUG_ESP_HTTP_SERVER
-      DEBUG_OUTPUT.print("headerName: ");
-      DEBUG_OUTPUT.println(headerName);
-      DEBUG_OUTPUT.print("headerValue: ");
-      DEBUG_OUTPUT.println(headerValue);
-      #endif
-
-      if (headerName.equalsIgnoreCase(FPSTR(Content_Type))){
-        using namespace mime;
-        if (headerValue.startsWith(FPSTR(mimeTable[txt].mimeType))){
-          isForm = false;
-        } else if (headerValue.startsWith(F("application/x-www-form-urlencoded"))){
-          isForm = false;
-          isEncoded = true;
-        } else if (headerValue.startsWith(F("multipart/"))){
-          boundaryStr = headerValue.substring(headerValue.indexOf('=') + 1);
-          boundaryStr.replace("\"","");
-          isForm = true;
-        }
-      } else if (headerName.equalsIgnoreCase(F("Content-Length"))){
-        contentLength = headerValue.toInt();
-      } else if (headerName.equalsIgnoreCase(F("Host"))){
-        _hostHeader = headerValue;
+
+    const char* contentType = _parser.header(Content_Type_RAM);
+    if (contentType) {
+      using namespace mime;
+      if (strncmp_P(contentType, mimeTable[txt].mimeType, strlen_P(mimeTable[txt].mimeType)) == 0){
+        isForm = false;
+      } else if (strncmp_P(contentType, PSTR("application/x-www-form-urlencoded"), 33) == 0){
+        isForm = false;
+        isEncoded = true;
+      } else if (strncmp_P(contentType, PSTR("multipart/"), 10) == 0){
+        const char* boundary = strchr(contentType, '=');
+        boundaryStr = boundary ? boundary + 1 : "";
+        boundaryStr.replace("\"","");
+        isForm = true;
       }
     }
+    const char* contentLengthStr = _parser.header(Content_Length_RAM);
+    if (contentLengthStr && !RequestParser::parseContentLength(contentLengthStr, contentLength)) {
+      _rejectRequest(400);
+      return false;
+    }
+    // in async mode only HTTP_ASYNC_BODY_BUFLEN of the body is there, waiting
+    // for more would hold up the other clients
+    if (_currentConnection && contentLength > HTTP_ASYNC_BODY_BUFLEN) {
+      _rejectRequest(413);
+      return false;
+    }
+    if (_currentConnection && isForm && !contentLength) {
+      // without a length the end of the form is not known in advance
+      _rejectRequest(411);
+      return false;
+    }
 
     if (!isForm){
-      size_t plainLength;
-      char* plainBuf = readBytesWithTimeout(client, contentLength, plainLength, HTTP_MAX_POST_WAIT);
-      if (plainLength < contentLength) {
-      	free(plainBuf);
-      	return false;
+      if (contentLength > HTTP_MAX_BODY_SIZE) {
+        _rejectRequest(413);
+        return false;
       }
       if (contentLength > 0) {
+        // small bodies live in the parser buffer, larger ones get their own
+        char* plainBuf = _parser.reserve(contentLength + 1);
+        if (!plainBuf) {
+          plainBuf = _body = (char*) _arena.alloc(contentLength + 1, 1);
+          if (!plainBuf) {
+            return false;
+          }
+        }
+        if (!readBytesWithTimeout(client, plainBuf, contentLength, HTTP_MAX_POST_WAIT)) {
+          return false;
+        }
         if(isEncoded){
           //url encoded form
-          if (searchStr != "") searchStr += '&';
-          searchStr += plainBuf;
-        }
-        _parseArguments(searchStr);
-        if(!isEncoded){
+          _parser.parseArguments(plainBuf, contentLength);
+        } else {
           //plain post json or other data
-          RequestArgument& arg = _currentArgs[_currentArgCount++];
-          arg.key = F("plain");
-          arg.value = String(plainBuf);
+          _parser.addArgumentRef("plain", plainBuf);
         }
 
   #ifdef DEBUG_ESP_HTTP_SERVER
         DEBUG_OUTPUT.print("Plain: ");
-        DEBUG_OUTPUT.println(plainBuf);
+        DEBUG_OUTPUT.println(isEncoded ? "(form)" : plainBuf);
   #endif
-        free(plainBuf);
-      } else {
-        // No content - but we can still have arguments in the URL.
-        _parseArguments(searchStr);
       }
     }
 
     if (isForm){
-      _parseArguments(searchStr);
       if (!_parseForm(client, boundaryStr, contentLength)) {
         return false;
       }
     }
-  } else {
-    String headerName;
-    String headerValue;
-    //parse headers
-    while(1){
-      req = client.readStringUntil('\r');
-      client.readStringUntil('\n');
-      if (req == "") break;//no moar headers
-      int headerDiv = req.indexOf(':');
-      if (headerDiv == -1){
-        break;
-      }
-      headerName = req.substring(0, headerDiv);
-      headerValue = req.substring(headerDiv + 2);
-      _collectHeader(headerName.c_str(),headerValue.c_str());
-
-	  #ifdef DEBUG_ESP_HTTP_SERVER
-	  DEBUG_OUTPUT.print("headerName: ");
-	  DEBUG_OUTPUT.println(headerName);
-	  DEBUG_OUTPUT.print("headerValue: ");
-	  DEBUG_OUTPUT.println(headerValue);
-	  #endif
-
-	  if (headerName.equalsIgnoreCase("Host")){
-        _hostHeader = headerValue;
-      }
-    }
-    _parseArguments(searchStr);
   }
   client.flush();
 
 #ifdef DEBUG_ESP_HTTP_SERVER
   DEBUG_OUTPUT.print("Request: ");
-  DEBUG_OUTPUT.println(url);
+  DEBUG_OUTPUT.println(_currentUri);
   DEBUG_OUTPUT.print(" Arguments: ");
-  DEBUG_OUTPUT.println(searchStr);
+  DEBUG_OUTPUT.println(_parser.args());
 #endif
 
   return true;
 }
 
-bool ESP8266WebServer::_collectHeader(const char* headerName, const char* headerValue) {
-  for (int i = 0; i < _headerKeysCount; i++) {
-    if (_currentHeaders[i].key.equalsIgnoreCase(headerName)) {
-            _currentHeaders[i].value=headerValue;
-            return true;
-        }
-  }
-  return false;
-}
-
-void ESP8266WebServer::_parseArguments(String data) {
+// Answers a request that is not handled, without reading its body. The
+// connection is not kept either way.
+void ESP8266WebServer::_rejectRequest(int code) {
 #ifdef DEBUG_ESP_HTTP_SERVER
-  DEBUG_OUTPUT.print("args: ");
-  DEBUG_OUTPUT.println(data);
+  DEBUG_OUTPUT.print("Rejected: ");
+  DEBUG_OUTPUT.println(code);
 #endif
-  if (_currentArgs)
-    delete[] _currentArgs;
-  _currentArgs = 0;
-  if (data.length() == 0) {
-    _currentArgCount = 0;
-    _currentArgs = new RequestArgument[1];
-    return;
-  }
-  _currentArgCount = 1;
+  using namespace mime;
+  _contentLength = CONTENT_LENGTH_NOT_SET;
+  send(code, String(FPSTR(mimeTable[txt].mimeType)), String(_responseCodeToString(code)));
+}
 
-  for (int i = 0; i < (int)data.length(); ) {
-    i = data.indexOf('&', i);
-    if (i == -1)
-      break;
-    ++i;
-    ++_currentArgCount;
+// Routes the parts of a form either to the upload handler (files) or into
+// the request arguments (plain fields)
+class ESP8266WebServer::FormListener : public MultipartParser::Listener {
+public:
+  FormListener(ESP8266WebServer& server)
+  : _server(server)
+  , _upload(*server._currentUpload)
+  , _notify(server._currentHandler && server._currentHandler->canUpload(server._currentUri))
+  , _file(false)
+  , _tooLarge(false)
+  , _inArena(false)
+  , _name(nullptr)
+  , _value(nullptr)
+  , _valueLen(0)
+  {
   }
+
+  bool partBegin(const char* name, const char* fileName, const char* contentType) override {
+    _file = (fileName != nullptr);
+    if (!_file) {
+      // field values are collected right behind the request in the parser
+      // buffer, or in the request arena once they outgrow it
+      size_t nameLen = strlen(name) + 1;
+      _name = _server._parser.reserve(nameLen);
+      if (!_name)
+        _name = (char*) _server._arena.alloc(nameLen, 1);
+      if (!_name) {
+        _tooLarge = true;
+        return false;
+      }
+      memcpy(_name, name, nameLen);
+      _value = _server._parser.reserve(0);
+      _valueLen = 0;
+      _inArena = false;
 #ifdef DEBUG_ESP_HTTP_SERVER
-  DEBUG_OUTPUT.print("args count: ");
-  DEBUG_OUTPUT.println(_currentArgCount);
+      DEBUG_OUTPUT.print("PostArg Name: ");
+      DEBUG_OUTPUT.println(name);
 #endif
+      return true;
+    }
 
-  _currentArgs = new RequestArgument[_currentArgCount+1];
-  int pos = 0;
-  int iarg;
-  for (iarg = 0; iarg < _currentArgCount;) {
-    int equal_sign_index = data.indexOf('=', pos);
-    int next_arg_index = data.indexOf('&', pos);
+    _upload.name = name;
+    _upload.filename = fileName;
+    //use GET to set the filename if uploading using blob
+    if (_upload.filename == F("blob") && _server.hasArg(FPSTR(filename)))
+      _upload.filename = _server.arg(FPSTR(filename));
+    if (contentType) {
+      _upload.type = contentType;
+    } else {
+      using namespace mime;
+      _upload.type = FPSTR(mimeTable[txt].mimeType);
+    }
+    _upload.status = UPLOAD_FILE_START;
+    _upload.totalSize = 0;
+    _upload.currentSize = 0;
 #ifdef DEBUG_ESP_HTTP_SERVER
-    DEBUG_OUTPUT.print("pos ");
-    DEBUG_OUTPUT.print(pos);
-    DEBUG_OUTPUT.print("=@ ");
-    DEBUG_OUTPUT.print(equal_sign_index);
-    DEBUG_OUTPUT.print(" &@ ");
-    DEBUG_OUTPUT.println(next_arg_index);
+    DEBUG_OUTPUT.print("Start File: ");
+    DEBUG_OUTPUT.print(_upload.filename);
+    DEBUG_OUTPUT.print(" Type: ");
+    DEBUG_OUTPUT.println(_upload.type);
 #endif
-    if ((equal_sign_index == -1) || ((equal_sign_index > next_arg_index) && (next_arg_index != -1))) {
+    _call();
+    _upload.status = UPLOAD_FILE_WRITE;
+    return true;
+  }
+
+  bool partData(uint8_t* data, size_t len) override {
+    if (_file) {
+      // data is _upload.buf itself, the block is handed over as it is
+      _upload.currentSize = len;
+      _call();
+      _upload.totalSize += len;
+      _upload.currentSize = 0;
+      return true;
+    }
+    return _append(data, len);
+  }
+
+  bool partEnd() override {
+    if (_file) {
+      _file = false;
+      _upload.status = UPLOAD_FILE_END;
+      _call();
 #ifdef DEBUG_ESP_HTTP_SERVER
-      DEBUG_OUTPUT.print("arg missing value: ");
-      DEBUG_OUTPUT.println(iarg);
+      DEBUG_OUTPUT.print("End File: ");
+      DEBUG_OUTPUT.print(_upload.filename);
+      DEBUG_OUTPUT.print(" Type: ");
+      DEBUG_OUTPUT.print(_upload.type);
+      DEBUG_OUTPUT.print(" Size: ");
+      DEBUG_OUTPUT.println(_upload.totalSize);
 #endif
-      if (next_arg_index == -1)
-        break;
-      pos = next_arg_index + 1;
-      continue;
+      return true;
     }
-    RequestArgument& arg = _currentArgs[iarg];
-    arg.key = urlDecode(data.substring(pos, equal_sign_index));
-    arg.value = urlDecode(data.substring(equal_sign_index + 1, next_arg_index));
+    static const uint8_t nul = 0;
+    if (!_append(&nul, 1))
+      return false;
+    _server._parser.addArgumentRef(_name, _value);
 #ifdef DEBUG_ESP_HTTP_SERVER
-    DEBUG_OUTPUT.print("arg ");
-    DEBUG_OUTPUT.print(iarg);
-    DEBUG_OUTPUT.print(" key: ");
-    DEBUG_OUTPUT.print(arg.key);
-    DEBUG_OUTPUT.print(" value: ");
-    DEBUG_OUTPUT.println(arg.value);
+    DEBUG_OUTPUT.print("PostArg Value: ");
+    DEBUG_OUTPUT.println(_value);
 #endif
-    ++iarg;
-    if (next_arg_index == -1)
-      break;
-    pos = next_arg_index + 1;
+    _name = nullptr;
+    return true;
   }
-  _currentArgCount = iarg;
-#ifdef DEBUG_ESP_HTTP_SERVER
-  DEBUG_OUTPUT.print("args count: ");
-  DEBUG_OUTPUT.println(_currentArgCount);
-#endif
 
-}
+  // A field did not fit in memory
+  bool tooLarge() const {
+    return _tooLarge;
+  }
 
-void ESP8266WebServer::_uploadWriteByte(uint8_t b){
-  if (_currentUpload->currentSize == HTTP_UPLOAD_BUFLEN){
-    if(_currentHandler && _currentHandler->canUpload(_currentUri))
-      _currentHandler->upload(*this, _currentUri, *_currentUpload);
-    _currentUpload->totalSize += _currentUpload->currentSize;
-    _currentUpload->currentSize = 0;
+  // Lets the upload handler know when a file was cut short
+  void abort() {
+    if (_file) {
+      _file = false;
+      _server._parseFormUploadAborted();
+    }
   }
-  _currentUpload->buf[_currentUpload->currentSize++] = b;
-}
 
-uint8_t ESP8266WebServer::_uploadReadByte(WiFiClient& client){
-  int res = client.read();
-  if(res == -1){
-    while(!client.available() && client.connected())
-      yield();
-    res = client.read();
+protected:
+  void _call() {
+    if (_notify)
+      _server._currentHandler->upload(_server, _server._currentUri, _upload);
+  }
+
+  bool _append(const uint8_t* data, size_t len) {
+    char* dest = _inArena ? nullptr : _server._parser.reserve(len);
+    if (!dest) {
+      // like a plain body, a value is kept up to HTTP_MAX_BODY_SIZE
+      char* value = nullptr;
+      if (_valueLen + len <= HTTP_MAX_BODY_SIZE) {
+        if (_inArena) {
+          value = (char*) _server._arena.realloc(_value, _valueLen, _valueLen + len);
+        } else if ((value = (char*) _server._arena.alloc(_valueLen + len, 1))) {
+          memcpy(value, _value, _valueLen);
+          _inArena = true;
+        }
+      }
+      if (!value) {
+        _tooLarge = true;
+        return false;
+      }
+      _value = value;
+      dest = value + _valueLen;
+    }
+    memcpy(dest, data, len);
+    _valueLen += len;
+    return true;
   }
-  return (uint8_t)res;
-}
 
-bool ESP8266WebServer::_parseForm(WiFiClient& client, String boundary, uint32_t len){
-  (void) len;
+  ESP8266WebServer& _server;
+  HTTPUpload& _upload;
+  bool _notify;
+  bool _file;
+  bool _tooLarge;
+  bool _inArena;
+  char* _name;
+  char* _value;
+  size_t _valueLen;
+};
+
+bool ESP8266WebServer::_parseForm(WiFiClient& client, const String& boundary, uint32_t len){
 #ifdef DEBUG_ESP_HTTP_SERVER
   DEBUG_OUTPUT.print("Parse Form: Boundary: ");
   DEBUG_OUTPUT.print(boundary);
   DEBUG_OUTPUT.print(" Length: ");
   DEBUG_OUTPUT.println(len);
 #endif
-  String line;
-  int retry = 0;
-  do {
-    line = client.readStringUntil('\r');
-    ++retry;
-  } while (line.length() == 0 && retry < 3);
-
-  client.readStringUntil('\n');
-  //start reading the form
-  if (line == ("--"+boundary)){
-    RequestArgument* postArgs = new RequestArgument[32];
-    int postArgsLen = 0;
-    while(1){
-      String argName;
-      String argValue;
-      String argType;
-      String argFilename;
-      bool argIsFile = false;
-
-      line = client.readStringUntil('\r');
-      client.readStringUntil('\n');
-      if (line.length() > 19 && line.substring(0, 19).equalsIgnoreCase(F("Content-Disposition"))){
-        int nameStart = line.indexOf('=');
-        if (nameStart != -1){
-          argName = line.substring(nameStart+2);
-          nameStart = argName.indexOf('=');
-          if (nameStart == -1){
-            argName = argName.substring(0, argName.length() - 1);
-          } else {
-            argFilename = argName.substring(nameStart+2, argName.length() - 1);
-            argName = argName.substring(0, argName.indexOf('"'));
-            argIsFile = true;
-#ifdef DEBUG_ESP_HTTP_SERVER
-            DEBUG_OUTPUT.print("PostArg FileName: ");
-            DEBUG_OUTPUT.println(argFilename);
-#endif
-            //use GET to set the filename if uploading using blob
-            if (argFilename == F("blob") && hasArg(FPSTR(filename))) 
-              argFilename = arg(FPSTR(filename));
-          }
-#ifdef DEBUG_ESP_HTTP_SERVER
-          DEBUG_OUTPUT.print("PostArg Name: ");
-          DEBUG_OUTPUT.println(argName);
-#endif
-          using namespace mime;
-          argType = FPSTR(mimeTable[txt].mimeType);
-          line = client.readStringUntil('\r');
-          client.readStringUntil('\n');
-          if (line.length() > 12 && line.substring(0, 12).equalsIgnoreCase(FPSTR(Content_Type))){
-            argType = line.substring(line.indexOf(':')+2);
-            //skip next line
-            client.readStringUntil('\r');
-            client.readStringUntil('\n');
-          }
-#ifdef DEBUG_ESP_HTTP_SERVER
-          DEBUG_OUTPUT.print("PostArg Type: ");
-          DEBUG_OUTPUT.println(argType);
-#endif
-          if (!argIsFile){
-            while(1){
-              line = client.readStringUntil('\r');
-              client.readStringUntil('\n');
-              if (line.startsWith("--"+boundary)) break;
-              if (argValue.length() > 0) argValue += "\n";
-              argValue += line;
-            }
+  // The body is received straight into the upload buffer, file contents
+  // are handed to the upload handler from there a whole buffer at a time
+  _currentUpload.reset(new HTTPUpload());
+  std::unique_ptr<MultipartParser> form(new MultipartParser(_currentUpload->buf, HTTP_UPLOAD_BUFLEN));
+  if (!form->begin(boundary.c_str())) {
 #ifdef DEBUG_ESP_HTTP_SERVER
-            DEBUG_OUTPUT.print("PostArg Value: ");
-            DEBUG_OUTPUT.println(argValue);
-            DEBUG_OUTPUT.println();
+    DEBUG_OUTPUT.println("Invalid boundary");
 #endif
+    return false;
+  }
 
-            RequestArgument& arg = postArgs[postArgsLen++];
-            arg.key = argName;
-            arg.value = argValue;
+  FormListener listener(*this);
+  uint32_t remaining = len;
+  unsigned long start = millis();
+  while (!form->done()) {
+    size_t want = form->space();
+    if (len) {
+      // do not read past the body
+      if (!remaining)
+        break;
+      want = std::min<size_t>(want, remaining);
+    }
+    int read = client.available() ? client.read(form->window(), want) : 0;
+    if (read > 0) {
+      remaining -= std::min<uint32_t>(remaining, read);
+      if (!form->commit(read, listener))
+        break;
+      start = millis();
+    } else if (!client.connected() || millis() - start > HTTP_MAX_POST_WAIT) {
+      break;
+    } else {
+      delay(1);
+    }
+  }
 
-            if (line == ("--"+boundary+"--")){
-#ifdef DEBUG_ESP_HTTP_SERVER
-              DEBUG_OUTPUT.println("Done Parsing POST");
-#endif
-              break;
-            }
-          } else {
-            _currentUpload.reset(new HTTPUpload());
-            _currentUpload->status = UPLOAD_FILE_START;
-            _currentUpload->name = argName;
-            _currentUpload->filename = argFilename;
-            _currentUpload->type = argType;
-            _currentUpload->totalSize = 0;
-            _currentUpload->currentSize = 0;
-#ifdef DEBUG_ESP_HTTP_SERVER
-            DEBUG_OUTPUT.print("Start File: ");
-            DEBUG_OUTPUT.print(_currentUpload->filename);
-            DEBUG_OUTPUT.print(" Type: ");
-            DEBUG_OUTPUT.println(_currentUpload->type);
-#endif
-            if(_currentHandler && _currentHandler->canUpload(_currentUri))
-              _currentHandler->upload(*this, _currentUri, *_currentUpload);
-            _currentUpload->status = UPLOAD_FILE_WRITE;
-            uint8_t argByte = _uploadReadByte(client);
-readfile:
-            while(argByte != 0x0D){
-              if (!client.connected()) return _parseFormUploadAborted();
-              _uploadWriteByte(argByte);
-              argByte = _uploadReadByte(client);
-            }
-
-            argByte = _uploadReadByte(client);
-            if (!client.connected()) return _parseFormUploadAborted();
-            if (argByte == 0x0A){
-              argByte = _uploadReadByte(client);
-              if (!client.connected()) return _parseFormUploadAborted();
-              if ((char)argByte != '-'){
-                //continue reading the file
-                _uploadWriteByte(0x0D);
-                _uploadWriteByte(0x0A);
-                goto readfile;
-              } else {
-                argByte = _uploadReadByte(client);
-                if (!client.connected()) return _parseFormUploadAborted();
-                if ((char)argByte != '-'){
-                  //continue reading the file
-                  _uploadWriteByte(0x0D);
-                  _uploadWriteByte(0x0A);
-                  _uploadWriteByte((uint8_t)('-'));
-                  goto readfile;
-                }
-              }
-
-              uint8_t endBuf[boundary.length()];
-              client.readBytes(endBuf, boundary.length());
-
-              if (strstr((const char*)endBuf, boundary.c_str()) != NULL){
-                if(_currentHandler && _currentHandler->canUpload(_currentUri))
-                  _currentHandler->upload(*this, _currentUri, *_currentUpload);
-                _currentUpload->totalSize += _currentUpload->currentSize;
-                _currentUpload->status = UPLOAD_FILE_END;
-                if(_currentHandler && _currentHandler->canUpload(_currentUri))
-                  _currentHandler->upload(*this, _currentUri, *_currentUpload);
-#ifdef DEBUG_ESP_HTTP_SERVER
-                DEBUG_OUTPUT.print("End File: ");
-                DEBUG_OUTPUT.print(_currentUpload->filename);
-                DEBUG_OUTPUT.print(" Type: ");
-                DEBUG_OUTPUT.print(_currentUpload->type);
-                DEBUG_OUTPUT.print(" Size: ");
-                DEBUG_OUTPUT.println(_currentUpload->totalSize);
-#endif
-                line = client.readStringUntil(0x0D);
-                client.readStringUntil(0x0A);
-                if (line == "--"){
+  if (!form->done()) {
 #ifdef DEBUG_ESP_HTTP_SERVER
-                  DEBUG_OUTPUT.println("Done Parsing POST");
+    DEBUG_OUTPUT.println("Error parsing form");
 #endif
-                  break;
-                }
-                continue;
-              } else {
-                _uploadWriteByte(0x0D);
-                _uploadWriteByte(0x0A);
-                _uploadWriteByte((uint8_t)('-'));
-                _uploadWriteByte((uint8_t)('-'));
-                uint32_t i = 0;
-                while(i < boundary.length()){
-                  _uploadWriteByte(endBuf[i++]);
-                }
-                argByte = _uploadReadByte(client);
-                goto readfile;
-              }
-            } else {
-              _uploadWriteByte(0x0D);
-              goto readfile;
-            }
-            break;
-          }
-        }
-      }
-    }
-
-    int iarg;
-    int totalArgs = ((32 - postArgsLen) < _currentArgCount)?(32 - postArgsLen):_currentArgCount;
-    for (iarg = 0; iarg < totalArgs; iarg++){
-      RequestArgument& arg = postArgs[postArgsLen++];
-      arg.key = _currentArgs[iarg].key;
-      arg.value = _currentArgs[iarg].value;
-    }
-    if (_currentArgs) delete[] _currentArgs;
-    _currentArgs = new RequestArgument[postArgsLen];
-    for (iarg = 0; iarg < postArgsLen; iarg++){
-      RequestArgument& arg = _currentArgs[iarg];
-      arg.key = postArgs[iarg].key;
-      arg.value = postArgs[iarg].value;
-    }
-    _currentArgCount = iarg;
-    if (postArgs) 
-      delete[] postArgs;
-    return true;
+    listener.abort();
+    if (listener.tooLarge())
+      _rejectRequest(413);
+    return false;
   }
 #ifdef DEBUG_ESP_HTTP_SERVER
-  DEBUG_OUTPUT.print("Error: line: ");
-  DEBUG_OUTPUT.println(line);
+  DEBUG_OUTPUT.println("Done Parsing POST");
 #endif
-  return false;
+  return true;
 }
 
 String ESP8266WebServer::urlDecode(const String& text)
@@ -0,0 +1,281 @@
+/*
+  AsyncConnection.cpp - Non-blocking HTTP connections, served side by side.
+
+  Copyright (c) 2015 Ivan Grokhotkov. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#define LWIP_INTERNAL
+
+extern "C" {
+  #include "osapi.h"
+}
+
+#include <memory>
+#include <Arduino.h>
+#include "lwip/tcp.h"
+#include "AsyncConnection.h"
+
+static const char Content_Length_Lower[] = "content-length:";
+
+AsyncConnection::AsyncConnection(const WiFiClient& client)
+: _client(client)
+, _state(READ_REQUEST)
+, _activity(false)
+, _headersDone(false)
+, _match(0)
+, _lineLen(0)
+, _headerBytes(0)
+, _bodyBytes(0)
+, _contentLength(0)
+, _sourceLeft(0)
+{
+  // anything received before is replayed from here
+  _client.setEventCallback([](void* arg, WiFiClient::Event event, const char* data, size_t len) {
+    reinterpret_cast<AsyncConnection*>(arg)->_event(event, data, len);
+  }, this);
+}
+
+AsyncConnection::~AsyncConnection()
+{
+  _client.setEventCallback(nullptr, nullptr);
+}
+
+void AsyncConnection::_event(int event, const char* data, size_t len)
+{
+  _activity = true;
+  if (event == WiFiClient::EVENT_RECEIVED) {
+    // what follows the request is left for the handler to read
+    if (_state == READ_REQUEST)
+      _scan(data, len);
+  } else if (event == WiFiClient::EVENT_CLOSED) {
+    _state = CLOSED;
+  }
+}
+
+void AsyncConnection::_scan(const char* data, size_t len)
+{
+  const size_t matchLen = sizeof(Content_Length_Lower) - 1;
+  size_t i = 0;
+  while (i < len && !_headersDone) {
+    char c = data[i++];
+    ++_headerBytes;
+    if (c == '\n') {
+      _headersDone = (_lineLen == 0);
+      _lineLen = 0;
+      _match = 0;
+    } else if (c != '\r') {
+      if (_match < matchLen) {
+        _match = (tolower(c) == Content_Length_Lower[_match]) ? _match + 1 : (uint8_t) NO_MATCH;
+        if (_match == matchLen)
+          _contentLength = 0;
+      } else if (_match == matchLen && c >= '0' && c <= '9' && _contentLength < 100000000) {
+        _contentLength = _contentLength * 10 + (c - '0');
+      }
+      if (_lineLen < 0xffff)
+        ++_lineLen;
+    }
+  }
+  _bodyBytes += len - i;
+
+  if (_headersDone) {
+    uint32_t wanted = (_contentLength < HTTP_ASYNC_BODY_BUFLEN) ? _contentLength : HTTP_ASYNC_BODY_BUFLEN;
+    if (_bodyBytes >= wanted)
+      _state = REQUEST_READY;
+  } else if (_headerBytes > HTTP_ASYNC_HEADER_MAX) {
+    // not a request worth waiting for, the parser gets to reject it
+    _state = REQUEST_READY;
+  }
+}
+
+bool AsyncConnection::takeActivity()
+{
+  bool activity = _activity;
+  _activity = false;
+  return activity;
+}
+
+void AsyncConnection::beginResponse()
+{
+  if (_state == REQUEST_READY)
+    _state = SEND_RESPONSE;
+}
+
+size_t AsyncConnection::write(const char* data, size_t len)
+{
+  if (_state != SEND_RESPONSE || _source)
+    return 0;
+  size_t written = 0;
+  if (!_tx || _tx->empty())
+    written = _client.writeSome(reinterpret_cast<const uint8_t*>(data), len);
+  if (written < len) {
+    _growQueue(len - written);
+    written += _tx->write(data + written, len - written);
+  }
+  return written;
+}
+
+void AsyncConnection::_growQueue(size_t len)
+{
+  if (!_tx)
+    _tx.reset(new cbuf(HTTP_ASYNC_TX_BUFLEN + 1));
+  size_t capacity = _tx->size() - 1;
+  if (_tx->room() >= len || capacity >= HTTP_ASYNC_TX_MAX)
+    return;
+  // at least twofold, a response written in small pieces is not copied
+  // over and over; when there is no heap for it the queue stays as it is
+  size_t wanted = std::max(capacity * 2, _tx->available() + len);
+  _tx->resize(std::min<size_t>(wanted, HTTP_ASYNC_TX_MAX) + 1);
+}
+
+bool AsyncConnection::flush()
+{
+  if (_state == CLOSED)
+    return false;
+  while (_tx && !_tx->empty()) {
+    cbuf::span first, second;
+    _tx->readSpans(first, second);
+    size_t written = _client.writeSome(reinterpret_cast<const uint8_t*>(first.data), first.size);
+    _tx->consume(written);
+    if (written < first.size)
+      return false;
+  }
+  return _flushSource();
+}
+
+bool AsyncConnection::_flushSource()
+{
+  while (_source && _sourceLeft) {
+    Stream& source = _source->stream();
+    size_t written;
+    if (source.hasPeekBufferAPI() && source.peekAvailable()) {
+      size_t len = std::min(source.peekAvailable(), _sourceLeft);
+      written = _client.writeSome(reinterpret_cast<const uint8_t*>(source.peekBuffer()), len);
+      source.peekConsume(written);
+    } else {
+      // read no more than lwIP takes, so nothing has to be put back
+      char buf[256];
+      size_t len = std::min(std::min(sizeof(buf), _sourceLeft), _client.availableForWrite());
+      if (!len)
+        return false;
+      len = source.readBytes(buf, len);
+      if (!len)
+        break;
+      written = _client.writeSome(reinterpret_cast<const uint8_t*>(buf), len);
+      if (written < len) {
+        // the queue is empty here, so it has room for the rest
+        if (!_tx)
+          _tx.reset(new cbuf(HTTP_ASYNC_TX_BUFLEN + 1));
+        _tx->write(buf + written, len - written);
+        _sourceLeft -= len;
+        return false;
+      }
+    }
+    if (!written)
+      return false;
+    _sourceLeft -= written;
+  }
+  // done, or the source ran out early
+  _source.reset();
+  _sourceLeft = 0;
+  return true;
+}
+
+bool AsyncConnection::sent()
+{
+  return _client.status() != ESTABLISHED || _client.availableForWrite() == TCP_SND_BUF;
+}
+
+void AsyncConnection::close()
+{
+  _client.stop();
+  _state = CLOSED;
+  _tx.reset();
+  _source.reset();
+}
+
+AsyncConnectionSet::AsyncConnectionSet(size_t maxConnections, uint32_t readTimeout, uint32_t sendTimeout)
+: _maxConnections(maxConnections)
+, _readTimeout(readTimeout)
+, _sendTimeout(sendTimeout)
+{
+}
+
+AsyncConnectionSet::~AsyncConnectionSet()
+{
+  clear();
+}
+
+bool AsyncConnectionSet::add(AsyncConnection* conn, uint32_t now)
+{
+  std::unique_ptr<AsyncConnection> owned(conn);
+  if (full())
+    return false;
+  Slot slot;
+  slot.conn = std::move(owned);
+  slot.lastActivity = now;
+  _connections.push_back(std::move(slot));
+  return true;
+}
+
+void AsyncConnectionSet::poll(TRequestHandler handler, void* arg, uint32_t now)
+{
+  for (size_t i = 0; i < _connections.size(); ) {
+    Slot& slot = _connections[i];
+    AsyncConnection& conn = *slot.conn;
+    if (conn.takeActivity())
+      slot.lastActivity = now;
+
+    bool done = false;
+    switch (conn.state()) {
+    case AsyncConnection::READ_REQUEST:
+      done = (uint32_t) (now - slot.lastActivity) > _readTimeout;
+      break;
+    case AsyncConnection::REQUEST_READY:
+      conn.beginResponse();
+      handler(arg, conn);
+      // the handler took its time, which is not the peer's fault
+      conn.takeActivity();
+      slot.lastActivity = now;
+      // fall through
+    case AsyncConnection::SEND_RESPONSE:
+      if (conn.state() == AsyncConnection::CLOSED)
+        done = true;
+      else if (conn.flush() && conn.sent())
+        done = true;
+      else
+        done = (uint32_t) (now - slot.lastActivity) > _sendTimeout;
+      break;
+    case AsyncConnection::CLOSED:
+      done = true;
+      break;
+    }
+
+    if (done) {
+      conn.close();
+      _connections.erase(_connections.begin() + i);
+    } else {
+      ++i;
+    }
+  }
+}
+
+void AsyncConnectionSet::clear()
+{
+  for (Slot& slot : _connections)
+    slot.conn->close();
+  _connections.clear();
+}
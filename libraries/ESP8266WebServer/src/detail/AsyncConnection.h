@@ -0,0 +1,174 @@
+/*
+  AsyncConnection.h - Non-blocking HTTP connections, served side by side.
+
+  Copyright (c) 2015 Ivan Grokhotkov. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef ASYNCCONNECTION_H
+#define ASYNCCONNECTION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <vector>
+#include <Stream.h>
+#include <cbuf.h>
+#include <WiFiClient.h>
+
+#ifndef HTTP_ASYNC_HEADER_MAX
+#define HTTP_ASYNC_HEADER_MAX 4096 // request header bytes to look through for the end of the headers
+#endif
+
+#ifndef HTTP_ASYNC_BODY_BUFLEN
+#define HTTP_ASYNC_BODY_BUFLEN 2048 // longest request body waited for, longer ones are answered with 413
+#endif
+
+#ifndef HTTP_ASYNC_TX_BUFLEN
+#define HTTP_ASYNC_TX_BUFLEN 2048 // response bytes queued while lwIP has no room for them
+#endif
+
+#ifndef HTTP_ASYNC_TX_MAX
+#define HTTP_ASYNC_TX_MAX 8192 // what the queue grows to on the heap for a larger response
+#endif
+
+// One client of a server that handles several at a time. The connection
+// is followed through the WiFiClient event callback: received data is
+// scanned where it lies for the end of the headers and for Content-Length,
+// so the request is only parsed (and consumed) once it is all there, and
+// acknowledgements make room for the rest of the response.
+//
+// Responses are written without waiting. Whatever lwIP has no room for is
+// queued, in HTTP_ASYNC_TX_BUFLEN that grows up to HTTP_ASYNC_TX_MAX when
+// needed, and a stream (e.g. a file) can be attached to be sent behind it
+// as the peer acknowledges data.
+class AsyncConnection
+{
+public:
+  enum State {
+    READ_REQUEST,   // waiting for the rest of the request
+    REQUEST_READY,  // all of it arrived, or HTTP_ASYNC_BODY_BUFLEN of the body
+    SEND_RESPONSE,  // handled, the response is still being sent
+    CLOSED
+  };
+
+  AsyncConnection(const WiFiClient& client);
+  virtual ~AsyncConnection();
+
+  // for the request parser, which reads the request from here
+  WiFiClient& client() { return _client; }
+  State state() const { return _state; }
+  // Content-Length of the request, 0 if it had none
+  uint32_t contentLength() const { return _contentLength; }
+
+  void beginResponse();
+  // Takes as much of data as lwIP and the queue have room for, short only
+  // once HTTP_ASYNC_TX_MAX is queued. Nothing is taken while a stream is
+  // attached, it has to be sent first.
+  size_t write(const char* data, size_t len);
+  // Sends len bytes of source behind what was written, as space frees up.
+  // The source is copied (a File shares its handle).
+  template<typename T>
+  size_t stream(T& source, size_t len) {
+    if (_state != SEND_RESPONSE || _source)
+      return 0;
+    _source.reset(new SourceHolder<T>(source));
+    _sourceLeft = len;
+    flush();
+    return len;
+  }
+  // Pushes queued output to lwIP, true once all of it is there
+  bool flush();
+  // Everything was handed to lwIP and acknowledged by the peer
+  bool sent();
+  void close();
+
+  // Whether the event callback reported anything since the last call
+  bool takeActivity();
+
+protected:
+  // Type erasure for stream(), Stream itself has no virtual destructor
+  struct Source {
+    virtual ~Source() {}
+    virtual Stream& stream() = 0;
+  };
+
+  template<typename T>
+  struct SourceHolder : Source {
+    SourceHolder(T& source) : _source(source) {}
+    Stream& stream() override { return _source; }
+    T _source;
+  };
+
+  enum { NO_MATCH = 0xff };
+
+  void _scan(const char* data, size_t len);
+  void _growQueue(size_t len);
+  bool _flushSource();
+  void _event(int event, const char* data, size_t len);
+
+  WiFiClient _client;
+  State _state;
+  bool _activity;
+  bool _headersDone;
+  uint8_t _match;       // characters of "content-length:" matched on this line
+  uint16_t _lineLen;
+  uint32_t _headerBytes;
+  uint32_t _bodyBytes;
+  uint32_t _contentLength;
+
+  std::unique_ptr<cbuf> _tx;
+  std::unique_ptr<Source> _source;
+  size_t _sourceLeft;
+
+private:
+  AsyncConnection(const AsyncConnection&);
+  AsyncConnection& operator=(const AsyncConnection&);
+};
+
+// The connections of the asynchronous server mode. poll() hands complete
+// requests to the handler, one after the other, keeps pushing responses
+// out and drops connections that are done or went quiet for too long. It
+// never waits: slow peers only hold on to their own slot.
+class AsyncConnectionSet
+{
+public:
+  typedef void (*TRequestHandler)(void* arg, AsyncConnection& conn);
+
+  AsyncConnectionSet(size_t maxConnections, uint32_t readTimeout, uint32_t sendTimeout);
+  ~AsyncConnectionSet();
+
+  size_t size() const { return _connections.size(); }
+  bool full() const { return _connections.size() >= _maxConnections; }
+
+  // Takes ownership of conn, which is dropped right away when full
+  bool add(AsyncConnection* conn, uint32_t now);
+  void poll(TRequestHandler handler, void* arg, uint32_t now);
+  void clear();
+
+protected:
+  struct Slot {
+    std::unique_ptr<AsyncConnection> conn;
+    uint32_t lastActivity;
+  };
+
+  size_t _maxConnections;
+  uint32_t _readTimeout;
+  uint32_t _sendTimeout;
+  std::vector<Slot> _connections;
+};
+
+#endif //ASYNCCONNECTION_H
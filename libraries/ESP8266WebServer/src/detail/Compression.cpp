@@ -0,0 +1,93 @@
+/*
+  Compression.cpp - Content coding choices for compressed responses.
+
+  Copyright (c) 2015 Ivan Grokhotkov. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <string.h>
+#include <strings.h>
+#include "Compression.h"
+
+namespace compression
+{
+
+enum { UNLISTED = -1, REFUSED = 0, ACCEPTED = 1 };
+
+static bool isSpace(char c)
+{
+  return c == ' ' || c == '\t';
+}
+
+// How acceptEncoding lists coding
+static int listed(const char* acceptEncoding, const char* coding)
+{
+  int result = UNLISTED;
+  int wildcard = UNLISTED;
+  size_t codingLen = strlen(coding);
+  const char* p = acceptEncoding;
+  while (*p) {
+    while (isSpace(*p) || *p == ',')
+      ++p;
+    const char* name = p;
+    while (*p && *p != ',' && *p != ';' && !isSpace(*p))
+      ++p;
+    size_t nameLen = p - name;
+
+    // parameters, of which only q matters
+    int accepted = ACCEPTED;
+    while (*p && *p != ',') {
+      if (*p++ != ';')
+        continue;
+      while (isSpace(*p))
+        ++p;
+      if ((*p == 'q' || *p == 'Q') && p[1] == '=') {
+        accepted = REFUSED;
+        for (p += 2; (*p >= '0' && *p <= '9') || *p == '.'; ++p) {
+          if (*p != '0' && *p != '.')
+            accepted = ACCEPTED;
+        }
+      }
+    }
+
+    if (nameLen == codingLen && strncasecmp(name, coding, nameLen) == 0)
+      result = accepted;
+    else if (nameLen == 1 && *name == '*')
+      wildcard = accepted;
+  }
+  return (result != UNLISTED) ? result : wildcard;
+}
+
+const char* chooseCoding(const char* acceptEncoding)
+{
+  if (!acceptEncoding)
+    return nullptr;
+  if (listed(acceptEncoding, "gzip") == ACCEPTED)
+    return "gzip";
+  if (listed(acceptEncoding, "deflate") == ACCEPTED)
+    return "deflate";
+  return nullptr;
+}
+
+bool isCompressible(const char* contentType)
+{
+  return strncasecmp(contentType, "text/", 5) == 0 ||
+         strstr(contentType, "json") != nullptr ||
+         strstr(contentType, "javascript") != nullptr ||
+         strstr(contentType, "xml") != nullptr;
+}
+
+}
@@ -0,0 +1,40 @@
+/*
+  Compression.h - Content coding choices for compressed responses.
+
+  Copyright (c) 2015 Ivan Grokhotkov. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+namespace compression
+{
+
+// The coding to compress a response with, given the Accept-Encoding header
+// of the request (may be nullptr): "gzip", "deflate" (zlib wrapped, as the
+// RFC has it) or nullptr when the client takes neither. A coding counts as
+// accepted when it is listed, or "*" is, with a q value above zero.
+const char* chooseCoding(const char* acceptEncoding);
+
+// Whether a response of this content type is worth compressing: text, and
+// JSON, JavaScript and XML under other names. Most other types, like
+// images, fonts and archives, are compressed already.
+bool isCompressible(const char* contentType);
+
+}
+
+#endif //COMPRESSION_H
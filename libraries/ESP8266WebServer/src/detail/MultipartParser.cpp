@@ -0,0 +1,254 @@
+/*
+  MultipartParser.cpp - Block oriented multipart/form-data parser.
+
+  Copyright (c) 2015 Ivan Grokhotkov. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <string.h>
+#include <strings.h>
+#include "MultipartParser.h"
+
+MultipartParser::MultipartParser(uint8_t* window, size_t size)
+: _window(window)
+, _size(size)
+, _fill(0)
+, _scan(0)
+, _state(FAILED)
+, _delimiterLen(0)
+{
+}
+
+bool MultipartParser::begin(const char* boundary)
+{
+  size_t len = strlen(boundary);
+  // the window must be able to hold a delimiter on top of the kept tail
+  if (len == 0 || len > MULTIPART_MAX_BOUNDARY || _size < 2 * (len + 4)) {
+    return _fail();
+  }
+  memcpy(_delimiter, "\r\n--", 4);
+  memcpy(_delimiter + 4, boundary, len);
+  _delimiterLen = len + 4;
+
+  // Horspool shift table: distance from the last occurrence of each byte
+  // (ignoring the final position) to the end of the delimiter
+  memset(_skip, _delimiterLen, sizeof(_skip));
+  for (size_t i = 0; i + 1 < _delimiterLen; ++i) {
+    _skip[(uint8_t) _delimiter[i]] = _delimiterLen - 1 - i;
+  }
+
+  // The first delimiter may come without the leading CRLF, pretend it
+  // was there so that every delimiter looks the same
+  _window[0] = '\r';
+  _window[1] = '\n';
+  _fill = 2;
+  _scan = 0;
+  _state = PREAMBLE;
+  return true;
+}
+
+int MultipartParser::find(const uint8_t* data, size_t len) const
+{
+  size_t m = _delimiterLen;
+  if (m == 0 || len < m) {
+    return -1;
+  }
+  const uint8_t last = _delimiter[m - 1];
+  for (size_t pos = 0; pos <= len - m; ) {
+    uint8_t c = data[pos + m - 1];
+    if (c == last && memcmp(data + pos, _delimiter, m - 1) == 0) {
+      return pos;
+    }
+    pos += _skip[c];
+  }
+  return -1;
+}
+
+bool MultipartParser::_fail()
+{
+  _state = FAILED;
+  return false;
+}
+
+void MultipartParser::_discard(size_t len)
+{
+  _fill -= len;
+  memmove(_window, _window + len, _fill);
+  _scan = (_scan > len) ? _scan - len : 0;
+}
+
+bool MultipartParser::commit(size_t len, Listener& listener)
+{
+  if (_state == DONE || _state == FAILED) {
+    return _state == DONE;
+  }
+  _fill += len;
+
+  for (;;) {
+    switch (_state) {
+    case PREAMBLE:
+    case PART_BODY: {
+      int at = find(_window + _scan, _fill - _scan);
+      if (at < 0) {
+        // a delimiter may still start within the last few bytes
+        size_t keep = _delimiterLen - 1;
+        size_t ready = (_fill > keep) ? _fill - keep : 0;
+        _scan = ready;
+        if (_state == PREAMBLE) {
+          _discard(ready);
+        } else if (_fill == _size) {
+          // only pass on whole windows, partial ones wait for more input
+          if (!listener.partData(_window, ready)) {
+            return _fail();
+          }
+          _discard(ready);
+        }
+        return true;
+      }
+      size_t end = _scan + at;
+      if (_state == PART_BODY) {
+        if ((end && !listener.partData(_window, end)) || !listener.partEnd()) {
+          return _fail();
+        }
+      }
+      _discard(end + _delimiterLen);
+      _state = DELIMITER_TAIL;
+      break;
+    }
+
+    case DELIMITER_TAIL: {
+      if (_fill < 2) {
+        return true;
+      }
+      if (_window[0] == '-' && _window[1] == '-') {
+        _state = DONE;
+        return true;
+      }
+      // skip transport padding up to the end of the delimiter line
+      uint8_t* eol = (uint8_t*) memchr(_window, '\n', _fill);
+      if (!eol) {
+        return (_fill == _size) ? _fail() : true;
+      }
+      _discard(eol + 1 - _window);
+      _state = PART_HEADERS;
+      break;
+    }
+
+    case PART_HEADERS: {
+      // the whole header block has to be in the window at once
+      size_t end = 0;
+      if (_fill >= 2 && _window[0] == '\r' && _window[1] == '\n') {
+        end = 0;
+      } else {
+        uint8_t* pos = _window;
+        uint8_t* limit = _window + _fill;
+        for (;;) {
+          pos = (uint8_t*) memchr(pos, '\r', limit - pos);
+          if (!pos || limit - pos < 4) {
+            return (_fill == _size) ? _fail() : true;
+          }
+          if (pos[1] == '\n' && pos[2] == '\r' && pos[3] == '\n') {
+            break;
+          }
+          ++pos;
+        }
+        end = pos - _window + 2;
+      }
+      if (!_parseHeaders(end, listener)) {
+        return _fail();
+      }
+      _discard(end + 2);
+      _scan = 0;
+      _state = PART_BODY;
+      break;
+    }
+
+    case DONE:
+      return true;
+
+    case FAILED:
+      return false;
+    }
+  }
+}
+
+// Splits "form-data; name=...; filename=..." in place
+static void parseDisposition(char* p, const char** name, const char** filename)
+{
+  while (*p) {
+    while (*p == ' ' || *p == '\t' || *p == ';') {
+      ++p;
+    }
+    char* key = p;
+    while (*p && *p != '=' && *p != ';') {
+      ++p;
+    }
+    if (*p != '=') {
+      // a token without a value, such as "form-data"
+      continue;
+    }
+    *p++ = 0;
+    char* value;
+    if (*p == '"') {
+      value = ++p;
+      while (*p && *p != '"') {
+        ++p;
+      }
+    } else {
+      value = p;
+      while (*p && *p != ';' && *p != ' ') {
+        ++p;
+      }
+    }
+    if (*p) {
+      *p++ = 0;
+    }
+    if (strcasecmp(key, "name") == 0) {
+      *name = value;
+    } else if (strcasecmp(key, "filename") == 0) {
+      *filename = value;
+    }
+  }
+}
+
+bool MultipartParser::_parseHeaders(size_t end, Listener& listener)
+{
+  const char* name = "";
+  const char* filename = nullptr;
+  const char* contentType = nullptr;
+
+  // every line in [0, end) is terminated by CRLF
+  char* line = (char*) _window;
+  char* limit = line + end;
+  while (line < limit) {
+    char* eol = (char*) memchr(line, '\r', limit - line);
+    *eol = 0;
+    char* value = strchr(line, ':');
+    if (value) {
+      *value++ = 0;
+      while (*value == ' ' || *value == '\t') {
+        ++value;
+      }
+      if (strcasecmp(line, "Content-Disposition") == 0) {
+        parseDisposition(value, &name, &filename);
+      } else if (strcasecmp(line, "Content-Type") == 0) {
+        contentType = value;
+      }
+    }
+    line = eol + 2;
+  }
+  return listener.partBegin(name, filename, contentType);
+}
@@ -0,0 +1,91 @@
+/*
+  MultipartParser.h - Block oriented multipart/form-data parser.
+
+  Copyright (c) 2015 Ivan Grokhotkov. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef MULTIPARTPARSER_H
+#define MULTIPARTPARSER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// RFC 2046 limits boundaries to 70 characters
+#define MULTIPART_MAX_BOUNDARY 70
+
+// Splits a multipart body into parts, working on whole blocks of input.
+// Input is received directly into a caller supplied window (typically
+// HTTPUpload::buf); part data is always reported from the start of that
+// window, in blocks as large as the window allows, so it can be handed on
+// without copying. The delimiter is located with a Boyer-Moore-Horspool
+// search, so most input bytes are never looked at individually.
+class MultipartParser
+{
+public:
+  class Listener {
+  public:
+    virtual ~Listener() { }
+    // Strings point into the window and are only valid during the call;
+    // filename and contentType are nullptr when the part does not have them
+    virtual bool partBegin(const char* name, const char* filename, const char* contentType) = 0;
+    virtual bool partData(uint8_t* data, size_t len) = 0;
+    virtual bool partEnd() = 0;
+  };
+
+  MultipartParser(uint8_t* window, size_t size);
+
+  bool begin(const char* boundary);
+
+  // Receive more input at window(), up to space() bytes, then commit() it
+  uint8_t* window() { return _window + _fill; }
+  size_t space() const { return _size - _fill; }
+  bool commit(size_t len, Listener& listener);
+
+  bool done() const { return _state == DONE; }
+  bool failed() const { return _state == FAILED; }
+  bool inPart() const { return _state == PART_BODY; }
+
+  // Offset of the delimiter ("\r\n--" boundary) in data, or -1
+  int find(const uint8_t* data, size_t len) const;
+
+protected:
+  enum State {
+    PREAMBLE,
+    DELIMITER_TAIL,
+    PART_HEADERS,
+    PART_BODY,
+    DONE,
+    FAILED
+  };
+
+  bool _parseHeaders(size_t end, Listener& listener);
+  void _discard(size_t len);
+  bool _fail();
+
+  uint8_t* _window;
+  size_t _size;
+  size_t _fill;
+  size_t _scan;   // window offset where the next delimiter search starts
+  State _state;
+
+  // "\r\n--" boundary
+  uint8_t _delimiterLen;
+  char _delimiter[MULTIPART_MAX_BOUNDARY + 4];
+  uint8_t _skip[256];
+};
+
+#endif //MULTIPARTPARSER_H
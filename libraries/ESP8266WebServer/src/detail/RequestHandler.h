@@ -8,6 +8,9 @@ public:
     virtual bool canUpload(String uri) { (void) uri; return false; }
     virtual bool handle(ESP8266WebServer& server, HTTPMethod requestMethod, String requestUri) { (void) server; (void) requestMethod; (void) requestUri; return false; }
     virtual void upload(ESP8266WebServer& server, String requestUri, HTTPUpload& upload) { (void) server; (void) requestUri; (void) upload; }
+    // Method and URI pattern of a handler that serves one fixed route, which lets
+    // the server dispatch to it without calling canHandle(); nullptr otherwise
+    virtual const char* route(HTTPMethod& method) { (void) method; return nullptr; }
 
     RequestHandler* next() { return _next; }
     void next(RequestHandler* r) { _next = r; }
@@ -14,6 +14,7 @@ public:
     , _ufn(ufn)
     , _uri(uri)
     , _method(method)
+    , _hasParams(uri.indexOf('{') >= 0)
     {
     }
 
@@ -21,12 +22,20 @@ public:
         if (_method != HTTP_ANY && _method != requestMethod)
             return false;
 
+        if (_hasParams)
+            return RouteTable::matches(_uri.c_str(), requestUri.c_str(), requestUri.length());
+
         if (requestUri != _uri)
             return false;
 
         return true;
     }
 
+    const char* route(HTTPMethod& method) override {
+        method = _method;
+        return _uri.c_str();
+    }
+
     bool canUpload(String requestUri) override  {
         if (!_ufn || !canHandle(HTTP_POST, requestUri))
             return false;
@@ -55,8 +64,13 @@ protected:
     ESP8266WebServer::THandlerFunction _ufn;
     String _uri;
     HTTPMethod _method;
+    bool _hasParams;
 };
 
+#ifndef STATIC_CACHE_ENTRIES
+#define STATIC_CACHE_ENTRIES 8 // files whose lookup results StaticRequestHandler keeps
+#endif
+
 class StaticRequestHandler : public RequestHandler {
 public:
     StaticRequestHandler(FS& fs, const char* path, const char* uri, const char* cache_header)
@@ -64,6 +78,8 @@ public:
     , _uri(uri)
     , _path(path)
     , _cache_header(cache_header)
+    , _cacheCount(0)
+    , _cacheNext(0)
     {
         _isFile = !fs.isDir(path);
         DEBUGV("StaticRequestHandler: path=%s uri=%s isFile=%d, cache_header=%s\r\n", path, uri, _isFile, cache_header);
@@ -99,49 +115,165 @@ public:
         }
         DEBUGV("StaticRequestHandler::handle: path=%s, isFile=%d\r\n", path.c_str(), _isFile);
 
-        String contentType = getContentType(path);
+        CacheEntry& entry = _lookup(path);
+        if (!entry.found)
+            return false;
 
-        // look for gz file, only if the original specified path is not a gz.  So part only works to send gzip via content encoding when a non compressed is asked for
-        // if you point the the path to gzip you will serve the gzip as content type "application/x-gzip", not text or javascript etc...
-        if (!path.endsWith(FPSTR(mimeTable[gz].endsWith)) && !_fs.exists(path))  {
-            String pathWithGz = path + FPSTR(mimeTable[gz].endsWith);
-            if(_fs.exists(pathWithGz))
-                path += FPSTR(mimeTable[gz].endsWith);
+        // ETag is "size-hash" of the file as served, empty if the FS cannot tell us about changes
+        char etag[24] = "";
+        if (entry.hashed) {
+            sprintf(etag, "\"%x-%08x\"", (unsigned) entry.size, (unsigned) entry.hash);
+            const char* ifNoneMatch = server._parser.header("If-None-Match");
+            if (ifNoneMatch && _matchesETag(ifNoneMatch, etag)) {
+                // the client has it already, the file is not even opened
+                if (_cache_header.length() != 0)
+                    server.sendHeader("Cache-Control", _cache_header);
+                server.sendHeader("ETag", etag);
+                server.send(304);
+                return true;
+            }
         }
 
-        File f = _fs.open(path, "r");
-        if (!f)
+        File f = _fs.open(entry.file, "r");
+        if (!f) {
+            entry.path = String();
             return false;
+        }
 
         if (_cache_header.length() != 0)
             server.sendHeader("Cache-Control", _cache_header);
+        if (etag[0])
+            server.sendHeader("ETag", etag);
 
-        server.streamFile(f, contentType);
+        server.streamFile(f, FPSTR(mimeTable[entry.mime].mimeType));
         return true;
     }
 
     static String getContentType(const String& path) {
         char buff[sizeof(mimeTable[0].mimeType)];
+        strcpy_P(buff, mimeTable[getContentTypeIndex(path)].mimeType);
+        return String(buff);
+    }
+
+    static type getContentTypeIndex(const String& path) {
+        char buff[sizeof(mimeTable[0].endsWith)];
         // Check all entries but last one for match, return if found
         for (size_t i=0; i < sizeof(mimeTable)/sizeof(mimeTable[0])-1; i++) {
             strcpy_P(buff, mimeTable[i].endsWith);
-            if (path.endsWith(buff)) {
-                strcpy_P(buff, mimeTable[i].mimeType);
-                return String(buff);
-            }
+            if (path.endsWith(buff))
+                return (type) i;
         }
         // Fall-through and just return default type
-        strcpy_P(buff, mimeTable[sizeof(mimeTable)/sizeof(mimeTable[0])-1].mimeType);
-        return String(buff);
+        return (type) (sizeof(mimeTable)/sizeof(mimeTable[0])-1);
     }
 
 protected:
+    // What a request path resolved to when it was last looked up
+    struct CacheEntry {
+        String path;    // as requested
+        String file;    // as found, possibly the .gz variant
+        type mime;
+        bool found;
+        bool hashed;
+        size_t size;
+        uint32_t hash;
+        uint32_t generation;    // of the file system when filled
+    };
+
+    // If-None-Match holds "*" or a list of entity tags, which are compared
+    // weakly, i.e. a W/ in front makes no difference (RFC 7232 3.2)
+    static bool _matchesETag(const char* list, const char* etag) {
+        size_t etagLen = strlen(etag);
+        const char* p = list;
+        while (*p) {
+            while (*p == ' ' || *p == '\t' || *p == ',')
+                p++;
+            if (*p == '*')
+                return true;
+            if (p[0] == 'W' && p[1] == '/')
+                p += 2;
+            // strchr() finds the terminating NUL too, the tag may end the list
+            if (strncmp(p, etag, etagLen) == 0 && strchr(" \t,", p[etagLen]))
+                return true;
+            if (*p == '"') {
+                // the tag may hold a comma
+                p = strchr(p + 1, '"');
+                if (!p)
+                    return false;
+                p++;
+            }
+            while (*p && *p != ',')
+                p++;
+        }
+        return false;
+    }
+
+    CacheEntry& _lookup(const String& path) {
+        for (size_t i = 0; i < _cacheCount; i++) {
+            CacheEntry& entry = _cache[i];
+            if (!entry.path.length() || entry.path != path)
+                continue;
+            // only a change to one of the files looked at costs a re-fill
+            if (_fs.changedSince(entry.path, entry.generation) ||
+                (entry.file != entry.path && _fs.changedSince(entry.file, entry.generation)))
+                _fill(entry, path);
+            return entry;
+        }
+
+        CacheEntry& entry = _cache[_cacheNext];
+        _cacheNext = (_cacheNext + 1) % STATIC_CACHE_ENTRIES;
+        if (_cacheCount < STATIC_CACHE_ENTRIES)
+            _cacheCount++;
+        _fill(entry, path);
+        return entry;
+    }
+
+    void _fill(CacheEntry& entry, const String& path) {
+        entry.generation = _fs.generation();
+        entry.path = path;
+        entry.file = path;
+        entry.mime = getContentTypeIndex(path);
+        entry.found = false;
+        entry.hashed = false;
+        entry.size = 0;
+        entry.hash = 0;
+
+        // look for gz file, only if the original specified path is not a gz.  So part only works to send gzip via content encoding when a non compressed is asked for
+        // if you point the the path to gzip you will serve the gzip as content type "application/x-gzip", not text or javascript etc...
+        File f = _fs.open(path, "r");
+        if (!f && !path.endsWith(FPSTR(mimeTable[gz].endsWith))) {
+            entry.file += FPSTR(mimeTable[gz].endsWith);
+            f = _fs.open(entry.file, "r");
+        }
+        if (!f)
+            return;
+
+        entry.found = true;
+        entry.size = f.size();
+        if (entry.generation != 0) {
+            // FNV-1a over the content, once per change of the file
+            uint8_t buf[128];
+            uint32_t h = 2166136261u;
+            size_t len;
+            while ((len = f.read(buf, sizeof(buf))) > 0) {
+                for (size_t i = 0; i < len; i++)
+                    h = (h ^ buf[i]) * 16777619u;
+            }
+            entry.hash = h;
+            entry.hashed = true;
+        }
+    }
+
     FS _fs;
     String _uri;
     String _path;
     String _cache_header;
     bool _isFile;
     size_t _baseUriLength;
+
+    size_t _cacheCount;
+    size_t _cacheNext;
+    CacheEntry _cache[STATIC_CACHE_ENTRIES];
 };
 
 
@@ -0,0 +1,412 @@
+/*
+  RequestParser.cpp - Incremental, allocation-free HTTP request parser.
+
+  Copyright (c) 2015 Ivan Grokhotkov. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "RequestParser.h"
+
+#define HTTP_MAX_METHOD_LEN 8
+
+static const char empty[] = "";
+
+RequestParser::RequestParser()
+: _filter(nullptr)
+, _filterArg(nullptr)
+{
+  reset();
+}
+
+void RequestParser::reset()
+{
+  _state = PARSE_METHOD;
+  _error = ERROR_NONE;
+  _len = 0;
+  _mark = 0;
+  _version = 0;
+  _method = empty;
+  _uri = empty;
+  _query = empty;
+  _headerCount = 0;
+  _argCount = 0;
+}
+
+void RequestParser::setHeaderFilter(THeaderFilter filter, void* arg)
+{
+  _filter = filter;
+  _filterArg = arg;
+}
+
+void RequestParser::_fail(Error error)
+{
+  _state = PARSE_ERROR;
+  _error = error;
+}
+
+bool RequestParser::_put(char c)
+{
+  // always leave room for the terminating NUL
+  if (_len + 1u >= sizeof(_buf)) {
+    _fail(_state <= PARSE_VERSION ? ERROR_URI_TOO_LONG : ERROR_HEADERS_TOO_LARGE);
+    return false;
+  }
+  _buf[_len++] = c;
+  return true;
+}
+
+bool RequestParser::_terminate()
+{
+  if (_len >= sizeof(_buf)) {
+    _fail(_state <= PARSE_VERSION ? ERROR_URI_TOO_LONG : ERROR_HEADERS_TOO_LARGE);
+    return false;
+  }
+  _buf[_len++] = 0;
+  return true;
+}
+
+bool RequestParser::_parseVersion(const char* version)
+{
+  if (strncmp(version, "HTTP/1.", 7) != 0 || version[7] < '0' || version[7] > '9') {
+    return false;
+  }
+  _version = version[7] - '0';
+  return true;
+}
+
+void RequestParser::_endHeaderValue()
+{
+  while (_len > _mark && (_buf[_len - 1] == ' ' || _buf[_len - 1] == '\t')) {
+    --_len;
+  }
+  if (_terminate()) {
+    _headers[_headerCount++].value = _buf + _mark;
+  }
+}
+
+size_t RequestParser::feed(const char* data, size_t len)
+{
+  size_t i = 0;
+  while (i < len && _state != PARSE_DONE && _state != PARSE_ERROR) {
+    char c = data[i];
+    switch (_state) {
+    case PARSE_METHOD:
+      if (c == ' ') {
+        if (_len == 0 || !_terminate()) {
+          _fail(ERROR_MALFORMED);
+          break;
+        }
+        _method = _buf;
+        _mark = _len;
+        _state = PARSE_URI;
+      } else if (c == '\r' || c == '\n') {
+        // empty lines ahead of the request line are allowed
+        if (_len) {
+          _fail(ERROR_MALFORMED);
+        }
+      } else if (_len == HTTP_MAX_METHOD_LEN) {
+        _fail(ERROR_MALFORMED);
+      } else {
+        _put(c);
+      }
+      break;
+
+    case PARSE_URI:
+    case PARSE_QUERY:
+      if (c == ' ' || (c == '?' && _state == PARSE_URI)) {
+        if (!_terminate()) {
+          break;
+        }
+        if (_state == PARSE_URI) {
+          _uri = _buf + _mark;
+        } else {
+          _query = _buf + _mark;
+        }
+        _mark = _len;
+        _state = (c == '?') ? PARSE_QUERY : PARSE_VERSION;
+      } else if (c == '\r' || c == '\n') {
+        _fail(ERROR_MALFORMED);
+      } else {
+        _put(c);
+      }
+      break;
+
+    case PARSE_VERSION:
+      if (c == '\r' || c == '\n') {
+        if (!_terminate()) {
+          break;
+        }
+        if (!_parseVersion(_buf + _mark)) {
+          _fail(ERROR_MALFORMED);
+          break;
+        }
+        // the version string itself is not needed any more
+        _len = _mark;
+        _state = (c == '\r') ? PARSE_LINE_END : PARSE_HEADER_START;
+      } else {
+        _put(c);
+      }
+      break;
+
+    case PARSE_LINE_END:
+      _state = PARSE_HEADER_START;
+      if (c != '\n') {
+        // bare CR, process this character as the start of the next line
+        continue;
+      }
+      break;
+
+    case PARSE_HEADER_START:
+      if (c == '\r') {
+        _state = PARSE_HEADERS_END;
+      } else if (c == '\n') {
+        _state = PARSE_DONE;
+      } else if (c == ' ' || c == '\t' || c == ':') {
+        // obsolete line folding or malformed line, ignored
+        _state = PARSE_HEADER_SKIP;
+      } else {
+        _mark = _len;
+        _state = PARSE_HEADER_NAME;
+        _put(c);
+      }
+      break;
+
+    case PARSE_HEADER_NAME:
+      if (c == ':') {
+        if (!_terminate()) {
+          break;
+        }
+        if (_headerCount < HTTP_MAX_HEADERS &&
+            (!_filter || _filter(_filterArg, _buf + _mark))) {
+          _headers[_headerCount].name = _buf + _mark;
+          _mark = _len;
+          _state = PARSE_HEADER_VALUE_START;
+        } else {
+          _len = _mark;
+          _state = PARSE_HEADER_SKIP;
+        }
+      } else if (c == '\r' || c == '\n') {
+        // no colon, not a header
+        _len = _mark;
+        _state = (c == '\r') ? PARSE_LINE_END : PARSE_HEADER_START;
+      } else {
+        _put(c);
+      }
+      break;
+
+    case PARSE_HEADER_VALUE_START:
+      if (c == ' ' || c == '\t') {
+        break;
+      }
+      _state = PARSE_HEADER_VALUE;
+      continue;
+
+    case PARSE_HEADER_VALUE:
+      if (c == '\r' || c == '\n') {
+        _endHeaderValue();
+        if (_state != PARSE_ERROR) {
+          _state = (c == '\r') ? PARSE_LINE_END : PARSE_HEADER_START;
+        }
+      } else {
+        _put(c);
+      }
+      break;
+
+    case PARSE_HEADER_SKIP:
+      if (c == '\n') {
+        _state = PARSE_HEADER_START;
+      }
+      break;
+
+    case PARSE_HEADERS_END:
+      _state = PARSE_DONE;
+      if (c != '\n') {
+        // bare CR, the body starts with this character
+        continue;
+      }
+      break;
+
+    case PARSE_DONE:
+    case PARSE_ERROR:
+      break;
+    }
+    ++i;
+  }
+  return i;
+}
+
+const char* RequestParser::headerName(int i) const
+{
+  return (i >= 0 && i < _headerCount) ? _headers[i].name : nullptr;
+}
+
+const char* RequestParser::headerValue(int i) const
+{
+  return (i >= 0 && i < _headerCount) ? _headers[i].value : nullptr;
+}
+
+const char* RequestParser::header(const char* name) const
+{
+  for (int i = 0; i < _headerCount; ++i) {
+    if (strcasecmp(_headers[i].name, name) == 0) {
+      return _headers[i].value;
+    }
+  }
+  return nullptr;
+}
+
+static int hexValue(char c)
+{
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+size_t RequestParser::urlDecode(char* data, size_t len)
+{
+  size_t out = 0;
+  for (size_t i = 0; i < len; ++i) {
+    char c = data[i];
+    if (c == '+') {
+      c = ' ';
+    } else if (c == '%' && i + 2 < len) {
+      int hi = hexValue(data[i + 1]);
+      int lo = hexValue(data[i + 2]);
+      if (hi >= 0 && lo >= 0) {
+        c = (char) ((hi << 4) | lo);
+        i += 2;
+      }
+    }
+    data[out++] = c;
+  }
+  return out;
+}
+
+bool RequestParser::parseContentLength(const char* value, uint32_t& length)
+{
+  // strtoul() would take a sign, and wrap "-1" around to the maximum
+  if (*value < '0' || *value > '9') {
+    return false;
+  }
+  errno = 0;
+  char* end;
+  unsigned long parsed = strtoul(value, &end, 10);
+  if (*end || errno == ERANGE || parsed > UINT32_MAX) {
+    return false;
+  }
+  length = parsed;
+  return true;
+}
+
+bool RequestParser::parseArguments(char* data, size_t len)
+{
+  char* end = data + len;
+  char* pos = data;
+  while (pos < end) {
+    char* next = (char*) memchr(pos, '&', end - pos);
+    if (!next) {
+      next = end;
+    }
+    char* equal = (char*) memchr(pos, '=', next - pos);
+    if (equal) {
+      if (_argCount == HTTP_MAX_ARGS) {
+        return false;
+      }
+      // decoded text is never longer, so the delimiters can hold the NULs
+      pos[urlDecode(pos, equal - pos)] = 0;
+      equal[1 + urlDecode(equal + 1, next - equal - 1)] = 0;
+      _args[_argCount].name = pos;
+      _args[_argCount].value = equal + 1;
+      ++_argCount;
+    }
+    pos = next + 1;
+  }
+  return true;
+}
+
+char* RequestParser::reserve(size_t len)
+{
+  if (len > freeSpace()) {
+    return nullptr;
+  }
+  char* ptr = _buf + _len;
+  _len += len;
+  return ptr;
+}
+
+bool RequestParser::addArgument(const char* name, const char* value)
+{
+  if (_argCount == HTTP_MAX_ARGS) {
+    return false;
+  }
+  size_t nameLen = strlen(name) + 1;
+  size_t valueLen = strlen(value) + 1;
+  char* ptr = reserve(nameLen + valueLen);
+  if (!ptr) {
+    return false;
+  }
+  memcpy(ptr, name, nameLen);
+  memcpy(ptr + nameLen, value, valueLen);
+  _args[_argCount].name = ptr;
+  _args[_argCount].value = ptr + nameLen;
+  ++_argCount;
+  return true;
+}
+
+bool RequestParser::parseQuery()
+{
+  if (_query == empty) {
+    return true;
+  }
+  char* query = _buf + (_query - _buf);
+  return parseArguments(query, strlen(query));
+}
+
+bool RequestParser::addArgumentRef(const char* name, const char* value)
+{
+  if (_argCount == HTTP_MAX_ARGS) {
+    return false;
+  }
+  _args[_argCount].name = name;
+  _args[_argCount].value = value;
+  ++_argCount;
+  return true;
+}
+
+const char* RequestParser::argName(int i) const
+{
+  return (i >= 0 && i < _argCount) ? _args[i].name : nullptr;
+}
+
+const char* RequestParser::argValue(int i) const
+{
+  return (i >= 0 && i < _argCount) ? _args[i].value : nullptr;
+}
+
+const char* RequestParser::arg(const char* name) const
+{
+  for (int i = 0; i < _argCount; ++i) {
+    if (strcmp(_args[i].name, name) == 0) {
+      return _args[i].value;
+    }
+  }
+  return nullptr;
+}
@@ -0,0 +1,159 @@
+/*
+  RequestParser.h - Incremental, allocation-free HTTP request parser.
+
+  Copyright (c) 2015 Ivan Grokhotkov. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef REQUESTPARSER_H
+#define REQUESTPARSER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef HTTP_REQUEST_BUFLEN
+#define HTTP_REQUEST_BUFLEN 1024
+#endif
+
+#ifndef HTTP_MAX_HEADERS
+#define HTTP_MAX_HEADERS 16
+#endif
+
+#ifndef HTTP_MAX_ARGS
+#define HTTP_MAX_ARGS 32
+#endif
+
+// Parses the request line and header block of an HTTP request as it
+// arrives, in any fragmentation. The parts that are kept are copied once
+// into a fixed-size buffer and NUL-terminated in place; all accessors
+// return pointers into that buffer, valid until reset().
+class RequestParser
+{
+public:
+  enum State {
+    PARSE_METHOD,
+    PARSE_URI,
+    PARSE_QUERY,
+    PARSE_VERSION,
+    PARSE_LINE_END,
+    PARSE_HEADER_START,
+    PARSE_HEADER_NAME,
+    PARSE_HEADER_VALUE_START,
+    PARSE_HEADER_VALUE,
+    PARSE_HEADER_SKIP,
+    PARSE_HEADERS_END,
+    PARSE_DONE,
+    PARSE_ERROR
+  };
+
+  // Why the request was refused, once failed()
+  enum Error {
+    ERROR_NONE,
+    ERROR_MALFORMED,
+    ERROR_URI_TOO_LONG,       // the request line did not fit in the buffer
+    ERROR_HEADERS_TOO_LARGE   // neither did the headers kept
+  };
+
+  // Decides whether a header (by name) is worth keeping
+  typedef bool (*THeaderFilter)(void* arg, const char* name);
+
+  RequestParser();
+
+  void reset();
+  void setHeaderFilter(THeaderFilter filter, void* arg);
+
+  // Consumes input up to the end of the header block and returns the
+  // number of bytes used; anything after it belongs to the request body
+  size_t feed(const char* data, size_t len);
+
+  State state() const { return _state; }
+  bool done() const { return _state == PARSE_DONE; }
+  bool failed() const { return _state == PARSE_ERROR; }
+  Error error() const { return _error; }
+
+  const char* method() const { return _method; }
+  const char* uri() const { return _uri; }
+  const char* query() const { return _query; }
+  uint8_t version() const { return _version; }
+
+  int headers() const { return _headerCount; }
+  const char* headerName(int i) const;
+  const char* headerValue(int i) const;
+  // Case-insensitive lookup, nullptr if not present
+  const char* header(const char* name) const;
+
+  // Splits url-encoded "key=value&..." pairs and decodes them in place.
+  // data[len] must be writable; pairs without '=' are skipped.
+  bool parseArguments(char* data, size_t len);
+  bool parseQuery();
+  // Copies name and value into the parser buffer
+  bool addArgument(const char* name, const char* value);
+  // Refers to strings that outlive the request instead of copying them
+  bool addArgumentRef(const char* name, const char* value);
+
+  int args() const { return _argCount; }
+  const char* argName(int i) const;
+  const char* argValue(int i) const;
+  // Case-sensitive lookup, nullptr if not present
+  const char* arg(const char* name) const;
+
+  // Hands out unused buffer space (e.g. for a small request body)
+  char* reserve(size_t len);
+  size_t freeSpace() const { return sizeof(_buf) - _len; }
+
+  static size_t urlDecode(char* data, size_t len);
+  // A Content-Length value: digits only, no sign, and no more than fits
+  // in 32 bits
+  static bool parseContentLength(const char* value, uint32_t& length);
+
+protected:
+  struct Entry {
+    const char* name;
+    const char* value;
+  };
+
+  void _fail(Error error);
+  bool _put(char c);
+  bool _terminate();
+  bool _parseVersion(const char* version);
+  void _endHeaderValue();
+
+  State _state;
+  Error _error;
+  uint16_t _len;
+  uint16_t _mark;
+  uint8_t _version;
+
+  const char* _method;
+  const char* _uri;
+  const char* _query;
+
+  THeaderFilter _filter;
+  void* _filterArg;
+
+  int _headerCount;
+  Entry _headers[HTTP_MAX_HEADERS];
+  int _argCount;
+  Entry _args[HTTP_MAX_ARGS];
+
+  char _buf[HTTP_REQUEST_BUFLEN];
+
+private:
+  RequestParser(const RequestParser&);
+  RequestParser& operator=(const RequestParser&);
+};
+
+#endif //REQUESTPARSER_H
@@ -0,0 +1,281 @@
+/*
+  RouteTable.cpp - Prefix tree of request routes.
+
+  Copyright (c) 2015 Ivan Grokhotkov. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "RouteTable.h"
+
+RouteTable::RouteTable()
+: _nodes(nullptr)
+, _nodeCount(0)
+, _nodeCapacity(0)
+, _entries(nullptr)
+, _entryCount(0)
+, _entryCapacity(0)
+, _fallbacks(nullptr)
+, _fallbackCount(0)
+{
+}
+
+RouteTable::~RouteTable()
+{
+  clear();
+}
+
+void RouteTable::clear()
+{
+  free(_nodes);
+  free(_entries);
+  free(_fallbacks);
+  _nodes = nullptr;
+  _entries = nullptr;
+  _fallbacks = nullptr;
+  _nodeCount = _nodeCapacity = 0;
+  _entryCount = _entryCapacity = 0;
+  _fallbackCount = 0;
+}
+
+bool RouteTable::reserve(size_t entries, size_t segments)
+{
+  clear();
+  // one more node for the root
+  if (entries >= NONE || segments + 1 >= NONE) {
+    return false;
+  }
+  _nodes = (Node*) malloc((segments + 1) * sizeof(Node));
+  _entries = (Entry*) malloc((entries ? entries : 1) * sizeof(Entry));
+  _fallbacks = (uint16_t*) malloc((entries ? entries : 1) * sizeof(uint16_t));
+  if (!_nodes || !_entries || !_fallbacks) {
+    clear();
+    return false;
+  }
+  _nodeCapacity = segments + 1;
+  _entryCapacity = entries;
+
+  Node& root = _nodes[_nodeCount++];
+  root.text = "";
+  root.len = 0;
+  root.child = NONE;
+  root.sibling = NONE;
+  root.entry = NONE;
+  return true;
+}
+
+bool RouteTable::routable(const char* pattern)
+{
+  return pattern && pattern[0] == '/';
+}
+
+size_t RouteTable::segments(const char* pattern)
+{
+  if (!routable(pattern) || !pattern[1]) {
+    return 0;
+  }
+  size_t count = 0;
+  for (; *pattern; ++pattern) {
+    if (*pattern == '/') {
+      ++count;
+    }
+  }
+  return count;
+}
+
+bool RouteTable::_isParam(const char* seg, size_t len)
+{
+  return len >= 2 && seg[0] == '{' && seg[len - 1] == '}';
+}
+
+uint16_t RouteTable::_child(uint16_t node, const char* seg, size_t len, bool param)
+{
+  uint16_t* link = &_nodes[node].child;
+  for (; *link != NONE; link = &_nodes[*link].sibling) {
+    const Node& child = _nodes[*link];
+    if (param ? !child.text : (child.text && child.len == len && memcmp(child.text, seg, len) == 0)) {
+      return *link;
+    }
+  }
+  if (_nodeCount == _nodeCapacity) {
+    return NONE;
+  }
+  uint16_t index = _nodeCount++;
+  Node& child = _nodes[index];
+  child.text = param ? nullptr : seg;
+  child.len = param ? 0 : len;
+  child.child = NONE;
+  child.sibling = NONE;
+  child.entry = NONE;
+  *link = index;
+  return index;
+}
+
+bool RouteTable::add(int method, const char* pattern, void* target)
+{
+  if (_entryCount == _entryCapacity || (pattern && !routable(pattern))) {
+    return false;
+  }
+
+  uint16_t node = 0;
+  if (pattern) {
+    for (const char* pos = pattern + 1; *pos; ) {
+      const char* slash = strchr(pos, '/');
+      size_t len = slash ? (size_t) (slash - pos) : strlen(pos);
+      node = _child(node, pos, len, _isParam(pos, len));
+      if (node == NONE) {
+        return false;
+      }
+      if (!slash) {
+        break;
+      }
+      pos = slash + 1;
+      if (!*pos) {
+        // trailing slash, an empty last segment
+        node = _child(node, pos, 0, false);
+        if (node == NONE) {
+          return false;
+        }
+      }
+    }
+  }
+
+  uint16_t index = _entryCount++;
+  Entry& entry = _entries[index];
+  entry.target = target;
+  entry.method = method;
+  entry.order = index;
+  entry.next = NONE;
+
+  if (!pattern) {
+    _fallbacks[_fallbackCount++] = index;
+    return true;
+  }
+  // keep registration order within a node
+  uint16_t* link = &_nodes[node].entry;
+  while (*link != NONE) {
+    link = &_entries[*link].next;
+  }
+  *link = index;
+  return true;
+}
+
+void RouteTable::_visit(uint16_t node, MatchState& state) const
+{
+  for (uint16_t i = _nodes[node].entry; i != NONE; i = _entries[i].next) {
+    const Entry& entry = _entries[i];
+    if (entry.method != ANY_METHOD && entry.method != state.method) {
+      continue;
+    }
+    if (!state.best || entry.order < state.best->order) {
+      state.best = &entry;
+      state.bestCount = state.count;
+      memcpy(state.captures, state.current, state.count * sizeof(Capture));
+    }
+    return;
+  }
+}
+
+void RouteTable::_match(uint16_t node, const char* pos, MatchState& state) const
+{
+  const char* slash = (const char*) memchr(pos, '/', state.end - pos);
+  const char* segEnd = slash ? slash : state.end;
+  size_t len = segEnd - pos;
+
+  for (uint16_t i = _nodes[node].child; i != NONE; i = _nodes[i].sibling) {
+    const Node& child = _nodes[i];
+    if (child.text) {
+      if (child.len != len || memcmp(child.text, pos, len) != 0) {
+        continue;
+      }
+    } else {
+      if (!len || state.count == ROUTE_MAX_PARAMS) {
+        continue;
+      }
+      state.current[state.count].offset = pos - state.uri;
+      state.current[state.count].len = len;
+      ++state.count;
+    }
+
+    if (slash) {
+      _match(i, slash + 1, state);
+    } else {
+      _visit(i, state);
+    }
+
+    if (!child.text) {
+      --state.count;
+    }
+  }
+}
+
+const RouteTable::Entry* RouteTable::match(int method, const char* uri, size_t len,
+                                           Capture* captures, uint8_t& captureCount) const
+{
+  captureCount = 0;
+  if (!_nodeCount || !len || uri[0] != '/') {
+    return nullptr;
+  }
+
+  MatchState state;
+  state.method = method;
+  state.uri = uri;
+  state.end = uri + len;
+  state.best = nullptr;
+  state.count = 0;
+  state.bestCount = 0;
+  state.captures = captures;
+
+  if (len == 1) {
+    _visit(0, state);
+  } else {
+    _match(0, uri + 1, state);
+  }
+  captureCount = state.bestCount;
+  return state.best;
+}
+
+bool RouteTable::matches(const char* pattern, const char* uri, size_t len)
+{
+  if (!routable(pattern) || !len || uri[0] != '/') {
+    return false;
+  }
+  const char* p = pattern + 1;
+  const char* u = uri + 1;
+  const char* end = uri + len;
+  if (!*p || u == end) {
+    return !*p && u == end;
+  }
+  for (;;) {
+    const char* ps = strchr(p, '/');
+    size_t plen = ps ? (size_t) (ps - p) : strlen(p);
+    const char* us = (const char*) memchr(u, '/', end - u);
+    size_t ulen = us ? (size_t) (us - u) : (size_t) (end - u);
+    if (_isParam(p, plen)) {
+      if (!ulen) {
+        return false;
+      }
+    } else if (plen != ulen || memcmp(p, u, plen) != 0) {
+      return false;
+    }
+    if (!ps || !us) {
+      return !ps && !us;
+    }
+    p = ps + 1;
+    u = us + 1;
+  }
+}
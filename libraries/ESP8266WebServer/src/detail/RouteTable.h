@@ -0,0 +1,121 @@
+/*
+  RouteTable.h - Prefix tree of request routes.
+
+  Copyright (c) 2015 Ivan Grokhotkov. All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef ROUTETABLE_H
+#define ROUTETABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef ROUTE_MAX_PARAMS
+#define ROUTE_MAX_PARAMS 8
+#endif
+
+// Dispatches request URIs over a tree of path segments. Patterns are
+// absolute paths whose segments are either literal or "{}" / "{name}",
+// which matches one non-empty segment and captures it as a parameter.
+//
+// Targets are opaque; entries added without a pattern are "fallbacks" the
+// caller has to probe itself, in order. Registration order is kept, so
+// callers can emulate first-match-wins over the mix of both. The tree is
+// built with reserve() and add() once; match() never allocates and
+// pattern strings must outlive the table.
+class RouteTable
+{
+public:
+  static const int ANY_METHOD = -1;
+  static const uint16_t NONE = 0xffff;
+
+  struct Entry {
+    void* target;
+    int method;
+    uint16_t order;
+    uint16_t next;  // next entry ending at the same node
+  };
+
+  struct Capture {
+    uint16_t offset;
+    uint16_t len;
+  };
+
+  RouteTable();
+  ~RouteTable();
+
+  void clear();
+  // Room for this many entries and pattern segments, see segments()
+  bool reserve(size_t entries, size_t segments);
+  // nullptr pattern adds a fallback
+  bool add(int method, const char* pattern, void* target);
+
+  // Best (earliest registered) route for method and uri, or nullptr;
+  // captures receives the parameters as offsets into uri
+  const Entry* match(int method, const char* uri, size_t len,
+                     Capture* captures, uint8_t& captureCount) const;
+
+  size_t fallbacks() const { return _fallbackCount; }
+  const Entry& fallback(size_t i) const { return _entries[_fallbacks[i]]; }
+  size_t size() const { return _entryCount; }
+
+  // Whether pattern can be routed, and the number of tree segments it needs
+  static bool routable(const char* pattern);
+  static size_t segments(const char* pattern);
+  // Matches a single pattern, without building a tree
+  static bool matches(const char* pattern, const char* uri, size_t len);
+
+protected:
+  struct Node {
+    const char* text;   // nullptr for a parameter segment
+    uint16_t len;
+    uint16_t child;
+    uint16_t sibling;
+    uint16_t entry;
+  };
+
+  struct MatchState {
+    int method;
+    const char* uri;
+    const char* end;
+    const Entry* best;
+    uint8_t count;
+    uint8_t bestCount;
+    Capture current[ROUTE_MAX_PARAMS];
+    Capture* captures;
+  };
+
+  static bool _isParam(const char* seg, size_t len);
+  uint16_t _child(uint16_t node, const char* seg, size_t len, bool param);
+  void _visit(uint16_t node, MatchState& state) const;
+  void _match(uint16_t node, const char* pos, MatchState& state) const;
+
+  Node* _nodes;
+  uint16_t _nodeCount;
+  uint16_t _nodeCapacity;
+  Entry* _entries;
+  uint16_t _entryCount;
+  uint16_t _entryCapacity;
+  uint16_t* _fallbacks;
+  uint16_t _fallbackCount;
+
+private:
+  RouteTable(const RouteTable&);
+  RouteTable& operator=(const RouteTable&);
+};
+
+#endif //ROUTETABLE_H
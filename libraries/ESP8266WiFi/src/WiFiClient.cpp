@@ -162,11 +162,34 @@ bool WiFiClient::getNoDelay() {
     return _client->getNoDelay();
 }
 
+void WiFiClient::setSync(bool sync) {
+    if (!_client)
+        return;
+    _client->setSync(sync);
+}
+
+bool WiFiClient::getSync() {
+    if (!_client)
+        return false;
+    return _client->getSync();
+}
+
 size_t WiFiClient::availableForWrite ()
 {
     return _client? _client->availableForWrite(): 0;
 }
 
+size_t WiFiClient::writeSome(const uint8_t* data, size_t size)
+{
+    return _client? _client->writeSome(data, size): 0;
+}
+
+void WiFiClient::setEventCallback(EventCallback cb, void* arg)
+{
+    if (_client)
+        _client->setEventCallback(cb, arg);
+}
+
 size_t WiFiClient::write(uint8_t b)
 {
     return write(&b, 1);
@@ -264,6 +287,22 @@ size_t WiFiClient::peekBytes(uint8_t *buffer, size_t length) {
     return _client->peekBytes((char *)buffer, count);
 }
 
+const char* WiFiClient::peekBuffer()
+{
+    return _client? _client->peekBuffer(): nullptr;
+}
+
+size_t WiFiClient::peekAvailable()
+{
+    return _client? _client->peekAvailable(): 0;
+}
+
+void WiFiClient::peekConsume(size_t consume)
+{
+    if (_client)
+        _client->peekConsume(consume);
+}
+
 void WiFiClient::flush()
 {
     if (_client)
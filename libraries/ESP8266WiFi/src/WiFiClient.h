@@ -67,6 +67,12 @@ public:
   size_t peekBytes(char *buffer, size_t length) {
     return peekBytes((uint8_t *) buffer, length);
   }
+  // Zero-copy receive, see Stream::peekBuffer(): each chunk is the rest of
+  // the current lwIP pbuf segment.
+  virtual bool hasPeekBufferAPI() const { return true; }
+  virtual size_t peekAvailable();
+  virtual const char* peekBuffer();
+  virtual void peekConsume(size_t consume);
   virtual void flush();
   virtual void stop();
   virtual uint8_t connected();
@@ -78,9 +84,24 @@ public:
   uint16_t  localPort();
   bool getNoDelay();
   void setNoDelay(bool nodelay);
+  // When sync, write() returns only after the peer acknowledged the data,
+  // which lets buffers be sent without an extra copy into lwIP memory
+  bool getSync();
+  void setSync(bool sync);
   static void setLocalPortStart(uint16_t port) { _localPort = port; }
 
   size_t availableForWrite();
+  // Copies as much of data into lwIP as it takes right now, without waiting
+  // for acknowledgements, and returns how much that was
+  size_t writeSome(const uint8_t* data, size_t size);
+  enum Event { EVENT_RECEIVED, EVENT_SENT, EVENT_CLOSED };
+  // data and len: the segment received, or len: the number of bytes acked
+  typedef void (*EventCallback)(void* arg, Event event, const char* data, size_t len);
+  // Follows the connection without polling it, for servers that serve
+  // several clients at once. cb runs in the lwIP handlers, so it should only
+  // take notes; data received earlier is replayed right away. Copies of this
+  // client share the callback, set it to nullptr before the last one goes.
+  void setEventCallback(EventCallback cb, void* arg);
 
   friend class WiFiServer;
 
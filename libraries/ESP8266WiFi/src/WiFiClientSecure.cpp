@@ -275,6 +275,35 @@ public:
         return will_copy;
     }
 
+    const char* peekBuffer()
+    {
+        return reinterpret_cast<const char*>(_read_ptr);
+    }
+
+    size_t peekAvailable()
+    {
+        if (!_available) {
+            _readAll();
+        }
+        return _available;
+    }
+
+    void peekConsume(size_t consume)
+    {
+        if (consume > _available) {
+            consume = _available;
+        }
+        _read_ptr += consume;
+        _available -= consume;
+        if (_available == 0) {
+            _read_ptr = nullptr;
+            /* Send pending outgoing data, if any */
+            if (_hasWriteBuffers()) {
+                _writeBuffersSend();
+            }
+        }
+    }
+
     int available()
     {
         auto cb = _available;
@@ -641,6 +670,23 @@ size_t WiFiClientSecure::peekBytes(uint8_t *buffer, size_t length)
     return _ssl->peekBytes((char *)buffer, count);
 }
 
+const char* WiFiClientSecure::peekBuffer()
+{
+    return _ssl? _ssl->peekBuffer(): nullptr;
+}
+
+size_t WiFiClientSecure::peekAvailable()
+{
+    return _ssl? _ssl->peekAvailable(): 0;
+}
+
+void WiFiClientSecure::peekConsume(size_t consume)
+{
+    if (_ssl) {
+        _ssl->peekConsume(consume);
+    }
+}
+
 int WiFiClientSecure::available()
 {
     if (!_ssl) {
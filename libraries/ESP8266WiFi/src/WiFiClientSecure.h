@@ -49,6 +49,9 @@ public:
   int read() override;
   int peek() override;
   size_t peekBytes(uint8_t *buffer, size_t length) override;
+  const char* peekBuffer() override;
+  size_t peekAvailable() override;
+  void peekConsume(size_t consume) override;
   void stop() override;
 
   bool setCACert(const uint8_t* pk, size_t size);
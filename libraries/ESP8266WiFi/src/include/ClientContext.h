@@ -22,7 +22,6 @@
 #define CLIENTCONTEXT_H
 
 class ClientContext;
-class WiFiClient;
 
 typedef void (*discard_cb_t)(void*, ClientContext*);
 
@@ -30,6 +29,7 @@ extern "C" void esp_yield();
 extern "C" void esp_schedule();
 
 #include "DataSource.h"
+#include "../WiFiClient.h"
 
 class ClientContext
 {
@@ -142,6 +142,22 @@ public:
         return 1;
     }
 
+    // Lets the owner follow the connection without polling it. The callback
+    // runs in the lwIP handlers, before any esp_yield()ing caller resumes, so
+    // it should only take notes. Data received earlier is replayed right away.
+    void setEventCallback(WiFiClient::EventCallback cb, void* arg)
+    {
+        _event_cb = cb;
+        _event_cb_arg = arg;
+        for (pbuf* p = _rx_buf; cb && p; p = p->next) {
+            size_t offset = (p == _rx_buf) ? _rx_buf_offset : 0;
+            cb(arg, WiFiClient::EVENT_RECEIVED, reinterpret_cast<const char*>(p->payload) + offset, p->len - offset);
+        }
+        if (cb && !_pcb) {
+            cb(arg, WiFiClient::EVENT_CLOSED, nullptr, 0);
+        }
+    }
+
     size_t availableForWrite()
     {
         return _pcb? tcp_sndbuf(_pcb): 0;
@@ -177,6 +193,16 @@ public:
         return _timeout_ms;
     }
 
+    void setSync(bool sync)
+    {
+        _sync = sync;
+    }
+
+    bool getSync() const
+    {
+        return _sync;
+    }
+
     uint32_t getRemoteAddress()
     {
         if(!_pcb) {
@@ -283,6 +309,35 @@ public:
         return copy_size;
     }
 
+    const char* peekBuffer()
+    {
+        if(!_rx_buf) {
+            return nullptr;
+        }
+
+        return reinterpret_cast<const char*>(_rx_buf->payload) + _rx_buf_offset;
+    }
+
+    size_t peekAvailable()
+    {
+        if(!_rx_buf) {
+            return 0;
+        }
+
+        return _rx_buf->len - _rx_buf_offset;
+    }
+
+    void peekConsume(size_t consume)
+    {
+        DEBUGV(":pc %d\r\n", consume);
+        while(consume && _rx_buf) {
+            size_t buf_size = _rx_buf->len - _rx_buf_offset;
+            size_t consume_size = (consume < buf_size) ? consume : buf_size;
+            _consume(consume_size);
+            consume -= consume_size;
+        }
+    }
+
     void discard_received()
     {
         if(!_rx_buf) {
@@ -335,6 +390,9 @@ public:
         if (!_pcb) {
             return 0;
         }
+        if (stream.hasPeekBufferAPI()) {
+            return _write_from_source(new PeekStreamDataSource(stream, stream.available()));
+        }
         return _write_from_source(new BufferedStreamDataSource<Stream>(stream, stream.available()));
     }
 
@@ -347,6 +405,33 @@ public:
         return _write_from_source(new BufferedStreamDataSource<ProgmemStream>(stream, size));
     }
 
+    // Copies as much of data into lwIP as it takes right now, without
+    // waiting for acknowledgements, and returns how much that was
+    size_t writeSome(const uint8_t* data, size_t size)
+    {
+        if (!_pcb || _datasource) {
+            return 0;
+        }
+        size_t written = 0;
+        while (size && _pcb->snd_queuelen < TCP_SND_QUEUELEN) {
+            size_t can_send = tcp_sndbuf(_pcb);
+            size_t next_chunk = (size < _write_chunk_size) ? size : _write_chunk_size;
+            next_chunk = (next_chunk < can_send) ? next_chunk : can_send;
+            if (!next_chunk || tcp_write(_pcb, data, next_chunk, TCP_WRITE_FLAG_COPY) != ERR_OK) {
+                break;
+            }
+            DEBUGV(":wsm %d %d\r\n", next_chunk, size);
+            data += next_chunk;
+            size -= next_chunk;
+            written += next_chunk;
+        }
+        if (written) {
+            _op_start_time = millis();
+            tcp_output(_pcb);
+        }
+        return written;
+    }
+
     void keepAlive (uint16_t idle_sec = TCP_DEFAULT_KEEPALIVE_IDLE_SEC, uint16_t intv_sec = TCP_DEFAULT_KEEPALIVE_INTERVAL_SEC, uint8_t count = TCP_DEFAULT_KEEPALIVE_COUNT)
     {
         if (idle_sec && intv_sec && count) {
@@ -418,9 +503,30 @@ protected:
             esp_yield();
         } while(true);
         _send_waiting = 0;
+        if (_sync) {
+            _wait_acked();
+        }
         return _written;
     }
 
+    void _wait_acked()
+    {
+        // In sync mode data may be queued by reference, so it must
+        // not be left with lwIP once the caller regains its buffer.
+        // A closing connection still retransmits, so only CLOSED ends
+        // the wait early.
+        while (state() != CLOSED && tcp_sndbuf(_pcb) != TCP_SND_BUF) {
+            if (_is_timeout()) {
+                DEBUGV(":atmo\r\n");
+                abort();
+                break;
+            }
+            ++_send_waiting;
+            esp_yield();
+        }
+        _send_waiting = 0;
+    }
+
     bool _write_some()
     {
         if (!_datasource || !_pcb) {
@@ -435,15 +541,23 @@ protected:
         size_t will_send = (can_send < left) ? can_send : left;
         DEBUGV(":wr %d %d %d\r\n", will_send, left, _written);
         bool need_output = false;
+        // with sync writes, persistent data is acked before write() returns
+        uint8_t flags = (_sync && _datasource->persistent()) ? 0 : TCP_WRITE_FLAG_COPY;
+        // uncopied data needs no intermediate allocation, so it is not chunked
+        size_t chunk_size = flags ? _write_chunk_size : will_send;
         while( will_send && _datasource) {
             size_t next_chunk =
-                will_send > _write_chunk_size ? _write_chunk_size : will_send;
+                will_send > chunk_size ? chunk_size : will_send;
+            size_t in_place = _datasource->in_place_available();
+            if (in_place && next_chunk > in_place) {
+                next_chunk = in_place;
+            }
             const uint8_t* buf = _datasource->get_buffer(next_chunk);
             if (state() == CLOSED) {
                 need_output = false;
                 break;
             }
-            err_t err = tcp_write(_pcb, buf, next_chunk, TCP_WRITE_FLAG_COPY);
+            err_t err = tcp_write(_pcb, buf, next_chunk, flags);
             DEBUGV(":wrc %d %d %d\r\n", next_chunk, will_send, (int) err);
             if (err == ERR_OK) {
                 _datasource->release_buffer(buf, next_chunk);
@@ -463,6 +577,13 @@ protected:
         return false;
     }
 
+    void _notify_event(WiFiClient::Event event, const char* data, size_t len)
+    {
+        if (_event_cb) {
+            _event_cb(_event_cb_arg, event, data, len);
+        }
+    }
+
     void _write_some_from_cb()
     {
         if (_send_waiting == 1) {
@@ -476,7 +597,9 @@ protected:
         (void) pcb;
         (void) len;
         DEBUGV(":ack %d\r\n", len);
+        _op_start_time = millis();
         _write_some_from_cb();
+        _notify_event(WiFiClient::EVENT_SENT, nullptr, len);
         return ERR_OK;
     }
 
@@ -514,6 +637,7 @@ protected:
             DEBUGV(":rcl\r\n");
             _notify_error();
             abort();
+            _notify_event(WiFiClient::EVENT_CLOSED, nullptr, 0);
             return ERR_ABRT;
         }
 
@@ -527,6 +651,9 @@ protected:
             _rx_buf = pb;
             _rx_buf_offset = 0;
         }
+        for (pbuf* p = pb; _event_cb && p; p = p->next) {
+            _notify_event(WiFiClient::EVENT_RECEIVED, reinterpret_cast<const char*>(p->payload), p->len);
+        }
         return ERR_OK;
     }
 
@@ -540,6 +667,7 @@ protected:
         tcp_err(_pcb, NULL);
         _pcb = nullptr;
         _notify_error();
+        _notify_event(WiFiClient::EVENT_CLOSED, nullptr, 0);
     }
 
     err_t _connected(struct tcp_pcb *pcb, err_t err)
@@ -599,6 +727,10 @@ private:
     uint32_t _op_start_time = 0;
     uint8_t _send_waiting = 0;
     uint8_t _connect_pending = 0;
+    bool _sync = false;
+
+    WiFiClient::EventCallback _event_cb = nullptr;
+    void* _event_cb_arg = nullptr;
 
     int8_t _refcnt;
     ClientContext* _next;
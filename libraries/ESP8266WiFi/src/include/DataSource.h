@@ -13,7 +13,12 @@ public:
     virtual size_t available() = 0;
     virtual const uint8_t* get_buffer(size_t size) = 0;
     virtual void release_buffer(const uint8_t* buffer, size_t size) = 0;
-
+    // Buffers handed out stay valid and unchanged until the write completes,
+    // so they can be queued by reference instead of copied
+    virtual bool persistent() const { return false; }
+    // How much of the data can be handed out without staging it, writes
+    // are cut to this when it is not zero
+    virtual size_t in_place_available() { return 0; }
 };
 
 class BufferDataSource : public DataSource {
@@ -43,6 +48,11 @@ public:
         _pos += size;
     }
 
+    bool persistent() const override
+    {
+        return true;
+    }
+
 protected:
     const uint8_t* _data;
     const size_t _size;
@@ -127,6 +137,55 @@ protected:
     size_t _streamPos = 0;
 };
 
+// Hands out the stream's own buffer where it has one (see
+// Stream::peekBuffer()), so the data is copied once, into lwIP. Files
+// and StreamString read this way need no staging buffer.
+class PeekStreamDataSource : public BufferedStreamDataSource<Stream> {
+public:
+    PeekStreamDataSource(Stream& stream, size_t size) :
+        BufferedStreamDataSource<Stream>(stream, size)
+    {
+    }
+
+    size_t in_place_available() override
+    {
+        if (_streamPos != _pos || !available()) {
+            // staged data goes first
+            return 0;
+        }
+        if (!_stream.peekAvailable()) {
+            // lets a buffered stream fill its buffer
+            _stream.peek();
+        }
+        size_t in_place = _stream.peekAvailable();
+        return (in_place < available()) ? in_place : available();
+    }
+
+    const uint8_t* get_buffer(size_t size) override
+    {
+        _peeked = (_streamPos == _pos && _stream.peekAvailable() >= size);
+        if (_peeked) {
+            return reinterpret_cast<const uint8_t*>(_stream.peekBuffer());
+        }
+        return BufferedStreamDataSource<Stream>::get_buffer(size);
+    }
+
+    void release_buffer(const uint8_t* buffer, size_t size) override
+    {
+        if (!_peeked) {
+            BufferedStreamDataSource<Stream>::release_buffer(buffer, size);
+            return;
+        }
+        _stream.peekConsume(size);
+        _pos += size;
+        _streamPos += size;
+        _peeked = false;
+    }
+
+protected:
+    bool _peeked = false;
+};
+
 class ProgmemStream
 {
 public:
@@ -23,7 +23,15 @@ extern "C" unsigned long millis()
 {
     timeval time;
     gettimeofday(&time, NULL);
-    return (time.tv_sec * 1000) + (time.tv_usec / 1000);
+    // wraps around at 32 bits, like on the target
+    return (uint32_t) ((time.tv_sec * 1000) + (time.tv_usec / 1000));
+}
+
+extern "C" unsigned long micros()
+{
+    timeval time;
+    gettimeofday(&time, NULL);
+    return (uint32_t) ((time.tv_sec * 1000000) + time.tv_usec);
 }
 
 
@@ -31,6 +39,10 @@ extern "C" void yield()
 {
 }
 
+extern "C" void optimistic_yield(uint32_t interval_us)
+{
+}
+
 
 extern "C" void __panic_func(const char* file, int line, const char* func) {
     abort();
@@ -39,3 +51,28 @@ extern "C" void __panic_func(const char* file, int line, const char* func) {
 extern "C" void delay(unsigned long ms)
 {
 }
+
+extern "C" void esp_yield()
+{
+}
+
+extern "C" void esp_schedule()
+{
+}
+
+// Serial is never used, but Print and Stream calls get devirtualized into
+// HardwareSerial when optimizing
+extern "C" size_t uart_write_char(uart_t* uart, char c)
+{
+    return 0;
+}
+
+extern "C" int uart_peek_char(uart_t* uart)
+{
+    return -1;
+}
+
+extern "C" int uart_read_char(uart_t* uart)
+{
+    return -1;
+}
@@ -34,8 +34,12 @@ extern "C" {
 #include <math.h>
     
 #include "binary.h"
+#include "c_types.h"
 #include "twi.h"
 #include "core_esp8266_features.h"
+
+    // esp8266_peri.h is left out, of its registers only this one is used
+#define RANDOM_REG32 ((uint32_t) rand())
     
 #define HIGH 0x1
 #define LOW  0x0
@@ -236,6 +240,7 @@ extern "C" {
 
 #ifdef __cplusplus
 
+#include <algorithm>
 #include "pgmspace.h"
 
 #include "WCharacter.h"
@@ -246,11 +251,8 @@ extern "C" {
 #include "Updater.h"
 #include "debug.h"
 
-#ifndef _GLIBCXX_VECTOR
-// arduino is not compatible with std::vector
-#define min(a,b) ((a)<(b)?(a):(b))
-#define max(a,b) ((a)>(b)?(a):(b))
-#endif
+using std::min;
+using std::max;
 
 #define _min(a,b) ((a)<(b)?(a):(b))
 #define _max(a,b) ((a)>(b)?(a):(b))
@@ -0,0 +1,79 @@
+/*
+ alloc_stats.cpp - heap call counters for host side benchmarks
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+#include "alloc_stats.h"
+
+static AllocStats s_stats;
+
+#ifdef HOST_ALLOC_STATS
+
+extern "C" {
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t nmemb, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void __real_free(void* ptr);
+
+void* __wrap_malloc(size_t size)
+{
+    ++s_stats.allocs;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t nmemb, size_t size)
+{
+    ++s_stats.allocs;
+    return __real_calloc(nmemb, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size)
+{
+    ++(ptr ? s_stats.reallocs : s_stats.allocs);
+    return __real_realloc(ptr, size);
+}
+
+void __wrap_free(void* ptr)
+{
+    if (ptr) {
+        ++s_stats.frees;
+    }
+    __real_free(ptr);
+}
+
+}
+
+bool alloc_stats_supported()
+{
+    return true;
+}
+
+#else
+
+bool alloc_stats_supported()
+{
+    return false;
+}
+
+#endif
+
+void alloc_stats_reset()
+{
+    s_stats = AllocStats();
+}
+
+AllocStats alloc_stats()
+{
+    return s_stats;
+}
@@ -0,0 +1,33 @@
+/*
+ alloc_stats.h - heap call counters for host side benchmarks
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+#ifndef alloc_stats_h
+#define alloc_stats_h
+
+#include <stddef.h>
+
+// Counts malloc/calloc/realloc/free calls made by the core and the tests.
+// Only available where the linker supports --wrap (see Makefile).
+struct AllocStats {
+    size_t allocs;
+    size_t reallocs;
+    size_t frees;
+};
+
+bool alloc_stats_supported();
+void alloc_stats_reset();
+AllocStats alloc_stats();
+
+#endif /* alloc_stats_h */
@@ -0,0 +1,38 @@
+/*
+ c_types.h - SDK header stand-in, the integer types the WiFi headers use
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+#ifndef c_types_h
+#define c_types_h
+
+#include <stdint.h>
+
+typedef uint8_t  uint8;
+typedef int8_t   sint8;
+typedef uint16_t uint16;
+typedef int16_t  sint16;
+typedef uint32_t uint32;
+typedef int32_t  sint32;
+
+#ifndef ICACHE_FLASH_ATTR
+#define ICACHE_FLASH_ATTR
+#endif
+#ifndef ICACHE_RAM_ATTR
+#define ICACHE_RAM_ATTR
+#endif
+#ifndef ICACHE_RODATA_ATTR
+#define ICACHE_RODATA_ATTR
+#endif
+
+#endif /* c_types_h */
@@ -0,0 +1,247 @@
+/*
+ lwip_mock.cpp - minimal lwIP TCP/pbuf mock for host side testing
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+#include <vector>
+#include "lwip_mock.h"
+
+static size_t s_pbuf_live = 0;
+static std::vector<tcp_pcb*> s_pcbs;
+static std::function<void(tcp_pcb*)> s_on_connect;
+
+tcp_pcb* tcp_new()
+{
+    tcp_pcb* pcb = new tcp_pcb;
+    pcb->state = CLOSED;
+    s_pcbs.push_back(pcb);
+    return pcb;
+}
+
+err_t tcp_bind(tcp_pcb* pcb, ip_addr_t* addr, uint16_t port)
+{
+    pcb->local_ip = *addr;
+    pcb->local_port = port;
+    return ERR_OK;
+}
+
+tcp_pcb* tcp_listen(tcp_pcb* pcb)
+{
+    pcb->state = LISTEN;
+    return pcb;
+}
+
+void tcp_accept(tcp_pcb* pcb, tcp_accept_fn accept)
+{
+    pcb->accept = accept;
+}
+
+void tcp_setprio(tcp_pcb* pcb, uint8_t prio)
+{
+    pcb->prio = prio;
+}
+
+void tcp_arg(tcp_pcb* pcb, void* arg)
+{
+    pcb->callback_arg = arg;
+}
+
+void tcp_recv(tcp_pcb* pcb, tcp_recv_fn recv)
+{
+    pcb->recv = recv;
+}
+
+void tcp_sent(tcp_pcb* pcb, tcp_sent_fn sent)
+{
+    pcb->sent = sent;
+}
+
+void tcp_err(tcp_pcb* pcb, tcp_err_fn err)
+{
+    pcb->errf = err;
+}
+
+void tcp_poll(tcp_pcb* pcb, tcp_poll_fn poll, uint8_t interval)
+{
+    (void) interval;
+    pcb->poll = poll;
+}
+
+void tcp_recved(tcp_pcb* pcb, uint16_t len)
+{
+    pcb->recved += len;
+}
+
+void tcp_abort(tcp_pcb* pcb)
+{
+    pcb->state = CLOSED;
+}
+
+err_t tcp_close(tcp_pcb* pcb)
+{
+    pcb->state = CLOSED;
+    return ERR_OK;
+}
+
+err_t tcp_connect(tcp_pcb* pcb, ip_addr_t* addr, uint16_t port, tcp_connected_fn connected)
+{
+    (void) connected;
+    pcb->remote_ip = *addr;
+    pcb->remote_port = port;
+    pcb->state = ESTABLISHED;
+    if (s_on_connect) {
+        s_on_connect(pcb);
+    }
+    return ERR_OK;
+}
+
+err_t tcp_write(tcp_pcb* pcb, const void* data, uint16_t len, uint8_t apiflags)
+{
+    if (pcb->reset) {
+        pcb->state = CLOSED;
+        return ERR_RST;
+    }
+    if (len > pcb->snd_buf || pcb->snd_queuelen >= TCP_SND_QUEUELEN) {
+        return ERR_MEM;
+    }
+    pcb->tx_data.append(reinterpret_cast<const char*>(data), len);
+    if (apiflags & TCP_WRITE_FLAG_COPY) {
+        pcb->tx_copied += len;
+    }
+    pcb->snd_buf -= len;
+    ++pcb->snd_queuelen;
+    return ERR_OK;
+}
+
+err_t tcp_output(tcp_pcb* pcb)
+{
+    ++pcb->outputs;
+    if (pcb->auto_ack) {
+        uint16_t acked = TCP_SND_BUF - pcb->snd_buf;
+        pcb->snd_buf = TCP_SND_BUF;
+        pcb->snd_queuelen = 0;
+        if (pcb->sent && acked) {
+            pcb->sent(pcb->callback_arg, pcb, acked);
+        }
+    }
+    if (pcb->on_output) {
+        pcb->on_output(pcb);
+    }
+    return ERR_OK;
+}
+
+void pbuf_ref(pbuf* p)
+{
+    if (p) {
+        ++p->ref;
+    }
+}
+
+uint8_t pbuf_free(pbuf* p)
+{
+    uint8_t count = 0;
+    while (p && --p->ref == 0) {
+        pbuf* next = p->next;
+        delete[] reinterpret_cast<char*>(p->payload);
+        delete p;
+        --s_pbuf_live;
+        ++count;
+        p = next;
+    }
+    return count;
+}
+
+void pbuf_cat(pbuf* head, pbuf* tail)
+{
+    pbuf* p = head;
+    for (; p->next; p = p->next) {
+        p->tot_len += tail->tot_len;
+    }
+    p->tot_len += tail->tot_len;
+    p->next = tail;
+}
+
+pbuf* pbuf_mock_chain(const char* data, const size_t* seg_lens, size_t segs)
+{
+    size_t total = 0;
+    for (size_t i = 0; i < segs; ++i) {
+        total += seg_lens[i];
+    }
+    pbuf* head = nullptr;
+    pbuf* prev = nullptr;
+    for (size_t i = 0; i < segs; ++i) {
+        pbuf* p = new pbuf;
+        char* payload = new char[seg_lens[i]];
+        memcpy(payload, data, seg_lens[i]);
+        p->next = nullptr;
+        p->payload = payload;
+        p->len = seg_lens[i];
+        p->tot_len = total;
+        p->ref = 1;
+        ++s_pbuf_live;
+        data += seg_lens[i];
+        total -= seg_lens[i];
+        if (prev) {
+            prev->next = p;
+        } else {
+            head = p;
+        }
+        prev = p;
+    }
+    return head;
+}
+
+size_t pbuf_mock_live()
+{
+    return s_pbuf_live;
+}
+
+err_t tcp_mock_deliver(tcp_pcb* pcb, pbuf* p)
+{
+    if (!pcb->recv) {
+        pbuf_free(p);
+        return ERR_OK;
+    }
+    return pcb->recv(pcb->callback_arg, pcb, p, ERR_OK);
+}
+
+tcp_pcb* tcp_mock_accept(uint16_t port)
+{
+    for (tcp_pcb* listener : s_pcbs) {
+        if (listener->state != LISTEN || listener->local_port != port || !listener->accept) {
+            continue;
+        }
+        tcp_pcb* pcb = new tcp_pcb;
+        pcb->local_port = port;
+        s_pcbs.push_back(pcb);
+        if (listener->accept(listener->callback_arg, pcb, ERR_OK) != ERR_OK) {
+            return nullptr;
+        }
+        return pcb;
+    }
+    return nullptr;
+}
+
+void tcp_mock_on_connect(std::function<void(tcp_pcb*)> fn)
+{
+    s_on_connect = fn;
+}
+
+void tcp_mock_reset()
+{
+    s_on_connect = nullptr;
+    for (tcp_pcb* pcb : s_pcbs) {
+        delete pcb;
+    }
+    s_pcbs.clear();
+}
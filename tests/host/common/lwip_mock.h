@@ -0,0 +1,172 @@
+/*
+ lwip_mock.h - minimal lwIP TCP/pbuf mock for host side testing
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+#ifndef lwip_mock_h
+#define lwip_mock_h
+
+// stands in for lwip/tcp.h, whose guard keeps wl_definitions.h from
+// declaring the TCP states again
+#define __LWIP_TCP_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <string>
+#include <functional>
+#include <Arduino.h>
+
+typedef long err_t; // s32_t, as LWIP_ERR_T on the target
+
+#define ERR_OK      0
+#define ERR_MEM    -1
+#define ERR_CONN  -11
+#define ERR_ABRT  -13
+#define ERR_RST   -14
+
+enum tcp_state {
+    CLOSED = 0,
+    LISTEN,
+    SYN_SENT,
+    SYN_RCVD,
+    ESTABLISHED,
+    FIN_WAIT_1,
+    FIN_WAIT_2,
+    CLOSE_WAIT,
+    CLOSING,
+    LAST_ACK,
+    TIME_WAIT,
+};
+
+#define TCP_PRIO_MIN         1
+#define SOF_REUSEADDR        0x04
+#define SOF_KEEPALIVE        0x08
+#define TCP_SND_BUF          (2 * 1460)
+#define TCP_SND_QUEUELEN     8
+#define TCP_WRITE_FLAG_COPY  0x01
+
+#ifndef TCP_DEFAULT_KEEPALIVE_IDLE_SEC
+#define TCP_DEFAULT_KEEPALIVE_IDLE_SEC          7200
+#define TCP_DEFAULT_KEEPALIVE_INTERVAL_SEC      75
+#define TCP_DEFAULT_KEEPALIVE_COUNT             9
+#endif
+
+#define os_memcpy memcpy
+
+struct ip_addr_t {
+    uint32_t addr;
+};
+
+#define IPADDR_ANY ((uint32_t) 0x00000000UL)
+
+struct pbuf {
+    pbuf* next;
+    void* payload;
+    uint16_t tot_len;
+    uint16_t len;
+    uint16_t ref;
+};
+
+struct tcp_pcb;
+
+typedef err_t (*tcp_recv_fn)(void* arg, tcp_pcb* pcb, pbuf* p, err_t err);
+typedef err_t (*tcp_sent_fn)(void* arg, tcp_pcb* pcb, uint16_t len);
+typedef err_t (*tcp_poll_fn)(void* arg, tcp_pcb* pcb);
+typedef void  (*tcp_err_fn)(void* arg, err_t err);
+typedef err_t (*tcp_connected_fn)(void* arg, tcp_pcb* pcb, err_t err);
+typedef err_t (*tcp_accept_fn)(void* arg, tcp_pcb* newpcb, err_t err);
+
+struct tcp_pcb {
+    uint8_t state = ESTABLISHED;
+    uint8_t prio = 0;
+    uint8_t so_options = 0;
+    bool nagle_disabled = false;
+    ip_addr_t local_ip = {0};
+    ip_addr_t remote_ip = {0};
+    uint16_t local_port = 0;
+    uint16_t remote_port = 0;
+    uint32_t keep_idle = 0;
+    uint32_t keep_intvl = 0;
+    uint32_t keep_cnt = 0;
+    uint16_t snd_buf = TCP_SND_BUF;
+    uint16_t snd_queuelen = 0;
+
+    void* callback_arg = nullptr;
+    tcp_recv_fn recv = nullptr;
+    tcp_sent_fn sent = nullptr;
+    tcp_poll_fn poll = nullptr;
+    tcp_err_fn errf = nullptr;
+    tcp_accept_fn accept = nullptr;
+
+    // Acknowledge everything as soon as it is output
+    bool auto_ack = false;
+    // tcp_write() fails from now on, as once the peer has reset the connection
+    bool reset = false;
+    // Runs at the end of tcp_output(), for a peer to answer what was sent
+    std::function<void(tcp_pcb*)> on_output;
+
+    // Observed by tests
+    std::string tx_data;
+    size_t tx_copied = 0;
+    size_t recved = 0;
+    size_t outputs = 0;
+};
+
+#define tcp_sndbuf(pcb)          ((pcb)->snd_buf)
+#define tcp_nagle_disable(pcb)   ((pcb)->nagle_disabled = true)
+#define tcp_nagle_enable(pcb)    ((pcb)->nagle_disabled = false)
+#define tcp_nagle_disabled(pcb)  ((pcb)->nagle_disabled)
+
+tcp_pcb* tcp_new();
+err_t tcp_bind(tcp_pcb* pcb, ip_addr_t* addr, uint16_t port);
+tcp_pcb* tcp_listen(tcp_pcb* pcb);
+void tcp_accept(tcp_pcb* pcb, tcp_accept_fn accept);
+#define tcp_accepted(pcb) ((void) (pcb))
+void tcp_setprio(tcp_pcb* pcb, uint8_t prio);
+void tcp_arg(tcp_pcb* pcb, void* arg);
+void tcp_recv(tcp_pcb* pcb, tcp_recv_fn recv);
+void tcp_sent(tcp_pcb* pcb, tcp_sent_fn sent);
+void tcp_err(tcp_pcb* pcb, tcp_err_fn err);
+void tcp_poll(tcp_pcb* pcb, tcp_poll_fn poll, uint8_t interval);
+void tcp_recved(tcp_pcb* pcb, uint16_t len);
+void tcp_abort(tcp_pcb* pcb);
+err_t tcp_close(tcp_pcb* pcb);
+err_t tcp_connect(tcp_pcb* pcb, ip_addr_t* addr, uint16_t port, tcp_connected_fn connected);
+err_t tcp_write(tcp_pcb* pcb, const void* data, uint16_t len, uint8_t apiflags);
+err_t tcp_output(tcp_pcb* pcb);
+
+void pbuf_ref(pbuf* p);
+uint8_t pbuf_free(pbuf* p);
+void pbuf_cat(pbuf* head, pbuf* tail);
+
+// Test helpers: build a heap-backed pbuf chain, one segment per length
+pbuf* pbuf_mock_chain(const char* data, const size_t* seg_lens, size_t segs);
+size_t pbuf_mock_live();
+
+// Deliver a received chain to whoever is registered on the pcb, like tcp_input would
+err_t tcp_mock_deliver(tcp_pcb* pcb, pbuf* p);
+
+// A peer connects to whoever listens on port. Returns the accepted pcb,
+// nullptr if nobody listens.
+tcp_pcb* tcp_mock_accept(uint16_t port);
+
+// Runs for every pcb tcp_connect() connects, for a test to play the server.
+// Cleared by tcp_mock_reset().
+void tcp_mock_on_connect(std::function<void(tcp_pcb*)> fn);
+
+// Frees the pcbs handed out by tcp_new() and tcp_mock_accept(), once nothing
+// refers to them any more
+void tcp_mock_reset();
+
+#endif /* lwip_mock_h */
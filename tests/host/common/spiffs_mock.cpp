@@ -19,6 +19,8 @@
 #include "debug.h"
 #include <flash_utils.h>
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
 
 #include <spiffs_api.h>
 
@@ -31,6 +33,9 @@ extern "C"
     uint8_t* s_phys_data = nullptr;
 }
 
+static size_t s_read_count = 0;
+static size_t s_read_bytes = 0;
+
 FS SPIFFS(nullptr);
 
 SpiffsMock::SpiffsMock(size_t fs_size, size_t fs_block, size_t fs_page)
@@ -46,7 +51,26 @@ SpiffsMock::SpiffsMock(size_t fs_size, size_t fs_block, size_t fs_page)
 
 void SpiffsMock::reset()
 {
-    SPIFFS = FS(FSImplPtr(new SPIFFSImpl(0, s_phys_size, s_phys_page, s_phys_block, 5)));
+    spiffs_hal_invalidate();
+    m_impl = new SPIFFSImpl(0, s_phys_size, s_phys_page, s_phys_block, 5);
+    SPIFFS = FS(FSImplPtr(m_impl));
+}
+
+void SpiffsMock::resetStats()
+{
+    spiffs_hal_reset_stats();
+    s_read_count = 0;
+    s_read_bytes = 0;
+}
+
+size_t SpiffsMock::readCount()
+{
+    return s_read_count;
+}
+
+size_t SpiffsMock::readBytes()
+{
+    return s_read_bytes;
 }
     
 SpiffsMock::~SpiffsMock()
@@ -57,27 +81,42 @@ SpiffsMock::~SpiffsMock()
     s_phys_block = 0;
     s_phys_data  = nullptr;
     SPIFFS = FS(FSImplPtr(nullptr));
+    m_impl = nullptr;
 }
 
-int32_t spiffs_hal_read(uint32_t addr, uint32_t size, uint8_t *dst) {
+// Flash primitives under spiffs_hal.cpp, as picky about alignment as the real ones
+
+static void checkAccess(uint32_t addr, uintptr_t ram, uint32_t size)
+{
+    if (((addr | ram | size) & 3) != 0 || addr + size > s_phys_size) {
+        fprintf(stderr, "spiffs_mock: bad flash access addr=%x ram=%lx size=%x\n",
+                addr, (unsigned long) ram, size);
+        abort();
+    }
+}
+
+bool spiffs_flash_read(uint32_t addr, uint32_t* dst, uint32_t size) {
+    checkAccess(addr, (uintptr_t) dst, size);
+    ++s_read_count;
+    s_read_bytes += size;
     memcpy(dst, s_phys_data + addr, size);
-    return SPIFFS_OK;
+    return true;
 }
 
-int32_t spiffs_hal_write(uint32_t addr, uint32_t size, uint8_t *src) {
-    memcpy(s_phys_data + addr, src, size);
-    return SPIFFS_OK;
+bool spiffs_flash_write(uint32_t addr, const uint32_t* src, uint32_t size) {
+    checkAccess(addr, (uintptr_t) src, size);
+    // like NOR flash, writes can only clear bits
+    const uint8_t* bytes = (const uint8_t*) src;
+    for (uint32_t i = 0; i < size; ++i) {
+        s_phys_data[addr + i] &= bytes[i];
+    }
+    return true;
 }
 
-int32_t spiffs_hal_erase(uint32_t addr, uint32_t size) {
-    if ((size & (FLASH_SECTOR_SIZE - 1)) != 0 ||
-        (addr & (FLASH_SECTOR_SIZE - 1)) != 0) {
+bool spiffs_flash_erase_sector(uint32_t sector) {
+    if ((sector + 1) * FLASH_SECTOR_SIZE > s_phys_size) {
         abort();
     }
-    const uint32_t sector = addr / FLASH_SECTOR_SIZE;
-    const uint32_t sectorCount = size / FLASH_SECTOR_SIZE;
-    for (uint32_t i = 0; i < sectorCount; ++i) {
-        memset(s_phys_data + (sector + i) * FLASH_SECTOR_SIZE, 0xff, FLASH_SECTOR_SIZE);
-    }
-    return SPIFFS_OK;
+    memset(s_phys_data + sector * FLASH_SECTOR_SIZE, 0xff, FLASH_SECTOR_SIZE);
+    return true;
 }
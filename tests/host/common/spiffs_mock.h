@@ -21,14 +21,30 @@
 #include <vector>
 #include <FS.h>
 
+class SPIFFSImpl;
+
 class SpiffsMock {
 public:
     SpiffsMock(size_t fs_size, size_t fs_block, size_t fs_page);
     void reset();
     ~SpiffsMock();
+
+    // The SPIFFSImpl behind SPIFFS, replaced by reset()
+    SPIFFSImpl* impl() { return m_impl; }
+
+    // The emulated flash
+    uint8_t* data() { return m_fs.data(); }
+    size_t size() const { return m_fs.size(); }
+
+    // Word aligned flash reads made under the HAL since the last
+    // resetStats(), which also resets the HAL statistics
+    static void resetStats();
+    static size_t readCount();
+    static size_t readBytes();
     
 protected:
     std::vector<uint8_t> m_fs;
+    SPIFFSImpl* m_impl;
 };
 
 #define SPIFFS_MOCK_DECLARE(size_kb, block_kb, page_b) SpiffsMock spiffs_mock(size_kb * 1024, block_kb * 1024, page_b)
@@ -0,0 +1,64 @@
+/*
+ umm_host.c - critical section timing for host side allocator benchmarks
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+#define _POSIX_C_SOURCE 199309L
+#include <string.h>
+#include <time.h>
+#include "umm_host.h"
+
+// From UMM, the last caller of a malloc/realloc/calloc which failed
+void* umm_last_fail_alloc_addr = NULL;
+int umm_last_fail_alloc_size = 0;
+
+static int s_depth = 0;
+static uint64_t s_enteredNs = 0;
+static umm_host_critical_stats s_stats;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// sections nest, like ets_intr_lock() only the outermost one counts
+void umm_host_critical_entry(void)
+{
+    if (s_depth++ == 0) {
+        s_enteredNs = now_ns();
+    }
+}
+
+void umm_host_critical_exit(void)
+{
+    if (--s_depth == 0) {
+        uint64_t ns = now_ns() - s_enteredNs;
+        ++s_stats.sections;
+        s_stats.totalNs += ns;
+        if (ns > s_stats.maxNs) {
+            s_stats.maxNs = ns;
+        }
+    }
+}
+
+void umm_host_critical_reset(void)
+{
+    memset(&s_stats, 0, sizeof(s_stats));
+}
+
+umm_host_critical_stats umm_host_critical(void)
+{
+    return s_stats;
+}
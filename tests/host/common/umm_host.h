@@ -0,0 +1,69 @@
+/*
+ umm_host.h - umm_malloc builds for host side allocator benchmarks
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+#ifndef umm_host_h
+#define umm_host_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+// stands in for umm_malloc_cfg.h, which needs the SDK
+#define _UMM_MALLOC_CFG_H
+#include "umm_malloc/umm_malloc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Size of each emulated heap, about what a sketch has left on the target
+#define UMM_HOST_HEAP_SIZE (40 * 1024)
+
+// umm_malloc.c built into its own heap: as configured for the target, with
+// UMM_SIZE_CLASSES and with UMM_SITE_STATS
+typedef struct {
+    const char* name;
+    void (*init)(void);
+    void* (*malloc)(size_t size);
+    void* (*realloc)(void* ptr, size_t size);
+    void (*free)(void* ptr);
+    size_t (*freeHeap)(void);
+    size_t (*maxFreeBlock)(void);
+    void* (*mallocAt)(size_t size, const void* site);
+    int (*fragmentation)(void);
+    void* (*info)(void* ptr, int force);
+    UMM_HEAP_INFO* heapInfo;
+    size_t (*sites)(UMM_SITE_INFO* sites, size_t count);
+} umm_host_heap;
+
+extern const umm_host_heap umm_host_plain;
+extern const umm_host_heap umm_host_classes;
+extern const umm_host_heap umm_host_sites;
+
+// Time spent between UMM_CRITICAL_ENTRY and UMM_CRITICAL_EXIT, which
+// disable interrupts on the target
+typedef struct {
+    uint32_t sections;
+    uint64_t totalNs;
+    uint64_t maxNs;
+} umm_host_critical_stats;
+
+void umm_host_critical_reset(void);
+umm_host_critical_stats umm_host_critical(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* umm_host_h */
@@ -0,0 +1,65 @@
+/*
+ umm_host_cfg.h - configuration for building umm_malloc.c on the host
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+// Included by umm_plain.c, umm_classes.c and umm_sites.c, which define UMM_HOST_NAME(x)
+// to give the globals of their copy of umm_malloc.c distinct names.
+
+#ifndef umm_host_cfg_h
+#define umm_host_cfg_h
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define umm_heap               UMM_HOST_NAME(heap)
+#define umm_numblocks          UMM_HOST_NAME(numblocks)
+#define ummHeapInfo            UMM_HOST_NAME(info_struct)
+#define umm_init               UMM_HOST_NAME(init)
+#define umm_info               UMM_HOST_NAME(info)
+#define umm_malloc             UMM_HOST_NAME(malloc)
+#define umm_calloc             UMM_HOST_NAME(calloc)
+#define umm_realloc            UMM_HOST_NAME(realloc)
+#define umm_size               UMM_HOST_NAME(size)
+#define umm_free               UMM_HOST_NAME(free)
+#define umm_free_heap_size     UMM_HOST_NAME(free_heap_size)
+#define umm_malloc_at          UMM_HOST_NAME(malloc_at)
+#define umm_calloc_at          UMM_HOST_NAME(calloc_at)
+#define umm_realloc_at         UMM_HOST_NAME(realloc_at)
+#define umm_max_block_size     UMM_HOST_NAME(max_block_size)
+#define umm_fragmentation_metric UMM_HOST_NAME(fragmentation_metric)
+#define umm_size_class_free    UMM_HOST_NAME(size_class_free)
+#define umm_site_info          UMM_HOST_NAME(site_info)
+
+#include "umm_host.h"
+
+#define ICACHE_FLASH_ATTR
+
+#define UMM_BEST_FIT
+
+#define UMM_H_ATTPACKPRE
+#define UMM_H_ATTPACKSUF __attribute__((__packed__))
+
+void umm_host_critical_entry(void);
+void umm_host_critical_exit(void);
+
+#define UMM_CRITICAL_ENTRY() umm_host_critical_entry()
+#define UMM_CRITICAL_EXIT()  umm_host_critical_exit()
+
+static uint32_t UMM_HOST_NAME(heap_storage)[UMM_HOST_HEAP_SIZE / 4];
+
+#define UMM_MALLOC_CFG__HEAP_ADDR ((uintptr_t) UMM_HOST_NAME(heap_storage))
+#define UMM_MALLOC_CFG__HEAP_SIZE ((size_t) UMM_HOST_HEAP_SIZE)
+
+#endif /* umm_host_cfg_h */
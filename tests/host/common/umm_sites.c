@@ -0,0 +1,34 @@
+/*
+ umm_sites.c - umm_malloc with allocation site statistics, for host side tests
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+#define UMM_HOST_NAME(x) umm_sites_##x
+#define UMM_SITE_STATS
+#include "umm_host_cfg.h"
+#include "umm_malloc/umm_malloc.c"
+
+const umm_host_heap umm_host_sites = {
+    "sites",
+    umm_init,
+    umm_malloc,
+    umm_realloc,
+    umm_free,
+    umm_free_heap_size,
+    umm_max_block_size,
+    umm_malloc_at,
+    umm_fragmentation_metric,
+    umm_info,
+    &ummHeapInfo,
+    umm_site_info,
+};
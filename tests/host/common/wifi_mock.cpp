@@ -0,0 +1,130 @@
+/*
+ wifi_mock.cpp - the parts of ESP8266WiFi that need the SDK, for host side testing
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+
+ESP8266WiFiClass WiFi;
+
+ESP8266WiFiGenericClass::ESP8266WiFiGenericClass()
+{
+}
+
+int ESP8266WiFiGenericClass::hostByName(const char* aHostname, IPAddress& aResult, uint32_t timeout_ms)
+{
+    (void) timeout_ms;
+    // there is no DNS, any name is the host itself
+    if (!aResult.fromString(aHostname)) {
+        aResult = IPAddress(127, 0, 0, 1);
+    }
+    return 1;
+}
+
+int ESP8266WiFiGenericClass::hostByName(const char* aHostname, IPAddress& aResult)
+{
+    return hostByName(aHostname, aResult, 10000);
+}
+
+// TLS is not emulated, a secure client talks in the clear and trusts anyone
+
+WiFiClientSecure::WiFiClientSecure()
+{
+}
+
+WiFiClientSecure::~WiFiClientSecure()
+{
+}
+
+int WiFiClientSecure::connect(IPAddress ip, uint16_t port)
+{
+    return WiFiClient::connect(ip, port);
+}
+
+int WiFiClientSecure::connect(const String host, uint16_t port)
+{
+    return WiFiClient::connect(host, port);
+}
+
+int WiFiClientSecure::connect(const char* name, uint16_t port)
+{
+    return WiFiClient::connect(name, port);
+}
+
+bool WiFiClientSecure::verify(const char* fingerprint, const char* domain_name)
+{
+    (void) fingerprint;
+    (void) domain_name;
+    return true;
+}
+
+uint8_t WiFiClientSecure::connected()
+{
+    return WiFiClient::connected();
+}
+
+size_t WiFiClientSecure::write(const uint8_t *buf, size_t size)
+{
+    return WiFiClient::write(buf, size);
+}
+
+size_t WiFiClientSecure::write_P(PGM_P buf, size_t size)
+{
+    return WiFiClient::write_P(buf, size);
+}
+
+int WiFiClientSecure::read(uint8_t *buf, size_t size)
+{
+    return WiFiClient::read(buf, size);
+}
+
+int WiFiClientSecure::available()
+{
+    return WiFiClient::available();
+}
+
+int WiFiClientSecure::read()
+{
+    return WiFiClient::read();
+}
+
+int WiFiClientSecure::peek()
+{
+    return WiFiClient::peek();
+}
+
+size_t WiFiClientSecure::peekBytes(uint8_t *buffer, size_t length)
+{
+    return WiFiClient::peekBytes(buffer, length);
+}
+
+const char* WiFiClientSecure::peekBuffer()
+{
+    return WiFiClient::peekBuffer();
+}
+
+size_t WiFiClientSecure::peekAvailable()
+{
+    return WiFiClient::peekAvailable();
+}
+
+void WiFiClientSecure::peekConsume(size_t consume)
+{
+    WiFiClient::peekConsume(consume);
+}
+
+void WiFiClientSecure::stop()
+{
+    WiFiClient::stop();
+}
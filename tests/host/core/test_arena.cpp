@@ -0,0 +1,216 @@
+/*
+ test_arena.cpp - Arena tests
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+#include <catch.hpp>
+#include <string.h>
+#include <vector>
+#include <Arduino.h>
+#include <Arena.h>
+#include "../common/alloc_stats.h"
+
+TEST_CASE("Arena hands out aligned memory from one chunk", "[core][arena]")
+{
+    Arena arena(256);
+    CHECK(arena.chunks() == 0);
+    uint8_t* a = (uint8_t*) arena.alloc(3, 1);
+    uint8_t* b = (uint8_t*) arena.alloc(8);
+    uint8_t* c = (uint8_t*) arena.alloc(1, 1);
+    uint64_t* d = (uint64_t*) arena.alloc(sizeof(uint64_t), alignof(uint64_t));
+    REQUIRE(a);
+    REQUIRE(b);
+    REQUIRE(c);
+    REQUIRE(d);
+    CHECK(arena.chunks() == 1);
+    CHECK(((uintptr_t) b % sizeof(void*)) == 0);
+    CHECK(((uintptr_t) d % alignof(uint64_t)) == 0);
+    CHECK(b >= a + 3);
+    CHECK(c >= b + 8);
+    CHECK((uint8_t*) d >= c + 1);
+    CHECK(arena.used() == 3 + 8 + 1 + 8);
+
+    // the last allocation grows in place, others move
+    uint8_t* e = (uint8_t*) arena.alloc(4, 1);
+    memcpy(e, "abcd", 4);
+    CHECK(arena.realloc(e, 4, 40) == e);
+    memcpy(b, "01234567", 8);
+    uint8_t* moved = (uint8_t*) arena.realloc(b, 8, 16);
+    CHECK(moved != b);
+    CHECK(memcmp(moved, "01234567", 8) == 0);
+
+    // and the last one can be given back
+    arena.release(moved, 16);
+    CHECK(arena.alloc(16) == moved);
+}
+
+TEST_CASE("Arena starts new chunks and frees them all in reset", "[core][arena]")
+{
+    Arena arena(128);
+    alloc_stats_reset();
+    for (int i = 0; i < 10; ++i) {
+        uint8_t* p = (uint8_t*) arena.alloc(50, 1);
+        REQUIRE(p);
+        memset(p, i, 50);
+    }
+    // two fit in a chunk, a large allocation gets a chunk of its own
+    CHECK(arena.chunks() == 5);
+    uint8_t* big = (uint8_t*) arena.alloc(1000);
+    REQUIRE(big);
+    memset(big, 0xaa, 1000);
+    CHECK(arena.chunks() == 6);
+    arena.reset();
+    CHECK(arena.chunks() == 0);
+    CHECK(arena.used() == 0);
+    if (alloc_stats_supported()) {
+        AllocStats stats = alloc_stats();
+        CHECK(stats.allocs == 6);
+        CHECK(stats.frees == 6);
+    }
+    // usable again after a reset
+    CHECK(arena.alloc(10));
+}
+
+TEST_CASE("Arena refuses sizes that would wrap around", "[core][arena]")
+{
+    Arena arena(128);
+    REQUIRE(arena.alloc(16));
+    CHECK(arena.alloc(SIZE_MAX) == nullptr);
+    CHECK(arena.alloc(SIZE_MAX - 8, 8) == nullptr);
+    CHECK(arena.alloc(SIZE_MAX - sizeof(void*) - 64, 1) == nullptr);
+    // ptr + size would wrap to below the end of the chunk
+    CHECK(arena.alloc(SIZE_MAX - 32, 1) == nullptr);
+    CHECK(arena.chunks() == 1);
+    CHECK(arena.used() == 16);
+
+    void* last = arena.alloc(8, 1);
+    REQUIRE(last);
+    CHECK(arena.realloc(last, 8, SIZE_MAX - 4) == nullptr);
+    CHECK(arena.used() == 24);
+
+    ArenaString str(arena);
+    REQUIRE(str.concat("abc"));
+    CHECK_FALSE(str.reserve(SIZE_MAX));
+    CHECK_FALSE(str.concat("x", SIZE_MAX - 1));
+    CHECK_FALSE(str.prepend("x", SIZE_MAX - 2));
+    CHECK(strcmp(str.c_str(), "abc") == 0);
+    str.clear();
+}
+
+TEST_CASE("ArenaString appends, prepends and prints", "[core][arena]")
+{
+    Arena arena(64);
+    ArenaString str(arena);
+    CHECK(str.length() == 0);
+    CHECK(strcmp(str.c_str(), "") == 0);
+    str += "Content-Length";
+    str += F(": ");
+    str.print(1234);
+    str += '\r';
+    str += String("\n");
+    CHECK(strcmp(str.c_str(), "Content-Length: 1234\r\n") == 0);
+    str.prepend("HTTP/1.1 200 OK\r\n", 17);
+    CHECK(strcmp(str.c_str(), "HTTP/1.1 200 OK\r\nContent-Length: 1234\r\n") == 0);
+
+    // grows past the chunk size
+    for (int i = 0; i < 100; ++i) {
+        str.print(i % 10);
+    }
+    CHECK(str.length() == 39 + 100);
+    CHECK(str.c_str()[str.length() - 1] == '9');
+
+    ArenaString other(arena);
+    other += "X-";
+    other += str;
+    CHECK(other.length() == 2 + str.length());
+
+    other.clear();
+    str.clear();
+    CHECK(str.length() == 0);
+    arena.reset();
+}
+
+TEST_CASE("ArenaAllocator works with standard containers", "[core][arena]")
+{
+    Arena arena(256);
+    {
+        std::vector<int, ArenaAllocator<int>> v{ArenaAllocator<int>(arena)};
+        for (int i = 0; i < 200; ++i) {
+            v.push_back(i);
+        }
+        for (int i = 0; i < 200; ++i) {
+            REQUIRE(v[i] == i);
+        }
+    }
+    CHECK(arena.chunks() > 1);
+    arena.reset();
+}
+
+TEST_CASE("Response headers built in an arena", "[core][arena][benchmark]")
+{
+    const int rounds = 1000;
+    String contentType = "text/html";
+
+    alloc_stats_reset();
+    for (int i = 0; i < rounds; ++i) {
+        // the way ESP8266WebServer used to build them
+        String headers;
+        String line = String(F("Content-Type")) + F(": ") + contentType + "\r\n";
+        headers = line + headers;
+        headers += String(F("Content-Length")) + F(": ") + String(1234) + "\r\n";
+        headers += String(F("Cache-Control")) + F(": ") + String(F("max-age=86400")) + "\r\n";
+        headers += String(F("Connection")) + F(": ") + String(F("close")) + "\r\n";
+        String response = String(F("HTTP/1.")) + String(1) + ' ';
+        response += String(200);
+        response += String(F(" OK\r\n"));
+        response += headers;
+        response += "\r\n";
+    }
+    AllocStats strings = alloc_stats();
+
+    Arena arena(512);
+    alloc_stats_reset();
+    for (int i = 0; i < rounds; ++i) {
+        ArenaString headers(arena);
+        headers += F("Cache-Control: max-age=86400\r\n");
+        ArenaString response(arena);
+        response += F("HTTP/1.");
+        response.print(1);
+        response += ' ';
+        response.print(200);
+        response += F(" OK\r\nContent-Type: ");
+        response += contentType;
+        response += F("\r\n");
+        response += headers;
+        response += F("Content-Length: ");
+        response.print(1234);
+        response += F("\r\nConnection: close\r\n\r\n");
+        headers.clear();
+        response.clear();
+        arena.reset();
+    }
+    AllocStats arenaStats = alloc_stats();
+
+    printf("response headers, per request:\n");
+    printf("  String: %5.1f allocs %5.1f reallocs %5.1f frees\n",
+           (double) strings.allocs / rounds, (double) strings.reallocs / rounds, (double) strings.frees / rounds);
+    printf("  Arena:  %5.1f allocs %5.1f reallocs %5.1f frees\n",
+           (double) arenaStats.allocs / rounds, (double) arenaStats.reallocs / rounds, (double) arenaStats.frees / rounds);
+    if (alloc_stats_supported()) {
+        CHECK(arenaStats.allocs == (size_t) rounds);
+        CHECK(arenaStats.reallocs == 0);
+        CHECK(arenaStats.frees == (size_t) rounds);
+        size_t stringCalls = strings.allocs + strings.reallocs;
+        CHECK(stringCalls > (size_t) (10 * rounds));
+    }
+}
@@ -0,0 +1,173 @@
+/*
+ test_cbuf.cpp - circular buffer tests
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+#include <catch.hpp>
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <cbuf.h>
+
+TEST_CASE("cbuf reads what was written, across the end", "[core][cbuf]")
+{
+    cbuf buf(8);
+    CHECK(buf.empty());
+    CHECK(buf.room() == 7);
+    CHECK(buf.write("abcde", 5) == 5);
+    CHECK(buf.available() == 5);
+    char out[16] = {0};
+    CHECK(buf.read(out, 3) == 3);
+    CHECK(memcmp(out, "abc", 3) == 0);
+    // wraps
+    CHECK(buf.write("fghijkl", 7) == 5);
+    CHECK(buf.full());
+    CHECK(buf.room() == 0);
+    CHECK(buf.write('x') == 0);
+    CHECK(buf.peek() == 'd');
+    CHECK(buf.peek(out, 16) == 7);
+    CHECK(memcmp(out, "defghij", 7) == 0);
+    CHECK(buf.remove(2) == 5);
+    CHECK(buf.read() == 'f');
+    CHECK(buf.read(out, 16) == 4);
+    CHECK(memcmp(out, "ghij", 4) == 0);
+    CHECK(buf.empty());
+    CHECK(buf.read() == -1);
+
+    CHECK(buf.write("12345", 5) == 5);
+    buf.flush();
+    CHECK(buf.empty());
+    CHECK(buf.write("12345", 5) == 5);
+    CHECK(buf.resizeAdd(8) == 16);
+    CHECK(buf.available() == 5);
+    CHECK(buf.room() == 10);
+    CHECK(buf.read(out, 16) == 5);
+    CHECK(memcmp(out, "12345", 5) == 0);
+}
+
+TEST_CASE("cbuf spans cover the data and the free space in place", "[core][cbuf]")
+{
+    cbuf buf(8);
+    cbuf::span first, second;
+
+    CHECK(buf.writeSpans(first, second) == 7);
+    CHECK(first.size == 7);
+    CHECK(second.size == 0);
+    memcpy(first.data, "abcdef", 6);
+    buf.commit(6);
+    CHECK(buf.readSpans(first, second) == 6);
+    CHECK(first.size == 6);
+    CHECK(memcmp(first.data, "abcdef", 6) == 0);
+    buf.consume(4);
+
+    // free space is now at the end and at the start
+    CHECK(buf.writeSpans(first, second) == 5);
+    CHECK(first.size == 2);
+    CHECK(second.size == 3);
+    memcpy(first.data, "gh", 2);
+    memcpy(second.data, "ijk", 3);
+    buf.commit(5);
+    CHECK(buf.full());
+
+    CHECK(buf.readSpans(first, second) == 7);
+    CHECK(first.size == 4);
+    CHECK(second.size == 3);
+    CHECK(memcmp(first.data, "efgh", 4) == 0);
+    CHECK(memcmp(second.data, "ijk", 3) == 0);
+    buf.consume(5);
+    CHECK(buf.readSpans(first, second) == 2);
+    CHECK(first.size == 2);
+    CHECK(memcmp(first.data, "jk", 2) == 0);
+    buf.consume(2);
+    CHECK(buf.empty());
+}
+
+TEST_CASE("cbuf works with a producer and a consumer thread", "[core][cbuf]")
+{
+    const size_t total = 1024 * 1024;
+    cbuf buf(97);
+    std::atomic<bool> ok(true);
+    size_t received = 0;
+
+    std::thread producer([&buf, &ok, total]() {
+        size_t sent = 0;
+        size_t chunk = 1;
+        while (sent < total && ok) {
+            if (sent % 3 == 0) {
+                cbuf::span first, second;
+                size_t room = buf.writeSpans(first, second);
+                size_t n = std::min(std::min(room, chunk), total - sent);
+                for (size_t i = 0; i < n; ++i) {
+                    char* p = (i < first.size) ? first.data + i : second.data + (i - first.size);
+                    *p = (char) ((sent + i) % 251);
+                }
+                buf.commit(n);
+                sent += n;
+            } else if (sent % 3 == 1) {
+                if (buf.write((char) (sent % 251))) {
+                    ++sent;
+                }
+            } else {
+                char data[64];
+                size_t n = std::min(std::min(chunk, sizeof(data)), total - sent);
+                for (size_t i = 0; i < n; ++i) {
+                    data[i] = (char) ((sent + i) % 251);
+                }
+                sent += buf.write(data, n);
+            }
+            chunk = chunk % 61 + 1;
+            if (buf.full()) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    std::thread consumer([&buf, &ok, &received, total]() {
+        size_t chunk = 1;
+        while (received < total && ok) {
+            if (received % 2 == 0) {
+                cbuf::span first, second;
+                size_t available = buf.readSpans(first, second);
+                size_t n = std::min(available, chunk);
+                for (size_t i = 0; i < n; ++i) {
+                    char c = (i < first.size) ? first.data[i] : second.data[i - first.size];
+                    if (c != (char) ((received + i) % 251)) {
+                        ok = false;
+                    }
+                }
+                buf.consume(n);
+                received += n;
+            } else {
+                char data[64];
+                size_t n = buf.read(data, std::min(chunk, sizeof(data)));
+                for (size_t i = 0; i < n; ++i) {
+                    if (data[i] != (char) ((received + i) % 251)) {
+                        ok = false;
+                    }
+                }
+                received += n;
+            }
+            chunk = chunk % 53 + 1;
+            if (buf.empty()) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    producer.join();
+    consumer.join();
+    CHECK(ok);
+    INFO("received " << received);
+    CHECK(received == total);
+    CHECK(buf.empty());
+}
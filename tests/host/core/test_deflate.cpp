@@ -0,0 +1,250 @@
+/*
+ test_deflate.cpp - DeflatePrint and InflatePrint tests
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+#include <catch.hpp>
+#include <string>
+#include <Arduino.h>
+#include <Deflate.h>
+
+class StringSink: public Print {
+public:
+    size_t write(uint8_t c) override
+    {
+        return write(&c, 1);
+    }
+    size_t write(const uint8_t* buffer, size_t size) override
+    {
+        if (size > limit - data.size()) {
+            size = limit - data.size();
+        }
+        data.append((const char*) buffer, size);
+        return size;
+    }
+    using Print::write;
+
+    std::string data;
+    size_t limit = (size_t) -1;
+};
+
+static std::string jsonRecords(int count)
+{
+    std::string s;
+    char line[64];
+    for (int i = 0; i < count; ++i) {
+        snprintf(line, sizeof(line), "{\"id\":%d,\"name\":\"sensor-%d\",\"value\":%d},\n", i, i % 7, (i * 37) % 1000);
+        s += line;
+    }
+    return s;
+}
+
+// records with runs of noise between them, for literals of every value
+static std::string mixedData(size_t size)
+{
+    std::string s;
+    uint32_t seed = 1;
+    while (s.size() < size) {
+        s += jsonRecords(1 + seed % 5);
+        for (size_t n = seed % 64; n; --n) {
+            seed = seed * 1103515245 + 12345;
+            s += (char) (seed >> 16);
+        }
+    }
+    s.resize(size);
+    return s;
+}
+
+static std::string deflate(const std::string& data, deflate_format_t format, uint8_t windowBits)
+{
+    StringSink out;
+    DeflatePrint deflate(out, format, windowBits);
+    REQUIRE(deflate.ok());
+    // pieces of varying size, and a flush() on the way
+    size_t pos = 0;
+    for (size_t k = 1; pos < data.size(); ++k) {
+        size_t len = std::min(data.size() - pos, k * 97 % 1500 + 1);
+        REQUIRE(deflate.write((const uint8_t*) data.data() + pos, len) == len);
+        pos += len;
+        if (k == 5) {
+            deflate.flush();
+        }
+    }
+    REQUIRE(deflate.finish());
+    REQUIRE(deflate.totalIn() == data.size());
+    REQUIRE(deflate.totalOut() == out.data.size());
+    return out.data;
+}
+
+static std::string inflate(const std::string& data, deflate_format_t format, uint8_t windowBits, size_t piece)
+{
+    StringSink out;
+    InflatePrint inflate(out, format, windowBits);
+    for (size_t pos = 0; pos < data.size(); pos += piece) {
+        size_t len = std::min(piece, data.size() - pos);
+        REQUIRE(inflate.write((const uint8_t*) data.data() + pos, len) == len);
+    }
+    REQUIRE(inflate.done());
+    REQUIRE(inflate.totalOut() == out.data.size());
+    return out.data;
+}
+
+// gzip member made by zlib at level 9 (a dynamic block, 32KB window), with
+// extra, name, comment and header CRC fields, of jsonRecords(60)
+static const uint8_t zlibGzip[] = {
+    0x1f, 0x8b, 0x08, 0x1e, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x04, 0x00, 0x61, 0x62, 0x00, 0x00,
+    0x64, 0x61, 0x74, 0x61, 0x2e, 0x6a, 0x73, 0x6f, 0x6e, 0x00, 0x63, 0x00, 0xc6, 0xc6, 0x7d, 0x95,
+    0xbb, 0x4a, 0x44, 0x41, 0x10, 0x05, 0x73, 0x3f, 0xe3, 0xc6, 0x2b, 0x4c, 0xbf, 0xa6, 0xbb, 0xfd,
+    0x9b, 0x05, 0x37, 0x10, 0x74, 0x05, 0x17, 0x4d, 0x16, 0xff, 0xdd, 0x47, 0x30, 0xe7, 0x72, 0x83,
+    0x93, 0x0e, 0x15, 0x55, 0x31, 0xa7, 0xef, 0xdb, 0xcb, 0xf3, 0xf6, 0x34, 0x4e, 0xdb, 0xf5, 0xfc,
+    0x76, 0xd9, 0x9e, 0xb6, 0xdb, 0xe5, 0x7a, 0x7b, 0xff, 0x78, 0x1c, 0xdb, 0x69, 0xfb, 0x3a, 0xbf,
+    0x7e, 0xfe, 0x3e, 0x8d, 0xef, 0xd3, 0xc3, 0xfd, 0x9f, 0x92, 0x23, 0x25, 0xa0, 0x2c, 0x17, 0xa6,
+    0x47, 0x4c, 0x81, 0xa5, 0x2f, 0xcc, 0x8e, 0x98, 0x01, 0x13, 0x91, 0xc5, 0xf9, 0x91, 0xf3, 0x1d,
+    0xe7, 0xb5, 0xb8, 0x38, 0x72, 0xb1, 0xe3, 0x2a, 0x16, 0x37, 0x8f, 0xdc, 0x04, 0xa7, 0xaa, 0x8b,
+    0x4b, 0xe2, 0x44, 0xa3, 0x17, 0x57, 0xc4, 0x8a, 0xf6, 0x5c, 0x5c, 0x13, 0x2d, 0x66, 0x06, 0xcb,
+    0x83, 0x88, 0xb1, 0xdc, 0xe5, 0x10, 0x62, 0xc6, 0x07, 0x82, 0x88, 0x12, 0x35, 0xee, 0x48, 0x22,
+    0x46, 0xdc, 0x78, 0xa1, 0x89, 0x38, 0x91, 0x13, 0x82, 0x28, 0x12, 0xc4, 0x4e, 0x04, 0xaa, 0xc8,
+    0x24, 0x7a, 0xa2, 0x91, 0x45, 0x92, 0xe8, 0x99, 0x8a, 0x2e, 0x52, 0x44, 0xcf, 0x9c, 0x08, 0x23,
+    0x4d, 0xf4, 0xe4, 0x40, 0x19, 0x1d, 0x44, 0x4f, 0x3a, 0xca, 0xa8, 0x10, 0x3d, 0x99, 0xbb, 0xaf,
+    0xa2, 0x44, 0x4f, 0x09, 0xca, 0xa8, 0x11, 0x3d, 0x15, 0x28, 0xa3, 0x4e, 0xf4, 0x54, 0xa1, 0x8c,
+    0x06, 0xd1, 0xd3, 0x8a, 0x32, 0x3a, 0x89, 0x9e, 0x9e, 0x28, 0xa3, 0x49, 0xf4, 0x74, 0xa3, 0x8c,
+    0x16, 0xd1, 0x63, 0x08, 0xa3, 0x4d, 0xec, 0x24, 0xba, 0xd8, 0x20, 0x72, 0x44, 0xd0, 0xc5, 0x84,
+    0x6d, 0x8e, 0xa3, 0x8b, 0x29, 0x1b, 0x9d, 0xda, 0x8d, 0x98, 0x11, 0x39, 0xaa, 0xe8, 0x62, 0xce,
+    0x66, 0x27, 0xd0, 0xc5, 0x82, 0xed, 0x4e, 0xa3, 0x8b, 0x4d, 0x36, 0xc7, 0x86, 0x2e, 0x96, 0x6c,
+    0x79, 0x26, 0xba, 0x58, 0x11, 0x3d, 0x3e, 0x10, 0xc6, 0x9a, 0x2d, 0x8f, 0xa3, 0x8c, 0x0f, 0xb6,
+    0x3c, 0x85, 0x32, 0x2e, 0x44, 0x4f, 0x08, 0xca, 0xb8, 0xb2, 0xe5, 0x09, 0x94, 0x71, 0x63, 0xcb,
+    0xd3, 0xbb, 0xfb, 0xe2, 0x44, 0xcf, 0x54, 0x94, 0xf1, 0x60, 0xcb, 0x33, 0x51, 0xc6, 0x27, 0xd1,
+    0x93, 0x03, 0x65, 0x3c, 0xd9, 0xf2, 0x18, 0xca, 0x78, 0xb1, 0xe5, 0x49, 0x94, 0xf1, 0x26, 0x7a,
+    0x4a, 0x50, 0x26, 0x06, 0x5b, 0x9e, 0x40, 0x99, 0x10, 0xb6, 0x3c, 0x85, 0x32, 0xa1, 0x44, 0x4f,
+    0x2b, 0xca, 0x84, 0xb1, 0xe5, 0x99, 0x28, 0x13, 0xce, 0x96, 0xa7, 0x77, 0xa7, 0x3f, 0x88, 0x1e,
+    0x43, 0x98, 0x98, 0x6c, 0x97, 0xd1, 0x25, 0x92, 0xc8, 0x91, 0x81, 0x2e, 0x51, 0x6c, 0x79, 0x1c,
+    0x5d, 0xa2, 0xd9, 0xf2, 0xd4, 0x5f, 0x97, 0x1f, 0x03, 0x26, 0xbd, 0x98, 0x8a, 0x09, 0x00, 0x00,
+};
+
+TEST_CASE("DeflatePrint output inflates back", "[core][deflate]")
+{
+    std::string data = mixedData(40000);
+    const deflate_format_t formats[] = { DEFLATE_RAW, DEFLATE_ZLIB, DEFLATE_GZIP };
+    const uint8_t windows[] = { 9, 10, 14 };
+    for (deflate_format_t format : formats) {
+        for (uint8_t windowBits : windows) {
+            std::string compressed = deflate(data, format, windowBits);
+            deflate_format_t detect = (format == DEFLATE_RAW) ? DEFLATE_RAW : DEFLATE_AUTO;
+            REQUIRE(inflate(compressed, detect, windowBits, 1) == data);
+            REQUIRE(inflate(compressed, detect, windowBits, 777) == data);
+        }
+    }
+
+    SECTION("nothing written")
+    {
+        std::string compressed = deflate("", DEFLATE_GZIP, 10);
+        // an empty block, and the empty last one
+        REQUIRE(compressed.size() == 10 + 3 + 8);
+        REQUIRE(inflate(compressed, DEFLATE_GZIP, 10, 1) == "");
+    }
+}
+
+TEST_CASE("DeflatePrint compresses repeated text", "[core][deflate]")
+{
+    std::string records = jsonRecords(60);
+    std::string small = deflate(records, DEFLATE_GZIP, 9);
+    std::string large = deflate(records, DEFLATE_GZIP, 14);
+    CHECK(small.size() < records.size() / 3);
+    CHECK(large.size() <= small.size());
+
+    SECTION("output stops at the other Print")
+    {
+        StringSink out;
+        out.limit = 16;
+        DeflatePrint deflate(out);
+        deflate.print(records.c_str());
+        REQUIRE_FALSE(deflate.finish());
+        REQUIRE(deflate.getWriteError());
+        REQUIRE(deflate.write('x') == 0);
+    }
+}
+
+TEST_CASE("InflatePrint decodes what zlib makes", "[core][deflate]")
+{
+    std::string data((const char*) zlibGzip, sizeof(zlibGzip));
+    std::string records = jsonRecords(60);
+    REQUIRE(inflate(data, DEFLATE_AUTO, 15, 1) == records);
+    REQUIRE(inflate(data, DEFLATE_GZIP, 15, 100) == records);
+    REQUIRE(inflate(data, DEFLATE_GZIP, 15, data.size()) == records);
+
+    SECTION("data after the end is not taken")
+    {
+        StringSink out;
+        InflatePrint inflate(out);
+        data += "more";
+        REQUIRE(inflate.write((const uint8_t*) data.data(), data.size()) == sizeof(zlibGzip));
+        REQUIRE(inflate.done());
+        REQUIRE(inflate.write('x') == 0);
+        REQUIRE(out.data == records);
+    }
+}
+
+TEST_CASE("InflatePrint reports bad data", "[core][deflate]")
+{
+    std::string data((const char*) zlibGzip, sizeof(zlibGzip));
+    StringSink out;
+
+    SECTION("check mismatch")
+    {
+        data[data.size() - 6] ^= 1;
+        InflatePrint inflate(out);
+        REQUIRE(inflate.write((const uint8_t*) data.data(), data.size()) == 0);
+        REQUIRE(inflate.error() == InflatePrint::BAD_DATA);
+        REQUIRE(inflate.getWriteError());
+        REQUIRE_FALSE(inflate.done());
+    }
+
+    SECTION("truncated")
+    {
+        InflatePrint inflate(out);
+        REQUIRE(inflate.write((const uint8_t*) data.data(), data.size() - 1) == data.size() - 1);
+        REQUIRE_FALSE(inflate.done());
+        REQUIRE(inflate.error() == InflatePrint::NONE);
+        REQUIRE(out.data == jsonRecords(60));
+    }
+
+    SECTION("not compressed")
+    {
+        InflatePrint inflate(out, DEFLATE_GZIP);
+        inflate.print("{\"id\":1}");
+        REQUIRE(inflate.error() == InflatePrint::BAD_DATA);
+        REQUIRE(out.data.empty());
+    }
+
+    SECTION("refers back further than the window")
+    {
+        std::string repeated = mixedData(12000);
+        repeated += repeated.substr(0, 1000);
+        std::string compressed = deflate(repeated, DEFLATE_GZIP, 14);
+        REQUIRE(inflate(compressed, DEFLATE_GZIP, 14, 500) == repeated);
+
+        InflatePrint inflate(out, DEFLATE_GZIP, 10);
+        inflate.write((const uint8_t*) compressed.data(), compressed.size());
+        REQUIRE(inflate.error() == InflatePrint::BAD_DATA);
+    }
+}
+
+TEST_CASE("InflatePrint stops at the other Print", "[core][deflate]")
+{
+    StringSink out;
+    out.limit = 100;
+    InflatePrint inflate(out);
+    REQUIRE(inflate.write(zlibGzip, sizeof(zlibGzip)) == 0);
+    REQUIRE(inflate.error() == InflatePrint::WRITE_FAILED);
+    REQUIRE(out.data == jsonRecords(60).substr(0, 100));
+}
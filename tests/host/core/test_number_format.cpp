@@ -0,0 +1,416 @@
+/*
+ test_number_format.cpp - number formatting tests
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+#include <catch.hpp>
+#include <string>
+#include <random>
+#include <vector>
+#include <chrono>
+#include <float.h>
+#include <math.h>
+#include <Arduino.h>
+#include <StreamString.h>
+#include <NumberFormat.h>
+#include <stdlib_noniso.h>
+
+static std::string formatUnsignedString(uint64_t value, uint8_t base, bool upperCase = false)
+{
+    char buf[NUMBER_FORMAT_INT_SIZE];
+    char* end = &buf[sizeof(buf)];
+    char* str = formatUnsigned(value, base, end, upperCase);
+    return std::string(str, end);
+}
+
+static std::string formatSignedString(int64_t value, uint8_t base)
+{
+    char buf[NUMBER_FORMAT_INT_SIZE];
+    char* end = &buf[sizeof(buf)];
+    char* str = formatSigned(value, base, end);
+    return std::string(str, end);
+}
+
+static std::string formatFixedString(double value, unsigned decimals)
+{
+    char buf[64];
+    size_t len = formatFixed(value, decimals, buf, sizeof(buf));
+    if (len <= sizeof(buf)) {
+        return std::string(buf, len);
+    }
+    std::string out(len, ' ');
+    len = formatFixed(value, decimals, &out[0], len);
+    out.resize(len);
+    return out;
+}
+
+template<typename T>
+static std::string formatShortestString(T value)
+{
+    char buf[NUMBER_FORMAT_SHORTEST_SIZE];
+    return std::string(buf, formatShortest(value, buf));
+}
+
+// the exact decimal expansion from the C library, rounded half away from zero
+static std::string referenceFixed(double value, unsigned decimals)
+{
+    static char exact[1200];
+    snprintf(exact, sizeof(exact), "%.1100f", fabs(value));
+    std::string text = exact;
+    size_t point = text.find('.');
+    std::string digits = text.substr(0, point) + text.substr(point + 1);
+    size_t keep = point + decimals;
+    bool up = digits[keep] >= '5';
+    digits.resize(keep);
+    if (up) {
+        int i = (int) keep - 1;
+        while (i >= 0 && digits[i] == '9') {
+            digits[i--] = '0';
+        }
+        if (i < 0) {
+            digits.insert(0, "1");
+            ++point;
+        } else {
+            ++digits[i];
+        }
+    }
+    std::string out = (value < 0) ? "-" : "";
+    out += digits.substr(0, point);
+    if (decimals) {
+        out += "." + digits.substr(point);
+    }
+    return out;
+}
+
+// number of significant digits in the shortest "%.*e" that reads back as value
+template<typename T>
+static int shortestLength(T value, T (*parse)(const char*, char**))
+{
+    char buf[64];
+    for (int digits = 1; digits < 17; ++digits) {
+        snprintf(buf, sizeof(buf), "%.*e", digits - 1, (double) value);
+        if (parse(buf, nullptr) == value) {
+            return digits;
+        }
+    }
+    return 17;
+}
+
+static int significantDigits(const std::string& text)
+{
+    std::string digits;
+    for (char c : text) {
+        if (c == 'e') {
+            break;
+        }
+        if (c >= '0' && c <= '9') {
+            digits += c;
+        }
+    }
+    digits.erase(0, digits.find_first_not_of('0'));
+    digits.erase(digits.find_last_not_of('0') + 1);
+    return digits.size();
+}
+
+TEST_CASE("formatUnsigned and formatSigned in all bases", "[core][numberformat]")
+{
+    CHECK(formatUnsignedString(0, 10) == "0");
+    CHECK(formatUnsignedString(7, 10) == "7");
+    CHECK(formatUnsignedString(42, 10) == "42");
+    CHECK(formatUnsignedString(100, 10) == "100");
+    CHECK(formatUnsignedString(4294967295ULL, 10) == "4294967295");
+    CHECK(formatUnsignedString(4294967296ULL, 10) == "4294967296");
+    CHECK(formatUnsignedString(10000000000000001ULL, 10) == "10000000000000001");
+    CHECK(formatUnsignedString(UINT64_MAX, 10) == "18446744073709551615");
+    CHECK(formatUnsignedString(UINT64_MAX, 2) == std::string(64, '1'));
+    CHECK(formatUnsignedString(0xdeadbeef, 16) == "deadbeef");
+    CHECK(formatUnsignedString(0xdeadbeef, 16, true) == "DEADBEEF");
+    CHECK(formatUnsignedString(35, 36) == "z");
+    CHECK(formatUnsignedString(12, 1) == "12");
+    CHECK(formatSignedString(-12, 16) == "-c");
+    CHECK(formatSignedString(INT64_MIN, 10) == "-9223372036854775808");
+    CHECK(formatSignedString(INT64_MAX, 10) == "9223372036854775807");
+
+    std::mt19937_64 random(1);
+    for (int i = 0; i < 20000; ++i) {
+        uint64_t value = random() >> (random() % 64);
+        uint8_t base = 2 + random() % 35;
+        std::string expected;
+        uint64_t rest = value;
+        do {
+            unsigned digit = rest % base;
+            expected.insert(expected.begin(), (char) ((digit < 10) ? '0' + digit : 'a' + digit - 10));
+            rest /= base;
+        } while (rest);
+        INFO(value << " in base " << (int) base);
+        REQUIRE(formatUnsignedString(value, base) == expected);
+        REQUIRE(formatSignedString(-(int64_t) (value >> 1), base) == ((value >> 1) ? "-" : "") + formatUnsignedString(value >> 1, base));
+    }
+}
+
+TEST_CASE("formatFixed rounds the exact value", "[core][numberformat]")
+{
+    CHECK(formatFixedString(0, 2) == "0.00");
+    CHECK(formatFixedString(-0.0, 2) == "0.00");
+    CHECK(formatFixedString(1.5, 0) == "2");
+    CHECK(formatFixedString(2.5, 0) == "3");
+    CHECK(formatFixedString(-2.5, 0) == "-3");
+    CHECK(formatFixedString(0.125, 2) == "0.13");
+    CHECK(formatFixedString(1.005, 2) == "1.00"); // 1.00499999999999989...
+    CHECK(formatFixedString(9.995, 2) == "9.99"); // 9.99499999999999921...
+    CHECK(formatFixedString(9.9999, 2) == "10.00");
+    CHECK(formatFixedString(-0.0001, 2) == "-0.00");
+    CHECK(formatFixedString(0.1, 20) == "0.10000000000000000555");
+    CHECK(formatFixedString(0.001, 5) == "0.00100");
+    CHECK(formatFixedString(5e-324, 3) == "0.000");
+    CHECK(formatFixedString(1e-20, 20) == "0.00000000000000000001");
+    CHECK(formatFixedString(18446744073709549568.0, 1) == "18446744073709549568.0");
+    CHECK(formatFixedString(1e20, 2) == "100000000000000000000.00");
+    CHECK(formatFixedString(-DBL_MAX, 0) == "-17976931348623157" + std::string(292, '0'));
+    CHECK(formatFixedString(NAN, 2) == "nan");
+    CHECK(formatFixedString(-INFINITY, 2) == "inf");
+
+    // too small a buffer gives a size that is large enough
+    char small[8];
+    size_t need = formatFixed(1234.5678, 3, small, sizeof(small));
+    CHECK(need >= 8);
+    std::string large(need, ' ');
+    CHECK(formatFixed(1234.5678, 3, &large[0], need) == 8);
+    CHECK(large.compare(0, 8, "1234.568") == 0);
+
+    std::mt19937_64 random(2);
+    std::uniform_int_distribution<int> exponent(-1080, 12);
+    for (int i = 0; i < 3000; ++i) {
+        double value = ldexp((double) (random() >> 11), exponent(random));
+        if (random() & 1) {
+            value = -value;
+        }
+        unsigned decimals = random() % 24;
+        INFO(referenceFixed(value, 30) << " with " << decimals << " decimals");
+        REQUIRE(formatFixedString(value, decimals) == referenceFixed(value, decimals));
+    }
+    // the kind of values sensors give
+    for (int i = 0; i < 3000; ++i) {
+        double value = (double) (int) (random() % 2000001 - 1000000) / 1000;
+        unsigned decimals = random() % 5;
+        INFO(value << " with " << decimals << " decimals");
+        REQUIRE(formatFixedString(value, decimals) == referenceFixed(value, decimals));
+    }
+}
+
+TEST_CASE("formatShortest reads back as the same value", "[core][numberformat]")
+{
+    CHECK(formatShortestString(0.0) == "0");
+    CHECK(formatShortestString(-0.0) == "-0");
+    CHECK(formatShortestString(0.1) == "0.1");
+    CHECK(formatShortestString(-1.5) == "-1.5");
+    CHECK(formatShortestString(100.0) == "100");
+    CHECK(formatShortestString(1e20) == "100000000000000000000");
+    CHECK(formatShortestString(1e21) == "1e+21");
+    CHECK(formatShortestString(1.5e22) == "1.5e+22");
+    CHECK(formatShortestString(0.000001) == "0.000001");
+    CHECK(formatShortestString(1.5e-7) == "1.5e-7");
+    CHECK(formatShortestString(5e-324) == "5e-324");
+    CHECK(formatShortestString(DBL_MAX) == "1.7976931348623157e+308");
+    CHECK(formatShortestString(-2.2250738585072014e-308) == "-2.2250738585072014e-308");
+    CHECK(formatShortestString(0.3) == "0.3");
+    CHECK(formatShortestString(0.1 + 0.2) == "0.30000000000000004");
+    CHECK(formatShortestString(NAN) == "nan");
+    CHECK(formatShortestString(-INFINITY) == "-inf");
+    CHECK(formatShortestString(0.1f) == "0.1");
+    CHECK(formatShortestString(16777216.0f) == "16777216");
+    CHECK(formatShortestString(FLT_MAX) == "3.4028235e+38");
+    CHECK(formatShortestString(1e-45f) == "1e-45");
+
+    std::mt19937_64 random(3);
+    int longer = 0;
+    const int count = 20000;
+    for (int i = 0; i < count; ++i) {
+        uint64_t bits = random();
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        if (!isfinite(value)) {
+            continue;
+        }
+        std::string text = formatShortestString(value);
+        INFO(text);
+        REQUIRE(text.size() <= NUMBER_FORMAT_SHORTEST_SIZE);
+        REQUIRE(strtod(text.c_str(), nullptr) == value);
+        int digits = significantDigits(text);
+        int shortest = shortestLength<double>(value, strtod);
+        REQUIRE(digits >= shortest);
+        if (digits > shortest) {
+            ++longer;
+        }
+    }
+    for (int i = 0; i < count; ++i) {
+        uint32_t bits = random();
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        if (!isfinite(value)) {
+            continue;
+        }
+        std::string text = formatShortestString(value);
+        INFO(text);
+        REQUIRE(strtof(text.c_str(), nullptr) == value);
+        int digits = significantDigits(text);
+        int shortest = shortestLength<float>(value, strtof);
+        REQUIRE(digits >= shortest);
+        if (digits > shortest) {
+            ++longer;
+        }
+    }
+    INFO(longer << " of " << 2 * count << " one digit longer than needed");
+    CHECK(longer < 2 * count / 100);
+}
+
+TEST_CASE("decimalToDouble and Stream::parseFloat", "[core][numberformat]")
+{
+    std::mt19937_64 random(4);
+    char buf[64];
+    for (int i = 0; i < 20000; ++i) {
+        uint64_t significand = random() >> (11 + random() % 53);
+        int exponent = (int) (random() % 45) - 22;
+        snprintf(buf, sizeof(buf), "%llue%d", (unsigned long long) significand, exponent);
+        INFO(buf);
+        REQUIRE(decimalToDouble(significand, exponent) == strtod(buf, nullptr));
+    }
+    CHECK(decimalToDouble(0, 400) == 0);
+    CHECK(isinf(decimalToDouble(1, 400)));
+    CHECK(decimalToDouble(1, -400) == 0);
+    CHECK(fabs(decimalToDouble(15, 300) - 1.5e301) < 1.5e301 * 1e-15);
+
+    const char* inputs[] = { "3.14159", "-0.001", "12345.678", "0.1", "-273.15",
+        "123456789012345678901234", "0.000000000000000000000012345", "7" };
+    for (const char* input : inputs) {
+        StreamString stream;
+        stream.setTimeout(0);
+        stream += input;
+        stream += ',';
+        INFO(input);
+        CHECK(stream.parseFloat() == (float) strtod(input, nullptr));
+    }
+}
+
+TEST_CASE("Print and String use the shared formatting", "[core][numberformat]")
+{
+    CHECK(String(-12, HEX) == "-c");
+    CHECK(String(255u, HEX) == "ff");
+    CHECK(String(-2147483647L - 1) == "-2147483648");
+    CHECK(String(1.5, 3) == "1.500");
+    CHECK(String(-0.125f, 2) == "-0.13");
+    // dtostrf padded to decimalPlaces + 2
+    CHECK(String(5.0, 0) == " 5");
+    CHECK(String(15.0, 0) == "15");
+    CHECK(String(1e20, 1) == "100000000000000000000.0");
+    String many = "x";
+    many.concat(0.25, 40);
+    CHECK(many == ("x0.25" + std::string(38, '0')).c_str());
+
+    StreamString out;
+    out.print(255, HEX);
+    out.print(' ');
+    out.print(-7);
+    out.print(' ');
+    out.print(2.675, 2);
+    out.print(' ');
+    out.print(4294967296.0);
+    CHECK(out == "FF -7 2.67 ovf");
+}
+
+// Host timings, which say little about the lx106 (no FPU, no divider).
+// With make OPTIMIZE=-O2 COVERAGE= formatUnsigned takes about 16 ns
+// against 32 ns for ultoa, and formatShortest about 80 ns against 360 ns
+// for "%.17g". The default -O0 coverage build turns both around: about
+// 180 ns against 135 ns, and 1000 ns against 650 ns.
+TEST_CASE("Number formatting speed", "[core][numberformat][benchmark]")
+{
+    const int rounds = 20000;
+    std::mt19937_64 random(5);
+    std::vector<uint32_t> integers(rounds);
+    std::vector<double> readings(rounds);
+    for (int i = 0; i < rounds; ++i) {
+        integers[i] = random() >> (32 + random() % 32);
+        readings[i] = (double) (int) (random() % 200001 - 100000) / 1000;
+    }
+    char buf[64];
+    size_t sink = 0;
+    using clock = std::chrono::steady_clock;
+    auto report = [](const char* what, clock::time_point start) {
+        double ns = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+        printf("  %-34s %8.1f ns\n", what, ns / rounds);
+    };
+    printf("number formatting, per call:\n");
+#ifndef __OPTIMIZE__
+    printf("  (unoptimized build, see the Makefile for timings that compare)\n");
+#endif
+
+    auto start = clock::now();
+    for (uint32_t value : integers) {
+        char* end = &buf[sizeof(buf)];
+        sink += end - formatUnsigned(value, 10, end);
+    }
+    report("formatUnsigned", start);
+    start = clock::now();
+    for (uint32_t value : integers) {
+        sink += strlen(ultoa(value, buf, 10));
+    }
+    report("ultoa", start);
+    start = clock::now();
+    for (uint32_t value : integers) {
+        sink += snprintf(buf, sizeof(buf), "%u", value);
+    }
+    report("snprintf %u", start);
+
+    start = clock::now();
+    for (double value : readings) {
+        sink += formatFixed(value, 2, buf, sizeof(buf));
+    }
+    report("formatFixed, 2 decimals", start);
+    start = clock::now();
+    for (double value : readings) {
+        sink += strlen(dtostrf(value, 4, 2, buf));
+    }
+    report("dtostrf, 2 decimals", start);
+    start = clock::now();
+    for (double value : readings) {
+        sink += snprintf(buf, sizeof(buf), "%.2f", value);
+    }
+    report("snprintf %.2f", start);
+
+    start = clock::now();
+    for (double value : readings) {
+        sink += formatShortest(value, buf);
+    }
+    report("formatShortest", start);
+    start = clock::now();
+    for (double value : readings) {
+        sink += snprintf(buf, sizeof(buf), "%.17g", value);
+    }
+    report("snprintf %.17g", start);
+
+    // a JSON telemetry record
+    start = clock::now();
+    for (int i = 0; i < rounds; ++i) {
+        String json = F("{\"t\":");
+        json += integers[i];
+        json += F(",\"temp\":");
+        json.concat(readings[i], 2);
+        json += F(",\"rssi\":");
+        json += -(int) (integers[i] % 90);
+        json += '}';
+        sink += json.length();
+    }
+    report("JSON record in a String", start);
+    CHECK(sink > 0);
+}
@@ -0,0 +1,232 @@
+/*
+ test_print.cpp - Print and BufferedPrint tests
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+#include <catch.hpp>
+#include <string>
+#include <chrono>
+#include <Arduino.h>
+#include <BufferedPrint.h>
+
+// only takes single bytes, like most simple Print implementations
+class ByteSink: public Print {
+public:
+    size_t write(uint8_t c) override
+    {
+        ++calls;
+        data += (char) c;
+        return 1;
+    }
+    using Print::write;
+
+    std::string data;
+    size_t calls = 0;
+};
+
+// takes blocks, and optionally only up to some total
+class BlockSink: public Print {
+public:
+    size_t write(uint8_t c) override
+    {
+        return write(&c, 1);
+    }
+    size_t write(const uint8_t* buffer, size_t size) override
+    {
+        ++calls;
+        if (size > limit - data.size()) {
+            size = limit - data.size();
+        }
+        data.append((const char*) buffer, size);
+        return size;
+    }
+    using Print::write;
+
+    std::string data;
+    size_t calls = 0;
+    size_t limit = (size_t) -1;
+};
+
+TEST_CASE("Print formats numbers in one write", "[core][print]")
+{
+    BlockSink out;
+    auto check = [&out](const char* expected) {
+        CHECK(out.data == expected);
+        CHECK(out.calls == 1);
+        out.data.clear();
+        out.calls = 0;
+    };
+
+    CHECK(out.print(-123) == 4);
+    check("-123");
+    out.print(0);
+    check("0");
+    out.print(-2147483647L - 1);
+    check("-2147483648");
+    out.print(4294967295UL);
+    check("4294967295");
+    out.print(255, HEX);
+    check("FF");
+    out.print(-1, HEX);
+    CHECK(out.data.find_first_not_of('F') == std::string::npos);
+    out.data.clear();
+    out.calls = 0;
+    out.print(5, BIN);
+    check("101");
+    out.print(1.5, 2);
+    check("1.50");
+    out.print(-0.125, 3);
+    check("-0.125");
+    out.print(1.999, 2);
+    check("2.00");
+    out.print(12.0, 0);
+    check("12");
+    out.print(-4294967295.0);
+    check("ovf");
+    out.print(NAN);
+    check("nan");
+    out.print(F("flash string"));
+    check("flash string");
+
+    // more digits than the float buffer holds
+    out.print(0.5, 60);
+    CHECK(out.data.size() == 62);
+    CHECK(out.data.compare(0, 3, "0.5") == 0);
+    CHECK(out.data.find_first_not_of('0', 3) == std::string::npos);
+    CHECK(out.calls == 1);
+}
+
+TEST_CASE("Print writes long flash strings in chunks", "[core][print]")
+{
+    static const char text[] PROGMEM =
+        "0123456789012345678901234567890123456789012345678901234567890123"
+        "0123456789012345678901234567890123456789012345678901234567890123"
+        "tail";
+    BlockSink out;
+    CHECK(out.print(FPSTR(text)) == 132);
+    CHECK(out.data == text);
+    CHECK(out.calls == 3);
+
+    BlockSink partial;
+    partial.limit = 70;
+    CHECK(partial.print(FPSTR(text)) == 70);
+    CHECK(partial.calls == 2);
+}
+
+TEST_CASE("BufferedPrint coalesces small writes", "[core][print]")
+{
+    BlockSink out;
+    {
+        uint8_t buffer[16];
+        BufferedPrint buffered(out, buffer, sizeof(buffer));
+        buffered.print("abc");
+        buffered.print(12);
+        buffered.print('x');
+        CHECK(buffered.buffered() == 6);
+        CHECK(out.calls == 0);
+        buffered.print("0123456789");
+        // 16 bytes fit exactly
+        CHECK(out.calls == 0);
+        buffered.print('y');
+        CHECK(out.calls == 1);
+        CHECK(out.data == "abc12x0123456789");
+        CHECK(buffered.buffered() == 1);
+        buffered.flush();
+        CHECK(out.calls == 2);
+        CHECK(buffered.buffered() == 0);
+        buffered.print("z");
+    }
+    // the rest goes out when it goes away
+    CHECK(out.data == "abc12x0123456789yz");
+    CHECK(out.calls == 3);
+}
+
+TEST_CASE("BufferedPrint passes large writes through", "[core][print]")
+{
+    BlockSink out;
+    BufferedPrint buffered(out, 8);
+    buffered.print("ab");
+    std::string large(20, 'L');
+    CHECK(buffered.write(large.c_str(), large.size()) == 20);
+    CHECK(out.calls == 2);
+    CHECK(out.data == "ab" + large);
+    CHECK(buffered.buffered() == 0);
+
+    // no buffer at all
+    BlockSink direct;
+    BufferedPrint unbuffered(direct, nullptr, 0);
+    unbuffered.print('a');
+    unbuffered.print("bc");
+    CHECK(direct.calls == 2);
+    CHECK(direct.data == "abc");
+}
+
+TEST_CASE("BufferedPrint reports short writes", "[core][print]")
+{
+    BlockSink out;
+    out.limit = 4;
+    uint8_t buffer[8];
+    BufferedPrint buffered(out, buffer, sizeof(buffer));
+    buffered.print("abcdef");
+    CHECK(buffered.getWriteError() == 0);
+    CHECK_FALSE(buffered.send());
+    CHECK(buffered.getWriteError() != 0);
+    CHECK(out.data == "abcd");
+    CHECK(buffered.buffered() == 0);
+}
+
+TEST_CASE("BufferedPrint with a byte sink", "[core][print][benchmark]")
+{
+    const int rounds = 2000;
+    auto log = [](Print& out, int i) {
+        out.print(F("[sensor] t="));
+        out.print(i * 17L);
+        out.print(F(" temp="));
+        out.print(21.5 + (i % 10) * 0.1, 2);
+        out.print(F(" rssi="));
+        out.println(-40 - i % 30);
+    };
+
+    BlockSink direct;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i) {
+        log(direct, i);
+    }
+    double directNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    BlockSink coalesced;
+    start = std::chrono::steady_clock::now();
+    {
+        uint8_t buffer[256];
+        BufferedPrint buffered(coalesced, buffer, sizeof(buffer));
+        for (int i = 0; i < rounds; ++i) {
+            log(buffered, i);
+        }
+    }
+    double bufferedNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    CHECK(coalesced.data == direct.data);
+    size_t scaled = coalesced.calls * 20;
+    CHECK(scaled < direct.calls);
+    printf("Print calls per log line:\n");
+    printf("  %-28s %6.2f calls %8.1f ns\n", "unbuffered",
+           (double) direct.calls / rounds, directNs / rounds);
+    printf("  %-28s %6.2f calls %8.1f ns\n", "BufferedPrint, 256 bytes",
+           (double) coalesced.calls / rounds, bufferedNs / rounds);
+
+    // the default write(buffer, size) still feeds byte sinks one at a time
+    ByteSink bytes;
+    log(bytes, 1);
+    CHECK(bytes.data == "[sensor] t=17 temp=21.60 rssi=-41\r\n");
+    CHECK(bytes.calls == bytes.data.size());
+}
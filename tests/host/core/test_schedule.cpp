@@ -0,0 +1,279 @@
+/*
+ test_schedule.cpp - scheduled function tests
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+#include <catch.hpp>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <Arduino.h>
+#include <Schedule.h>
+#include "../common/alloc_stats.h"
+
+TEST_CASE("Scheduled functions run once, in order", "[core][schedule]")
+{
+    std::vector<int> order;
+    for (int i = 0; i < 8; ++i) {
+        CHECK(schedule_function([&order, i]() { order.push_back(i); }));
+    }
+    run_scheduled_functions();
+    REQUIRE(order.size() == 8);
+    for (int i = 0; i < 8; ++i) {
+        CHECK(order[i] == i);
+    }
+    run_scheduled_functions();
+    CHECK(order.size() == 8);
+
+    // std::function and std::bind still work
+    int counter = 0;
+    std::function<void(void)> fn = [&counter]() { ++counter; };
+    CHECK(schedule_function(fn));
+    CHECK(schedule_function(std::bind([&counter](int n) { counter += n; }, 10)));
+    run_scheduled_functions();
+    CHECK(counter == 11);
+}
+
+TEST_CASE("Scheduled functions run by priority", "[core][schedule]")
+{
+    std::vector<int> order;
+    schedule_function([&order]() { order.push_back(3); }, SCHEDULE_PRIORITY_LOW);
+    schedule_function([&order]() { order.push_back(1); }, SCHEDULE_PRIORITY_NORMAL);
+    schedule_function([&order]() { order.push_back(0); }, SCHEDULE_PRIORITY_HIGH);
+    schedule_function([&order]() { order.push_back(2); }, SCHEDULE_PRIORITY_NORMAL);
+    run_scheduled_functions();
+    REQUIRE(order.size() == 4);
+    for (int i = 0; i < 4; ++i) {
+        CHECK(order[i] == i);
+    }
+}
+
+TEST_CASE("Scheduled functions are limited to SCHEDULED_FN_MAX_COUNT", "[core][schedule]")
+{
+    int counter = 0;
+    int i;
+    for (i = 0; i < SCHEDULED_FN_MAX_COUNT; ++i) {
+        CHECK(schedule_function([&counter]() { ++counter; }, (schedule_priority_t) (i % SCHEDULE_PRIORITY_COUNT)));
+    }
+    CHECK_FALSE(schedule_function([&counter]() { ++counter; }));
+    run_scheduled_functions();
+    CHECK(counter == SCHEDULED_FN_MAX_COUNT);
+    for (i = 0; i < SCHEDULED_FN_MAX_COUNT; ++i) {
+        CHECK(schedule_function([&counter]() { ++counter; }));
+    }
+    CHECK_FALSE(schedule_function([&counter]() { ++counter; }));
+    run_scheduled_functions();
+    CHECK(counter == 2 * SCHEDULED_FN_MAX_COUNT);
+}
+
+TEST_CASE("Functions scheduled while running run next time", "[core][schedule]")
+{
+    int counter = 0;
+    std::function<void(void)> again;
+    again = [&]() {
+        if (++counter < 3) {
+            schedule_function(again, SCHEDULE_PRIORITY_HIGH);
+        }
+    };
+    schedule_function(again, SCHEDULE_PRIORITY_LOW);
+    run_scheduled_functions();
+    CHECK(counter == 1);
+    run_scheduled_functions();
+    CHECK(counter == 2);
+    run_scheduled_functions();
+    run_scheduled_functions();
+    CHECK(counter == 3);
+}
+
+TEST_CASE("Delayed functions wait for their time", "[core][schedule]")
+{
+    std::vector<int> order;
+    CHECK(schedule_function_us([&order]() { order.push_back(1); }, 20000));
+    CHECK(schedule_function([&order]() { order.push_back(0); }));
+    run_scheduled_functions();
+    REQUIRE(order.size() == 1);
+    CHECK(order[0] == 0);
+    run_scheduled_functions();
+    CHECK(order.size() == 1);
+    uint32_t start = micros();
+    while (order.size() == 1 && micros() - start < 1000000) {
+        run_scheduled_functions();
+    }
+    uint32_t waited = micros() - start;
+    REQUIRE(order.size() == 2);
+    CHECK(waited >= 10000);
+}
+
+TEST_CASE("Scheduled callables are destroyed after running", "[core][schedule]")
+{
+    auto token = std::make_shared<int>(0);
+    std::weak_ptr<int> weak = token;
+    // larger than the inline storage, goes through a std::function
+    char big[64] = {1};
+    schedule_function([token]() { ++*token; });
+    schedule_function([token, big]() { *token += big[0]; });
+    token.reset();
+    CHECK_FALSE(weak.expired());
+    run_scheduled_functions();
+    CHECK(weak.expired());
+}
+
+TEST_CASE("Scheduling small callables doesn't allocate", "[core][schedule][benchmark]")
+{
+    const int rounds = 10000;
+    int counter = 0;
+    // warm up
+    schedule_function([]() {});
+    run_scheduled_functions();
+
+    alloc_stats_reset();
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < rounds; ++i) {
+        for (int j = 0; j < 8; ++j) {
+            schedule_function([&counter, j]() { counter += j; });
+        }
+        run_scheduled_functions();
+    }
+    auto elapsed = std::chrono::high_resolution_clock::now() - start;
+    AllocStats inlineStats = alloc_stats();
+
+    CHECK(counter == rounds * 28);
+    printf("scheduled functions, per function:\n");
+    printf("  %5.2f allocs %6.0f ns to schedule and run\n",
+           (double) inlineStats.allocs / (8 * rounds),
+           (double) std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / (8 * rounds));
+    if (alloc_stats_supported()) {
+        CHECK(inlineStats.allocs == 0);
+    }
+}
+
+static void busy_wait_us(uint32_t us)
+{
+    uint32_t start = micros();
+    while (micros() - start < us) {
+    }
+}
+
+TEST_CASE("Recurrent functions run until they return false", "[core][schedule]")
+{
+    int runs = 0;
+    int id = schedule_recurrent_function_us([&runs]() { return ++runs < 3; }, 2000);
+    REQUIRE(id >= 0);
+    run_scheduled_functions();
+    CHECK(runs == 0);
+    uint32_t start = micros();
+    while (runs < 3 && micros() - start < 1000000) {
+        run_scheduled_functions();
+    }
+    uint32_t elapsed = micros() - start;
+    CHECK(runs == 3);
+    CHECK(elapsed >= 4000);
+    scheduled_fn_stats_t stats;
+    CHECK_FALSE(get_scheduled_function_stats(id, stats));
+    run_scheduled_functions();
+    CHECK(runs == 3);
+}
+
+TEST_CASE("Recurrent functions report run time, lateness and overruns", "[core][schedule]")
+{
+    int runs = 0;
+    bool keep = true;
+    int id = schedule_recurrent_function_us([&runs, &keep]() {
+        ++runs;
+        busy_wait_us(500);
+        return keep;
+    }, 1000);
+    REQUIRE(id >= 0);
+    // let five periods pass before running it
+    busy_wait_us(5500);
+    run_scheduled_functions();
+    CHECK(runs == 1);
+    scheduled_fn_stats_t stats;
+    REQUIRE(get_scheduled_function_stats(id, stats));
+    CHECK(stats.runs == 1);
+    CHECK(stats.overruns >= 4);
+    CHECK(stats.maxLateUs >= 4000);
+    CHECK(stats.maxRunUs >= 500);
+    CHECK(stats.totalRunUs >= 500);
+    // the periods missed are skipped, not run back to back
+    run_scheduled_functions();
+    CHECK(runs == 1);
+
+    // there are SCHEDULED_RECURRENT_MAX_COUNT of them at most
+    int count = 1;
+    int stopped = 0;
+    while (schedule_recurrent_function_us([&stopped]() { ++stopped; return false; }, 1000) >= 0) {
+        ++count;
+    }
+    CHECK(count == SCHEDULED_RECURRENT_MAX_COUNT);
+
+    keep = false;
+    uint32_t start = micros();
+    while ((stopped < count - 1 || get_scheduled_function_stats(id, stats)) && micros() - start < 1000000) {
+        run_scheduled_functions();
+    }
+    CHECK(stopped == count - 1);
+    CHECK_FALSE(get_scheduled_function_stats(id, stats));
+}
+
+TEST_CASE("Scheduled functions over the budget run next time", "[core][schedule]")
+{
+    set_scheduled_functions_budget_us(2000);
+    int runs = 0;
+    for (int i = 0; i < 10; ++i) {
+        schedule_function([&runs]() {
+            ++runs;
+            busy_wait_us(1000);
+        });
+    }
+    run_scheduled_functions();
+    CHECK(runs >= 2);
+    CHECK(runs <= 3);
+    int passes = 1;
+    while (runs < 10) {
+        run_scheduled_functions();
+        ++passes;
+    }
+    CHECK(passes >= 4);
+    set_scheduled_functions_budget_us(SCHEDULED_FN_BUDGET_US);
+}
+
+TEST_CASE("Idle recurrent functions cost little", "[core][schedule][benchmark]")
+{
+    const int rounds = 100000;
+    const int count = SCHEDULED_RECURRENT_MAX_COUNT;
+    bool keep = true;
+    int stopped = 0;
+    for (int i = 0; i < count; ++i) {
+        REQUIRE(schedule_recurrent_function_us([&keep, &stopped]() {
+            if (!keep) {
+                ++stopped;
+            }
+            return keep;
+        }, 200000) >= 0);
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < rounds; ++i) {
+        run_scheduled_functions();
+    }
+    auto elapsed = std::chrono::high_resolution_clock::now() - start;
+    printf("run_scheduled_functions with %d recurrent functions waiting: %.0f ns\n", count,
+           (double) std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / rounds);
+
+    keep = false;
+    uint32_t wait = micros();
+    while (stopped < count && micros() - wait < 2000000) {
+        run_scheduled_functions();
+    }
+    CHECK(stopped == count);
+}
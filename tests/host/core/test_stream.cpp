@@ -0,0 +1,173 @@
+/*
+ test_stream.cpp - Stream helper tests
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+#include <catch.hpp>
+#include <string>
+#include <chrono>
+#include <Arduino.h>
+#include <StreamString.h>
+
+// hands out its data in segments, like received packets, with the peek
+// buffer API switched on or off
+class SegmentStream: public Stream {
+public:
+    SegmentStream(const std::string& data, size_t segment, bool bulk)
+        : data(data)
+        , segment(segment)
+        , bulk(bulk)
+    {
+        setTimeout(0);
+    }
+
+    int available() override
+    {
+        return data.size() - pos;
+    }
+    int read() override
+    {
+        ++reads;
+        return (pos < data.size()) ? (uint8_t) data[pos++] : -1;
+    }
+    int peek() override
+    {
+        return (pos < data.size()) ? (uint8_t) data[pos] : -1;
+    }
+    size_t write(uint8_t) override
+    {
+        return 0;
+    }
+
+    bool hasPeekBufferAPI() const override
+    {
+        return bulk;
+    }
+    size_t peekAvailable() override
+    {
+        size_t end = std::min((pos / segment + 1) * segment, data.size());
+        return end - pos;
+    }
+    const char* peekBuffer() override
+    {
+        return data.c_str() + pos;
+    }
+    void peekConsume(size_t consume) override
+    {
+        ++consumes;
+        pos += consume;
+    }
+
+    std::string data;
+    size_t segment;
+    bool bulk;
+    size_t pos = 0;
+    size_t reads = 0;
+    size_t consumes = 0;
+};
+
+static std::string rest(SegmentStream& stream)
+{
+    return stream.data.substr(stream.pos);
+}
+
+TEST_CASE("Stream helpers give the same results with and without the peek buffer", "[core][stream]")
+{
+    const std::string data = std::string("GET / HTTP/1.1\r\nHost: esp8266.local\r\n") +
+        "X-Binary: \xc3\xa9\xff" + '\0' + "tail\r\n\r\nbody";
+    const size_t segments[] = { 1, 3, 7, 64 };
+    for (size_t segment : segments) {
+        SegmentStream bytes(data, segment, false);
+        SegmentStream bulk(data, segment, true);
+        INFO("segment " << segment);
+
+        CHECK(bulk.readStringUntil('\n') == bytes.readStringUntil('\n'));
+        CHECK(rest(bulk) == rest(bytes));
+
+        char a[16], b[16];
+        CHECK(bulk.readBytesUntil(':', a, 4) == bytes.readBytesUntil(':', b, 4));
+        CHECK(std::string(a, 4) == std::string(b, 4));
+        CHECK(rest(bulk) == rest(bytes));
+        size_t la = bulk.readBytesUntil('\n', a, sizeof(a));
+        CHECK(la == bytes.readBytesUntil('\n', b, sizeof(b)));
+        CHECK(std::string(a, la) == std::string(b, la));
+
+        CHECK(bulk.find((char*) "\xff") == bytes.find((char*) "\xff"));
+        CHECK(rest(bulk) == rest(bytes));
+        // stops at the zero byte, as it always did
+        CHECK(bulk.find((char*) "tail") == bytes.find((char*) "tail"));
+        CHECK(rest(bulk) == rest(bytes));
+        CHECK(bulk.findUntil((char*) "body", (char*) "\r\n\r\n") == bytes.findUntil((char*) "body", (char*) "\r\n\r\n"));
+        CHECK(rest(bulk) == rest(bytes));
+
+        CHECK(bulk.readBytes(a, 2) == bytes.readBytes(b, 2));
+        CHECK(std::string(a, 2) == std::string(b, 2));
+        CHECK(bulk.readString() == bytes.readString());
+        CHECK(bulk.available() == 0);
+        CHECK_FALSE(bulk.find((char*) "x"));
+        CHECK(bulk.readStringUntil('\n') == "");
+    }
+}
+
+TEST_CASE("Stream helpers work on whole chunks", "[core][stream]")
+{
+    std::string data;
+    for (int i = 0; i < 20; ++i) {
+        data += "Header-" + std::to_string(i) + ": some value\r\n";
+    }
+    data += "\r\n";
+    SegmentStream stream(data, 256, true);
+    int lines = 0;
+    while (stream.readStringUntil('\n').length() > 1) {
+        ++lines;
+    }
+    CHECK(lines == 20);
+    CHECK(stream.reads == 0);
+    CHECK(stream.consumes < 30);
+
+    SegmentStream found(data, 256, true);
+    CHECK(found.find((char*) "Header-19: "));
+    CHECK(found.reads == 0);
+    CHECK(rest(found) == "some value\r\n\r\n");
+
+    StreamString text;
+    text.setTimeout(0);
+    text += "key=value&next=1";
+    CHECK(text.readStringUntil('=') == "key");
+    CHECK(text.find((char*) "&"));
+    char buf[8];
+    CHECK(text.readBytesUntil('\n', buf, sizeof(buf)) == 6);
+    CHECK(memcmp(buf, "next=1", 6) == 0);
+    CHECK(text.available() == 0);
+}
+
+TEST_CASE("Stream header line parsing speed", "[core][stream][benchmark]")
+{
+    std::string data;
+    for (int i = 0; i < 2000; ++i) {
+        data += "Header-" + std::to_string(i) + ": value of this header line\r\n";
+    }
+    printf("readStringUntil per header line:\n");
+    const char* names[] = { "byte by byte", "peek buffer" };
+    for (int bulk = 0; bulk < 2; ++bulk) {
+        SegmentStream stream(data, 1460, bulk);
+        auto start = std::chrono::steady_clock::now();
+        size_t lines = 0;
+        while (stream.available()) {
+            lines += stream.readStringUntil('\n').length() > 0;
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        CHECK(lines == 2000);
+        printf("  %-14s %6.1f reads %8.1f ns\n", names[bulk], (double) stream.reads / lines, ns / lines);
+    }
+}
@@ -0,0 +1,212 @@
+/*
+ test_string.cpp - String tests
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+#include <catch.hpp>
+#include <string.h>
+#include <utility>
+#include <vector>
+#include <Arduino.h>
+#include "../common/alloc_stats.h"
+
+TEST_CASE("String keeps its value across short and long lengths", "[core][string]")
+{
+    String s;
+    CHECK(s.length() == 0);
+    CHECK(strcmp(s.c_str(), "") == 0);
+    CHECK_FALSE(s);
+
+    std::string expected;
+    for (int i = 0; i < 200; ++i) {
+        char c = 'a' + i % 26;
+        s += c;
+        expected += c;
+        REQUIRE(s.length() == expected.size());
+        REQUIRE(strcmp(s.c_str(), expected.c_str()) == 0);
+    }
+    s.remove(3);
+    CHECK(s == "abc");
+    s.clear();
+    CHECK(s.length() == 0);
+    s = "0123456789abcdefghijklmnopqrstuvwxyz";
+    CHECK(s.length() == 36);
+    s = "short";
+    CHECK(s == "short");
+    s.clear(true);
+    CHECK(s.length() == 0);
+    CHECK(strcmp(s.c_str(), "") == 0);
+
+    String a = "key";
+    String b = a + "=" + 12 + "; " + F("path=/");
+    CHECK(b == "key=12; path=/");
+    b.replace("12", "1234567890123456");
+    CHECK(b == "key=1234567890123456; path=/");
+    b.replace("1234567890123456", "");
+    CHECK(b == "key=; path=/");
+    b.toUpperCase();
+    CHECK(b == "KEY=; PATH=/");
+    CHECK(b.indexOf("PATH") == 6);
+    CHECK(b.lastIndexOf('=') == 10);
+    CHECK(b.substring(6) == "PATH=/");
+    String t = "  padded  ";
+    t.trim();
+    CHECK(t == "padded");
+    CHECK(t.startsWith("pad"));
+    CHECK(t.endsWith("ded"));
+    CHECK(String("abc") < String("abd"));
+    CHECK(String("42").toInt() == 42);
+
+    // indexing a short string writes through
+    String w = "abc";
+    w[1] = 'X';
+    w.setCharAt(2, 'Y');
+    CHECK(w == "aXY");
+}
+
+TEST_CASE("String copies and moves between short and long values", "[core][string]")
+{
+    const char* longValue = "a value that is too long to be stored inline";
+    String shortA = "ab";
+    String longA = longValue;
+    String copy = shortA;
+    CHECK(copy == "ab");
+    copy = longA;
+    CHECK(copy == longValue);
+    copy = shortA;
+    CHECK(copy == "ab");
+
+    String moved(std::move(longA));
+    CHECK(moved == longValue);
+    CHECK(longA.length() == 0);
+    String movedShort(std::move(shortA));
+    CHECK(movedShort == "ab");
+    CHECK(shortA.length() == 0);
+
+    String target = "other long value, also not inline at all";
+    target = std::move(moved);
+    CHECK(target == longValue);
+    target = std::move(movedShort);
+    CHECK(target == "ab");
+
+    std::vector<String> v;
+    for (int i = 0; i < 50; ++i) {
+        v.push_back(String(i) + (i % 2 ? "" : " and something long enough for the heap"));
+    }
+    for (int i = 0; i < 50; ++i) {
+        REQUIRE(v[i].startsWith(String(i)));
+        REQUIRE(v[i].length() == (i % 2 ? String(i).length() : String(i).length() + 39));
+    }
+}
+
+TEST_CASE("String moves don't allocate", "[core][string]")
+{
+    if (!alloc_stats_supported()) {
+        return;
+    }
+    String longValue = "a value that is too long to be stored inline";
+    String shortValue = "ab";
+    String other = "another value that is too long for inline storage";
+    alloc_stats_reset();
+    String a(std::move(longValue));
+    String b(std::move(shortValue));
+    a = std::move(other);
+    b = std::move(a);
+    AllocStats stats = alloc_stats();
+    CHECK(stats.allocs == 0);
+    CHECK(stats.reallocs == 0);
+    CHECK(stats.frees == 0);
+}
+
+TEST_CASE("String heap use for HTTP header workloads", "[core][string][benchmark]")
+{
+    static const char* const headers[][2] = {
+        {"Host", "esp8266.local"},
+        {"Connection", "keep-alive"},
+        {"Accept", "*/*"},
+        {"Accept-Encoding", "gzip"},
+        {"Content-Type", "text/html"},
+        {"Content-Length", "1234"},
+        {"Cache-Control", "max-age=86400"},
+        {"User-Agent", "Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36"},
+    };
+    const size_t count = sizeof(headers) / sizeof(headers[0]);
+    const int rounds = 1000;
+
+    auto report = [&](const char* what, AllocStats stats) {
+        printf("  %-28s %6.2f allocs %6.2f reallocs %6.2f frees\n", what,
+               (double) stats.allocs / rounds, (double) stats.reallocs / rounds, (double) stats.frees / rounds);
+        return stats.allocs + stats.reallocs;
+    };
+    printf("String heap calls per request:\n");
+
+    // names and values kept as separate Strings, as a request parser would
+    alloc_stats_reset();
+    for (int r = 0; r < rounds; ++r) {
+        std::vector<String> keep;
+        keep.reserve(2 * count);
+        for (size_t i = 0; i < count; ++i) {
+            keep.push_back(String(headers[i][0]));
+            keep.push_back(String(headers[i][1]));
+        }
+    }
+    size_t fields = report("header names and values", alloc_stats());
+
+    // a response header block built by appending
+    alloc_stats_reset();
+    for (int r = 0; r < rounds; ++r) {
+        String response = F("HTTP/1.1 200 OK\r\n");
+        for (size_t i = 0; i < count; ++i) {
+            response += headers[i][0];
+            response += F(": ");
+            response += headers[i][1];
+            response += "\r\n";
+        }
+        response += "\r\n";
+    }
+    size_t block = report("header block, appended", alloc_stats());
+
+    // and with temporaries, the way sendHeader() used to do it
+    alloc_stats_reset();
+    for (int r = 0; r < rounds; ++r) {
+        String response;
+        for (size_t i = 0; i < count; ++i) {
+            String line = String(headers[i][0]) + F(": ") + headers[i][1] + "\r\n";
+            response += line;
+        }
+    }
+    size_t temporaries = report("header block, temporaries", alloc_stats());
+
+    // status codes and short tokens
+    alloc_stats_reset();
+    for (int r = 0; r < rounds; ++r) {
+        String code(200);
+        String version = String(F("HTTP/1.")) + 1;
+        String method = "GET";
+        String empty;
+        code += ' ';
+        (void) version;
+        (void) method;
+        (void) empty;
+    }
+    size_t tokens = report("short tokens", alloc_stats());
+
+    if (alloc_stats_supported()) {
+        // with a heap buffer for every String and 16 byte growth steps these
+        // were 16, 13, 41 and 6 heap calls per request
+        CHECK(fields <= (size_t) rounds * 2);
+        CHECK(block <= (size_t) rounds * 5);
+        CHECK(temporaries <= (size_t) rounds * 24);
+        CHECK(tokens == 0);
+    }
+}
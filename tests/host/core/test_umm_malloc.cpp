@@ -0,0 +1,396 @@
+/*
+ test_umm_malloc.cpp - umm_malloc size class and statistics tests
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+#include <catch.hpp>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include "../common/umm_host.h"
+
+extern "C" size_t umm_classes_size_class_free(void);
+
+namespace {
+
+struct TraceOp {
+    enum Type { ALLOC, REALLOC, FREE } type;
+    uint16_t slot;
+    uint16_t size;
+};
+
+// Deterministic stand-in for the heap traffic of a sketch serving HTTP over
+// WiFi: short lived Strings and std::functions of 8 to 64 bytes, packet
+// buffers of a few hundred bytes to a full segment, Strings growing by
+// concatenation, and a few long lived objects.
+std::vector<TraceOp> makeTrace(size_t count)
+{
+    std::vector<TraceOp> trace;
+    std::vector<bool> live(512, false);
+    uint32_t seed = 12345;
+    auto rnd = [&](uint32_t n) {
+        seed = seed * 1103515245 + 12345;
+        return (seed >> 8) % n;
+    };
+    auto freeSlot = [&](uint16_t first, uint16_t count) -> int {
+        uint16_t start = rnd(count);
+        for (uint16_t i = 0; i < count; ++i) {
+            uint16_t slot = first + (start + i) % count;
+            if (!live[slot]) {
+                return slot;
+            }
+        }
+        return -1;
+    };
+    auto liveSlot = [&](uint16_t first, uint16_t count) -> int {
+        uint16_t start = rnd(count);
+        for (uint16_t i = 0; i < count; ++i) {
+            uint16_t slot = first + (start + i) % count;
+            if (live[slot]) {
+                return slot;
+            }
+        }
+        return -1;
+    };
+    // slots 0..255 small objects, 256..271 buffers, 320..383 growing
+    // strings, 384..447 long lived
+    while (trace.size() < count) {
+        uint32_t kind = rnd(100);
+        int slot;
+        if (kind < 70) {
+            if (rnd(2) && (slot = freeSlot(0, 256)) >= 0) {
+                trace.push_back({TraceOp::ALLOC, (uint16_t) slot, (uint16_t) (8 + rnd(57))});
+                live[slot] = true;
+            } else if ((slot = liveSlot(0, 256)) >= 0) {
+                trace.push_back({TraceOp::FREE, (uint16_t) slot, 0});
+                live[slot] = false;
+            }
+        } else if (kind < 80) {
+            if (rnd(2) && (slot = freeSlot(256, 16)) >= 0) {
+                static const uint16_t sizes[] = {128, 256, 536, 1460};
+                trace.push_back({TraceOp::ALLOC, (uint16_t) slot, sizes[rnd(4)]});
+                live[slot] = true;
+            } else if ((slot = liveSlot(256, 16)) >= 0) {
+                trace.push_back({TraceOp::FREE, (uint16_t) slot, 0});
+                live[slot] = false;
+            }
+        } else if (kind < 98) {
+            if ((slot = liveSlot(320, 64)) >= 0 && rnd(4)) {
+                if (rnd(6)) {
+                    trace.push_back({TraceOp::REALLOC, (uint16_t) slot, (uint16_t) (16 + rnd(240))});
+                } else {
+                    trace.push_back({TraceOp::FREE, (uint16_t) slot, 0});
+                    live[slot] = false;
+                }
+            } else if ((slot = freeSlot(320, 64)) >= 0) {
+                trace.push_back({TraceOp::ALLOC, (uint16_t) slot, (uint16_t) (8 + rnd(24))});
+                live[slot] = true;
+            }
+        } else if ((slot = freeSlot(384, 64)) >= 0) {
+            trace.push_back({TraceOp::ALLOC, (uint16_t) slot, (uint16_t) (16 + rnd(100))});
+            live[slot] = true;
+        }
+    }
+    return trace;
+}
+
+struct ReplayResult {
+    double nsPerOp;
+    umm_host_critical_stats critical;
+    size_t failed;
+    double worstFragmentation;
+};
+
+ReplayResult replay(const umm_host_heap& heap, const std::vector<TraceOp>& trace)
+{
+    using clock = std::chrono::steady_clock;
+    ReplayResult result;
+    memset(&result, 0, sizeof(result));
+    std::vector<void*> slots(512, nullptr);
+    heap.init();
+    umm_host_critical_reset();
+    clock::duration elapsed(0);
+    for (size_t i = 0; i < trace.size(); ++i) {
+        const TraceOp& op = trace[i];
+        void*& p = slots[op.slot];
+        auto start = clock::now();
+        switch (op.type) {
+        case TraceOp::ALLOC:
+            p = heap.malloc(op.size);
+            break;
+        case TraceOp::REALLOC: {
+            void* q = heap.realloc(p, op.size);
+            if (q) {
+                p = q;
+            }
+            break;
+        }
+        case TraceOp::FREE:
+            heap.free(p);
+            p = nullptr;
+            break;
+        }
+        elapsed += clock::now() - start;
+        if (op.type != TraceOp::FREE && !p) {
+            ++result.failed;
+        }
+        if (i % 500 == 0) {
+            size_t free = heap.freeHeap();
+            double fragmentation = free ? 1.0 - (double) heap.maxFreeBlock() / free : 0;
+            if (fragmentation > result.worstFragmentation) {
+                result.worstFragmentation = fragmentation;
+            }
+        }
+    }
+    result.critical = umm_host_critical();
+    result.nsPerOp = (double) std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / trace.size();
+    for (void* p : slots) {
+        heap.free(p);
+    }
+    return result;
+}
+
+} // namespace
+
+TEST_CASE("Size classes hand out blocks of the right size", "[umm_malloc]")
+{
+    const umm_host_heap& heap = umm_host_classes;
+    heap.init();
+    // the first small allocation carves the arena out of the heap
+    heap.free(heap.malloc(1));
+    size_t initialFree = heap.freeHeap();
+    std::vector<uint8_t*> blocks;
+    for (size_t size = 1; size <= 100; ++size) {
+        uint8_t* p = (uint8_t*) heap.malloc(size);
+        REQUIRE(p);
+        memset(p, (int) size, size);
+        blocks.push_back(p);
+    }
+    size_t slabFree = umm_classes_size_class_free();
+    CHECK(slabFree > 0);
+    // freed slots are handed out again for the same sizes
+    for (size_t i = 0; i < blocks.size(); i += 2) {
+        heap.free(blocks[i]);
+    }
+    CHECK(umm_classes_size_class_free() > slabFree);
+    for (size_t i = 0; i < blocks.size(); i += 2) {
+        size_t size = i + 1;
+        blocks[i] = (uint8_t*) heap.malloc(size);
+        REQUIRE(blocks[i]);
+        memset(blocks[i], (int) size, size);
+    }
+    CHECK(umm_classes_size_class_free() == slabFree);
+    // growing moves small blocks between classes and out to the heap
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        size_t size = i + 1;
+        for (size_t j = 0; j < size; ++j) {
+            REQUIRE(blocks[i][j] == (uint8_t) size);
+        }
+        blocks[i] = (uint8_t*) heap.realloc(blocks[i], size + 20);
+        REQUIRE(blocks[i]);
+        for (size_t j = 0; j < size; ++j) {
+            REQUIRE(blocks[i][j] == (uint8_t) size);
+        }
+    }
+    for (uint8_t* p : blocks) {
+        heap.free(p);
+    }
+    // the arena is free space again
+    CHECK(heap.freeHeap() == initialFree);
+}
+
+TEST_CASE("Small blocks go to the heap when the arena is full", "[umm_malloc]")
+{
+    const umm_host_heap& heap = umm_host_classes;
+    heap.init();
+    // the first small allocation carves the arena out of the heap
+    heap.free(heap.malloc(1));
+    size_t initialFree = heap.freeHeap();
+    std::vector<uint8_t*> blocks;
+    while (uint8_t* p = (uint8_t*) heap.malloc(24)) {
+        memset(p, (int) blocks.size(), 24);
+        blocks.push_back(p);
+    }
+    REQUIRE(blocks.size() > 1000);
+    CHECK(umm_classes_size_class_free() < 24);
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        REQUIRE(blocks[i][23] == (uint8_t) i);
+    }
+    // emptying the arena lets another class use its pages
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        heap.free(blocks[i]);
+    }
+    CHECK(heap.freeHeap() == initialFree);
+    void* p = heap.malloc(64);
+    CHECK(p);
+    heap.free(p);
+}
+
+TEST_CASE("Heap statistics describe the free space", "[umm_malloc]")
+{
+    const umm_host_heap& heap = umm_host_plain;
+    heap.init();
+    CHECK(heap.fragmentation() == 0);
+    size_t max = heap.maxFreeBlock();
+    CHECK(max > UMM_HOST_HEAP_SIZE - 64);
+    void* all = heap.malloc(max);
+    CHECK(all);
+    heap.free(all);
+    CHECK_FALSE(heap.malloc(max + 1));
+
+    // 50 holes of 9 blocks each between live blocks
+    std::vector<void*> blocks;
+    for (int i = 0; i < 100; ++i) {
+        blocks.push_back(heap.malloc(64));
+    }
+    for (int i = 0; i < 100; i += 2) {
+        heap.free(blocks[i]);
+    }
+    int fragmentation = heap.fragmentation();
+    heap.info(NULL, 0);
+    CHECK(heap.heapInfo->freeEntries == 51);
+    CHECK(heap.heapInfo->freeRuns[3] == 50);
+    size_t runs = 0;
+    for (int i = 0; i < UMM_FREE_RUN_BUCKETS; ++i) {
+        runs += heap.heapInfo->freeRuns[i];
+    }
+    // the holes and the rest of the heap
+    CHECK(runs == 51);
+    CHECK(heap.heapInfo->freeRuns[UMM_FREE_RUN_BUCKETS - 1] == 1);
+    CHECK(heap.maxFreeBlock() < max - 100 * 64);
+
+    // the rest of the heap as well, all that's free is the holes
+    void* rest = heap.malloc(heap.maxFreeBlock());
+    REQUIRE(rest);
+    CHECK(heap.maxFreeBlock() == 9 * 8 - 4);
+    CHECK(heap.fragmentation() > 80);
+    CHECK(heap.fragmentation() > fragmentation);
+    heap.free(rest);
+    for (int i = 1; i < 100; i += 2) {
+        heap.free(blocks[i]);
+    }
+    CHECK(heap.fragmentation() == 0);
+}
+
+TEST_CASE("Allocation sites count live blocks and bytes", "[umm_malloc]")
+{
+    const umm_host_heap& heap = umm_host_sites;
+    heap.init();
+    size_t initialFree = heap.freeHeap();
+    const void* siteA = (const void*) 0x40201000;
+    const void* siteB = (const void*) 0x40202000;
+    std::vector<void*> a;
+    for (int i = 0; i < 10; ++i) {
+        uint8_t* p = (uint8_t*) heap.mallocAt(100, siteA);
+        REQUIRE(p);
+        memset(p, 0x55, 100);
+        a.push_back(p);
+    }
+    void* b = heap.mallocAt(20, siteB);
+    void* c = heap.malloc(2000);
+    REQUIRE(b);
+    REQUIRE(c);
+
+    UMM_SITE_INFO sites[4];
+    size_t count = heap.sites(sites, 4);
+    REQUIRE(count == 3);
+    CHECK(sites[0].liveBytes >= 2000);
+    CHECK(sites[1].site == siteA);
+    CHECK(sites[1].liveCount == 10);
+    CHECK(sites[1].liveBytes >= 1000);
+    CHECK(sites[1].liveBytes < 1100);
+    CHECK(sites[2].site == siteB);
+    CHECK(sites[2].liveCount == 1);
+    // a short table gets the largest ones
+    REQUIRE(heap.sites(sites, 1) == 1);
+    CHECK(sites[0].liveBytes >= 2000);
+
+    // realloc charges the block to its caller
+    for (int i = 0; i < 5; ++i) {
+        heap.free(a[i]);
+    }
+    b = heap.realloc(b, 200);
+    REQUIRE(b);
+    count = heap.sites(sites, 4);
+    REQUIRE(count == 4);
+    bool foundA = false;
+    for (size_t i = 0; i < count; ++i) {
+        if (sites[i].site == siteA) {
+            foundA = true;
+            CHECK(sites[i].liveCount == 5);
+            CHECK(sites[i].allocCount == 10);
+        }
+        if (sites[i].site == siteB) {
+            CHECK(sites[i].liveCount == 0);
+            CHECK(sites[i].liveBytes == 0);
+        }
+    }
+    CHECK(foundA);
+
+    for (int i = 5; i < 10; ++i) {
+        REQUIRE(((uint8_t*) a[i])[99] == 0x55);
+        heap.free(a[i]);
+    }
+    heap.free(b);
+    heap.free(c);
+    count = heap.sites(sites, 4);
+    for (size_t i = 0; i < count; ++i) {
+        CHECK(sites[i].liveBytes == 0);
+        CHECK(sites[i].liveCount == 0);
+    }
+    CHECK(heap.freeHeap() == initialFree);
+}
+
+TEST_CASE("Sites beyond the table are added up together", "[umm_malloc]")
+{
+    const umm_host_heap& heap = umm_host_sites;
+    heap.init();
+    std::vector<void*> blocks;
+    for (uintptr_t i = 1; i <= 40; ++i) {
+        blocks.push_back(heap.mallocAt(16, (const void*) (0x40200000 + i * 4)));
+    }
+    UMM_SITE_INFO sites[64];
+    size_t count = heap.sites(sites, 64);
+    // 31 sites of their own and the rest
+    CHECK(count == 32);
+    size_t live = 0;
+    bool others = false;
+    for (size_t i = 0; i < count; ++i) {
+        live += sites[i].liveCount;
+        if (!sites[i].site) {
+            others = true;
+            CHECK(sites[i].liveCount == 9);
+        }
+    }
+    CHECK(others);
+    CHECK(live == 40);
+    for (void* p : blocks) {
+        heap.free(p);
+    }
+}
+
+TEST_CASE("Allocation trace replay", "[umm_malloc][benchmark]")
+{
+    std::vector<TraceOp> trace = makeTrace(200000);
+    ReplayResult plain = replay(umm_host_plain, trace);
+    ReplayResult classes = replay(umm_host_classes, trace);
+
+    printf("replaying %zu heap operations on a %d byte heap:\n", trace.size(), UMM_HOST_HEAP_SIZE);
+    for (auto r : {std::make_pair("best fit:    ", &plain), std::make_pair("size classes:", &classes)}) {
+        printf("  %s %6.0f ns/op, interrupts off %6.0f ns/op, longest %6llu ns, %zu failed, fragmentation up to %2.0f%%\n",
+               r.first, r.second->nsPerOp, (double) r.second->critical.totalNs / trace.size(),
+               (unsigned long long) r.second->critical.maxNs, r.second->failed, r.second->worstFragmentation * 100);
+    }
+    CHECK(classes.critical.totalNs < plain.critical.totalNs);
+    CHECK(classes.failed <= plain.failed);
+}
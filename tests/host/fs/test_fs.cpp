@@ -18,6 +18,9 @@
 #include <FS.h>
 #include "../common/spiffs_mock.h"
 #include <spiffs/spiffs.h>
+#include <spiffs_api.h>
+#include <spiffs_hal.h>
+#include <Schedule.h>
 
 static void createFile (const char* name, const char* content)
 {
@@ -184,3 +187,421 @@ TEST_CASE("#1819 Can list all files with openDir(\"\")", "[fs][bugreport]")
     auto files = listDir("");
     REQUIRE(files.size() == 4);
 }
+
+TEST_CASE("Generation changes with every write, but not with reads", "[fs]")
+{
+    SPIFFS_MOCK_DECLARE(64, 8, 512);
+    REQUIRE(SPIFFS.begin());
+    uint32_t gen = SPIFFS.generation();
+    REQUIRE(gen != 0);
+    createFile("/index.html", "<html></html>");
+    REQUIRE(SPIFFS.generation() != gen);
+
+    gen = SPIFFS.generation();
+    REQUIRE(readFile("/index.html") == "<html></html>");
+    REQUIRE(SPIFFS.exists("/index.html"));
+    listDir("/");
+    REQUIRE(SPIFFS.generation() == gen);
+
+    auto f = SPIFFS.open("/index.html", "a");
+    REQUIRE(f);
+    gen = SPIFFS.generation();
+    f.print("<!-- -->");
+    f.close();
+    REQUIRE(SPIFFS.generation() != gen);
+
+    gen = SPIFFS.generation();
+    REQUIRE(SPIFFS.rename("/index.html", "/index.htm"));
+    REQUIRE(SPIFFS.generation() != gen);
+
+    gen = SPIFFS.generation();
+    REQUIRE(SPIFFS.remove("/index.htm"));
+    REQUIRE(SPIFFS.generation() != gen);
+}
+
+TEST_CASE("changedSince tells which paths changed", "[fs]")
+{
+    SPIFFS_MOCK_DECLARE(64, 8, 512);
+    REQUIRE(SPIFFS.begin());
+    createFile("/a.html", "a");
+    createFile("/b.html", "b");
+    uint32_t gen = SPIFFS.generation();
+    CHECK_FALSE(SPIFFS.changedSince("/a.html", gen));
+    CHECK(SPIFFS.changedSince("/a.html", 0));
+
+    auto f = SPIFFS.open("/a.html", "a");
+    REQUIRE(f);
+    f.print("more");
+    f.print("and more");
+    f.close();
+    CHECK(SPIFFS.changedSince("/a.html", gen));
+    CHECK_FALSE(SPIFFS.changedSince("/b.html", gen));
+    CHECK_FALSE(SPIFFS.changedSince("/missing", gen));
+
+    gen = SPIFFS.generation();
+    REQUIRE(SPIFFS.rename("/a.html", "/c.html"));
+    CHECK(SPIFFS.changedSince("/a.html", gen));
+    CHECK(SPIFFS.changedSince("/c.html", gen));
+    CHECK_FALSE(SPIFFS.changedSince("/b.html", gen));
+    REQUIRE(SPIFFS.remove("/c.html"));
+    CHECK(SPIFFS.changedSince("/c.html", gen));
+    CHECK_FALSE(SPIFFS.changedSince("/b.html", gen));
+
+    // too many changes since to tell
+    for (int i = 0; i < SPIFFS_CHANGE_LOG; ++i) {
+        createFile(String("/" + String(i)).c_str(), "x");
+    }
+    CHECK(SPIFFS.changedSince("/b.html", gen));
+    gen = SPIFFS.generation();
+    CHECK_FALSE(SPIFFS.changedSince("/b.html", gen));
+
+    REQUIRE(SPIFFS.format());
+    CHECK(SPIFFS.changedSince("/b.html", gen));
+}
+
+static void checkNames (bool indexed)
+{
+    SPIFFS_MOCK_DECLARE(64, 8, 512);
+    spiffs_mock.impl()->setIndexEnabled(indexed);
+    REQUIRE(SPIFFS.begin());
+    createFile("/www/index.html", "<html></html>");
+    createFile("/www/css/site.css", "body {}");
+    createFile("/config.json", "{}");
+    createFile("plain", "no slash");
+
+    CHECK(SPIFFS.exists("/www/index.html"));
+    CHECK(SPIFFS.exists("plain"));
+    CHECK_FALSE(SPIFFS.exists("/www/index.htm"));
+    CHECK_FALSE(SPIFFS.exists("/www"));
+    CHECK(SPIFFS.size("/www/index.html") == 13);
+    CHECK(SPIFFS.size("/config.json") == 2);
+    CHECK(SPIFFS.size("/missing") == 0);
+
+    CHECK(SPIFFS.isDir("/"));
+    CHECK(SPIFFS.isDir("/www"));
+    CHECK(SPIFFS.isDir("/www/"));
+    CHECK(SPIFFS.isDir("/www/css"));
+    CHECK_FALSE(SPIFFS.isDir("/ww"));
+    CHECK_FALSE(SPIFFS.isDir("/config.json"));
+    CHECK_FALSE(SPIFFS.isDir("/www/index.html"));
+
+    CHECK(listDir("/www/") == std::set<String>({"/www/index.html", "/www/css/site.css"}));
+    CHECK(listDir("/www/c") == std::set<String>({"/www/css/site.css"}));
+    CHECK(listDir("/c").size() == 1);
+
+    REQUIRE(SPIFFS.rename("/www/index.html", "/www/old.html"));
+    CHECK_FALSE(SPIFFS.exists("/www/index.html"));
+    CHECK(readFile("/www/old.html") == "<html></html>");
+    REQUIRE(SPIFFS.remove("/www/css/site.css"));
+    CHECK_FALSE(SPIFFS.isDir("/www/css"));
+    CHECK(listDir("/www/") == std::set<String>({"/www/old.html"}));
+
+    SPIFFS_MOCK_RESET();
+    spiffs_mock.impl()->setIndexEnabled(indexed);
+    REQUIRE(SPIFFS.begin());
+    CHECK(SPIFFS.exists("/www/old.html"));
+    CHECK(SPIFFS.size("/www/old.html") == 13);
+    CHECK(listDir("").size() == 3);
+}
+
+TEST_CASE("Names resolve the same with and without the index", "[fs][index]")
+{
+    checkNames(true);
+    checkNames(false);
+}
+
+TEST_CASE("Index follows files moved by garbage collection", "[fs][index]")
+{
+    SPIFFS_MOCK_DECLARE(64, 8, 512);
+    REQUIRE(SPIFFS.begin());
+    String text(' ', 1000);
+    for (int i = 0; i < 12; ++i) {
+        createFile((String("/keep/") + i).c_str(), (String(i) + text).c_str());
+    }
+    // churn through the free space until every block was collected
+    for (int round = 0; round < 40; ++round) {
+        createFile("/churn", text.c_str());
+        REQUIRE(SPIFFS.remove("/churn"));
+        createFile((String("/keep/") + (round % 12)).c_str(), (String(round % 12) + text).c_str());
+    }
+    for (int i = 0; i < 12; ++i) {
+        String name = String("/keep/") + i;
+        CHECK(readFile(name.c_str()) == String(i) + text);
+        CHECK(SPIFFS.size(name.c_str()) == (String(i) + text).length());
+    }
+    CHECK_FALSE(SPIFFS.exists("/churn"));
+    CHECK(listDir("/keep/").size() == 12);
+}
+
+TEST_CASE("Files can be removed while listing", "[fs][index]")
+{
+    SPIFFS_MOCK_DECLARE(64, 8, 512);
+    REQUIRE(SPIFFS.begin());
+    for (int i = 0; i < 10; ++i) {
+        createFile((String("/tmp/") + i).c_str(), "x");
+    }
+    createFile("/other", "y");
+    Dir dir = SPIFFS.openDir("/tmp/");
+    size_t count = 0;
+    while (dir.next()) {
+        REQUIRE(SPIFFS.remove(dir.entryName()));
+        ++count;
+    }
+    CHECK(count == 10);
+    CHECK(listDir("/").size() == 1);
+}
+
+TEST_CASE("Index saves flash reads on lookups", "[fs][index][benchmark]")
+{
+    const int dirs = 8;
+    const int filesPerDir = 50;
+    SPIFFS_MOCK_DECLARE(1024, 8, 256);
+    REQUIRE(SPIFFS.begin());
+    for (int d = 0; d < dirs; ++d) {
+        for (int f = 0; f < filesPerDir; ++f) {
+            createFile((String("/d") + d + "/file" + f + ".txt").c_str(), "data");
+        }
+    }
+
+    struct Cost {
+        size_t reads;
+        size_t bytes;
+    };
+    auto measure = [&](bool indexed, Cost& exists, Cost& list) {
+        spiffs_mock.impl()->setIndexEnabled(indexed);
+        SPIFFS.end();
+        REQUIRE(SPIFFS.begin());
+
+        SpiffsMock::resetStats();
+        size_t found = 0;
+        for (int f = 0; f < filesPerDir; ++f) {
+            found += SPIFFS.exists((String("/d5/file") + f + ".txt").c_str());
+            found += SPIFFS.size((String("/d2/file") + f + ".txt").c_str()) == 4;
+        }
+        found += SPIFFS.isDir("/d7");
+        found += SPIFFS.exists("/d9/file0.txt");
+        CHECK(found == 2 * filesPerDir + 1);
+        exists.reads = SpiffsMock::readCount();
+        exists.bytes = SpiffsMock::readBytes();
+
+        SpiffsMock::resetStats();
+        CHECK(listDir("/d3/").size() == (size_t) filesPerDir);
+        list.reads = SpiffsMock::readCount();
+        list.bytes = SpiffsMock::readBytes();
+    };
+
+    Cost scanExists, scanList, indexExists, indexList;
+    measure(false, scanExists, scanList);
+    measure(true, indexExists, indexList);
+
+    printf("flash reads with %d files in %d directories:\n", dirs * filesPerDir, dirs);
+    printf("  %d lookups, scan:  %7zu reads %9zu bytes\n", 2 * filesPerDir + 2, scanExists.reads, scanExists.bytes);
+    printf("  %d lookups, index: %7zu reads %9zu bytes\n", 2 * filesPerDir + 2, indexExists.reads, indexExists.bytes);
+    printf("  list one dir, scan:  %5zu reads %9zu bytes\n", scanList.reads, scanList.bytes);
+    printf("  list one dir, index: %5zu reads %9zu bytes\n", indexList.reads, indexList.bytes);
+    CHECK(indexExists.bytes < scanExists.bytes);
+    CHECK(indexList.bytes < scanList.bytes);
+}
+
+TEST_CASE("FSInfo reports the read cache", "[fs][cache]")
+{
+    SPIFFS_MOCK_DECLARE(64, 8, 512);
+    REQUIRE(SPIFFS.begin());
+    createFile("/config.json", "{\"ssid\":\"test\"}");
+    for (int i = 0; i < 3; ++i) {
+        REQUIRE(readFile("/config.json") == "{\"ssid\":\"test\"}");
+    }
+    FSInfo info;
+    REQUIRE(SPIFFS.info(info));
+    CHECK(info.cachePages == 5);
+    CHECK(info.cacheHits > 0);
+    CHECK(info.cacheMisses > 0);
+
+    FSConfig config;
+    config.cachePages = 12;
+    REQUIRE(SPIFFS.begin(config));
+    REQUIRE(SPIFFS.info(info));
+    CHECK(info.cachePages == 12);
+    CHECK(info.cacheEvictions == 0);
+    REQUIRE(readFile("/config.json") == "{\"ssid\":\"test\"}");
+
+    config.cachePages = 100;
+    REQUIRE(SPIFFS.begin(config));
+    REQUIRE(SPIFFS.info(info));
+    CHECK(info.cachePages == SPIFFS_MAX_CACHE_PAGES);
+    REQUIRE(readFile("/config.json") == "{\"ssid\":\"test\"}");
+}
+
+TEST_CASE("Read-ahead keeps position, seek and peek consistent", "[fs][cache]")
+{
+    SPIFFS_MOCK_DECLARE(64, 8, 512);
+    FSConfig config;
+    config.readAhead = 256;
+    REQUIRE(SPIFFS.begin(config));
+    String content;
+    for (int i = 0; content.length() < 3000; ++i) {
+        content += String(i) + ",";
+    }
+    createFile("/data.csv", content.c_str());
+
+    File f = SPIFFS.open("/data.csv", "r");
+    REQUIRE(f);
+    String text;
+    while (f.available() > 2000) {
+        int c = f.peek();
+        REQUIRE(f.read() == c);
+        text += (char) c;
+        CHECK(f.position() == text.length());
+    }
+    REQUIRE(f.seek(10, SeekCur));
+    text += content.substring(text.length(), text.length() + 10);
+    REQUIRE(f.seek(-20, SeekCur));
+    text.remove(text.length() - 20);
+    CHECK(f.position() == text.length());
+    char chunk[700];
+    size_t len = f.read((uint8_t*) chunk, sizeof(chunk));
+    REQUIRE(len == sizeof(chunk));
+    text.concat(chunk, len);
+    while (f.available()) {
+        text += (char) f.read();
+    }
+    CHECK(f.read() == -1);
+    CHECK(text == content);
+    REQUIRE(f.seek(5, SeekSet));
+    CHECK(f.read() == content[5]);
+}
+
+TEST_CASE("Stream helpers read files through the read-ahead buffer", "[fs][cache]")
+{
+    SPIFFS_MOCK_DECLARE(64, 8, 512);
+    FSConfig config;
+    config.readAhead = 128;
+    REQUIRE(SPIFFS.begin(config));
+    String content;
+    for (int i = 0; i < 100; ++i) {
+        content += "line " + String(i) + "\n";
+    }
+    createFile("/lines.txt", content.c_str());
+
+    File f = SPIFFS.open("/lines.txt", "r");
+    REQUIRE(f);
+    f.setTimeout(0);
+    CHECK(f.hasPeekBufferAPI());
+    for (int i = 0; i < 50; ++i) {
+        REQUIRE(f.readStringUntil('\n') == "line " + String(i));
+    }
+    CHECK(f.position() == content.indexOf("line 50"));
+    REQUIRE(f.find("line 98\n"));
+    CHECK(f.readString() == "line 99\n");
+    CHECK(f.available() == 0);
+}
+
+TEST_CASE("Read cache and read-ahead reduce flash traffic", "[fs][cache][benchmark]")
+{
+    const int files = 6;
+    const int rounds = 10;
+    SPIFFS_MOCK_DECLARE(256, 8, 256);
+    REQUIRE(SPIFFS.begin());
+    String content(' ', 600);
+    for (int i = 0; i < files; ++i) {
+        createFile((String("/asset") + i).c_str(), content.c_str());
+    }
+
+    auto reread = [&](size_t cachePages, size_t readAhead, FSInfo& info) {
+        FSConfig config;
+        config.cachePages = cachePages;
+        config.readAhead = readAhead;
+        SPIFFS.end();
+        REQUIRE(SPIFFS.begin(config));
+        SpiffsMock::resetStats();
+        for (int r = 0; r < rounds; ++r) {
+            for (int i = 0; i < files; ++i) {
+                File f = SPIFFS.open((String("/asset") + i).c_str(), "r");
+                REQUIRE(f);
+                size_t len = 0;
+                while (f.read() >= 0) {
+                    ++len;
+                }
+                REQUIRE(len == content.length());
+            }
+        }
+        REQUIRE(SPIFFS.info(info));
+    };
+
+    printf("rereading %d files of %d bytes %d times, byte by byte:\n", files, (int) content.length(), rounds);
+    FSInfo small, large, ahead;
+    reread(0, 0, small);
+    size_t smallReads = SpiffsMock::readCount();
+    printf("  %2zu pages:               %6zu flash reads, %7u hits %6u misses %6u evictions\n",
+           small.cachePages, smallReads, small.cacheHits, small.cacheMisses, small.cacheEvictions);
+    reread(32, 0, large);
+    size_t largeReads = SpiffsMock::readCount();
+    printf("  %2zu pages:               %6zu flash reads, %7u hits %6u misses %6u evictions\n",
+           large.cachePages, largeReads, large.cacheHits, large.cacheMisses, large.cacheEvictions);
+    reread(32, 256, ahead);
+    size_t aheadReads = SpiffsMock::readCount();
+    printf("  %2zu pages, 256 read-ahead: %6zu flash reads, %7u hits %6u misses %6u evictions\n",
+           ahead.cachePages, aheadReads, ahead.cacheHits, ahead.cacheMisses, ahead.cacheEvictions);
+    CHECK(largeReads < smallReads);
+    CHECK(large.cacheEvictions < small.cacheEvictions);
+    CHECK(aheadReads <= largeReads);
+    CHECK(ahead.cacheHits < large.cacheHits / 10);
+}
+
+TEST_CASE("Background GC keeps writes out of inline GC", "[fs][gc][benchmark]")
+{
+    struct Latency {
+        uint32_t maxErases;
+        uint32_t maxFlashOps;
+        uint32_t stalledWrites;
+        uint32_t totalErases;
+    };
+    // a data logger appending records to a few rotating files
+    auto logRecords = [](bool backgroundGC, Latency& latency) {
+        SPIFFS_MOCK_DECLARE(256, 8, 256);
+        FSConfig config;
+        config.backgroundGC = backgroundGC;
+        REQUIRE(SPIFFS.begin(config));
+        memset(&latency, 0, sizeof(latency));
+        String record(' ', 60);
+        record += "\n";
+        for (int i = 0; i < 4000; ++i) {
+            const char* mode = (i % 150 == 0) ? "w" : "a";
+            SPIFFSHalStats before, after;
+            spiffs_hal_get_stats(&before);
+            File f = SPIFFS.open((String("/log") + (i / 150 % 4)).c_str(), mode);
+            REQUIRE(f);
+            REQUIRE(f.print(record) == record.length());
+            f.close();
+            spiffs_hal_get_stats(&after);
+            uint32_t erases = after.erases - before.erases;
+            uint32_t flashOps = after.flashReads - before.flashReads + after.flashWrites - before.flashWrites;
+            latency.maxErases = std::max(latency.maxErases, erases);
+            latency.maxFlashOps = std::max(latency.maxFlashOps, flashOps);
+            latency.stalledWrites += erases ? 1 : 0;
+            // what loop() returning gives the scheduled functions
+            run_scheduled_functions();
+        }
+        SPIFFSHalStats stats;
+        spiffs_hal_get_stats(&stats);
+        latency.totalErases = stats.erases;
+        REQUIRE(SPIFFS.exists("/log3"));
+    };
+
+    Latency inlineGC, backgroundGC;
+    SpiffsMock::resetStats();
+    logRecords(false, inlineGC);
+    SpiffsMock::resetStats();
+    logRecords(true, backgroundGC);
+
+    // a 4k sector erase takes 30-50ms on typical ESP8266 modules
+    printf("4000 appends of 61 bytes to rotating logs, worst case per write:\n");
+    printf("  inline GC:     %u erases %5u flash ops, %4u writes erased, %4u erases in total\n",
+           inlineGC.maxErases, inlineGC.maxFlashOps, inlineGC.stalledWrites, inlineGC.totalErases);
+    printf("  background GC: %u erases %5u flash ops, %4u writes erased, %4u erases in total\n",
+           backgroundGC.maxErases, backgroundGC.maxFlashOps, backgroundGC.stalledWrites, backgroundGC.totalErases);
+    CHECK(inlineGC.maxErases > 0);
+    CHECK(backgroundGC.maxErases == 0);
+    // no more wear than collecting inline
+    CHECK(backgroundGC.totalErases < inlineGC.totalErases + inlineGC.totalErases / 10);
+}
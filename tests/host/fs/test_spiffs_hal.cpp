@@ -0,0 +1,153 @@
+/*
+ test_spiffs_hal.cpp - SPIFFS flash access tests
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+#include <catch.hpp>
+#include <string.h>
+#include <FS.h>
+#include "../common/spiffs_mock.h"
+#include <spiffs/spiffs.h>
+#include <spiffs_hal.h>
+
+static void fillPattern(SpiffsMock& mock)
+{
+    for (size_t i = 0; i < mock.size(); ++i) {
+        mock.data()[i] = (uint8_t) (i * 7 + (i >> 8));
+    }
+}
+
+TEST_CASE("HAL reads are byte exact at any alignment", "[fs][spiffs_hal]")
+{
+    SPIFFS_MOCK_DECLARE(64, 8, 256);
+    fillPattern(spiffs_mock);
+    // a sector boundary is in the middle of the range
+    const uint32_t base = 4096 - 300;
+    uint8_t buf[600 + 8];
+    for (uint32_t size = 1; size <= 600; size += (size < 80) ? 1 : 37) {
+        for (uint32_t addrOfs = 0; addrOfs < 4; ++addrOfs) {
+            for (uint32_t dstOfs = 0; dstOfs < 4; ++dstOfs) {
+                for (uint32_t shift = 0; shift < 300; shift += 61) {
+                    uint32_t addr = base + shift + addrOfs;
+                    memset(buf, 0xaa, sizeof(buf));
+                    REQUIRE(spiffs_hal_read(addr, size, buf + dstOfs) == SPIFFS_OK);
+                    REQUIRE(memcmp(buf + dstOfs, spiffs_mock.data() + addr, size) == 0);
+                    // nothing around the destination is touched
+                    for (uint32_t i = 0; i < dstOfs; ++i) {
+                        REQUIRE(buf[i] == 0xaa);
+                    }
+                    REQUIRE(buf[dstOfs + size] == 0xaa);
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("HAL writes and erases invalidate the line buffer", "[fs][spiffs_hal]")
+{
+    SPIFFS_MOCK_DECLARE(64, 8, 256);
+    uint8_t small[16];
+    REQUIRE(spiffs_hal_read(8192 + 10, 5, small) == SPIFFS_OK);
+    CHECK(memcmp(small, "\xff\xff\xff\xff\xff", 5) == 0);
+
+    uint8_t data[7] = {1, 2, 3, 4, 5, 6, 7};
+    for (uint32_t addrOfs = 0; addrOfs < 4; ++addrOfs) {
+        uint32_t addr = 8192 + 9 + addrOfs * 16;
+        REQUIRE(spiffs_hal_write(addr, sizeof(data), data + 0) == SPIFFS_OK);
+        REQUIRE(spiffs_hal_read(addr - 1, sizeof(data) + 2, small) == SPIFFS_OK);
+        CHECK(small[0] == 0xff);
+        CHECK(memcmp(small + 1, data, sizeof(data)) == 0);
+        CHECK(small[sizeof(data) + 1] == 0xff);
+    }
+
+    // a misaligned source longer than the bounce buffer
+    uint8_t big[1500 + 1];
+    for (size_t i = 0; i < sizeof(big); ++i) {
+        big[i] = (uint8_t) (i * 13);
+    }
+    REQUIRE(spiffs_hal_write(12288 + 2, 1500, big + 1) == SPIFFS_OK);
+    CHECK(memcmp(spiffs_mock.data() + 12288 + 2, big + 1, 1500) == 0);
+    CHECK(spiffs_mock.data()[12288 + 1] == 0xff);
+    CHECK(spiffs_mock.data()[12288 + 1502] == 0xff);
+
+    REQUIRE(spiffs_hal_read(8192 + 10, 5, small) == SPIFFS_OK);
+    REQUIRE(spiffs_hal_erase(8192, 4096) == SPIFFS_OK);
+    REQUIRE(spiffs_hal_read(8192 + 10, 5, small) == SPIFFS_OK);
+    CHECK(memcmp(small, "\xff\xff\xff\xff\xff", 5) == 0);
+}
+
+TEST_CASE("HAL statistics count calls and flash accesses", "[fs][spiffs_hal]")
+{
+    SPIFFS_MOCK_DECLARE(64, 8, 256);
+    SpiffsMock::resetStats();
+    uint8_t buf[256] __attribute__((aligned(4)));
+    REQUIRE(spiffs_hal_read(0, 2, buf) == SPIFFS_OK);
+    REQUIRE(spiffs_hal_read(2, 2, buf) == SPIFFS_OK);
+    REQUIRE(spiffs_hal_read(6, 8, buf) == SPIFFS_OK);
+    REQUIRE(spiffs_hal_read(256, 256, buf) == SPIFFS_OK);
+
+    SPIFFSHalStats stats;
+    spiffs_hal_get_stats(&stats);
+    CHECK(stats.reads == 4);
+    CHECK(stats.readBytes == 268);
+    CHECK(stats.lineHits == 2);
+    CHECK(stats.flashReads == 2);
+    CHECK(stats.flashReadBytes == SPIFFS_HAL_LINE_SIZE + 256);
+    CHECK(stats.readSizes[0] == 2);
+    CHECK(stats.readSizes[1] == 1);
+    CHECK(stats.readSizes[6] == 1);
+    CHECK(SpiffsMock::readCount() == 2);
+
+    spiffs_hal_reset_stats();
+    spiffs_hal_get_stats(&stats);
+    CHECK(stats.reads == 0);
+    CHECK(stats.readSizes[0] == 0);
+}
+
+TEST_CASE("Line buffer saves flash reads on mount and lookups", "[fs][spiffs_hal][benchmark]")
+{
+    SPIFFS_MOCK_DECLARE(512, 8, 256);
+    REQUIRE(SPIFFS.begin());
+    for (int i = 0; i < 60; ++i) {
+        File f = SPIFFS.open((String("/f") + i).c_str(), "w");
+        REQUIRE(f);
+        f.print(i);
+    }
+    SPIFFS.end();
+
+    SPIFFSHalStats stats;
+    auto report = [&](const char* what) {
+        spiffs_hal_get_stats(&stats);
+        printf("  %-12s %6u calls %8u bytes -> %6u flash reads %8u bytes, %6u line hits\n",
+               what, stats.reads, stats.readBytes, stats.flashReads, stats.flashReadBytes, stats.lineHits);
+        printf("  %-12s read sizes:", "");
+        for (int i = 0; i < SPIFFS_HAL_SIZE_BUCKETS; ++i) {
+            printf(" %u", stats.readSizes[i]);
+        }
+        printf("\n");
+    };
+
+    printf("flash access with 60 files:\n");
+    SpiffsMock::resetStats();
+    REQUIRE(SPIFFS.begin());
+    report("mount");
+    CHECK(stats.flashReads < stats.reads);
+    SpiffsMock::resetStats();
+    size_t found = 0;
+    for (int i = 0; i < 60; ++i) {
+        found += SPIFFS.exists((String("/f") + i).c_str());
+    }
+    found += SPIFFS.exists("/missing");
+    CHECK(found == 60);
+    report("exists()");
+}
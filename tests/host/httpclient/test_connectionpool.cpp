@@ -0,0 +1,124 @@
+/*
+ test_connectionpool.cpp - HTTPClient keep-alive connection pool tests
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+#include <catch.hpp>
+#include <Arduino.h>
+#include <ConnectionPool.h>
+
+// just enough of a client to tell connections apart
+struct FakeClient {
+    FakeClient(int id, int* stops) : id(id), stops(stops) {}
+
+    uint8_t connected() { return open; }
+    int available() { return pending; }
+    void stop()
+    {
+        if (open) {
+            open = false;
+            ++*stops;
+        }
+    }
+
+    int id;
+    int* stops;
+    bool open = true;
+    int pending = 0;
+};
+
+typedef ConnectionPool<FakeClient> Pool;
+
+static Pool::ClientPtr client(int id, int& stops)
+{
+    return Pool::ClientPtr(new FakeClient(id, &stops));
+}
+
+TEST_CASE("ConnectionPool hands connections back by host, port and TLS", "[httpclient][pool]")
+{
+    int stops = 0;
+    Pool pool(4, 1000);
+    pool.checkin("api.example.com", 443, true, client(1, stops), 0);
+    pool.checkin("api.example.com", 80, false, client(2, stops), 0);
+    pool.checkin("log.example.com", 443, true, client(3, stops), 0);
+    CHECK(pool.size() == 3);
+
+    CHECK_FALSE(pool.checkout("api.example.com", 443, false, 10));
+    CHECK_FALSE(pool.checkout("api.example.com", 8443, true, 10));
+    CHECK_FALSE(pool.checkout("other.example.com", 443, true, 10));
+
+    auto tls = pool.checkout("API.example.com", 443, true, 10);
+    REQUIRE(tls);
+    CHECK(tls->id == 1);
+    CHECK_FALSE(pool.checkout("api.example.com", 443, true, 10));
+    CHECK(pool.size() == 2);
+
+    // back in, and out again as the most recently used one
+    pool.checkin("api.example.com", 443, true, std::move(tls), 20);
+    pool.checkin("api.example.com", 443, true, client(4, stops), 30);
+    auto latest = pool.checkout("api.example.com", 443, true, 40);
+    REQUIRE(latest);
+    CHECK(latest->id == 4);
+    CHECK(stops == 0);
+
+    pool.clear();
+    CHECK(pool.size() == 0);
+    CHECK(stops == 3);
+}
+
+TEST_CASE("ConnectionPool closes idle, dropped and surplus connections", "[httpclient][pool]")
+{
+    int stops = 0;
+    Pool pool(2, 1000);
+
+    pool.checkin("a", 80, false, client(1, stops), 0);
+    pool.checkin("b", 80, false, client(2, stops), 500);
+    pool.expire(999);
+    CHECK(pool.size() == 2);
+    pool.expire(1000);
+    CHECK(pool.size() == 1);
+    CHECK(stops == 1);
+
+    // the least recently used one makes room
+    pool.checkin("c", 80, false, client(3, stops), 600);
+    pool.checkin("d", 80, false, client(4, stops), 700);
+    CHECK(pool.size() == 2);
+    CHECK(stops == 2);
+    CHECK_FALSE(pool.checkout("b", 80, false, 800));
+    CHECK(pool.size() == 2);
+
+    // closed by the server, or with data nobody asked for
+    auto dropped = client(5, stops);
+    dropped->open = false;
+    pool.checkin("e", 80, false, std::move(dropped), 800);
+    CHECK(pool.size() == 2);
+    Pool::ClientPtr c = pool.checkout("c", 80, false, 800);
+    REQUIRE(c);
+    c->pending = 8;
+    pool.checkin("c", 80, false, std::move(c), 800);
+    CHECK_FALSE(pool.checkout("c", 80, false, 900));
+    CHECK(stops == 3);
+
+    // millis() wrapping around
+    pool.clear();
+    pool.checkin("a", 80, false, client(6, stops), 0xffffff00UL);
+    CHECK(pool.checkout("a", 80, false, 0x100));
+    pool.checkin("a", 80, false, client(7, stops), 0xffffff00UL);
+    pool.expire(0x400);
+    CHECK(pool.size() == 0);
+
+    // a pool of zero keeps nothing
+    pool.setMaxConnections(0);
+    pool.checkin("a", 80, false, client(8, stops), 0);
+    CHECK(pool.size() == 0);
+}
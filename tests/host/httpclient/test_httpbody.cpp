@@ -0,0 +1,363 @@
+/*
+ test_httpbody.cpp - HTTPClient response body pipeline tests
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+#include <catch.hpp>
+#include <string>
+#include <chrono>
+#include <vector>
+#include <Arduino.h>
+#include <StreamString.h>
+#include <HTTPBody.h>
+#include <Deflate.h>
+
+// server side of a connection: hands out the response in TCP segments,
+// with the peek buffer API switched on or off
+class ServerStub: public Client {
+public:
+    ServerStub(const std::string& data, size_t segment, bool peek)
+        : data(data)
+        , segment(segment)
+        , peekAPI(peek)
+    {
+    }
+
+    int connect(IPAddress, uint16_t) override { return 1; }
+    int connect(const char*, uint16_t) override { return 1; }
+    size_t write(uint8_t) override { return 0; }
+    size_t write(const uint8_t*, size_t) override { return 0; }
+    int available() override { return data.size() - pos; }
+    int read() override
+    {
+        return (pos < data.size()) ? (uint8_t) data[pos++] : -1;
+    }
+    int read(uint8_t* buffer, size_t size) override
+    {
+        size = std::min(size, std::min(data.size() - pos, segment - pos % segment));
+        memcpy(buffer, data.data() + pos, size);
+        pos += size;
+        return size;
+    }
+    int peek() override
+    {
+        return (pos < data.size()) ? (uint8_t) data[pos] : -1;
+    }
+    void flush() override {}
+    void stop() override { keepOpen = false; }
+    uint8_t connected() override { return keepOpen || pos < data.size(); }
+    operator bool() override { return true; }
+
+    bool hasPeekBufferAPI() const override { return peekAPI; }
+    size_t peekAvailable() override
+    {
+        return std::min((pos / segment + 1) * segment, data.size()) - pos;
+    }
+    const char* peekBuffer() override { return data.data() + pos; }
+    void peekConsume(size_t consume) override { pos += consume; }
+
+    std::string data;
+    size_t segment;
+    bool peekAPI;
+    size_t pos = 0;
+    bool keepOpen = false;
+};
+
+// a File, in short: takes blocks, optionally only up to some total
+class SinkStream: public Stream {
+public:
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buffer, size_t size) override
+    {
+        ++writes;
+        size = std::min(size, limit - data.size());
+        data.append((const char*) buffer, size);
+        return size;
+    }
+
+    std::string data;
+    size_t writes = 0;
+    size_t limit = (size_t) -1;
+};
+
+static std::string chunked(const std::string& body, size_t chunk, const std::string& trailer = "\r\n")
+{
+    std::string out;
+    char head[16];
+    for (size_t pos = 0; pos < body.size(); pos += chunk) {
+        std::string part = body.substr(pos, chunk);
+        snprintf(head, sizeof(head), "%zx\r\n", part.size());
+        out += head + part + "\r\n";
+    }
+    return out + "0\r\n" + trailer;
+}
+
+static std::string decode(ChunkedDecoder& decoder, const std::string& in, size_t split, size_t& used)
+{
+    std::string body;
+    used = 0;
+    while (used < in.size() && !decoder.done() && !decoder.failed()) {
+        size_t len = std::min(split, in.size() - used);
+        size_t framing = decoder.skipFraming(in.data() + used, len);
+        used += framing;
+        if (framing == 0) {
+            size_t n = std::min(len, decoder.bodyAvailable());
+            if (n == 0) {
+                break;
+            }
+            body.append(in, used, n);
+            decoder.consumeBody(n);
+            used += n;
+        }
+    }
+    return body;
+}
+
+TEST_CASE("ChunkedDecoder splits framing from body at any boundary", "[httpclient][body]")
+{
+    const std::string message =
+        "5;name=value\r\nhello\r\n"
+        "1A\r\nabcdefghijklmnopqrstuvwxyz\r\n"
+        "3\nxyz\n"
+        "0\r\nX-Checksum: 1234\r\n\r\n"
+        "HTTP/1.1 200 OK\r\n";
+    const std::string body = "helloabcdefghijklmnopqrstuvwxyzxyz";
+    for (size_t split = 1; split < message.size(); ++split) {
+        INFO("split " << split);
+        ChunkedDecoder decoder;
+        size_t used;
+        CHECK(decode(decoder, message, split, used) == body);
+        CHECK(decoder.done());
+        // the next response stays where it is
+        CHECK(message.substr(used) == "HTTP/1.1 200 OK\r\n");
+    }
+
+    ChunkedDecoder empty;
+    size_t used;
+    CHECK(decode(empty, "0\r\n\r\n", 64, used) == "");
+    CHECK(empty.done());
+    CHECK(used == 5);
+}
+
+TEST_CASE("ChunkedDecoder rejects broken framing", "[httpclient][body]")
+{
+    const char* broken[] = {
+        "\r\n",
+        "zz\r\n",
+        "5\r\nhelloX\r\n",
+        "5\rhello\r\n",
+        "100000000\r\n",
+        "0\r\n\rX",
+    };
+    for (const char* message : broken) {
+        INFO(message);
+        ChunkedDecoder decoder;
+        size_t used;
+        decode(decoder, message, 64, used);
+        CHECK(decoder.failed());
+        CHECK_FALSE(decoder.done());
+        CHECK(decoder.skipFraming("0\r\n\r\n", 5) == 0);
+    }
+}
+
+struct Response {
+    int code;
+    bool keepAlive;
+    std::string body;
+};
+
+// reads back to back responses the way HTTPClient::handleQueue does
+static std::vector<Response> parseAll(const std::string& in, const std::vector<bool>& head, size_t split)
+{
+    std::vector<Response> responses;
+    HTTPResponseParser parser;
+    StreamString body;
+    size_t used = 0;
+    while (responses.size() < head.size()) {
+        parser.reset(head[responses.size()]);
+        body.remove(0);
+        while (!parser.done() && !parser.failed() && used < in.size()) {
+            used += parser.feed(in.data() + used, std::min(split, in.size() - used), &body);
+        }
+        if (used == in.size()) {
+            parser.close();
+        }
+        if (!parser.done()) {
+            responses.push_back({parser.error(), false, ""});
+            break;
+        }
+        responses.push_back({parser.code(), parser.keepAlive(), body.c_str()});
+    }
+    return responses;
+}
+
+TEST_CASE("HTTPResponseParser reads pipelined responses in order", "[httpclient][body]")
+{
+    const std::string responses =
+        "HTTP/1.1 100 Continue\r\n\r\n"
+        "HTTP/1.1 200 OK\r\nContent-Length: 5\r\nX-Long: " + std::string(300, 'x') + "\r\n\r\nhello"
+        "HTTP/1.1 200 OK\r\ntransfer-encoding: Chunked\r\n\r\n3\r\nabc\r\n0\r\n\r\n"
+        "HTTP/1.1 200 OK\r\nContent-Length: 1000\r\n\r\n"
+        "HTTP/1.1 204 No Content\r\n\r\n"
+        "HTTP/1.1 304 Not Modified\r\nETag: \"x\"\r\n\r\n"
+        "HTTP/1.0 200 OK\r\nConnection: Keep-Alive\r\nContent-Length: 2\r\n\r\nok"
+        "HTTP/1.1 404 Not Found\nConnection: close\nContent-Length: 0\n\n"
+        "HTTP/1.0 200 OK\r\n\r\nuntil close";
+    const std::vector<bool> head = { false, false, true, false, false, false, false, false };
+    for (size_t split = 1; split <= responses.size(); split += (split < 40) ? 1 : 97) {
+        INFO("split " << split);
+        auto parsed = parseAll(responses, head, split);
+        REQUIRE(parsed.size() == 8);
+        CHECK(parsed[0].code == 200);
+        CHECK(parsed[0].body == "hello");
+        CHECK(parsed[1].body == "abc");
+        CHECK(parsed[2].body == "");
+        CHECK(parsed[3].code == 204);
+        CHECK(parsed[4].code == 304);
+        CHECK(parsed[5].body == "ok");
+        CHECK(parsed[6].code == 404);
+        CHECK(parsed[7].body == "until close");
+        for (size_t i = 0; i < 6; ++i) {
+            CHECK(parsed[i].keepAlive);
+        }
+        CHECK(parsed[5].keepAlive);
+        CHECK_FALSE(parsed[6].keepAlive);
+        CHECK_FALSE(parsed[7].keepAlive);
+    }
+}
+
+TEST_CASE("HTTPResponseParser reports broken responses", "[httpclient][body]")
+{
+    CHECK(parseAll("SSH-2.0-OpenSSH\r\n", {false}, 64)[0].code == HTTPC_ERROR_NO_HTTP_SERVER);
+    CHECK(parseAll("HTTP/1.1 200 OK\r\nTransfer-Encoding: gzip\r\n\r\n", {false}, 64)[0].code == HTTPC_ERROR_ENCODING);
+    CHECK(parseAll("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\nxyz\r\n", {false}, 64)[0].code == HTTPC_ERROR_ENCODING);
+    CHECK(parseAll("HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\nshort", {false}, 64)[0].code == HTTPC_ERROR_CONNECTION_LOST);
+    CHECK(parseAll("HTTP/1.1 200 OK\r\nContent-Le", {false}, 64)[0].code == HTTPC_ERROR_CONNECTION_LOST);
+}
+
+TEST_CASE("writeHTTPBody copies identity and chunked bodies", "[httpclient][body]")
+{
+    std::string body;
+    for (int i = 0; i < 5000; ++i) {
+        body += (char) ('a' + i % 26);
+    }
+    const size_t segments[] = { 1, 7, 536, 1460 };
+    for (size_t segment : segments) {
+        for (int peek = 0; peek < 2; ++peek) {
+            INFO("segment " << segment << " peek " << peek);
+
+            ServerStub sized(body + "next", segment, peek);
+            SinkStream file;
+            CHECK(writeHTTPBody(sized, &file, body.size(), HTTPC_TE_IDENTITY, 100) == (int) body.size());
+            CHECK(file.data == body);
+            CHECK(sized.pos == body.size());
+
+            ServerStub unsized(body, segment, peek);
+            SinkStream untilClose;
+            CHECK(writeHTTPBody(unsized, &untilClose, -1, HTTPC_TE_IDENTITY, 100) == (int) body.size());
+            CHECK(untilClose.data == body);
+
+            ServerStub chunks(chunked(body, 1000, "X-Trailer: 1\r\n\r\n") + "next", segment, peek);
+            chunks.keepOpen = true;
+            SinkStream decoded;
+            CHECK(writeHTTPBody(chunks, &decoded, -1, HTTPC_TE_CHUNKED, 100) == (int) body.size());
+            CHECK(decoded.data == body);
+            CHECK(chunks.data.substr(chunks.pos) == "next");
+        }
+    }
+
+    ServerStub direct(body, 1460, true);
+    SinkStream file;
+    writeHTTPBody(direct, &file, body.size(), HTTPC_TE_IDENTITY, 100);
+    // one write per received segment
+    CHECK(file.writes == 4);
+}
+
+TEST_CASE("writeHTTPBody decodes a compressed body through InflatePrint", "[httpclient][body]")
+{
+    std::string body;
+    for (int i = 0; i < 300; ++i) {
+        body += "{\"id\":" + std::to_string(i) + ",\"value\":" + std::to_string(i * 37 % 1000) + "},\n";
+    }
+    SinkStream compressed;
+    DeflatePrint gzip(compressed);
+    gzip.write((const uint8_t*) body.data(), body.size());
+    REQUIRE(gzip.finish());
+    REQUIRE(compressed.data.size() < body.size() / 3);
+
+    for (int peek = 0; peek < 2; ++peek) {
+        INFO("peek " << peek);
+        ServerStub chunks(chunked(compressed.data, 500), 536, peek);
+        SinkStream file;
+        InflatePrint inflate(file);
+        CHECK(writeHTTPBody(chunks, &inflate, -1, HTTPC_TE_CHUNKED, 100) == (int) compressed.data.size());
+        CHECK(inflate.done());
+        CHECK(file.data == body);
+    }
+}
+
+TEST_CASE("writeHTTPBody reports errors", "[httpclient][body]")
+{
+    const std::string body(3000, 'x');
+    for (int peek = 0; peek < 2; ++peek) {
+        INFO("peek " << peek);
+
+        ServerStub truncated(chunked(body, 1000).substr(0, 1500), 1460, peek);
+        SinkStream out;
+        CHECK(writeHTTPBody(truncated, &out, -1, HTTPC_TE_CHUNKED, 100) == HTTPC_ERROR_CONNECTION_LOST);
+
+        ServerStub garbage("5\r\nhello\r\nnot a chunk\r\n", 1460, peek);
+        CHECK(writeHTTPBody(garbage, &out, -1, HTTPC_TE_CHUNKED, 100) == HTTPC_ERROR_ENCODING);
+
+        ServerStub shortBody(body, 1460, peek);
+        CHECK(writeHTTPBody(shortBody, &out, 4000, HTTPC_TE_IDENTITY, 100) == HTTPC_ERROR_STREAM_WRITE);
+
+        ServerStub stalled(body, 1460, peek);
+        stalled.keepOpen = true;
+        CHECK(writeHTTPBody(stalled, &out, 4000, HTTPC_TE_IDENTITY, 5) == HTTPC_ERROR_READ_TIMEOUT);
+
+        ServerStub full(body, 1460, peek);
+        SinkStream disk;
+        disk.limit = 2000;
+        CHECK(writeHTTPBody(full, &disk, body.size(), HTTPC_TE_IDENTITY, 100) == HTTPC_ERROR_STREAM_WRITE);
+        CHECK(disk.data.size() == 2000);
+    }
+}
+
+TEST_CASE("writeHTTPBody download speed", "[httpclient][body][benchmark]")
+{
+    std::string body(1 << 20, 'f');
+    for (size_t i = 0; i < body.size(); i += 97) {
+        body[i] = (char) i;
+    }
+    printf("HTTPClient writeToStream, 1 MB in 1460 byte segments:\n");
+    const char* names[] = { "copy through buffer", "peek buffer" };
+    for (int chunk = 0; chunk < 2; ++chunk) {
+        for (int peek = 0; peek < 2; ++peek) {
+            ServerStub server(chunk ? chunked(body, 4096) : body, 1460, peek);
+            SinkStream file;
+            file.data.reserve(body.size());
+            auto start = std::chrono::steady_clock::now();
+            int written = writeHTTPBody(server, &file, chunk ? -1 : body.size(),
+                                        chunk ? HTTPC_TE_CHUNKED : HTTPC_TE_IDENTITY, 100);
+            double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+            CHECK(written == (int) body.size());
+            CHECK(file.data == body);
+            printf("  %-8s %-20s %8.0f us %7.1f MB/s %5zu writes\n", chunk ? "chunked" : "identity",
+                   names[peek], us, body.size() / us, file.writes);
+        }
+    }
+}
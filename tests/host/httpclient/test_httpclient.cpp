@@ -0,0 +1,252 @@
+/*
+ test_httpclient.cpp - host side HTTPClient tests, against a scripted server
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+#include <catch.hpp>
+#include <string>
+#include <vector>
+#include <Arduino.h>
+#include "../common/lwip_mock.h"
+#include <ESP8266HTTPClient.h>
+
+// The server end of every connection HTTPClient opens, played through the
+// lwIP mock. Each complete request is passed to the handler, which answers
+// it or drops the connection. Goes before the clients, so that it outlives
+// them and the pooled connections.
+class Server {
+public:
+    typedef std::function<void(Server& server, tcp_pcb* pcb, const std::string& request)> Handler;
+
+    Server(Handler handler) : _handler(handler)
+    {
+        tcp_mock_on_connect([this](tcp_pcb* pcb) {
+            pcb->auto_ack = true;
+            _parsed.push_back(0);
+            pcbs.push_back(pcb);
+            size_t index = pcbs.size() - 1;
+            pcb->on_output = [this, index](tcp_pcb* pcb) { _output(index, pcb); };
+        });
+    }
+
+    ~Server()
+    {
+        HTTPClient::connectionPool().clear();
+        tcp_mock_reset();
+    }
+
+    void reply(tcp_pcb* pcb, const std::string& response)
+    {
+        size_t len = response.size();
+        tcp_mock_deliver(pcb, pbuf_mock_chain(response.data(), &len, 1));
+    }
+
+    void close(tcp_pcb* pcb)
+    {
+        tcp_mock_deliver(pcb, nullptr);
+    }
+
+    // connections in the order they were opened
+    std::vector<tcp_pcb*> pcbs;
+    // the first line of every request, the connection's index prepended
+    std::vector<std::string> requests;
+
+protected:
+    void _output(size_t index, tcp_pcb* pcb)
+    {
+        for (;;) {
+            const std::string& data = pcb->tx_data;
+            size_t start = _parsed[index];
+            size_t end = data.find("\r\n\r\n", start);
+            if (end == std::string::npos) {
+                return;
+            }
+            end += 4;
+            std::string head = data.substr(start, end - start);
+            size_t length = 0;
+            size_t pos = head.find("Content-Length: ");
+            if (pos != std::string::npos) {
+                length = atoi(head.c_str() + pos + 16);
+            }
+            if (data.size() < end + length) {
+                return;
+            }
+            _parsed[index] = end + length;
+            requests.push_back(std::to_string(index) + " " + head.substr(0, head.find("\r\n")));
+            _handler(*this, pcb, data.substr(start, end + length - start));
+            if (pcb->state == CLOSED) {
+                return;
+            }
+        }
+    }
+
+    Handler _handler;
+    std::vector<size_t> _parsed;
+};
+
+static const char* const okResponse = "HTTP/1.1 200 OK\r\nContent-Length: 2\r\nConnection: keep-alive\r\n\r\nok";
+
+// Parks one connection to example.com in the pool
+static void warmUp(Server& server)
+{
+    HTTPClient http;
+    http.setReuse(true);
+    REQUIRE(http.begin("http://example.com/warm"));
+    REQUIRE(http.GET() == 200);
+    REQUIRE(http.getString() == "ok");
+    http.end();
+    REQUIRE(HTTPClient::connectionPool().size() == 1);
+    REQUIRE(server.pcbs.size() == 1);
+}
+
+TEST_CASE("HTTPClient repeats only safe requests a pooled connection dropped", "[httpclient]")
+{
+    // the first connection goes away once it is used again, as if the
+    // server had timed it out just before
+    Server server([](Server& server, tcp_pcb* pcb, const std::string& request) {
+        (void) request;
+        if (pcb == server.pcbs[0] && server.requests.size() > 1) {
+            server.close(pcb);
+        } else {
+            server.reply(pcb, okResponse);
+        }
+    });
+    warmUp(server);
+
+    HTTPClient http;
+    http.setReuse(true);
+    REQUIRE(http.begin("http://example.com/data"));
+
+    SECTION("GET goes out again on a new connection") {
+        CHECK(http.GET() == 200);
+        CHECK(http.getString() == "ok");
+        CHECK(server.pcbs.size() == 2);
+        CHECK(server.requests == std::vector<std::string>({
+            "0 GET /warm HTTP/1.1", "0 GET /data HTTP/1.1", "1 GET /data HTTP/1.1"}));
+    }
+    SECTION("POST may have been acted on, it is not sent twice") {
+        int code = http.POST("x");
+        CHECK(code < 0);
+        CHECK(code != HTTPC_ERROR_CONNECTION_REFUSED);
+        CHECK(server.pcbs.size() == 1);
+        CHECK(server.requests == std::vector<std::string>({
+            "0 GET /warm HTTP/1.1", "0 POST /data HTTP/1.1"}));
+    }
+    SECTION("PUT and PATCH are not sent twice either") {
+        CHECK(http.PUT("x") < 0);
+        CHECK(server.pcbs.size() == 1);
+    }
+    http.end();
+}
+
+TEST_CASE("HTTPClient repeats any request that never left", "[httpclient]")
+{
+    Server server([](Server& server, tcp_pcb* pcb, const std::string& request) {
+        (void) request;
+        server.reply(pcb, okResponse);
+    });
+    warmUp(server);
+    // reset while idle, noticed only on the first write
+    server.pcbs[0]->reset = true;
+
+    HTTPClient http;
+    http.setReuse(true);
+    REQUIRE(http.begin("http://example.com/data"));
+    CHECK(http.POST("x") == 200);
+    CHECK(http.getString() == "ok");
+    CHECK(server.pcbs.size() == 2);
+    CHECK(server.requests == std::vector<std::string>({
+        "0 GET /warm HTTP/1.1", "1 POST /data HTTP/1.1"}));
+    CHECK(server.pcbs[1]->tx_data.substr(server.pcbs[1]->tx_data.size() - 1) == "x");
+    http.end();
+}
+
+static std::string response(const std::string& body)
+{
+    return "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+}
+
+// the uri of a request
+static std::string uri(const std::string& request)
+{
+    size_t start = request.find(' ') + 1;
+    return request.substr(start, request.find(' ', start) - start);
+}
+
+// Queues GETs, or HEADs for uris starting with "/head", and runs the queue
+// dry. Returns the responses in the order they were handed out.
+static std::vector<std::string> runQueue(HTTPClient& http, const std::vector<std::string>& uris)
+{
+    std::vector<std::string> responses;
+    for (const std::string& u : uris) {
+        bool head = u.compare(0, 5, "/head") == 0;
+        REQUIRE(http.queueRequest(head ? "HEAD" : "GET", u.c_str(), [&responses, u](int code, const String& payload) {
+            responses.push_back(u + " " + std::to_string(code) + " " + payload.c_str());
+        }));
+    }
+    for (int i = 0; i < 10 && http.handleQueue() > 0; ++i) {
+    }
+    CHECK(http.handleQueue() == 0);
+    return responses;
+}
+
+TEST_CASE("HTTPClient sends the requests a closed pipeline left unanswered again", "[httpclient][pipeline]")
+{
+    // the first connection answers /1, sits on /2 and closes on /3
+    Server server([](Server& server, tcp_pcb* pcb, const std::string& request) {
+        std::string u = uri(request);
+        if (pcb != server.pcbs[0] || u == "/1") {
+            server.reply(pcb, response(u));
+        } else if (u == "/3") {
+            server.close(pcb);
+        }
+    });
+    HTTPClient http;
+    REQUIRE(http.begin("http://example.com/"));
+
+    CHECK(runQueue(http, {"/1", "/2", "/3"}) == std::vector<std::string>({
+        "/1 200 /1", "/2 200 /2", "/3 200 /3"}));
+    CHECK(server.pcbs.size() == 2);
+    // the answered one is not sent again, the others in their order
+    CHECK(server.requests == std::vector<std::string>({
+        "0 GET /1 HTTP/1.1", "0 GET /2 HTTP/1.1", "0 GET /3 HTTP/1.1",
+        "1 GET /2 HTTP/1.1", "1 GET /3 HTTP/1.1"}));
+    // the connection went to the pool once the queue was empty
+    CHECK(HTTPClient::connectionPool().size() == 1);
+}
+
+TEST_CASE("HTTPClient reads no body for a HEAD inside a pipeline", "[httpclient][pipeline]")
+{
+    // all the responses arrive together, once the last request is in
+    std::string replies;
+    Server server([&replies](Server& server, tcp_pcb* pcb, const std::string& request) {
+        std::string u = uri(request);
+        if (u.compare(0, 5, "/head") == 0) {
+            // the length of the body a GET would get
+            replies += "HTTP/1.1 200 OK\r\nContent-Length: 100\r\n\r\n";
+        } else {
+            replies += response(u);
+        }
+        if (server.requests.size() == 4) {
+            server.reply(pcb, replies);
+        }
+    });
+    HTTPClient http;
+    REQUIRE(http.begin("http://example.com/"));
+
+    CHECK(runQueue(http, {"/a", "/head", "/b", "/head2"}) == std::vector<std::string>({
+        "/a 200 /a", "/head 200 ", "/b 200 /b", "/head2 200 "}));
+    CHECK(server.pcbs.size() == 1);
+    CHECK(server.requests == std::vector<std::string>({
+        "0 GET /a HTTP/1.1", "0 HEAD /head HTTP/1.1", "0 GET /b HTTP/1.1", "0 HEAD /head2 HTTP/1.1"}));
+}
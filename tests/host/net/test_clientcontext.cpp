@@ -0,0 +1,226 @@
+/*
+ test_clientcontext.cpp - host side ClientContext tests
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+#include <catch.hpp>
+#include <memory>
+#include <Arduino.h>
+#include <Stream.h>
+#include "../common/lwip_mock.h"
+#include <include/ClientContext.h>
+
+static const char payload[] = "GET / HTTP/1.1\r\nHost: esp8266\r\n\r\n";
+
+static ClientContext* receive(tcp_pcb& pcb, const size_t* segs, size_t count)
+{
+    ClientContext* ctx = new ClientContext(&pcb, nullptr, nullptr);
+    ctx->ref();
+    REQUIRE(tcp_mock_deliver(&pcb, pbuf_mock_chain(payload, segs, count)) == ERR_OK);
+    return ctx;
+}
+
+TEST_CASE("ClientContext peekBuffer exposes each pbuf segment in place", "[net][clientcontext]")
+{
+    tcp_pcb pcb;
+    const size_t segs[] = {4, 12, 17};
+    ClientContext* ctx = receive(pcb, segs, 3);
+    REQUIRE(ctx->getSize() == sizeof(payload) - 1);
+
+    std::string collected;
+    for (size_t i = 0; i < 3; ++i) {
+        REQUIRE(ctx->peekAvailable() == segs[i]);
+        const char* buf = ctx->peekBuffer();
+        REQUIRE(buf != nullptr);
+        collected.append(buf, ctx->peekAvailable());
+        ctx->peekConsume(ctx->peekAvailable());
+    }
+    CHECK(collected == payload);
+    CHECK(ctx->peekAvailable() == 0);
+    CHECK(ctx->peekBuffer() == nullptr);
+    CHECK(ctx->getSize() == 0);
+    CHECK(pbuf_mock_live() == 0);
+    ctx->unref();
+}
+
+TEST_CASE("ClientContext peekConsume handles partial and cross-segment consumption", "[net][clientcontext]")
+{
+    tcp_pcb pcb;
+    const size_t segs[] = {4, 12, 17};
+    ClientContext* ctx = receive(pcb, segs, 3);
+
+    ctx->peekConsume(2);
+    REQUIRE(ctx->peekAvailable() == 2);
+    CHECK(memcmp(ctx->peekBuffer(), "T ", 2) == 0);
+
+    // spans the rest of the first segment and part of the second
+    ctx->peekConsume(5);
+    REQUIRE(ctx->peekAvailable() == 9);
+    CHECK(memcmp(ctx->peekBuffer(), "TTP/1.1\r\n", 9) == 0);
+    CHECK(pbuf_mock_live() == 2);
+
+    // mixes with the copying API
+    char c = ctx->read();
+    CHECK(c == 'T');
+    CHECK(ctx->peekAvailable() == 8);
+
+    // over-consumption is clamped to what was received
+    ctx->peekConsume(1000);
+    CHECK(ctx->getSize() == 0);
+    CHECK(pbuf_mock_live() == 0);
+    ctx->unref();
+}
+
+TEST_CASE("ClientContext peek API sees data appended after the first segment", "[net][clientcontext]")
+{
+    tcp_pcb pcb;
+    const size_t first[] = {16};
+    ClientContext* ctx = receive(pcb, first, 1);
+    const size_t second[] = {17};
+    REQUIRE(tcp_mock_deliver(&pcb, pbuf_mock_chain(payload + 16, second, 1)) == ERR_OK);
+    CHECK(pcb.recved == sizeof(payload) - 1);
+
+    CHECK(ctx->peekAvailable() == 16);
+    ctx->peekConsume(16);
+    CHECK(ctx->peekAvailable() == 17);
+    CHECK(memcmp(ctx->peekBuffer(), payload + 16, 17) == 0);
+    ctx->unref();
+    CHECK(pbuf_mock_live() == 0);
+}
+
+// Counts bytes copied out of the stream, i.e. into a staging buffer
+class CountingStream : public Stream {
+public:
+    CountingStream(const char* data, size_t size) : _data(data), _size(size) {}
+    int available() override { return _size - _pos; }
+    int read() override { return _pos < _size ? (uint8_t) _data[_pos++] : -1; }
+    int peek() override { return _pos < _size ? (uint8_t) _data[_pos] : -1; }
+    void flush() override {}
+    size_t write(uint8_t) override { return 0; }
+    size_t readBytes(char* buffer, size_t length) override
+    {
+        size_t n = std::min(length, _size - _pos);
+        memcpy(buffer, _data + _pos, n);
+        _pos += n;
+        copied += n;
+        return n;
+    }
+    size_t copied = 0;
+protected:
+    const char* _data;
+    size_t _size;
+    size_t _pos = 0;
+};
+
+// Like a File: read() goes through a buffer, which peekBuffer() exposes
+class BufferedCountingStream : public CountingStream {
+public:
+    BufferedCountingStream(const char* data, size_t size) : CountingStream(data, size) {}
+    int peek() override
+    {
+        if (!peekAvailable() && _pos < _size) {
+            _bufLen = std::min(sizeof(_buf), _size - _pos);
+            memcpy(_buf, _data + _pos, _bufLen);
+            _bufPos = 0;
+            copied += _bufLen;
+        }
+        return peekAvailable() ? (uint8_t) _buf[_bufPos] : -1;
+    }
+    bool hasPeekBufferAPI() const override { return true; }
+    size_t peekAvailable() override { return _bufLen - _bufPos; }
+    const char* peekBuffer() override { return _buf + _bufPos; }
+    void peekConsume(size_t consume) override
+    {
+        consume = std::min(consume, peekAvailable());
+        _bufPos += consume;
+        _pos += consume;
+    }
+protected:
+    char _buf[512];
+    size_t _bufPos = 0;
+    size_t _bufLen = 0;
+};
+
+static std::string makeBody(size_t size)
+{
+    std::string body;
+    for (size_t i = 0; i < size; ++i) {
+        body += (char) ('a' + i % 26);
+    }
+    return body;
+}
+
+TEST_CASE("ClientContext bytes copied per byte sent", "[net][clientcontext][benchmark]")
+{
+    const std::string body = makeBody(16 * 1024);
+    tcp_pcb pcb;
+    pcb.auto_ack = true;
+    ClientContext* ctx = new ClientContext(&pcb, nullptr, nullptr);
+    ctx->ref();
+
+    SECTION("buffer, copied into lwIP") {
+        REQUIRE(ctx->write((const uint8_t*) body.data(), body.size()) == body.size());
+        CHECK(pcb.tx_data == body);
+        CHECK(pcb.tx_copied == body.size());
+    }
+    SECTION("buffer, sync write queued by reference") {
+        ctx->setSync(true);
+        REQUIRE(ctx->write((const uint8_t*) body.data(), body.size()) == body.size());
+        CHECK(pcb.tx_data == body);
+        CHECK(pcb.tx_copied == 0);
+        CHECK(tcp_sndbuf(&pcb) == TCP_SND_BUF);
+    }
+    SECTION("stream, staged then copied into lwIP") {
+        CountingStream stream(body.data(), body.size());
+        ctx->setSync(true);
+        REQUIRE(ctx->write(stream) == body.size());
+        CHECK(pcb.tx_data == body);
+        size_t copied = stream.copied + pcb.tx_copied;
+        CHECK(copied == 2 * body.size());
+    }
+    SECTION("stream with a peek buffer, copied into lwIP from it") {
+        BufferedCountingStream stream(body.data(), body.size());
+        REQUIRE(ctx->write(stream) == body.size());
+        CHECK(pcb.tx_data == body);
+        // filling the stream's own buffer is the read, not staging
+        CHECK(stream.copied == body.size());
+        CHECK(pcb.tx_copied == body.size());
+    }
+    ctx->unref();
+}
+
+TEST_CASE("ClientContext sync write waits for acks while the connection closes", "[net][clientcontext]")
+{
+    const std::string body = makeBody(1024);
+    tcp_pcb pcb;
+    pcb.state = CLOSE_WAIT;
+    ClientContext* ctx = new ClientContext(&pcb, nullptr, nullptr);
+    ctx->ref();
+    ctx->setSync(true);
+    ctx->setTimeout(20);
+
+    SECTION("acked, the connection stays") {
+        pcb.auto_ack = true;
+        REQUIRE(ctx->write((const uint8_t*) body.data(), body.size()) == body.size());
+        CHECK(pcb.tx_copied == 0);
+        CHECK(pcb.state == CLOSE_WAIT);
+        CHECK(ctx->state() == CLOSE_WAIT);
+    }
+    SECTION("not acked, lwIP is not left with the buffer") {
+        REQUIRE(ctx->write((const uint8_t*) body.data(), body.size()) == body.size());
+        CHECK(pcb.tx_copied == 0);
+        CHECK(pcb.state == CLOSED);
+        CHECK(ctx->state() == CLOSED);
+    }
+    ctx->unref();
+}
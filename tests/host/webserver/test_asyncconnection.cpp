@@ -0,0 +1,362 @@
+/*
+ test_asyncconnection.cpp - asynchronous web server connection tests
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+#include <catch.hpp>
+#include <string>
+#include <vector>
+#include <Arduino.h>
+#include <StreamString.h>
+#include "../common/lwip_mock.h"
+#include <include/ClientContext.h>
+#include <detail/AsyncConnection.h>
+
+// a connection as WiFiServer hands it out
+class AcceptedClient : public WiFiClient {
+public:
+    AcceptedClient(ClientContext* ctx) : WiFiClient(ctx) {}
+};
+
+static void deliver(tcp_pcb& pcb, const char* data, size_t len)
+{
+    REQUIRE(tcp_mock_deliver(&pcb, pbuf_mock_chain(data, &len, 1)) == ERR_OK);
+}
+
+static void deliver(tcp_pcb& pcb, const std::string& data)
+{
+    deliver(pcb, data.data(), data.size());
+}
+
+// the peer acknowledges everything it was sent so far
+static void ack(tcp_pcb& pcb)
+{
+    uint16_t acked = TCP_SND_BUF - pcb.snd_buf;
+    pcb.snd_buf = TCP_SND_BUF;
+    pcb.snd_queuelen = 0;
+    if (acked && pcb.sent) {
+        pcb.sent(pcb.callback_arg, &pcb, acked);
+    }
+}
+
+// without the peek buffer API, read a piece at a time
+class MemoryStream : public Stream {
+public:
+    MemoryStream(const std::string& data) : _data(&data) {}
+    int available() override { return _data->size() - _pos; }
+    int read() override { return available() ? (*_data)[_pos++] : -1; }
+    int peek() override { return available() ? (*_data)[_pos] : -1; }
+    size_t write(uint8_t) override { return 0; }
+    void flush() override {}
+
+protected:
+    const std::string* _data;
+    size_t _pos = 0;
+};
+
+TEST_CASE("AsyncConnection waits for the whole request, however it trickles in", "[webserver][async]")
+{
+    const std::string head = "POST /form HTTP/1.1\r\nHost: esp8266\r\ncontent-LENGTH:  11\r\n\r\n";
+    const std::string body = "hello=world";
+    tcp_pcb pcb;
+    {
+        AsyncConnection conn(AcceptedClient(new ClientContext(&pcb, nullptr, nullptr)));
+        for (size_t i = 0; i < head.size(); ++i) {
+            CHECK(conn.state() == AsyncConnection::READ_REQUEST);
+            deliver(pcb, head.data() + i, 1);
+        }
+        CHECK(conn.contentLength() == 11);
+        for (size_t i = 0; i < body.size(); ++i) {
+            CHECK(conn.state() == AsyncConnection::READ_REQUEST);
+            deliver(pcb, body.data() + i, 1);
+        }
+        CHECK(conn.state() == AsyncConnection::REQUEST_READY);
+        CHECK(conn.takeActivity());
+        CHECK_FALSE(conn.takeActivity());
+        // left for the request parser
+        CHECK(conn.client().available() == (int) (head.size() + body.size()));
+    }
+    CHECK(pbuf_mock_live() == 0);
+    CHECK(pcb.state == CLOSED);
+}
+
+TEST_CASE("AsyncConnection catches up on what arrived before it", "[webserver][async]")
+{
+    tcp_pcb pcb;
+    ClientContext* ctx = new ClientContext(&pcb, nullptr, nullptr);
+    const size_t segs[] = {10, 7};
+    const char request[] = "GET / HTTP/1.0\n\n";
+    REQUIRE(tcp_mock_deliver(&pcb, pbuf_mock_chain(request, segs, 2)) == ERR_OK);
+    ctx->peekConsume(2);
+    AsyncConnection conn(AcceptedClient{ctx});
+    CHECK(conn.state() == AsyncConnection::REQUEST_READY);
+    CHECK(conn.contentLength() == 0);
+}
+
+TEST_CASE("AsyncConnection does not wait forever on large requests", "[webserver][async]")
+{
+    SECTION("large body") {
+        tcp_pcb pcb;
+        AsyncConnection conn(AcceptedClient(new ClientContext(&pcb, nullptr, nullptr)));
+        deliver(pcb, "POST /upload HTTP/1.1\r\nContent-Length: 100000\r\n\r\n");
+        deliver(pcb, std::string(HTTP_ASYNC_BODY_BUFLEN - 1, 'x'));
+        CHECK(conn.state() == AsyncConnection::READ_REQUEST);
+        deliver(pcb, "x");
+        CHECK(conn.state() == AsyncConnection::REQUEST_READY);
+        CHECK(conn.contentLength() == 100000);
+    }
+    SECTION("endless headers") {
+        tcp_pcb pcb;
+        AsyncConnection conn(AcceptedClient(new ClientContext(&pcb, nullptr, nullptr)));
+        deliver(pcb, "GET / HTTP/1.1\r\nCookie: ");
+        deliver(pcb, std::string(HTTP_ASYNC_HEADER_MAX, 'c'));
+        CHECK(conn.state() == AsyncConnection::REQUEST_READY);
+    }
+    SECTION("peer gone") {
+        tcp_pcb pcb;
+        AsyncConnection conn(AcceptedClient(new ClientContext(&pcb, nullptr, nullptr)));
+        deliver(pcb, "GET / HTTP/1.1\r\n");
+        REQUIRE(tcp_mock_deliver(&pcb, nullptr) == ERR_ABRT);
+        CHECK(conn.state() == AsyncConnection::CLOSED);
+        CHECK(conn.takeActivity());
+    }
+    CHECK(pbuf_mock_live() == 0);
+}
+
+TEST_CASE("AsyncConnection queues what lwIP has no room for", "[webserver][async]")
+{
+    std::string data;
+    for (int i = 0; data.size() < 8000; ++i) {
+        data += String(i).c_str();
+        data += ',';
+    }
+    tcp_pcb pcb;
+    pcb.snd_buf = 100;
+    AsyncConnection conn(AcceptedClient(new ClientContext(&pcb, nullptr, nullptr)));
+    CHECK(conn.write("early", 5) == 0);
+    deliver(pcb, "GET / HTTP/1.1\r\n\r\n");
+    conn.beginResponse();
+    REQUIRE(conn.state() == AsyncConnection::SEND_RESPONSE);
+
+    size_t accepted = conn.write(data.data(), 1000);
+    CHECK(accepted == 1000);
+    CHECK(pcb.tx_data.size() == 100);
+    // the queue grows past HTTP_ASYNC_TX_BUFLEN
+    accepted += conn.write(data.data() + accepted, 3000);
+    CHECK(accepted == 4000);
+    CHECK_FALSE(conn.flush());
+
+    SECTION("a stream follows the queue") {
+        StreamString rest;
+        rest.concat(data.c_str() + accepted);
+        CHECK(conn.stream(rest, rest.length()) == rest.length());
+        // nothing overtakes the stream
+        CHECK(conn.write("x", 1) == 0);
+        int rounds = 0;
+        while (!conn.flush()) {
+            ack(pcb);
+            ++rounds;
+        }
+        CHECK(rounds == 4);
+        CHECK(pcb.tx_data == data);
+        CHECK_FALSE(conn.sent());
+        ack(pcb);
+        CHECK(conn.sent());
+    }
+    SECTION("a stream without the peek buffer API") {
+        std::string tail(data, accepted);
+        MemoryStream rest(tail);
+        conn.stream(rest, tail.size() - 7);
+        while (!conn.flush()) {
+            ack(pcb);
+        }
+        CHECK(pcb.tx_data == data.substr(0, data.size() - 7));
+        CHECK(conn.write("x", 1) == 1);
+    }
+    SECTION("but not past HTTP_ASYNC_TX_MAX") {
+        std::string more(HTTP_ASYNC_TX_MAX, 'x');
+        CHECK(conn.write(more.data(), more.size()) == HTTP_ASYNC_TX_MAX - 3900);
+        CHECK(conn.write("x", 1) == 0);
+        // until the peer takes some
+        ack(pcb);
+        conn.flush();
+        CHECK(conn.write("x", 1) == 1);
+    }
+    SECTION("the peer drops out") {
+        REQUIRE(tcp_mock_deliver(&pcb, nullptr) == ERR_ABRT);
+        CHECK_FALSE(conn.flush());
+        CHECK(conn.write("x", 1) == 0);
+    }
+}
+
+// Serves "/big" with a 6000 byte stream and anything else with "ok"
+struct TestServer {
+    TestServer()
+    {
+        for (int i = 0; big.size() < 6000; ++i) {
+            big += String(i, HEX).c_str();
+            big += ' ';
+        }
+        big.resize(6000);
+    }
+
+    static void handle(void* arg, AsyncConnection& conn)
+    {
+        TestServer& server = *reinterpret_cast<TestServer*>(arg);
+        WiFiClient& client = conn.client();
+        std::string request(client.available(), 0);
+        client.read((uint8_t*) &request[0], request.size());
+        server.requests.push_back(request);
+        if (request.compare(0, 9, "GET /big ") == 0) {
+            const std::string head = server.head(server.big.size());
+            conn.write(head.data(), head.size());
+            StreamString body;
+            body.concat(server.big.c_str());
+            conn.stream(body, body.length());
+        } else {
+            std::string response = server.response("ok");
+            conn.write(response.data(), response.size());
+        }
+    }
+
+    std::string head(size_t len)
+    {
+        char head[64];
+        snprintf(head, sizeof(head), "HTTP/1.1 200 OK\r\nContent-Length: %u\r\n\r\n", (unsigned) len);
+        return head;
+    }
+
+    std::string response(const std::string& body)
+    {
+        return head(body.size()) + body;
+    }
+
+    std::string big;
+    std::vector<std::string> requests;
+};
+
+TEST_CASE("AsyncConnectionSet keeps serving while slow clients trickle", "[webserver][async][load]")
+{
+    // Two peers send their request a byte per round and two read their
+    // response slowly, acknowledging every third round; the rest are
+    // quick. Connections are accepted from a backlog as slots free up.
+    enum Kind { QUICK, SLOW_SENDER, SLOW_READER };
+    struct Peer {
+        Kind kind;
+        std::string request;
+        tcp_pcb pcb;
+        ClientContext* ctx = nullptr;
+        size_t delivered = 0;
+        int accepted = -1;
+        int completed = -1;
+    };
+    const size_t peerCount = 24;
+    std::vector<Peer> peers(peerCount);
+    for (size_t i = 0; i < peerCount; ++i) {
+        Peer& peer = peers[i];
+        peer.kind = (i == 0 || i == 1) ? SLOW_SENDER : (i == 2 || i == 9) ? SLOW_READER : QUICK;
+        peer.request = (peer.kind == SLOW_READER) ? "GET /big HTTP/1.1\r\n\r\n" :
+                       "GET /" + std::to_string(i) + " HTTP/1.1\r\nHost: esp8266\r\n\r\n";
+        peer.pcb.auto_ack = (peer.kind != SLOW_READER);
+        // lwIP accepts them all, the server takes them as it has room
+        peer.ctx = new ClientContext(&peer.pcb, nullptr, nullptr);
+    }
+
+    TestServer server;
+    AsyncConnectionSet set(4, 5000, 5000);
+    size_t backlog = 0;
+    uint32_t now = 1000;
+    int round = 0;
+    for (; round < 1000; ++round, now += 10) {
+        for (Peer& peer : peers) {
+            if (peer.delivered == peer.request.size())
+                continue;
+            size_t len = (peer.kind == SLOW_SENDER) ? 1 : peer.request.size();
+            deliver(peer.pcb, peer.request.data() + peer.delivered, len);
+            peer.delivered += len;
+        }
+        if (round % 3 == 0) {
+            for (Peer& peer : peers) {
+                if (peer.kind == SLOW_READER)
+                    ack(peer.pcb);
+            }
+        }
+        while (backlog < peerCount && !set.full()) {
+            peers[backlog].accepted = round;
+            REQUIRE(set.add(new AsyncConnection(AcceptedClient(peers[backlog++].ctx)), now));
+        }
+        set.poll(&TestServer::handle, &server, now);
+        for (size_t i = 0; i < backlog; ++i) {
+            if (peers[i].completed < 0 && peers[i].pcb.state == CLOSED)
+                peers[i].completed = round;
+        }
+        if (backlog == peerCount && !set.size())
+            break;
+    }
+    REQUIRE(round < 1000);
+
+    CHECK(server.requests.size() == peerCount);
+    for (Peer& peer : peers) {
+        INFO(peer.request);
+        CHECK(peer.pcb.tx_data == server.response(peer.kind == SLOW_READER ? server.big : "ok"));
+        if (peer.kind == QUICK) {
+            // served the moment a slot was free for it
+            CHECK(peer.completed == peer.accepted);
+        }
+    }
+    // the slow ones kept their slots throughout, the others shared the rest
+    const int slowest = std::max(peers[0].completed, peers[1].completed);
+    CHECK(slowest >= 30);
+    CHECK(peers[peerCount - 1].completed < slowest);
+    CHECK(pbuf_mock_live() == 0);
+}
+
+TEST_CASE("AsyncConnectionSet drops connections that stall", "[webserver][async]")
+{
+    TestServer server;
+    AsyncConnectionSet set(2, 5000, 3000);
+    tcp_pcb quiet, stuck, gone;
+    stuck.snd_buf = 10;
+    CHECK(set.add(new AsyncConnection(AcceptedClient(new ClientContext(&quiet, nullptr, nullptr))), 0));
+    CHECK(set.add(new AsyncConnection(AcceptedClient(new ClientContext(&stuck, nullptr, nullptr))), 0));
+    CHECK(set.full());
+    CHECK_FALSE(set.add(new AsyncConnection(AcceptedClient(new ClientContext(&gone, nullptr, nullptr))), 0));
+    CHECK(gone.state == CLOSED);
+
+    deliver(quiet, "GET / HTTP/1.1\r\n");
+    deliver(stuck, "GET / HTTP/1.1\r\n\r\n");
+    set.poll(&TestServer::handle, &server, 100);
+    CHECK(set.size() == 2);
+    CHECK(stuck.tx_data.size() == 10);
+
+    // a partial request, then silence
+    set.poll(&TestServer::handle, &server, 3100);
+    CHECK(set.size() == 2);
+    // no acknowledgements, the response cannot go anywhere
+    set.poll(&TestServer::handle, &server, 3101);
+    CHECK(set.size() == 1);
+    CHECK(stuck.state == CLOSED);
+    set.poll(&TestServer::handle, &server, 5100);
+    CHECK(set.size() == 1);
+    set.poll(&TestServer::handle, &server, 5101);
+    CHECK(set.size() == 0);
+    CHECK(quiet.state == CLOSED);
+    CHECK(server.requests.size() == 1);
+    CHECK(pbuf_mock_live() == 0);
+
+    // handed back when the server closes
+    tcp_pcb open;
+    set.add(new AsyncConnection(AcceptedClient(new ClientContext(&open, nullptr, nullptr))), 0);
+    set.clear();
+    CHECK(open.state == CLOSED);
+}
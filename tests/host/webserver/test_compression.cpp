@@ -0,0 +1,67 @@
+/*
+ test_compression.cpp - host side web server response compression tests
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+#include <catch.hpp>
+#include <string.h>
+#include <detail/Compression.h>
+
+using compression::chooseCoding;
+using compression::isCompressible;
+
+static const char* choose(const char* acceptEncoding)
+{
+    const char* coding = chooseCoding(acceptEncoding);
+    return coding ? coding : "";
+}
+
+TEST_CASE("chooseCoding prefers gzip, then deflate", "[webserver][compression]")
+{
+    CHECK(strcmp(choose("gzip, deflate"), "gzip") == 0);
+    CHECK(strcmp(choose("deflate, gzip"), "gzip") == 0);
+    CHECK(strcmp(choose("deflate"), "deflate") == 0);
+    CHECK(strcmp(choose("br,deflate"), "deflate") == 0);
+    CHECK(strcmp(choose("GZIP"), "gzip") == 0);
+    CHECK(strcmp(choose("x-gzip, identity"), "") == 0);
+    CHECK(strcmp(choose("identity"), "") == 0);
+    CHECK(strcmp(choose(""), "") == 0);
+    CHECK(chooseCoding(nullptr) == nullptr);
+}
+
+TEST_CASE("chooseCoding honours q values and the wildcard", "[webserver][compression]")
+{
+    CHECK(strcmp(choose("gzip;q=0, deflate"), "deflate") == 0);
+    CHECK(strcmp(choose("gzip; q=0.000, deflate;q=0.5"), "deflate") == 0);
+    CHECK(strcmp(choose("gzip;q=0.001"), "gzip") == 0);
+    CHECK(strcmp(choose("gzip;Q=1.0"), "gzip") == 0);
+    CHECK(strcmp(choose("gzip;q=0, deflate;q=0"), "") == 0);
+    CHECK(strcmp(choose("*"), "gzip") == 0);
+    CHECK(strcmp(choose("*;q=0"), "") == 0);
+    CHECK(strcmp(choose("gzip;q=0, *"), "deflate") == 0);
+    CHECK(strcmp(choose("*;q=0, deflate"), "deflate") == 0);
+}
+
+TEST_CASE("isCompressible takes text, JSON, JavaScript and XML", "[webserver][compression]")
+{
+    CHECK(isCompressible("text/html"));
+    CHECK(isCompressible("Text/Plain; charset=utf-8"));
+    CHECK(isCompressible("application/json"));
+    CHECK(isCompressible("application/javascript"));
+    CHECK(isCompressible("application/xml"));
+    CHECK(isCompressible("image/svg+xml"));
+    CHECK_FALSE(isCompressible("image/png"));
+    CHECK_FALSE(isCompressible("application/octet-stream"));
+    CHECK_FALSE(isCompressible("application/x-gzip"));
+    CHECK_FALSE(isCompressible(""));
+}
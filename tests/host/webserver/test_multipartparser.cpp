@@ -0,0 +1,318 @@
+/*
+ test_multipartparser.cpp - host side web server multipart parser tests
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+#include <catch.hpp>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <string.h>
+#include <Arduino.h>
+#include <StreamString.h>
+#include <detail/MultipartParser.h>
+
+static const char boundary[] = "----WebKitFormBoundary7MA4YWxkTrZu0gW";
+static const size_t windowSize = 512;
+
+struct Part {
+    std::string name;
+    std::string filename;
+    std::string type;
+    bool hasFile;
+    std::string data;
+};
+
+class Collector : public MultipartParser::Listener {
+public:
+    Collector(const uint8_t* window) : window(window), ended(0), misplaced(0) { }
+
+    bool partBegin(const char* name, const char* filename, const char* contentType) override {
+        Part part;
+        part.name = name;
+        part.hasFile = (filename != nullptr);
+        part.filename = filename ? filename : "";
+        part.type = contentType ? contentType : "";
+        parts.push_back(part);
+        return true;
+    }
+
+    bool partData(uint8_t* data, size_t len) override {
+        if (data != window) {
+            ++misplaced;
+        }
+        blocks.push_back(len);
+        parts.back().data.append(reinterpret_cast<const char*>(data), len);
+        return true;
+    }
+
+    bool partEnd() override {
+        ++ended;
+        return true;
+    }
+
+    const uint8_t* window;
+    std::vector<Part> parts;
+    std::vector<size_t> blocks;
+    size_t ended;
+    size_t misplaced;
+};
+
+static std::string fileContents(size_t len)
+{
+    // binary data with plenty of CRLFs and dashes to trip a naive scanner
+    std::string data;
+    const std::string delimiter = std::string("\r\n--") + boundary;
+    for (size_t i = 0; data.size() < len; ++i) {
+        switch (i % 5) {
+        case 0: data += "\r\n--"; break;
+        case 1: data += delimiter.substr(0, i % delimiter.size()); break;
+        case 2: data += '\0'; data += (char) (i & 0xff); break;
+        default: data += "abcdefghij\r"; break;
+        }
+    }
+    data.resize(len);
+    return data;
+}
+
+static std::string formBody(const std::string& file)
+{
+    std::string body;
+    body += "--"; body += boundary; body += "\r\n";
+    body += "Content-Disposition: form-data; name=\"title\"\r\n\r\n";
+    body += "firmware\r\nupdate";
+    body += "\r\n--"; body += boundary; body += "\r\n";
+    body += "Content-Disposition: form-data; name=\"update\"; filename=\"fw.bin\"\r\n";
+    body += "Content-Type: application/octet-stream\r\n\r\n";
+    body += file;
+    body += "\r\n--"; body += boundary; body += "--\r\n";
+    return body;
+}
+
+static bool parseInChunks(MultipartParser& parser, Collector& collector, const std::string& body, size_t chunk)
+{
+    size_t pos = 0;
+    while (pos < body.size() && !parser.done()) {
+        size_t len = std::min(std::min(chunk, parser.space()), body.size() - pos);
+        memcpy(parser.window(), body.data() + pos, len);
+        if (!parser.commit(len, collector)) {
+            return false;
+        }
+        pos += len;
+    }
+    return parser.done();
+}
+
+static void checkForm(const Collector& collector, const std::string& file)
+{
+    REQUIRE(collector.parts.size() == 2);
+    CHECK(collector.ended == 2);
+    CHECK(collector.misplaced == 0);
+    CHECK(collector.parts[0].name == "title");
+    CHECK_FALSE(collector.parts[0].hasFile);
+    CHECK(collector.parts[0].data == "firmware\r\nupdate");
+    CHECK(collector.parts[1].name == "update");
+    CHECK(collector.parts[1].hasFile);
+    CHECK(collector.parts[1].filename == "fw.bin");
+    CHECK(collector.parts[1].type == "application/octet-stream");
+    CHECK(collector.parts[1].data == file);
+}
+
+TEST_CASE("MultipartParser finds the delimiter like a naive search", "[webserver][multipart]")
+{
+    uint8_t window[windowSize];
+    MultipartParser parser(window, sizeof(window));
+    REQUIRE(parser.begin(boundary));
+
+    const std::string delimiter = std::string("\r\n--") + boundary;
+    std::string data = fileContents(3000);
+    CHECK(parser.find((const uint8_t*) data.data(), data.size()) == -1);
+    CHECK(data.find(delimiter) == std::string::npos);
+    for (size_t at : {0, 1, 17, 1500, 2999 - 41}) {
+        std::string text = data.substr(0, at) + delimiter + data.substr(at);
+        size_t expected = text.find(delimiter);
+        CHECK(parser.find((const uint8_t*) text.data(), text.size()) == (int) expected);
+    }
+}
+
+TEST_CASE("MultipartParser splits a form in any fragmentation", "[webserver][multipart]")
+{
+    std::string file = fileContents(5000);
+    std::string body = formBody(file);
+
+    for (size_t chunk : {1, 3, 64, 536, 1460, 100000}) {
+        uint8_t window[windowSize];
+        MultipartParser parser(window, sizeof(window));
+        Collector collector(window);
+        REQUIRE(parser.begin(boundary));
+        REQUIRE(parseInChunks(parser, collector, body, chunk));
+        checkForm(collector, file);
+    }
+}
+
+TEST_CASE("MultipartParser hands data over in whole windows", "[webserver][multipart]")
+{
+    std::string file = fileContents(5000);
+    std::string body = formBody(file);
+    uint8_t window[windowSize];
+    MultipartParser parser(window, sizeof(window));
+    Collector collector(window);
+    REQUIRE(parser.begin(boundary));
+    REQUIRE(parseInChunks(parser, collector, body, 1460));
+    checkForm(collector, file);
+
+    // the field is a single block; all but the last block of the file
+    // fill the window, less the tail that may hold a partial delimiter
+    size_t full = windowSize - (strlen(boundary) + 4 - 1);
+    REQUIRE(collector.blocks.size() > 3);
+    for (size_t i = 1; i + 1 < collector.blocks.size(); ++i) {
+        CHECK(collector.blocks[i] == full);
+    }
+}
+
+TEST_CASE("MultipartParser handles preamble, empty parts and unquoted parameters", "[webserver][multipart]")
+{
+    std::string body = "ignored preamble\r\n--";
+    body += boundary; body += "  \r\n";
+    body += "content-disposition: form-data; name=plain\r\n\r\n";
+    body += "\r\n--"; body += boundary; body += "\r\n";
+    body += "\r\n";
+    body += "no headers";
+    body += "\r\n--"; body += boundary; body += "--";
+
+    uint8_t window[windowSize];
+    MultipartParser parser(window, sizeof(window));
+    Collector collector(window);
+    REQUIRE(parser.begin(boundary));
+    REQUIRE(parseInChunks(parser, collector, body, 7));
+    REQUIRE(collector.parts.size() == 2);
+    CHECK(collector.parts[0].name == "plain");
+    CHECK(collector.parts[0].data == "");
+    CHECK(collector.parts[1].name == "");
+    CHECK(collector.parts[1].data == "no headers");
+}
+
+TEST_CASE("MultipartParser rejects bad boundaries and oversized headers", "[webserver][multipart]")
+{
+    uint8_t window[windowSize];
+    MultipartParser parser(window, sizeof(window));
+    Collector collector(window);
+    CHECK_FALSE(parser.begin(""));
+    CHECK_FALSE(parser.begin(std::string(MULTIPART_MAX_BOUNDARY + 1, 'x').c_str()));
+
+    REQUIRE(parser.begin(boundary));
+    std::string body = "--";
+    body += boundary; body += "\r\n";
+    body += "Content-Disposition: form-data; name=\"";
+    body += std::string(windowSize, 'n');
+    body += "\"\r\n\r\ndata";
+    CHECK_FALSE(parseInChunks(parser, collector, body, 100));
+    CHECK(parser.failed());
+
+    // an unterminated body is never done
+    REQUIRE(parser.begin(boundary));
+    std::string file = fileContents(2000);
+    std::string cut = formBody(file).substr(0, 1500);
+    CHECK_FALSE(parseInChunks(parser, collector, cut, 100));
+    CHECK_FALSE(parser.failed());
+    CHECK(parser.inPart());
+}
+
+// The previous upload loop: one Stream::read() and a few compares per byte
+static size_t legacyUpload(Stream& stream, const String& boundary, uint8_t* buf, size_t bufLen)
+{
+    size_t total = 0;
+    size_t current = 0;
+    auto put = [&](uint8_t b) {
+        if (current == bufLen) {
+            total += current;
+            current = 0;
+        }
+        buf[current++] = b;
+    };
+    for (;;) {
+        int c = stream.read();
+        if (c < 0) {
+            break;
+        }
+        if (c != '\r') {
+            put(c);
+            continue;
+        }
+        if (stream.peek() != '\n') {
+            put(c);
+            continue;
+        }
+        stream.read();
+        if (stream.peek() != '-') {
+            put('\r'); put('\n');
+            continue;
+        }
+        stream.read();
+        if (stream.peek() != '-') {
+            put('\r'); put('\n'); put('-');
+            continue;
+        }
+        stream.read();
+        uint8_t endBuf[boundary.length()];
+        stream.readBytes(endBuf, boundary.length());
+        if (memcmp(endBuf, boundary.c_str(), boundary.length()) == 0) {
+            break;
+        }
+        put('\r'); put('\n'); put('-'); put('-');
+        for (size_t i = 0; i < boundary.length(); ++i) {
+            put(endBuf[i]);
+        }
+    }
+    return total + current;
+}
+
+TEST_CASE("MultipartParser upload throughput", "[webserver][multipart][benchmark]")
+{
+    const size_t fileSize = 256 * 1024;
+    const size_t bufLen = 2048;
+    using clock = std::chrono::steady_clock;
+    typedef std::chrono::microseconds us;
+
+    // the per byte loop misreads data that resembles the delimiter
+    std::string file(fileSize, 0);
+    for (size_t i = 0; i < fileSize; ++i) {
+        file[i] = 'a' + (i * 7) % 26;
+    }
+    std::string tail = std::string("\r\n--") + boundary + "--\r\n";
+
+    StreamString stream;
+    stream.write((const uint8_t*) file.data(), file.size());
+    stream.write((const uint8_t*) tail.data(), tail.size());
+    std::vector<uint8_t> buf(bufLen);
+    auto start = clock::now();
+    size_t legacySize = legacyUpload(stream, boundary, buf.data(), bufLen);
+    auto legacyTime = clock::now() - start;
+    CHECK(legacySize == fileSize);
+
+    std::string body = formBody(file);
+    MultipartParser parser(buf.data(), bufLen);
+    Collector collector(buf.data());
+    REQUIRE(parser.begin(boundary));
+    start = clock::now();
+    REQUIRE(parseInChunks(parser, collector, body, 1460));
+    auto parserTime = clock::now() - start;
+    CHECK(collector.parts.back().data.size() == fileSize);
+
+    printf("multipart upload of %zu bytes:\n", fileSize);
+    printf("  per byte reads:  %8lld us\n",
+           (long long) std::chrono::duration_cast<us>(legacyTime).count());
+    printf("  MultipartParser: %8lld us, %zu blocks\n",
+           (long long) std::chrono::duration_cast<us>(parserTime).count(),
+           collector.blocks.size());
+}
@@ -0,0 +1,257 @@
+/*
+ test_requestparser.cpp - host side web server request parser tests
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+#include <catch.hpp>
+#include <chrono>
+#include <string.h>
+#include <strings.h>
+#include <Arduino.h>
+#include <StreamString.h>
+#include <detail/RequestParser.h>
+#include "../common/alloc_stats.h"
+
+static const char request[] =
+    "GET /api/status?led=on&name=esp%20one&flag&x=a+b HTTP/1.1\r\n"
+    "Host: esp8266.local\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9\r\n"
+    "Accept-Encoding: gzip, deflate\r\n"
+    "Cookie: session=0123456789abcdef0123456789abcdef\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n";
+
+static bool onlyHostAndCookie(void* arg, const char* name)
+{
+    (void) arg;
+    return strcasecmp(name, "Host") == 0 || strcasecmp(name, "Cookie") == 0;
+}
+
+static void checkRequest(const RequestParser& parser)
+{
+    REQUIRE(parser.done());
+    CHECK(strcmp(parser.method(), "GET") == 0);
+    CHECK(strcmp(parser.uri(), "/api/status") == 0);
+    CHECK(strcmp(parser.query(), "led=on&name=esp%20one&flag&x=a+b") == 0);
+    CHECK(parser.version() == 1);
+    REQUIRE(parser.headers() == 6);
+    CHECK(strcmp(parser.headerName(0), "Host") == 0);
+    CHECK(strcmp(parser.header("host"), "esp8266.local") == 0);
+    CHECK(strcmp(parser.header("Connection"), "keep-alive") == 0);
+    CHECK(parser.header("Content-Length") == nullptr);
+}
+
+TEST_CASE("RequestParser parses a complete request", "[webserver][parser]")
+{
+    RequestParser parser;
+    size_t len = sizeof(request) - 1;
+    REQUIRE(parser.feed(request, len) == len);
+    checkRequest(parser);
+}
+
+TEST_CASE("RequestParser parses a request fed byte by byte", "[webserver][parser]")
+{
+    RequestParser parser;
+    for (size_t i = 0; i < sizeof(request) - 1; ++i) {
+        REQUIRE(parser.feed(request + i, 1) == 1);
+    }
+    checkRequest(parser);
+}
+
+TEST_CASE("RequestParser stops at the end of the header block", "[webserver][parser]")
+{
+    RequestParser parser;
+    const char post[] = "POST /form HTTP/1.0\r\nContent-Length: 7\r\n\r\na=1&b=2";
+    size_t used = parser.feed(post, sizeof(post) - 1);
+    REQUIRE(parser.done());
+    CHECK(strcmp(post + used, "a=1&b=2") == 0);
+    CHECK(parser.version() == 0);
+    CHECK(strcmp(parser.header("content-length"), "7") == 0);
+    // anything fed after completion is left alone
+    CHECK(parser.feed("more", 4) == 0);
+}
+
+TEST_CASE("RequestParser decodes arguments in place", "[webserver][parser]")
+{
+    RequestParser parser;
+    parser.feed(request, sizeof(request) - 1);
+    REQUIRE(parser.parseQuery());
+    REQUIRE(parser.args() == 3);
+    CHECK(strcmp(parser.argName(0), "led") == 0);
+    CHECK(strcmp(parser.arg("led"), "on") == 0);
+    CHECK(strcmp(parser.arg("name"), "esp one") == 0);
+    CHECK(strcmp(parser.arg("x"), "a b") == 0);
+    CHECK(parser.arg("flag") == nullptr);
+
+    char body[] = "k%3D=v%26&bad=%zz&trail=%4";
+    REQUIRE(parser.parseArguments(body, strlen(body)));
+    REQUIRE(parser.args() == 6);
+    CHECK(strcmp(parser.arg("k="), "v&") == 0);
+    CHECK(strcmp(parser.arg("bad"), "%zz") == 0);
+    CHECK(strcmp(parser.arg("trail"), "%4") == 0);
+
+    REQUIRE(parser.addArgument("plain", "{\"a\":1}"));
+    CHECK(strcmp(parser.argValue(6), "{\"a\":1}") == 0);
+}
+
+TEST_CASE("RequestParser keeps only headers accepted by the filter", "[webserver][parser]")
+{
+    RequestParser parser;
+    parser.setHeaderFilter(onlyHostAndCookie, nullptr);
+    parser.feed(request, sizeof(request) - 1);
+    REQUIRE(parser.done());
+    REQUIRE(parser.headers() == 2);
+    CHECK(strcmp(parser.header("Cookie"), "session=0123456789abcdef0123456789abcdef") == 0);
+    CHECK(parser.header("User-Agent") == nullptr);
+}
+
+TEST_CASE("RequestParser tolerates bare LF and leading empty lines", "[webserver][parser]")
+{
+    RequestParser parser;
+    const char req[] = "\r\nDELETE /x HTTP/1.1\nA:  b \t\nbogus line\n\n";
+    parser.feed(req, sizeof(req) - 1);
+    REQUIRE(parser.done());
+    CHECK(strcmp(parser.method(), "DELETE") == 0);
+    CHECK(strcmp(parser.uri(), "/x") == 0);
+    REQUIRE(parser.headers() == 1);
+    CHECK(strcmp(parser.header("a"), "b") == 0);
+}
+
+TEST_CASE("RequestParser rejects malformed and oversized requests", "[webserver][parser]")
+{
+    RequestParser parser;
+    SECTION("no version") {
+        parser.feed("GET /\r\n\r\n", 9);
+        CHECK(parser.failed());
+        CHECK(parser.error() == RequestParser::ERROR_MALFORMED);
+    }
+    SECTION("bad version") {
+        parser.feed("GET / FTP/1.0\r\n\r\n", 17);
+        CHECK(parser.failed());
+    }
+    SECTION("uri too long") {
+        parser.feed("GET /", 5);
+        std::string uri(HTTP_REQUEST_BUFLEN, 'a');
+        parser.feed(uri.data(), uri.size());
+        CHECK(parser.failed());
+        CHECK(parser.error() == RequestParser::ERROR_URI_TOO_LONG);
+    }
+    SECTION("headers too large") {
+        parser.feed("GET / HTTP/1.1\r\nA: ", 19);
+        std::string value(HTTP_REQUEST_BUFLEN, 'a');
+        parser.feed(value.data(), value.size());
+        CHECK(parser.failed());
+        CHECK(parser.error() == RequestParser::ERROR_HEADERS_TOO_LARGE);
+    }
+    SECTION("reset allows reuse") {
+        parser.feed("GET /\r\n", 7);
+        REQUIRE(parser.failed());
+        parser.reset();
+        CHECK(parser.error() == RequestParser::ERROR_NONE);
+        parser.feed(request, sizeof(request) - 1);
+        checkRequest(parser);
+    }
+}
+
+TEST_CASE("RequestParser takes only unsigned 32 bit Content-Length values", "[webserver][parser]")
+{
+    uint32_t length = 7;
+    CHECK(RequestParser::parseContentLength("0", length));
+    CHECK(length == 0);
+    CHECK(RequestParser::parseContentLength("1234", length));
+    CHECK(length == 1234);
+    CHECK(RequestParser::parseContentLength("4294967295", length));
+    CHECK(length == 4294967295u);
+
+    const char* invalid[] = {"", "-1", "-0", "+1", " 1", "1 ", "12abc", "0x10", "4294967296", "99999999999999999999"};
+    for (const char* value : invalid) {
+        INFO(value);
+        length = 7;
+        CHECK_FALSE(RequestParser::parseContentLength(value, length));
+        CHECK(length == 7);
+    }
+}
+
+// The String based parsing this replaces, for comparison
+static void legacyParse(Stream& client)
+{
+    String req = client.readStringUntil('\r');
+    client.readStringUntil('\n');
+    int addr_start = req.indexOf(' ');
+    int addr_end = req.indexOf(' ', addr_start + 1);
+    String methodStr = req.substring(0, addr_start);
+    String url = req.substring(addr_start + 1, addr_end);
+    String versionEnd = req.substring(addr_end + 8);
+    String searchStr = "";
+    int hasSearch = url.indexOf('?');
+    if (hasSearch != -1) {
+        searchStr = url.substring(hasSearch + 1);
+        url = url.substring(0, hasSearch);
+    }
+    String headerName;
+    String headerValue;
+    while (1) {
+        req = client.readStringUntil('\r');
+        client.readStringUntil('\n');
+        if (req == "") break;
+        int headerDiv = req.indexOf(':');
+        if (headerDiv == -1) break;
+        headerName = req.substring(0, headerDiv);
+        headerValue = req.substring(headerDiv + 2);
+    }
+}
+
+TEST_CASE("RequestParser allocations and time per request", "[webserver][parser][benchmark]")
+{
+    const int rounds = 2000;
+    using clock = std::chrono::steady_clock;
+
+    StreamString stream;
+    stream.concat(request);
+    alloc_stats_reset();
+    auto start = clock::now();
+    for (int i = 0; i < rounds; ++i) {
+        stream.reset();
+        legacyParse(stream);
+    }
+    auto legacyTime = clock::now() - start;
+    AllocStats legacy = alloc_stats();
+
+    RequestParser parser;
+    alloc_stats_reset();
+    start = clock::now();
+    for (int i = 0; i < rounds; ++i) {
+        parser.reset();
+        parser.feed(request, sizeof(request) - 1);
+        parser.parseQuery();
+    }
+    auto parserTime = clock::now() - start;
+    AllocStats current = alloc_stats();
+    REQUIRE(parser.done());
+
+    typedef std::chrono::nanoseconds ns;
+    printf("request parsing, per request:\n");
+    printf("  String based: %5zu allocs %5zu reallocs %8lld ns\n",
+           legacy.allocs / rounds, legacy.reallocs / rounds,
+           (long long) std::chrono::duration_cast<ns>(legacyTime).count() / rounds);
+    printf("  RequestParser: %4zu allocs %5zu reallocs %8lld ns\n",
+           current.allocs / rounds, current.reallocs / rounds,
+           (long long) std::chrono::duration_cast<ns>(parserTime).count() / rounds);
+
+    CHECK(current.allocs == 0);
+    CHECK(current.reallocs == 0);
+    if (alloc_stats_supported()) {
+        CHECK(legacy.allocs > 10 * rounds);
+    }
+}
@@ -0,0 +1,201 @@
+/*
+ test_routetable.cpp - host side web server route table tests
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+#include <catch.hpp>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <string.h>
+#include <Arduino.h>
+#include <detail/RouteTable.h>
+#include "../common/alloc_stats.h"
+
+enum { GET = 1, POST = 2 };
+
+static void build(RouteTable& table, const std::vector<std::pair<int, const char*>>& routes)
+{
+    size_t segments = 0;
+    for (auto& r : routes) {
+        segments += RouteTable::segments(r.second);
+    }
+    REQUIRE(table.reserve(routes.size(), segments));
+    for (size_t i = 0; i < routes.size(); ++i) {
+        const char* pattern = RouteTable::routable(routes[i].second) ? routes[i].second : nullptr;
+        REQUIRE(table.add(routes[i].first, pattern, (void*) (i + 1)));
+    }
+}
+
+static size_t lookup(const RouteTable& table, int method, const char* uri, std::vector<std::string>* params = nullptr)
+{
+    RouteTable::Capture captures[ROUTE_MAX_PARAMS];
+    uint8_t count;
+    const RouteTable::Entry* entry = table.match(method, uri, strlen(uri), captures, count);
+    if (params) {
+        params->clear();
+        for (uint8_t i = 0; i < count; ++i) {
+            params->push_back(std::string(uri + captures[i].offset, captures[i].len));
+        }
+    }
+    return entry ? (size_t) entry->target : 0;
+}
+
+TEST_CASE("RouteTable matches literal routes by method", "[webserver][routes]")
+{
+    RouteTable table;
+    build(table, {
+        {GET, "/"},
+        {GET, "/status"},
+        {POST, "/status"},
+        {RouteTable::ANY_METHOD, "/api/led"},
+        {GET, "/api/"},
+    });
+    CHECK(lookup(table, GET, "/") == 1);
+    CHECK(lookup(table, GET, "/status") == 2);
+    CHECK(lookup(table, POST, "/status") == 3);
+    CHECK(lookup(table, 5, "/status") == 0);
+    CHECK(lookup(table, GET, "/api/led") == 4);
+    CHECK(lookup(table, POST, "/api/led") == 4);
+    CHECK(lookup(table, GET, "/api/") == 5);
+    CHECK(lookup(table, GET, "/api") == 0);
+    CHECK(lookup(table, GET, "/status/") == 0);
+    CHECK(lookup(table, GET, "/stat") == 0);
+    CHECK(lookup(table, GET, "//") == 0);
+    CHECK(lookup(table, GET, "") == 0);
+    CHECK(lookup(table, GET, "status") == 0);
+}
+
+TEST_CASE("RouteTable captures path parameters", "[webserver][routes]")
+{
+    RouteTable table;
+    build(table, {
+        {GET, "/users/{id}"},
+        {GET, "/users/{id}/posts/{post}"},
+        {GET, "/users/me"},
+        {GET, "/files/{}/raw"},
+    });
+    std::vector<std::string> params;
+    CHECK(lookup(table, GET, "/users/42", &params) == 1);
+    REQUIRE(params.size() == 1);
+    CHECK(params[0] == "42");
+    CHECK(lookup(table, GET, "/users/7/posts/abc", &params) == 2);
+    REQUIRE(params.size() == 2);
+    CHECK(params[0] == "7");
+    CHECK(params[1] == "abc");
+    CHECK(lookup(table, GET, "/files/a.txt/raw", &params) == 4);
+    REQUIRE(params.size() == 1);
+    CHECK(params[0] == "a.txt");
+    CHECK(lookup(table, GET, "/users/") == 0);
+    CHECK(lookup(table, GET, "/users/7/posts") == 0);
+
+    // the earliest registered route wins, like the handler list
+    CHECK(lookup(table, GET, "/users/me", &params) == 1);
+    CHECK(params.size() == 1);
+}
+
+TEST_CASE("RouteTable keeps fallbacks in registration order", "[webserver][routes]")
+{
+    RouteTable table;
+    build(table, {
+        {GET, "/a"},
+        {0, "*"},
+        {GET, "/b"},
+        {0, nullptr},
+    });
+    CHECK(table.size() == 4);
+    REQUIRE(table.fallbacks() == 2);
+    CHECK(table.fallback(0).order == 1);
+    CHECK(table.fallback(1).order == 3);
+    CHECK((size_t) table.fallback(0).target == 2);
+    RouteTable::Capture captures[ROUTE_MAX_PARAMS];
+    uint8_t count;
+    const RouteTable::Entry* entry = table.match(GET, "/b", 2, captures, count);
+    REQUIRE(entry);
+    CHECK(entry->order == 2);
+    CHECK_FALSE(table.add(GET, "/c", nullptr));
+}
+
+TEST_CASE("RouteTable matches single patterns", "[webserver][routes]")
+{
+    auto matches = [](const char* pattern, const char* uri) {
+        return RouteTable::matches(pattern, uri, strlen(uri));
+    };
+    CHECK(matches("/", "/"));
+    CHECK_FALSE(matches("/", "/a"));
+    CHECK(matches("/a/{}", "/a/b"));
+    CHECK_FALSE(matches("/a/{}", "/a/"));
+    CHECK_FALSE(matches("/a/{}", "/a/b/c"));
+    CHECK(matches("/a/{x}/c", "/a/b/c"));
+    CHECK(matches("/a/", "/a/"));
+    CHECK_FALSE(matches("/a/", "/a"));
+    CHECK_FALSE(matches("a", "a"));
+}
+
+TEST_CASE("RouteTable dispatch cost against a handler list", "[webserver][routes][benchmark]")
+{
+    const int routeCount = 64;
+    const int rounds = 2000;
+    using clock = std::chrono::steady_clock;
+    typedef std::chrono::nanoseconds ns;
+
+    std::vector<String> uris;
+    for (int i = 0; i < routeCount; ++i) {
+        uris.push_back(String("/api/v1/endpoint") + String(i));
+    }
+    std::vector<std::pair<int, const char*>> routes;
+    for (auto& uri : uris) {
+        routes.push_back(std::make_pair((int) GET, uri.c_str()));
+    }
+    RouteTable table;
+    build(table, routes);
+
+    // canHandle(HTTPMethod, String) takes the uri by value for every probe
+    auto canHandle = [](const String& route, String uri) { return uri == route; };
+    String requestUri = uris.back();
+
+    alloc_stats_reset();
+    auto start = clock::now();
+    size_t found = 0;
+    for (int r = 0; r < rounds; ++r) {
+        for (int i = 0; i < routeCount; ++i) {
+            if (canHandle(uris[i], requestUri)) {
+                found += i;
+                break;
+            }
+        }
+    }
+    auto listTime = clock::now() - start;
+    AllocStats list = alloc_stats();
+    CHECK(found == (size_t) (routeCount - 1) * rounds);
+
+    RouteTable::Capture captures[ROUTE_MAX_PARAMS];
+    uint8_t count;
+    alloc_stats_reset();
+    start = clock::now();
+    found = 0;
+    for (int r = 0; r < rounds; ++r) {
+        const RouteTable::Entry* entry = table.match(GET, requestUri.c_str(), requestUri.length(), captures, count);
+        found += entry->order;
+    }
+    auto tableTime = clock::now() - start;
+    AllocStats trie = alloc_stats();
+    CHECK(found == (size_t) (routeCount - 1) * rounds);
+
+    printf("dispatch to the last of %d routes, per request:\n", routeCount);
+    printf("  handler list: %5zu allocs %8lld ns\n", list.allocs / rounds,
+           (long long) std::chrono::duration_cast<ns>(listTime).count() / rounds);
+    printf("  RouteTable:   %5zu allocs %8lld ns\n", trie.allocs / rounds,
+           (long long) std::chrono::duration_cast<ns>(tableTime).count() / rounds);
+    CHECK(trie.allocs == 0);
+}
@@ -0,0 +1,492 @@
+/*
+ test_server.cpp - host side web server tests, requests served end to end
+ Copyright © 2016 Ivan Grokhotkov
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+*/
+
+#include <catch.hpp>
+#include <string>
+#include <Arduino.h>
+#include "../common/lwip_mock.h"
+#include "../common/spiffs_mock.h"
+#include <ESP8266WebServer.h>
+
+// Frees the mock pcbs once the server and its clients are gone, so it
+// goes before them
+struct MockNetwork {
+    ~MockNetwork() { tcp_mock_reset(); }
+};
+
+// A client of the server, played through the lwIP mock
+class Peer {
+public:
+    Peer(uint16_t port = 80) : _pcb(tcp_mock_accept(port))
+    {
+        REQUIRE(_pcb != nullptr);
+        _pcb->auto_ack = true;
+    }
+
+    void send(const std::string& data)
+    {
+        size_t len = data.size();
+        REQUIRE(tcp_mock_deliver(_pcb, pbuf_mock_chain(data.data(), &len, 1)) == ERR_OK);
+    }
+
+    void close()
+    {
+        tcp_mock_deliver(_pcb, nullptr);
+    }
+
+    // Takes what was sent only when ack() is called
+    void holdAcks()
+    {
+        _pcb->auto_ack = false;
+    }
+
+    void ack()
+    {
+        uint16_t acked = TCP_SND_BUF - _pcb->snd_buf;
+        _pcb->snd_buf = TCP_SND_BUF;
+        _pcb->snd_queuelen = 0;
+        if (acked && _pcb->sent) {
+            _pcb->sent(_pcb->callback_arg, _pcb, acked);
+        }
+    }
+
+    bool closed() const { return _pcb->state == CLOSED; }
+    const std::string& received() const { return _pcb->tx_data; }
+
+protected:
+    tcp_pcb* _pcb;
+};
+
+static int status(const std::string& response)
+{
+    if (response.compare(0, 9, "HTTP/1.1 ") != 0 && response.compare(0, 9, "HTTP/1.0 ") != 0) {
+        return 0;
+    }
+    return atoi(response.c_str() + 9);
+}
+
+// Value of a response header, "" without it
+static std::string header(const std::string& response, const std::string& name)
+{
+    size_t end = response.find("\r\n\r\n");
+    std::string line = "\r\n" + name + ": ";
+    size_t pos = response.find(line);
+    if (pos == std::string::npos || pos > end) {
+        return "";
+    }
+    pos += line.size();
+    return response.substr(pos, response.find("\r\n", pos) - pos);
+}
+
+static bool hasHeader(const std::string& response, const std::string& name)
+{
+    size_t end = response.find("\r\n\r\n");
+    size_t pos = response.find("\r\n" + name + ": ");
+    return pos != std::string::npos && pos < end;
+}
+
+static std::string body(const std::string& response)
+{
+    size_t pos = response.find("\r\n\r\n");
+    return (pos == std::string::npos) ? "" : response.substr(pos + 4);
+}
+
+TEST_CASE("ESP8266WebServer reads a request body of valid length", "[webserver][server]")
+{
+    MockNetwork network;
+    ESP8266WebServer server(80);
+    server.on("/form", HTTP_POST, [&]() {
+        server.send(200, "text/plain", server.arg("plain"));
+    });
+    server.begin();
+
+    Peer peer;
+    peer.send("POST /form HTTP/1.1\r\nHost: esp8266\r\nContent-Length: 5\r\n\r\nhello");
+    server.handleClient();
+    CHECK(status(peer.received()) == 200);
+    CHECK(header(peer.received(), "Content-Length") == "5");
+    CHECK(body(peer.received()) == "hello");
+}
+
+static std::string formField(const std::string& name, const std::string& value)
+{
+    return "--b\r\nContent-Disposition: form-data; name=\"" + name + "\"\r\n\r\n" + value + "\r\n";
+}
+
+TEST_CASE("ESP8266WebServer keeps form fields larger than the parser buffer", "[webserver][server]")
+{
+    MockNetwork network;
+    ESP8266WebServer server(80);
+    bool handled = false;
+    server.on("/form", HTTP_POST, [&]() {
+        handled = true;
+        server.send(200, "text/plain", server.arg("small") + "," + server.arg("large") + "," + server.arg("last"));
+    }, [&]() {});
+    server.begin();
+
+    const std::string large(2 * HTTP_REQUEST_BUFLEN, 'x');
+    const std::string tooLarge(HTTP_MAX_BODY_SIZE + 1, 'y');
+    struct {
+        std::string form;
+        int status;
+        std::string answer;
+    } cases[] = {
+        {formField("small", "a") + formField("large", large) + formField("last", "z"), 200, "a," + large + ",z"},
+        {formField("small", "a") + formField("large", tooLarge), 413, ""},
+    };
+    for (auto& c : cases) {
+        handled = false;
+        std::string form = c.form + "--b--\r\n";
+        Peer peer;
+        peer.send("POST /form HTTP/1.1\r\nContent-Type: multipart/form-data; boundary=b\r\n"
+                  "Content-Length: " + std::to_string(form.size()) + "\r\n\r\n" + form);
+        server.handleClient();
+        CHECK(status(peer.received()) == c.status);
+        CHECK(handled == (c.status == 200));
+        if (handled) {
+            CHECK(body(peer.received()) == c.answer);
+        }
+        peer.close();
+        server.handleClient();
+    }
+}
+
+TEST_CASE("ESP8266WebServer rejects a Content-Length it cannot hold", "[webserver][server]")
+{
+    MockNetwork network;
+    ESP8266WebServer server(80);
+    bool handled = false;
+    server.on("/form", HTTP_POST, [&]() {
+        handled = true;
+        server.send(200, "text/plain", "");
+    });
+    server.begin();
+
+    struct {
+        const char* length;
+        int status;
+    } cases[] = {
+        {"-1", 400},
+        {"-4294967295", 400},
+        {"+5", 400},
+        {"5x", 400},
+        {"0x10", 400},
+        {"4294967296", 400},
+        {"18446744073709551616", 400},
+        {"4294967295", 413},
+        {"16385", 413},
+    };
+    for (auto& c : cases) {
+        INFO("Content-Length: " << c.length);
+        Peer peer;
+        peer.send(std::string("POST /form HTTP/1.1\r\nContent-Length: ") + c.length + "\r\n\r\nhello");
+        server.handleClient();
+        CHECK(status(peer.received()) == c.status);
+        CHECK_FALSE(handled);
+        // nothing is read or kept after the answer
+        CHECK(peer.closed());
+    }
+}
+
+TEST_CASE("ESP8266WebServer answers a request it cannot parse", "[webserver][server]")
+{
+    MockNetwork network;
+    ESP8266WebServer server(80);
+    bool handled = false;
+    server.on("/", [&]() {
+        handled = true;
+        server.send(200, "text/plain", "");
+    });
+    server.begin();
+
+    struct {
+        std::string request;
+        int status;
+    } cases[] = {
+        {"GET /\r\n\r\n", 400},
+        {"GET / FTP/1.0\r\n\r\n", 400},
+        {"GET /" + std::string(HTTP_REQUEST_BUFLEN, 'a') + " HTTP/1.1\r\n\r\n", 414},
+        {"GET / HTTP/1.1\r\nHost: " + std::string(HTTP_REQUEST_BUFLEN, 'a') + "\r\n\r\n", 431},
+    };
+    for (auto& c : cases) {
+        INFO(c.request.substr(0, 40));
+        Peer peer;
+        peer.send(c.request);
+        server.handleClient();
+        CHECK(status(peer.received()) == c.status);
+        CHECK_FALSE(handled);
+        CHECK(peer.closed());
+    }
+}
+
+static std::string get(ESP8266WebServer& server, const std::string& uri, const std::string& headers = "")
+{
+    Peer peer;
+    peer.send("GET " + uri + " HTTP/1.1\r\nHost: esp8266\r\n" + headers + "\r\n");
+    server.handleClient();
+    // the server holds on to the client until it goes
+    peer.close();
+    server.handleClient();
+    return peer.received();
+}
+
+TEST_CASE("serveStatic answers a matching If-None-Match with 304", "[webserver][server][fs]")
+{
+    SPIFFS_MOCK_DECLARE(64, 8, 512);
+    REQUIRE(SPIFFS.begin());
+    SPIFFS.open("/www/a.html", "w").print("<html>a</html>");
+    SPIFFS.open("/www/b.html", "w").print("<html>b</html>");
+
+    MockNetwork network;
+    ESP8266WebServer server(80);
+    server.serveStatic("/", SPIFFS, "/www/");
+    server.begin();
+
+    std::string response = get(server, "/a.html");
+    REQUIRE(status(response) == 200);
+    CHECK(body(response) == "<html>a</html>");
+    std::string etagA = header(response, "ETag");
+    REQUIRE(etagA.size() > 2);
+    std::string etagB = header(get(server, "/b.html"), "ETag");
+    REQUIRE(etagB.size() > 2);
+    CHECK(etagA != etagB);
+
+    response = get(server, "/a.html", "If-None-Match: " + etagA + "\r\n");
+    CHECK(status(response) == 304);
+    CHECK(header(response, "ETag") == etagA);
+    CHECK(body(response) == "");
+    CHECK(status(get(server, "/a.html", "If-None-Match: \"0-00000000\"\r\n")) == 200);
+    // weak, listed or any
+    const std::string matching[] = {"W/" + etagA, "\"x,y\", " + etagB + " ,\t" + etagA, "W/\"1\",W/" + etagA, "*"};
+    for (const std::string& value : matching) {
+        INFO(value);
+        CHECK(status(get(server, "/a.html", "If-None-Match: " + value + "\r\n")) == 304);
+    }
+    const std::string other[] = {etagB + ", W/" + etagB, "\"" + etagA + "\"", "W/" + etagA.substr(0, etagA.size() - 1)};
+    for (const std::string& value : other) {
+        INFO(value);
+        CHECK(status(get(server, "/a.html", "If-None-Match: " + value + "\r\n")) == 200);
+    }
+
+    SECTION("a change to one file leaves the others cached") {
+        SPIFFS.open("/www/a.html", "a").print("<!-- -->");
+        SpiffsMock::resetStats();
+        CHECK(status(get(server, "/b.html", "If-None-Match: " + etagB + "\r\n")) == 304);
+        // neither opened nor hashed again
+        CHECK(SpiffsMock::readCount() == 0);
+
+        response = get(server, "/a.html", "If-None-Match: " + etagA + "\r\n");
+        CHECK(status(response) == 200);
+        CHECK(body(response) == "<html>a</html><!-- -->");
+        CHECK(header(response, "ETag") != etagA);
+    }
+    SECTION("removing a file is noticed") {
+        REQUIRE(SPIFFS.remove("/www/a.html"));
+        CHECK(status(get(server, "/a.html", "If-None-Match: " + etagA + "\r\n")) == 404);
+    }
+}
+
+TEST_CASE("ESP8266WebServer in async mode refuses bodies it would wait for", "[webserver][server][async]")
+{
+    MockNetwork network;
+    ESP8266WebServer server(80);
+    REQUIRE(server.setAsync(true));
+    bool handled = false;
+    size_t uploaded = 0;
+    server.on("/form", HTTP_POST, [&]() {
+        handled = true;
+        server.send(200, "text/plain", server.arg("plain") + server.arg("name") + "," + String(uploaded));
+    }, [&]() {
+        HTTPUpload& upload = server.upload();
+        if (upload.status == UPLOAD_FILE_END) {
+            uploaded = upload.totalSize;
+        }
+    });
+    server.on("/", HTTP_GET, [&]() {
+        server.send(200, "text/plain", "hello");
+    });
+    server.begin();
+
+    const std::string formHead = "POST /form HTTP/1.1\r\nContent-Type: multipart/form-data; boundary=b\r\n";
+    const std::string form = formField("name", "esp") +
+                             "--b\r\nContent-Disposition: form-data; name=\"f\"; filename=\"f.txt\"\r\n\r\n"
+                             "data\r\n--b--\r\n";
+    const std::string largeForm = formField("name", std::string(HTTP_ASYNC_BODY_BUFLEN, 'x')) + "--b--\r\n";
+    struct {
+        std::string request;
+        int status;
+    } cases[] = {
+        // longer than the async buffer
+        {"POST /form HTTP/1.1\r\nContent-Length: " + std::to_string(HTTP_ASYNC_BODY_BUFLEN + 1) +
+            "\r\n\r\n" + std::string(HTTP_ASYNC_BODY_BUFLEN, 'x'), 413},
+        {formHead + "Content-Length: " + std::to_string(largeForm.size()) + "\r\n\r\n" +
+            largeForm.substr(0, HTTP_ASYNC_BODY_BUFLEN), 413},
+        // a form that could go on forever
+        {formHead + "\r\n" + form, 411},
+    };
+    for (auto& c : cases) {
+        const std::string& request = c.request;
+        INFO(request.substr(0, 60));
+        Peer uploader;
+        Peer other;
+        uploader.send(request);
+        other.send("GET / HTTP/1.1\r\nHost: esp8266\r\n\r\n");
+
+        unsigned long start = millis();
+        server.handleClient();
+        // nobody waited for the rest of the body
+        unsigned long elapsed = millis() - start;
+        CHECK(elapsed < HTTP_MAX_POST_WAIT / 2);
+        CHECK(status(uploader.received()) == c.status);
+        CHECK_FALSE(handled);
+        CHECK(status(other.received()) == 200);
+        CHECK(body(other.received()) == "hello");
+        // dropped once the answer is out
+        CHECK(uploader.closed());
+        CHECK(other.closed());
+    }
+
+    // while a body that fits is taken, a form with a file too
+    Peer poster;
+    poster.send("POST /form HTTP/1.1\r\nContent-Length: 5\r\n\r\nhello");
+    server.handleClient();
+    CHECK(status(poster.received()) == 200);
+    CHECK(body(poster.received()) == "hello,0");
+
+    Peer uploader;
+    uploader.send(formHead + "Content-Length: " + std::to_string(form.size()) + "\r\n\r\n" + form);
+    server.handleClient();
+    CHECK(status(uploader.received()) == 200);
+    CHECK(body(uploader.received()) == "esp,4");
+}
+
+TEST_CASE("ESP8266WebServer in async mode does not wait for a slow reader", "[webserver][server][async]")
+{
+    MockNetwork network;
+    ESP8266WebServer server(80);
+    REQUIRE(server.setAsync(true));
+    // more than lwIP and the initial queue take
+    std::string big;
+    for (int i = 0; big.size() < TCP_SND_BUF + HTTP_ASYNC_TX_BUFLEN + 1000; ++i) {
+        big += std::to_string(i) + ",";
+    }
+    server.on("/big", [&]() {
+        server.send(200, "text/plain", big.c_str());
+    });
+    server.on("/", [&]() {
+        server.send(200, "text/plain", "hello");
+    });
+    server.begin();
+
+    Peer slow;
+    slow.holdAcks();
+    Peer other;
+    slow.send("GET /big HTTP/1.1\r\n\r\n");
+    other.send("GET / HTTP/1.1\r\n\r\n");
+    unsigned long start = millis();
+    server.handleClient();
+    unsigned long elapsed = millis() - start;
+    CHECK(elapsed < HTTP_MAX_SEND_WAIT / 2);
+    CHECK(body(other.received()) == "hello");
+    CHECK(slow.received().size() < big.size());
+
+    // the rest goes out as the slow one takes it
+    for (int i = 0; i < 20 && !slow.closed(); ++i) {
+        slow.ack();
+        server.handleClient();
+    }
+    CHECK(status(slow.received()) == 200);
+    CHECK(body(slow.received()) == big);
+}
+
+// Collects what an InflatePrint decodes
+class Inflated: public Print {
+public:
+    size_t write(uint8_t c) override
+    {
+        return write(&c, 1);
+    }
+    size_t write(const uint8_t* buffer, size_t size) override
+    {
+        data.append((const char*) buffer, size);
+        return size;
+    }
+    using Print::write;
+
+    std::string data;
+};
+
+TEST_CASE("ESP8266WebServer compresses a response the client accepts gzip for", "[webserver][server][deflate]")
+{
+    MockNetwork network;
+    ESP8266WebServer server(80);
+    std::string text;
+    for (int i = 0; i < 40; ++i) {
+        text += "line " + std::to_string(i) + " of a text worth compressing\n";
+    }
+    REQUIRE(text.size() > HTTP_DEFLATE_MIN_SIZE);
+    server.on("/whole", [&]() {
+        server.send(200, "text/plain", text.c_str());
+    });
+    server.on("/streamed", [&]() {
+        server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+        server.send(200, "text/plain", "");
+        for (size_t pos = 0; pos < text.size(); pos += 100) {
+            server.sendContent(String(text.substr(pos, 100).c_str()));
+        }
+    });
+    server.on("/image", [&]() {
+        server.send(200, "image/png", text.c_str());
+    });
+    server.setCompression(true);
+    server.begin();
+
+    for (const char* uri : {"/whole", "/streamed"}) {
+        INFO(uri);
+        std::string response = get(server, uri, "Accept-Encoding: gzip, deflate\r\n");
+        CHECK(status(response) == 200);
+        CHECK(header(response, "Content-Encoding") == "gzip");
+        CHECK(header(response, "Vary") == "Accept-Encoding");
+        // the end of the body is the end of the connection
+        CHECK_FALSE(hasHeader(response, "Content-Length"));
+        CHECK_FALSE(hasHeader(response, "Transfer-Encoding"));
+
+        std::string compressed = body(response);
+        CHECK(compressed.size() < text.size());
+        Inflated out;
+        InflatePrint inflate(out, DEFLATE_GZIP);
+        inflate.write((const uint8_t*) compressed.data(), compressed.size());
+        CHECK(inflate.error() == InflatePrint::NONE);
+        CHECK(inflate.done());
+        CHECK(out.data == text);
+    }
+
+    // without Accept-Encoding, or with one that is not supported, it goes
+    // out as it is, still telling caches that it depends on it
+    for (const char* headers : {"", "Accept-Encoding: br\r\n"}) {
+        INFO(headers);
+        std::string response = get(server, "/whole", headers);
+        CHECK_FALSE(hasHeader(response, "Content-Encoding"));
+        CHECK(header(response, "Vary") == "Accept-Encoding");
+        CHECK(header(response, "Content-Length") == std::to_string(text.size()));
+        CHECK(body(response) == text);
+    }
+
+    // which never is the case for types that are not compressed
+    std::string response = get(server, "/image", "Accept-Encoding: gzip\r\n");
+    CHECK(status(response) == 200);
+    CHECK_FALSE(hasHeader(response, "Content-Encoding"));
+    CHECK_FALSE(hasHeader(response, "Vary"));
+}